@@ -61,6 +61,10 @@ audit::start()
                                                             , shared_from_this()
                                                             , std::placeholders::_1
                                                             , std::placeholders::_2));
+        this->node->register_for_message(bzn_envelope::kAudit, std::bind(&audit::handle_envelope
+                                                            , shared_from_this()
+                                                            , std::placeholders::_1
+                                                            , std::placeholders::_2));
         if (this->monitor_endpoint)
         {
             LOG(info) << boost::format("Audit module running, will send stats to %1%:%2%")
@@ -227,7 +231,28 @@ audit::handle(const bzn::json_message& json, std::shared_ptr<bzn::session_base>
     audit_message message;
     message.ParseFromString(boost::beast::detail::base64_decode(json["audit-data"].asString()));
 
-    LOG(debug) << "Got audit message" << message.DebugString();
+    this->handle_audit_message(message);
+
+    session->close();
+}
+
+void
+audit::handle_envelope(const bzn_envelope& envelope, std::shared_ptr<bzn::session_base> /*session*/)
+{
+    audit_message message;
+    if (!message.ParseFromString(envelope.audit()))
+    {
+        LOG(error) << "Failed to parse audit message from " << envelope.sender();
+        return;
+    }
+
+    this->handle_audit_message(message);
+}
+
+void
+audit::handle_audit_message(const audit_message& message)
+{
+    LOG(debug) << "Got audit message" << message.ShortDebugString().substr(0, MAX_MESSAGE_SIZE);
 
     if (message.has_raft_commit())
     {
@@ -249,12 +274,18 @@ audit::handle(const bzn::json_message& json, std::shared_ptr<bzn::session_base>
     {
         this->handle_failure_detected(message.failure_detected());
     }
+    else if (message.has_pbft_commit_batch())
+    {
+        this->handle_pbft_commit_batch(message.pbft_commit_batch());
+    }
+    else if (message.has_raft_commit_batch())
+    {
+        this->handle_raft_commit_batch(message.raft_commit_batch());
+    }
     else
     {
         LOG(error) << "Got an unknown audit message? " << message.ShortDebugString();
     }
-
-    session->close();
 }
 
 void audit::handle_primary_status(const primary_status& primary_status)
@@ -379,19 +410,51 @@ audit::handle_raft_commit(const raft_commit_notification& commit)
 
     this->send_to_monitor(bzn::RAFT_COMMIT_METRIC_NAME + bzn::STATSD_COUNTER_FORMAT);
 
-    if (this->recorded_raft_commits.count(commit.log_index()) == 0)
+    this->record_raft_commit(commit.log_index(), commit.operation());
+}
+
+void
+audit::handle_raft_commit_batch(const raft_commit_batch& batch)
+{
+    std::lock_guard<std::mutex> lock(this->audit_lock);
+
+    if (this->use_pbft)
+    {
+        LOG(debug) << "audit ignoring raft commit batch because we are in pbft mode";
+        return;
+    }
+
+    if (batch.log_indexes_size() != batch.operations_size())
     {
-        LOG(info) << "audit recording that message '" << commit.operation() << "' is committed at index " << commit.log_index();
-        this->recorded_raft_commits[commit.log_index()] = commit.operation();
+        LOG(error) << "audit ignoring malformed raft commit batch from " << batch.sender_uuid();
+        return;
+    }
+
+    // one counter update for the whole batch...
+    this->send_to_monitor(bzn::RAFT_COMMIT_METRIC_NAME + ":" + std::to_string(batch.operations_size()) + "|c");
+
+    for (int i = 0; i < batch.operations_size(); ++i)
+    {
+        this->record_raft_commit(batch.log_indexes(i), batch.operations(i));
+    }
+}
+
+void
+audit::record_raft_commit(uint64_t log_index, const std::string& operation)
+{
+    if (this->recorded_raft_commits.count(log_index) == 0)
+    {
+        LOG(info) << "audit recording that message '" << operation << "' is committed at index " << log_index;
+        this->recorded_raft_commits[log_index] = operation;
         this->trim();
     }
-    else if (this->recorded_raft_commits[commit.log_index()] != commit.operation())
+    else if (this->recorded_raft_commits[log_index] != operation)
     {
         std::string err = str(boost::format(
                 "Conflicting commit detected! '%1%' is the recorded entry at index %2%, but '%3%' has been committed with the same index.")
-                              % this->recorded_raft_commits[commit.log_index()]
-                              % commit.log_index()
-                              % commit.operation());
+                              % this->recorded_raft_commits[log_index]
+                              % log_index
+                              % operation);
         this->report_error(bzn::RAFT_COMMIT_CONFLICT_METRIC_NAME, err);
     }
 }
@@ -409,19 +472,51 @@ audit::handle_pbft_commit(const pbft_commit_notification& commit)
 
     this->send_to_monitor(bzn::PBFT_COMMIT_METRIC_NAME + bzn::STATSD_COUNTER_FORMAT);
 
-    if (this->recorded_pbft_commits.count(commit.sequence_number()) == 0)
+    this->record_pbft_commit(commit.sequence_number(), commit.operation());
+}
+
+void
+audit::handle_pbft_commit_batch(const pbft_commit_batch& batch)
+{
+    std::lock_guard<std::mutex> lock(this->audit_lock);
+
+    if (!this->use_pbft)
+    {
+        LOG(debug) << "audit ignoring pbft commit batch because we are in raft mode";
+        return;
+    }
+
+    if (batch.sequence_numbers_size() != batch.operations_size())
+    {
+        LOG(error) << "audit ignoring malformed pbft commit batch from " << batch.sender_uuid();
+        return;
+    }
+
+    // one counter update for the whole batch...
+    this->send_to_monitor(bzn::PBFT_COMMIT_METRIC_NAME + ":" + std::to_string(batch.operations_size()) + "|c");
+
+    for (int i = 0; i < batch.operations_size(); ++i)
+    {
+        this->record_pbft_commit(batch.sequence_numbers(i), batch.operations(i));
+    }
+}
+
+void
+audit::record_pbft_commit(uint64_t sequence, const std::string& operation)
+{
+    if (this->recorded_pbft_commits.count(sequence) == 0)
     {
-        LOG(info) << "audit recording that message '" << commit.operation() << "' is committed at sequence " << commit.sequence_number();
-        this->recorded_pbft_commits[commit.sequence_number()] = commit.operation();
+        LOG(debug) << "audit recording that message '" << operation << "' is committed at sequence " << sequence;
+        this->recorded_pbft_commits[sequence] = operation;
         this->trim();
     }
-    else if (this->recorded_pbft_commits[commit.sequence_number()] != commit.operation())
+    else if (this->recorded_pbft_commits[sequence] != operation)
     {
         std::string err = str(boost::format(
                 "Conflicting commit detected! '%1%' is the recorded entry at sequence %2%, but '%3%' has been committed with the same sequence.")
-                              % this->recorded_pbft_commits[commit.sequence_number()]
-                              % commit.sequence_number()
-                              % commit.operation());
+                              % this->recorded_pbft_commits[sequence]
+                              % sequence
+                              % operation);
         this->report_error(bzn::PBFT_COMMIT_CONFLICT_METRIC_NAME, err);
     }
 }
@@ -41,10 +41,13 @@ namespace bzn
 
 
         void handle(const bzn::json_message& message, std::shared_ptr<bzn::session_base> session) override;
+        void handle_envelope(const bzn_envelope& envelope, std::shared_ptr<bzn::session_base> session) override;
         void handle_raft_commit(const raft_commit_notification&) override;
+        void handle_raft_commit_batch(const raft_commit_batch&) override;
         void handle_leader_status(const leader_status&) override;
 
         void handle_pbft_commit(const pbft_commit_notification&) override;
+        void handle_pbft_commit_batch(const pbft_commit_batch&) override;
         void handle_primary_status(const primary_status&) override;
 
         void handle_failure_detected(const failure_detected&) override;
@@ -67,6 +70,10 @@ namespace bzn
         void report_error(const std::string& metric_name, const std::string& error_description);
         void send_to_monitor(const std::string& stat);
 
+        void handle_audit_message(const audit_message& message);
+        void record_raft_commit(uint64_t log_index, const std::string& operation);
+        void record_pbft_commit(uint64_t sequence, const std::string& operation);
+
         void handle_leader_data(const leader_status&);
         void handle_leader_made_progress(const leader_status&);
 
@@ -55,12 +55,18 @@ namespace bzn
 
         virtual void handle(const bzn::json_message& msg, std::shared_ptr<bzn::session_base> session) = 0;
 
+        virtual void handle_envelope(const bzn_envelope& msg, std::shared_ptr<bzn::session_base> session) = 0;
+
         virtual void handle_raft_commit(const raft_commit_notification&) = 0;
 
+        virtual void handle_raft_commit_batch(const raft_commit_batch&) = 0;
+
         virtual void handle_leader_status(const leader_status&) = 0;
 
         virtual void handle_pbft_commit(const pbft_commit_notification&) = 0;
 
+        virtual void handle_pbft_commit_batch(const pbft_commit_batch&) = 0;
+
         virtual void handle_primary_status(const primary_status&) = 0;
 
         virtual void handle_failure_detected(const failure_detected&) = 0;
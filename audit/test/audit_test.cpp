@@ -190,6 +190,50 @@ TEST_F(audit_test, audit_throws_error_when_commits_conflict)
     EXPECT_EQ(this->audit->error_count(), 1u);
 }
 
+TEST_F(audit_test, audit_throws_error_when_batched_raft_commits_conflict)
+{
+    this->build_audit();
+
+    raft_commit_batch first, second;
+
+    first.set_sender_uuid("uuid1");
+    first.add_log_indexes(1);
+    first.add_operations("do something");
+    first.add_log_indexes(2);
+    first.add_operations("do a different thing");
+
+    second.set_sender_uuid("uuid2");
+    second.add_log_indexes(2);
+    second.add_operations("do a different thing");
+    second.add_log_indexes(1);
+    second.add_operations("do something else");
+
+    this->audit->handle_raft_commit_batch(first);
+    EXPECT_EQ(this->audit->error_count(), 0u);
+
+    this->audit->handle_raft_commit_batch(second);
+    EXPECT_EQ(this->audit->error_count(), 1u);
+}
+
+TEST_F(audit_test, audit_ignores_malformed_raft_commit_batch)
+{
+    this->build_audit();
+
+    raft_commit_batch batch;
+    batch.add_log_indexes(1);
+    batch.add_operations("do something");
+    batch.add_log_indexes(2);
+
+    this->audit->handle_raft_commit_batch(batch);
+
+    raft_commit_notification conflicting;
+    conflicting.set_log_index(1);
+    conflicting.set_operation("do something else");
+    this->audit->handle_raft_commit(conflicting);
+
+    EXPECT_EQ(this->audit->error_count(), 0u);
+}
+
 TEST_F(audit_test, audit_throws_error_when_pbft_commits_conflict)
 {
     this->use_pbft = true;
@@ -214,6 +258,72 @@ TEST_F(audit_test, audit_throws_error_when_pbft_commits_conflict)
     EXPECT_EQ(this->audit->error_count(), 1u);
 }
 
+TEST_F(audit_test, audit_throws_error_when_batched_pbft_commits_conflict)
+{
+    this->use_pbft = true;
+    this->build_audit();
+
+    pbft_commit_batch first, second;
+
+    first.set_sender_uuid("uuid1");
+    first.add_sequence_numbers(1);
+    first.add_operations("do something");
+    first.add_sequence_numbers(2);
+    first.add_operations("do a different thing");
+
+    second.set_sender_uuid("uuid2");
+    second.add_sequence_numbers(2);
+    second.add_operations("do a different thing");
+    second.add_sequence_numbers(1);
+    second.add_operations("do something else");
+
+    this->audit->handle_pbft_commit_batch(first);
+    EXPECT_EQ(this->audit->error_count(), 0u);
+
+    this->audit->handle_pbft_commit_batch(second);
+    EXPECT_EQ(this->audit->error_count(), 1u);
+}
+
+TEST_F(audit_test, audit_ignores_malformed_pbft_commit_batch)
+{
+    this->use_pbft = true;
+    this->build_audit();
+
+    pbft_commit_batch batch;
+    batch.add_sequence_numbers(1);
+    batch.add_operations("do something");
+    batch.add_sequence_numbers(2);
+
+    this->audit->handle_pbft_commit_batch(batch);
+
+    pbft_commit_notification conflicting;
+    conflicting.set_sequence_number(1);
+    conflicting.set_operation("do something else");
+    this->audit->handle_pbft_commit(conflicting);
+
+    EXPECT_EQ(this->audit->error_count(), 0u);
+}
+
+TEST_F(audit_test, audit_handles_binary_audit_envelopes)
+{
+    this->use_pbft = true;
+    this->build_audit();
+
+    audit_message message;
+    message.mutable_pbft_commit_batch()->add_sequence_numbers(1);
+    message.mutable_pbft_commit_batch()->add_operations("do something");
+
+    bzn_envelope envelope;
+    envelope.set_audit(message.SerializeAsString());
+    this->audit->handle_envelope(envelope, nullptr);
+
+    message.mutable_pbft_commit_batch()->set_operations(0, "do something else");
+    envelope.set_audit(message.SerializeAsString());
+    this->audit->handle_envelope(envelope, nullptr);
+
+    EXPECT_EQ(this->audit->error_count(), 1u);
+}
+
 TEST_F(audit_test, audit_throws_error_when_no_leader_alive)
 {
     EXPECT_CALL(*(this->leader_alive_timer), expires_from_now(_)).Times(AtLeast(1));
@@ -17,7 +17,7 @@
 using namespace bzn;
 
 
-crud::crud(std::shared_ptr<bzn::storage_base> storage, std::shared_ptr<bzn::subscription_manager_base> subscription_manager)
+crud::crud(std::shared_ptr<bzn::snapshot_storage_base> storage, std::shared_ptr<bzn::subscription_manager_base> subscription_manager)
            : storage(std::move(storage))
            , subscription_manager(std::move(subscription_manager))
            , message_handlers{{database_msg::kCreate, std::bind(&crud::handle_create, this, std::placeholders::_1, std::placeholders::_2)},
@@ -27,6 +27,10 @@ crud::crud(std::shared_ptr<bzn::storage_base> storage, std::shared_ptr<bzn::subs
                               {database_msg::kHas,    std::bind(&crud::handle_has,    this, std::placeholders::_1, std::placeholders::_2)},
                               {database_msg::kKeys,   std::bind(&crud::handle_keys,   this, std::placeholders::_1, std::placeholders::_2)},
                               {database_msg::kSize,   std::bind(&crud::handle_size,   this, std::placeholders::_1, std::placeholders::_2)}}
+           , query_handlers{{database_msg::kRead, std::bind(&crud::query_read, this, std::placeholders::_1, std::placeholders::_2)},
+                            {database_msg::kHas,  std::bind(&crud::query_has,  this, std::placeholders::_1, std::placeholders::_2)},
+                            {database_msg::kKeys, std::bind(&crud::query_keys, this, std::placeholders::_1, std::placeholders::_2)},
+                            {database_msg::kSize, std::bind(&crud::query_size, this, std::placeholders::_1, std::placeholders::_2)}}
 {
 }
 
@@ -38,6 +42,43 @@ crud::start()
 }
 
 
+std::optional<database_response>
+crud::query(const database_msg& request)
+{
+    if (auto it = this->query_handlers.find(request.msg_case()); it != this->query_handlers.end())
+    {
+        database_response response;
+
+        this->set_response_result(request, it->second(request, response), response);
+
+        return response;
+    }
+
+    return std::nullopt;
+}
+
+
+bool
+crud::save_state()
+{
+    return this->storage->create_snapshot();
+}
+
+
+std::shared_ptr<std::string>
+crud::get_saved_state_chunk(size_t chunk, size_t chunk_count)
+{
+    return this->storage->get_snapshot_chunk(chunk, chunk_count);
+}
+
+
+bool
+crud::load_state_chunk(size_t chunk, size_t chunk_count, const std::string& data)
+{
+    return this->storage->load_snapshot_chunk(chunk, chunk_count, data);
+}
+
+
 void
 crud::handle_request(const database_msg& request, const std::shared_ptr<bzn::session_base>& session)
 {
@@ -55,8 +96,7 @@ crud::handle_request(const database_msg& request, const std::shared_ptr<bzn::ses
 
 
 void
-crud::send_response(const database_msg& request, const bzn::storage_base::result result,
-    database_response&& response, std::shared_ptr<bzn::session_base>& session)
+crud::set_response_result(const database_msg& request, const bzn::storage_base::result result, database_response& response)
 {
     *response.mutable_header() = request.header();
 
@@ -83,6 +123,14 @@ crud::send_response(const database_msg& request, const bzn::storage_base::result
             LOG(error) << "unknown error code: " << uint32_t(result);
         }
     }
+}
+
+
+void
+crud::send_response(const database_msg& request, const bzn::storage_base::result result,
+    database_response&& response, std::shared_ptr<bzn::session_base>& session)
+{
+    this->set_response_result(request, result, response);
 
     session->send_message(std::make_shared<std::string>(response.SerializeAsString()), false);
 }
@@ -109,18 +157,11 @@ crud::handle_read(const database_msg& request, std::shared_ptr<bzn::session_base
 {
     if (session)
     {
-        auto result = this->storage->read(request.header().db_uuid(), request.read().key());
-
         database_response response;
 
-        if (result)
-        {
-            response.mutable_read()->set_key(request.read().key());
-            response.mutable_read()->set_value(*result);
-        }
+        auto result = this->query_read(request, response);
 
-        this->send_response(request, (result) ? bzn::storage_base::result::ok : bzn::storage_base::result::not_found,
-            std::move(response), session);
+        this->send_response(request, result, std::move(response), session);
 
         return;
     }
@@ -166,10 +207,11 @@ crud::handle_has(const database_msg& request, std::shared_ptr<bzn::session_base>
 {
     if (session)
     {
-        const bool has = this->storage->has(request.header().db_uuid(), request.has().key());
+        database_response response;
 
-        this->send_response(request, (has) ? storage_base::result::ok : storage_base::result::not_found,
-            database_response(), session);
+        auto result = this->query_has(request, response);
+
+        this->send_response(request, result, std::move(response), session);
 
         return;
     }
@@ -183,17 +225,11 @@ crud::handle_keys(const database_msg& request, std::shared_ptr<bzn::session_base
 {
     if (session)
     {
-        const auto keys = this->storage->get_keys(request.header().db_uuid());
-
         database_response response;
-        response.mutable_keys();
 
-        for (const auto& key : keys)
-        {
-            response.mutable_keys()->add_keys(key);
-        }
+        auto result = this->query_keys(request, response);
 
-        this->send_response(request, storage_base::result::ok, std::move(response), session);
+        this->send_response(request, result, std::move(response), session);
 
         return;
     }
@@ -207,17 +243,68 @@ crud::handle_size(const database_msg& request, std::shared_ptr<bzn::session_base
 {
     if (session)
     {
-        const auto [keys, size] = this->storage->get_size(request.header().db_uuid());
-
         database_response response;
 
-        response.mutable_size()->set_keys(keys);
-        response.mutable_size()->set_bytes(size);
+        auto result = this->query_size(request, response);
 
-        this->send_response(request, storage_base::result::ok, std::move(response), session);
+        this->send_response(request, result, std::move(response), session);
 
         return;
     }
 
     LOG(warning) << "session no longer available. SIZE not executed.";
 }
+
+
+bzn::storage_base::result
+crud::query_read(const database_msg& request, database_response& response)
+{
+    auto result = this->storage->read(request.header().db_uuid(), request.read().key());
+
+    if (result)
+    {
+        response.mutable_read()->set_key(request.read().key());
+        response.mutable_read()->set_value(*result);
+
+        return storage_base::result::ok;
+    }
+
+    return storage_base::result::not_found;
+}
+
+
+bzn::storage_base::result
+crud::query_has(const database_msg& request, database_response& /*response*/)
+{
+    const bool has = this->storage->has(request.header().db_uuid(), request.has().key());
+
+    return (has) ? storage_base::result::ok : storage_base::result::not_found;
+}
+
+
+bzn::storage_base::result
+crud::query_keys(const database_msg& request, database_response& response)
+{
+    const auto keys = this->storage->get_keys(request.header().db_uuid());
+
+    response.mutable_keys();
+
+    for (const auto& key : keys)
+    {
+        response.mutable_keys()->add_keys(key);
+    }
+
+    return storage_base::result::ok;
+}
+
+
+bzn::storage_base::result
+crud::query_size(const database_msg& request, database_response& response)
+{
+    const auto [keys, size] = this->storage->get_size(request.header().db_uuid());
+
+    response.mutable_size()->set_keys(keys);
+    response.mutable_size()->set_bytes(size);
+
+    return storage_base::result::ok;
+}
@@ -18,7 +18,7 @@
 #include <crud/crud_base.hpp>
 #include <crud/subscription_manager_base.hpp>
 #include <node/node_base.hpp>
-#include <storage/storage_base.hpp>
+#include <storage/snapshot_storage_base.hpp>
 
 
 namespace bzn
@@ -26,12 +26,20 @@ namespace bzn
     class crud final : public bzn::crud_base, public std::enable_shared_from_this<crud>
     {
     public:
-        crud(std::shared_ptr<bzn::storage_base> storage, std::shared_ptr<bzn::subscription_manager_base> subscription_manager);
+        crud(std::shared_ptr<bzn::snapshot_storage_base> storage, std::shared_ptr<bzn::subscription_manager_base> subscription_manager);
 
         void handle_request(const database_msg& request, const std::shared_ptr<bzn::session_base>& session) override;
 
         void start() override;
 
+        std::optional<database_response> query(const database_msg& request) override;
+
+        bool save_state() override;
+
+        std::shared_ptr<std::string> get_saved_state_chunk(size_t chunk, size_t chunk_count) override;
+
+        bool load_state_chunk(size_t chunk, size_t chunk_count, const std::string& data) override;
+
     private:
 
         void handle_create(const database_msg& request, std::shared_ptr<bzn::session_base> session);
@@ -48,15 +56,29 @@ namespace bzn
 
         void handle_size(const database_msg& request, std::shared_ptr<bzn::session_base> session);
 
+        bzn::storage_base::result query_read(const database_msg& request, database_response& response);
+
+        bzn::storage_base::result query_has(const database_msg& request, database_response& response);
+
+        bzn::storage_base::result query_keys(const database_msg& request, database_response& response);
+
+        bzn::storage_base::result query_size(const database_msg& request, database_response& response);
+
+        void set_response_result(const database_msg& request, bzn::storage_base::result result, database_response& response);
+
         void send_response(const database_msg& request, bzn::storage_base::result result, database_response&& response,
             std::shared_ptr<bzn::session_base>& session);
 
-        std::shared_ptr<bzn::storage_base> storage;
+        std::shared_ptr<bzn::snapshot_storage_base> storage;
         std::shared_ptr<bzn::subscription_manager_base> subscription_manager;
 
         using message_handler_t = std::function<void(const database_msg& request, std::shared_ptr<bzn::session_base> session)>;
 
         std::unordered_map<database_msg::MsgCase, message_handler_t> message_handlers;
+
+        using query_handler_t = std::function<bzn::storage_base::result(const database_msg& request, database_response& response)>;
+
+        std::unordered_map<database_msg::MsgCase, query_handler_t> query_handlers;
     };
 
 } // namespace bzn
@@ -17,6 +17,7 @@
 #include <include/bluzelle.hpp>
 #include <node/session_base.hpp>
 #include <proto/bluzelle.pb.h>
+#include <optional>
 
 
 namespace bzn
@@ -59,6 +60,36 @@ namespace bzn
         virtual void handle_request(const database_msg& request, const std::shared_ptr<bzn::session_base>& session) = 0;
 
         virtual void start() = 0;
+
+        /**
+         * Execute a read-only request (read, has, keys or size) against the current state
+         * @param request   the request
+         * @return the response, or nullopt if the request is not read-only
+         */
+        virtual std::optional<database_response> query(const database_msg& request) = 0;
+
+        /**
+         * Snapshot the current state of every database
+         * @return true if the state was saved
+         */
+        virtual bool save_state() = 0;
+
+        /**
+         * Get one chunk of the last saved state
+         * @param chunk         index of the chunk
+         * @param chunk_count   number of chunks the state is divided into
+         * @return serialized chunk or nullptr if there is no saved state
+         */
+        virtual std::shared_ptr<std::string> get_saved_state_chunk(size_t chunk, size_t chunk_count) = 0;
+
+        /**
+         * Replace one chunk of the current state with a chunk saved by a peer
+         * @param chunk         index of the chunk
+         * @param chunk_count   number of chunks the state is divided into
+         * @param data          serialized chunk
+         * @return true if the chunk was loaded
+         */
+        virtual bool load_state_chunk(size_t chunk, size_t chunk_count, const std::string& data) = 0;
     };
 
 } // namespace bzn
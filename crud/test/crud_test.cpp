@@ -434,3 +434,40 @@ TEST(crud, test_that_size_sends_proper_response)
     // null session nothing should happen...
     crud.handle_request(msg, nullptr);
 }
+
+
+TEST(crud, test_that_query_executes_read_only_requests_only)
+{
+    bzn::crud crud(std::make_shared<bzn::mem_storage>(), nullptr);
+
+    database_msg msg;
+    msg.mutable_header()->set_db_uuid("uuid");
+    msg.mutable_header()->set_transaction_id(uint64_t(123));
+    msg.mutable_create()->set_key("key");
+    msg.mutable_create()->set_value("value");
+
+    EXPECT_FALSE(crud.query(msg));
+
+    crud.handle_request(msg, nullptr);
+
+    msg.mutable_read()->set_key("key");
+
+    auto resp = crud.query(msg);
+    ASSERT_TRUE(resp);
+    EXPECT_EQ(resp->header().transaction_id(), uint64_t(123));
+    EXPECT_EQ(resp->read().value(), "value");
+
+    msg.mutable_read()->set_key("missing");
+
+    resp = crud.query(msg);
+    ASSERT_TRUE(resp);
+    EXPECT_EQ(resp->error().message(), bzn::MSG_RECORD_NOT_FOUND);
+
+    msg.mutable_keys();
+
+    resp = crud.query(msg);
+    ASSERT_TRUE(resp);
+    ASSERT_EQ(resp->keys().keys_size(), 1);
+    EXPECT_EQ(resp->keys().keys(0), "key");
+}
+
@@ -13,9 +13,13 @@
 // along with this program. If not, see <http://www.gnu.org/licenses/>.
 
 #include <crypto/crypto.hpp>
+#include <proto/pbft.pb.h>
 #include <openssl/pem.h>
 #include <openssl/err.h>
 #include <openssl/crypto.h>
+#include <openssl/ecdh.h>
+#include <openssl/hmac.h>
+#include <algorithm>
 
 using namespace bzn;
 
@@ -23,13 +27,25 @@ namespace
 {
     const std::string PEM_PREFIX = "-----BEGIN PUBLIC KEY-----\n";
     const std::string PEM_SUFFIX = "\n-----END PUBLIC KEY-----\n";
+
+    // a MAC convinces only its receiver, so it can't stand in for a signature on anything that may be shown to
+    // others as proof; only pbft's normal case prepares and commits are never used that way
+    bool
+    may_be_authenticated(const bzn_envelope& msg)
+    {
+        pbft_msg inner;
+
+        return msg.payload_case() == bzn_envelope::kPbft && inner.ParseFromString(msg.pbft())
+            && (inner.type() == PBFT_MSG_PREPARE || inner.type() == PBFT_MSG_COMMIT);
+    }
 }
 
 crypto::crypto(std::shared_ptr<bzn::options_base> options)
         : options(std::move(options))
 {
     LOG(info) << "Using " << SSLeay_version(SSLEAY_VERSION);
-    if(this->options->get_simple_options().get<bool>(bzn::option_names::CRYPTO_ENABLED_OUTGOING))
+    if(this->options->get_simple_options().get<bool>(bzn::option_names::CRYPTO_ENABLED_OUTGOING)
+        || this->options->get_simple_options().get<bool>(bzn::option_names::CRYPTO_MAC_AUTHENTICATORS))
     {
         this->load_private_key();
     }
@@ -72,15 +88,44 @@ crypto::extract_payload(const bzn_envelope& msg)
     }
 }
 
-bool
-crypto::verify(const bzn_envelope& msg)
+crypto::EC_KEY_ptr_t
+crypto::read_public_key(const bzn::uuid_t& uuid)
 {
     BIO_ptr_t bio(BIO_new(BIO_s_mem()), &BIO_free);
     EC_KEY_ptr_t pubkey(nullptr, &EC_KEY_free);
+
+    bool result =
+            (bool) (bio)
+            // Reconstruct the PEM file in memory (this is awkward, but it avoids dealing with EC specifics)
+            && (0 < BIO_write(bio.get(), PEM_PREFIX.c_str(), PEM_PREFIX.length()))
+            && (0 < BIO_write(bio.get(), uuid.c_str(), uuid.length()))
+            && (0 < BIO_write(bio.get(), PEM_SUFFIX.c_str(), PEM_SUFFIX.length()))
+
+            // Parse the PEM string to get the public key the message is allegedly from
+            && (pubkey = EC_KEY_ptr_t(PEM_read_bio_EC_PUBKEY(bio.get(), NULL, NULL, NULL), &EC_KEY_free))
+            && (1 == EC_KEY_check_key(pubkey.get()));
+
+    return result ? std::move(pubkey) : EC_KEY_ptr_t(nullptr, &EC_KEY_free);
+}
+
+bool
+crypto::verify(const bzn_envelope& msg)
+{
+    if (msg.signature().empty() && msg.authenticator_size() > 0)
+    {
+        return may_be_authenticated(msg) && this->verify_authenticator(msg);
+    }
+
+    return this->verify_signature(msg);
+}
+
+bool
+crypto::verify_signature(const bzn_envelope& msg)
+{
     EVP_PKEY_ptr_t key(EVP_PKEY_new(), &EVP_PKEY_free);
     EVP_MD_CTX_ptr_t context(EVP_MD_CTX_create(), &EVP_MD_CTX_free);
 
-    if (!bio || !key || !context)
+    if (!key || !context)
     {
         LOG(error) << "failed to allocate memory for signature verification";
         return false;
@@ -91,16 +136,10 @@ crypto::verify(const bzn_envelope& msg)
     std::string signature = msg.signature();
     char* sig_ptr = signature.data();
 
+    EC_KEY_ptr_t pubkey = this->read_public_key(msg.sender());
 
     bool result =
-            // Reconstruct the PEM file in memory (this is awkward, but it avoids dealing with EC specifics)
-            (0 < BIO_write(bio.get(), PEM_PREFIX.c_str(), PEM_PREFIX.length()))
-            && (0 < BIO_write(bio.get(), msg.sender().c_str(), msg.sender().length()))
-            && (0 < BIO_write(bio.get(), PEM_SUFFIX.c_str(), PEM_SUFFIX.length()))
-
-            // Parse the PEM string to get the public key the message is allegedly from
-            && (pubkey = EC_KEY_ptr_t(PEM_read_bio_EC_PUBKEY(bio.get(), NULL, NULL, NULL), &EC_KEY_free))
-            && (1 == EC_KEY_check_key(pubkey.get()))
+            (bool) (pubkey)
             && (1 == EVP_PKEY_set1_EC_KEY(key.get(), pubkey.get()))
 
             // Perform the signature validation
@@ -116,6 +155,155 @@ crypto::verify(const bzn_envelope& msg)
     return result;
 }
 
+bool
+crypto::verify_authenticator(const bzn_envelope& msg)
+{
+    auto mac = msg.authenticator().find(this->options->get_uuid());
+
+    if (mac == msg.authenticator().end())
+    {
+        return false;
+    }
+
+    // only swarm members have keys; anyone else is turned away before any work is done for them...
+    const auto keys = this->get_session_keys();
+    auto key = keys->find(msg.sender());
+
+    if (key == keys->end())
+    {
+        return false;
+    }
+
+    const std::string expected = this->mac(key->second, this->extract_payload(msg));
+
+    return expected.size() == mac->second.size() && 0 == CRYPTO_memcmp(expected.data(), mac->second.data(), expected.size());
+}
+
+bool
+crypto::authenticate(bzn_envelope& msg, const std::vector<bzn::uuid_t>& receivers)
+{
+    if (!this->options->get_simple_options().get<bool>(bzn::option_names::CRYPTO_MAC_AUTHENTICATORS))
+    {
+        return this->sign(msg);
+    }
+
+    if (msg.sender().empty())
+    {
+        msg.set_sender(this->options->get_uuid());
+    }
+
+    if (msg.sender() != options->get_uuid())
+    {
+        LOG(error) << "Cannot authenticate message purportedly sent by " << msg.sender();
+        return false;
+    }
+
+    msg.clear_authenticator();
+
+    const auto keys = this->get_session_keys();
+
+    for (const auto& receiver : receivers)
+    {
+        auto key = keys->find(receiver);
+
+        if (key == keys->end())
+        {
+            LOG(error) << "No session key for " << receiver << "; signing message instead";
+            msg.clear_authenticator();
+            return this->sign(msg);
+        }
+
+        (*msg.mutable_authenticator())[receiver] = this->mac(key->second, this->extract_payload(msg));
+    }
+
+    return true;
+}
+
+void
+crypto::set_authenticated_peers(const std::vector<bzn::uuid_t>& peers)
+{
+    const auto current = this->get_session_keys();
+    auto keys = std::make_shared<session_key_map>();
+
+    // keys of members we already had are kept, and only new members' are agreed, without holding the lock...
+    for (const auto& peer : peers)
+    {
+        if (auto it = current->find(peer); it != current->end())
+        {
+            keys->emplace(*it);
+        }
+        else if (auto key = this->derive_session_key(peer))
+        {
+            keys->emplace(peer, std::move(*key));
+        }
+        else
+        {
+            LOG(error) << "No session key for " << peer << "; its messages will be signed";
+        }
+    }
+
+    std::lock_guard<std::mutex> lock(this->session_keys_lock);
+
+    this->session_keys = std::move(keys);
+}
+
+std::shared_ptr<const crypto::session_key_map>
+crypto::get_session_keys() const
+{
+    std::lock_guard<std::mutex> lock(this->session_keys_lock);
+
+    return this->session_keys;
+}
+
+std::optional<std::string>
+crypto::derive_session_key(const bzn::uuid_t& peer)
+{
+    if (!this->private_key_EC)
+    {
+        return std::nullopt;
+    }
+
+    EC_KEY_ptr_t pubkey = this->read_public_key(peer);
+
+    if (!pubkey)
+    {
+        ERR_clear_error();
+        return std::nullopt;
+    }
+
+    const int field_size = EC_GROUP_get_degree(EC_KEY_get0_group(this->private_key_EC.get()));
+    std::string secret((field_size + 7) / 8, '\0');
+
+    if (ECDH_compute_key(secret.data(), secret.size(), EC_KEY_get0_public_key(pubkey.get()), this->private_key_EC.get(), NULL) <= 0)
+    {
+        this->log_openssl_errors();
+        return std::nullopt;
+    }
+
+    // derive the mac key from the shared secret...
+    unsigned char key[EVP_MAX_MD_SIZE];
+    unsigned int key_length = 0;
+
+    if (1 != EVP_Digest(secret.data(), secret.size(), key, &key_length, EVP_sha256(), NULL))
+    {
+        this->log_openssl_errors();
+        return std::nullopt;
+    }
+
+    return std::string(reinterpret_cast<char*>(key), key_length);
+}
+
+std::string
+crypto::mac(const std::string& key, const std::string& data)
+{
+    unsigned char result[EVP_MAX_MD_SIZE];
+    unsigned int result_length = 0;
+
+    HMAC(EVP_sha256(), key.data(), key.size(), reinterpret_cast<const unsigned char*>(data.data()), data.size(), result, &result_length);
+
+    return std::string(reinterpret_cast<char*>(result), result_length);
+}
+
 bool
 crypto::sign(bzn_envelope& msg)
 {
@@ -20,6 +20,9 @@
 #include <proto/bluzelle.pb.h>
 #include <openssl/evp.h>
 #include <openssl/ec.h>
+#include <mutex>
+#include <optional>
+#include <unordered_map>
 
 namespace bzn
 {
@@ -33,9 +36,14 @@ namespace bzn
 
         bool verify(const bzn_envelope& msg) override;
 
+        bool authenticate(bzn_envelope& msg, const std::vector<bzn::uuid_t>& receivers) override;
+
+        void set_authenticated_peers(const std::vector<bzn::uuid_t>& peers) override;
+
         std::string hash(const std::string& msg) override;
 
     private:
+        using session_key_map = std::unordered_map<bzn::uuid_t, std::string>;
 
         using EC_KEY_ptr_t = std::unique_ptr<EC_KEY, decltype(&::EC_KEY_free)>;
         using EVP_PKEY_ptr_t = std::unique_ptr<EVP_PKEY, decltype(&::EVP_PKEY_free)>;
@@ -44,6 +52,18 @@ namespace bzn
 
         bool load_private_key();
 
+        EC_KEY_ptr_t read_public_key(const bzn::uuid_t& uuid);
+
+        bool verify_signature(const bzn_envelope& msg);
+
+        bool verify_authenticator(const bzn_envelope& msg);
+
+        std::optional<std::string> derive_session_key(const bzn::uuid_t& peer);
+
+        std::shared_ptr<const session_key_map> get_session_keys() const;
+
+        std::string mac(const std::string& key, const std::string& data);
+
         void log_openssl_errors();
 
         const std::string& extract_payload(const bzn_envelope& msg);
@@ -53,6 +73,11 @@ namespace bzn
         EVP_PKEY_ptr_t private_key_EVP = EVP_PKEY_ptr_t(nullptr, &EVP_PKEY_free);
         EC_KEY_ptr_t private_key_EC = EC_KEY_ptr_t(nullptr, &EC_KEY_free);
 
+        // pairwise keys agreed with each swarm member (ECDH between our key and the public key in their uuid), all
+        // made when the members are set, since any sender can claim a uuid; replaced whole, never changed in place
+        std::shared_ptr<const session_key_map> session_keys = std::make_shared<const session_key_map>();
+        mutable std::mutex session_keys_lock;
+
     };
 }
 
@@ -14,7 +14,9 @@
 
 #pragma once
 
+#include <include/bluzelle.hpp>
 #include <proto/bluzelle.pb.h>
+#include <vector>
 
 namespace bzn
 {
@@ -29,12 +31,29 @@ namespace bzn
         virtual bool sign(bzn_envelope& msg) = 0;
 
         /*
-         * verify that the signature on a message is correct and matches its sender
+         * verify that the signature (or our authenticator) on a message is correct and matches its sender
          * @msg message to verify
-         * @return signature is present, valid and matches sender
+         * @return signature or authenticator is present, valid and matches sender
          */
         virtual bool verify(const bzn_envelope& msg) = 0;
 
+        /*
+         * authenticate a message for a known set of receivers with a vector of pairwise MACs, which is much cheaper
+         * to verify than a signature but does not prove to a third party who sent it (signs the message instead if
+         * authenticators are disabled)
+         * @msg message to authenticate
+         * @receivers uuids of the nodes the message will be sent to
+         * @return if authentication was successful
+         */
+        virtual bool authenticate(bzn_envelope& msg, const std::vector<bzn::uuid_t>& receivers) = 0;
+
+        /*
+         * agree the pairwise keys for authenticators with the current swarm members, dropping those of former ones;
+         * authenticators from anyone else are rejected, and messages to them are signed instead
+         * @peers uuids of the swarm members, including our own
+         */
+        virtual void set_authenticated_peers(const std::vector<bzn::uuid_t>& peers) = 0;
+
         /*
          * Compute the hash of some message
          * @msg data
@@ -0,0 +1,126 @@
+// Copyright (C) 2018 Bluzelle
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU Affero General Public License, version 3,
+// as published by the Free Software Foundation.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU Affero General Public License for more details.
+//
+// You should have received a copy of the GNU Affero General Public License
+// along with this program. If not, see <http://www.gnu.org/licenses/>.
+
+// Compares what a receiver spends verifying one pbft prepare signed by its sender with one carrying a MAC
+// authenticator for it, between two freshly generated key pairs. Usage:
+//
+//   crypto_bench [iterations]
+
+#include <crypto/crypto.hpp>
+#include <options/options.hpp>
+#include <proto/pbft.pb.h>
+#include <boost/log/core.hpp>
+#include <openssl/pem.h>
+#include <chrono>
+#include <cstdio>
+#include <unistd.h>
+
+namespace
+{
+    // a node's options, with a new key pair written to the files given
+    std::shared_ptr<bzn::options_base>
+    make_options(const std::string& private_key_file, const std::string& public_key_file)
+    {
+        std::unique_ptr<EC_KEY, decltype(&::EC_KEY_free)> key(EC_KEY_new_by_curve_name(NID_secp256k1), &EC_KEY_free);
+        std::unique_ptr<FILE, decltype(&fclose)> private_fp(fopen(private_key_file.c_str(), "w"), &fclose);
+        std::unique_ptr<FILE, decltype(&fclose)> public_fp(fopen(public_key_file.c_str(), "w"), &fclose);
+
+        if (!key || !private_fp || !public_fp || 1 != EC_KEY_generate_key(key.get())
+            || 1 != PEM_write_ECPrivateKey(private_fp.get(), key.get(), NULL, NULL, 0, NULL, NULL)
+            || 1 != PEM_write_EC_PUBKEY(public_fp.get(), key.get()))
+        {
+            throw std::runtime_error("failed to write key pair");
+        }
+
+        auto options = std::make_shared<bzn::options>();
+        options->get_mutable_simple_options().set(bzn::option_names::NODE_PRIVATEKEY_FILE, private_key_file);
+        options->get_mutable_simple_options().set(bzn::option_names::NODE_PUBKEY_FILE, public_key_file);
+        options->get_mutable_simple_options().set(bzn::option_names::CRYPTO_MAC_AUTHENTICATORS, "true");
+
+        return options;
+    }
+
+
+    double
+    verify_ns_per_message(bzn::crypto& receiver, const bzn_envelope& msg, size_t iterations)
+    {
+        const auto start = std::chrono::steady_clock::now();
+
+        for (size_t i = 0; i < iterations; ++i)
+        {
+            if (!receiver.verify(msg))
+            {
+                throw std::runtime_error("message failed to verify");
+            }
+        }
+
+        const auto elapsed = std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - start);
+
+        return double(elapsed.count()) / iterations;
+    }
+}
+
+
+int
+main(int argc, const char* argv[])
+{
+    const size_t iterations = argc > 1 ? std::stoul(argv[1]) : 2000;
+
+    boost::log::core::get()->set_logging_enabled(false);
+
+    const std::vector<std::string> key_files{"bench_sender_private_key.pem", "bench_sender_public_key.pem",
+        "bench_receiver_private_key.pem", "bench_receiver_public_key.pem"};
+
+    auto sender_options = make_options(key_files[0], key_files[1]);
+    auto receiver_options = make_options(key_files[2], key_files[3]);
+
+    bzn::crypto sender(sender_options);
+    bzn::crypto receiver(receiver_options);
+
+    const std::vector<bzn::uuid_t> members{sender_options->get_uuid(), receiver_options->get_uuid()};
+    sender.set_authenticated_peers(members);
+    receiver.set_authenticated_peers(members);
+
+    pbft_msg prepare;
+    prepare.set_type(PBFT_MSG_PREPARE);
+    prepare.set_view(1);
+    prepare.set_sequence(1);
+    prepare.mutable_request()->mutable_operation()->mutable_create()->set_key("key");
+    prepare.mutable_request()->mutable_operation()->mutable_create()->set_value(std::string(100, 'x'));
+
+    bzn_envelope signed_msg;
+    signed_msg.set_pbft(prepare.SerializeAsString());
+    bzn_envelope authenticated_msg = signed_msg;
+
+    // the options read the uuid from the public key file whenever asked, so the files stay until we're done...
+    const bool ready = sender.sign(signed_msg) && sender.authenticate(authenticated_msg, {receiver_options->get_uuid()});
+
+    if (ready)
+    {
+        std::printf("%16s %12s\n", "verified by", "ns/message");
+        std::printf("%16s %12.0f\n", "signature", verify_ns_per_message(receiver, signed_msg, iterations));
+        std::printf("%16s %12.0f\n", "authenticator", verify_ns_per_message(receiver, authenticated_msg, iterations));
+    }
+    else
+    {
+        std::fprintf(stderr, "failed to sign or authenticate message\n");
+    }
+
+    for (const auto& file : key_files)
+    {
+        ::unlink(file.c_str());
+    }
+
+    return ready ? 0 : 1;
+}
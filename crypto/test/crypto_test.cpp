@@ -17,8 +17,11 @@
 #include <options/options.hpp>
 #include <gtest/gtest.h>
 #include <proto/bluzelle.pb.h>
+#include <proto/pbft.pb.h>
 #include <fstream>
+#include <chrono>
 #include <boost/range/irange.hpp>
+#include <openssl/pem.h>
 
 using namespace ::testing;
 
@@ -142,3 +145,145 @@ TEST_F(crypto_test, hash_deterministic_but_not_identity)
         EXPECT_NE(str, this->crypto->hash(str));
     }
 }
+
+class crypto_authenticator_test : public crypto_test
+{
+public:
+    std::shared_ptr<bzn::options_base> peer_options = std::make_shared<bzn::options>();
+    std::shared_ptr<bzn::crypto> peer_crypto;
+
+    const std::string peer_private_key_file = "test_peer_private_key.pem";
+    const std::string peer_public_key_file = "test_peer_public_key.pem";
+
+    crypto_authenticator_test()
+    {
+        // generate a second key pair on the same curve for the peer...
+        std::unique_ptr<EC_KEY, decltype(&::EC_KEY_free)> key(EC_KEY_new_by_curve_name(NID_secp256k1), &EC_KEY_free);
+        EXPECT_EQ(1, EC_KEY_generate_key(key.get()));
+
+        std::unique_ptr<FILE, decltype(&fclose)> private_fp(fopen(peer_private_key_file.c_str(), "w"), &fclose);
+        EXPECT_EQ(1, PEM_write_ECPrivateKey(private_fp.get(), key.get(), NULL, NULL, 0, NULL, NULL));
+        private_fp.reset();
+
+        std::unique_ptr<FILE, decltype(&fclose)> public_fp(fopen(peer_public_key_file.c_str(), "w"), &fclose);
+        EXPECT_EQ(1, PEM_write_EC_PUBKEY(public_fp.get(), key.get()));
+        public_fp.reset();
+
+        this->options->get_mutable_simple_options().set(bzn::option_names::CRYPTO_MAC_AUTHENTICATORS, "true");
+        this->crypto = std::make_shared<bzn::crypto>(this->options);
+
+        this->peer_options->get_mutable_simple_options().set(bzn::option_names::NODE_PRIVATEKEY_FILE, peer_private_key_file);
+        this->peer_options->get_mutable_simple_options().set(bzn::option_names::NODE_PUBKEY_FILE, peer_public_key_file);
+        this->peer_options->get_mutable_simple_options().set(bzn::option_names::CRYPTO_MAC_AUTHENTICATORS, "true");
+        this->peer_crypto = std::make_shared<bzn::crypto>(this->peer_options);
+
+        const std::vector<bzn::uuid_t> members{this->options->get_uuid(), this->peer_options->get_uuid()};
+        this->crypto->set_authenticated_peers(members);
+        this->peer_crypto->set_authenticated_peers(members);
+
+        // only prepares and commits may carry authenticators instead of a signature...
+        this->msg.set_pbft(pbft_message(PBFT_MSG_PREPARE));
+    }
+
+    static std::string
+    pbft_message(pbft_msg_type type)
+    {
+        pbft_msg msg;
+        msg.set_type(type);
+        msg.set_view(1);
+        msg.set_sequence(2);
+
+        return msg.SerializeAsString();
+    }
+
+    ~crypto_authenticator_test()
+    {
+        ::unlink(peer_private_key_file.c_str());
+        ::unlink(peer_public_key_file.c_str());
+    }
+};
+
+TEST_F(crypto_authenticator_test, authenticated_messages_verified_by_receivers)
+{
+    EXPECT_TRUE(crypto->authenticate(msg, {this->options->get_uuid(), this->peer_options->get_uuid()}));
+    EXPECT_TRUE(msg.signature().empty());
+    EXPECT_EQ(2u, msg.authenticator_size());
+
+    EXPECT_TRUE(peer_crypto->verify(msg));
+    EXPECT_TRUE(crypto->verify(msg));
+}
+
+TEST_F(crypto_authenticator_test, authenticator_for_other_receivers_rejected)
+{
+    EXPECT_TRUE(crypto->authenticate(msg, {this->options->get_uuid()}));
+
+    EXPECT_FALSE(peer_crypto->verify(msg));
+}
+
+TEST_F(crypto_authenticator_test, bad_authenticator_caught)
+{
+    EXPECT_TRUE(crypto->authenticate(msg, {this->peer_options->get_uuid()}));
+
+    bzn_envelope msg2 = msg;
+    msg2.set_pbft("a" + msg.pbft());
+    EXPECT_FALSE(peer_crypto->verify(msg2));
+
+    bzn_envelope msg3 = msg;
+    (*msg3.mutable_authenticator())[this->peer_options->get_uuid()][0] ^= 1;
+    EXPECT_FALSE(peer_crypto->verify(msg3));
+}
+
+TEST_F(crypto_authenticator_test, authenticator_only_accepted_on_prepares_and_commits)
+{
+    bzn_envelope commit = msg;
+    commit.set_pbft(pbft_message(PBFT_MSG_COMMIT));
+    EXPECT_TRUE(crypto->authenticate(commit, {this->peer_options->get_uuid()}));
+    EXPECT_TRUE(peer_crypto->verify(commit));
+
+    for (const auto type : {PBFT_MSG_PREPREPARE, PBFT_MSG_CHECKPOINT, PBFT_MSG_SET_STATE, PBFT_MSG_QUERY_REPLY})
+    {
+        bzn_envelope other = msg;
+        other.set_pbft(pbft_message(type));
+        EXPECT_TRUE(crypto->authenticate(other, {this->peer_options->get_uuid()}));
+        EXPECT_FALSE(peer_crypto->verify(other));
+    }
+
+    bzn_envelope database = msg;
+    database.set_database_response("response");
+    EXPECT_TRUE(crypto->authenticate(database, {this->peer_options->get_uuid()}));
+    EXPECT_FALSE(peer_crypto->verify(database));
+
+    bzn_envelope not_pbft = msg;
+    not_pbft.set_pbft("pretend this is a serialized protobuf message");
+    EXPECT_TRUE(crypto->authenticate(not_pbft, {this->peer_options->get_uuid()}));
+    EXPECT_FALSE(peer_crypto->verify(not_pbft));
+}
+
+TEST_F(crypto_authenticator_test, authenticators_only_accepted_from_members)
+{
+    EXPECT_TRUE(crypto->authenticate(msg, {this->peer_options->get_uuid()}));
+    EXPECT_TRUE(peer_crypto->verify(msg));
+
+    // once we're no longer a member, the peer turns our authenticators away...
+    this->peer_crypto->set_authenticated_peers({this->peer_options->get_uuid()});
+    EXPECT_FALSE(peer_crypto->verify(msg));
+
+    // ...and signs what it sends us instead
+    bzn_envelope reply;
+    reply.set_pbft(pbft_message(PBFT_MSG_COMMIT));
+    EXPECT_TRUE(peer_crypto->authenticate(reply, {this->options->get_uuid()}));
+    EXPECT_FALSE(reply.signature().empty());
+    EXPECT_EQ(0u, reply.authenticator_size());
+    EXPECT_TRUE(crypto->verify(reply));
+
+    this->peer_crypto->set_authenticated_peers({this->options->get_uuid(), this->peer_options->get_uuid()});
+    EXPECT_TRUE(peer_crypto->verify(msg));
+}
+
+TEST_F(crypto_test, authenticate_signs_when_authenticators_disabled)
+{
+    EXPECT_TRUE(crypto->authenticate(msg, {this->options->get_uuid()}));
+    EXPECT_FALSE(msg.signature().empty());
+    EXPECT_EQ(0u, msg.authenticator_size());
+    EXPECT_TRUE(crypto->verify(msg));
+}
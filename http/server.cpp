@@ -18,28 +18,44 @@
 using namespace bzn::http;
 
 
-server::server(std::shared_ptr<bzn::asio::io_context_base> io_context, std::shared_ptr<bzn::deprecated::crud_base> crud, const boost::asio::ip::tcp::endpoint& ep)
-    : tcp_acceptor(io_context->make_unique_tcp_acceptor(ep))
-    , io_context(std::move(io_context))
-    , crud(std::move(crud))
+server::server(std::shared_ptr<bzn::asio::io_context_base> io_context, std::shared_ptr<bzn::deprecated::crud_base> crud, const boost::asio::ip::tcp::endpoint& ep,
+    std::vector<std::shared_ptr<bzn::asio::io_context_base>> reactors)
+    : crud(std::move(crud))
 {
+    if (reactors.empty())
+    {
+        reactors.push_back(std::move(io_context));
+    }
+
+    for (auto& reactor : reactors)
+    {
+        auto acceptor = reactor->make_unique_tcp_acceptor(ep);
+        this->listeners.push_back(std::make_shared<listener>(listener{std::move(reactor), std::move(acceptor), nullptr}));
+    }
 }
 
 
 void
 server::start()
 {
-    std::call_once(this->start_once, &server::do_accept, this);
+    std::call_once(this->start_once,
+        [this]()
+        {
+            for (const auto& l : this->listeners)
+            {
+                this->do_accept(l);
+            }
+        });
 }
 
 
 void
-server::do_accept()
+server::do_accept(std::shared_ptr<listener> l)
 {
-    this->acceptor_socket = this->io_context->make_unique_tcp_socket();
+    l->acceptor_socket = l->io_context->make_unique_tcp_socket();
 
-    this->tcp_acceptor->async_accept(*this->acceptor_socket,
-        [self = shared_from_this()](const boost::system::error_code& ec)
+    l->tcp_acceptor->async_accept(*l->acceptor_socket,
+        [self = shared_from_this(), l](const boost::system::error_code& ec)
         {
             if (ec)
             {
@@ -47,15 +63,15 @@ server::do_accept()
             }
             else
             {
-                auto ep = self->acceptor_socket->remote_endpoint();
+                auto ep = l->acceptor_socket->remote_endpoint();
 
                 LOG(debug) << "connection from: " << ep.address() << ":" << ep.port();
 
-                auto hs = std::make_unique<bzn::beast::http_socket>(std::move(self->acceptor_socket->get_tcp_socket()));
+                auto hs = std::make_unique<bzn::beast::http_socket>(std::move(l->acceptor_socket->get_tcp_socket()));
 
-                std::make_shared<bzn::http::connection>(self->io_context, std::move(hs), self->crud)->start();
+                std::make_shared<bzn::http::connection>(l->io_context, std::move(hs), self->crud)->start();
             }
 
-            self->do_accept();
+            self->do_accept(l);
         });
 }
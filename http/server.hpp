@@ -18,6 +18,7 @@
 #include <crud/crud_base.hpp>
 #include <include/boost_asio_beast.hpp>
 #include <memory>
+#include <vector>
 
 
 // minimalistic http server to answer solidity/oracle CRUD commands
@@ -28,16 +29,23 @@ namespace bzn::http
     class server : public std::enable_shared_from_this<server>
     {
     public:
-        server(std::shared_ptr<bzn::asio::io_context_base> io_context, std::shared_ptr<bzn::deprecated::crud_base> crud, const boost::asio::ip::tcp::endpoint& ep);
+        // with reactors given, each listens on the endpoint and owns the connections it accepts
+        server(std::shared_ptr<bzn::asio::io_context_base> io_context, std::shared_ptr<bzn::deprecated::crud_base> crud, const boost::asio::ip::tcp::endpoint& ep,
+            std::vector<std::shared_ptr<bzn::asio::io_context_base>> reactors = {});
 
         void start();
 
     private:
-        void do_accept();
+        struct listener
+        {
+            std::shared_ptr<bzn::asio::io_context_base> io_context;
+            std::unique_ptr<bzn::asio::tcp_acceptor_base> tcp_acceptor;
+            std::unique_ptr<bzn::asio::tcp_socket_base> acceptor_socket;
+        };
 
-        std::unique_ptr<bzn::asio::tcp_acceptor_base> tcp_acceptor;
-        std::unique_ptr<bzn::asio::tcp_socket_base>   acceptor_socket;
-        std::shared_ptr<bzn::asio::io_context_base>   io_context;
+        void do_accept(std::shared_ptr<listener> l);
+
+        std::vector<std::shared_ptr<listener>>        listeners;
         std::shared_ptr<bzn::deprecated::crud_base>   crud;
 
         std::once_flag start_once;
@@ -66,4 +66,63 @@ namespace bzn::http
 
         ah(boost::system::error_code());
     }
+
+
+    TEST(server, test_that_each_reactor_accepts_and_owns_its_connections)
+    {
+        auto mock_io_context = std::make_shared<bzn::asio::Mockio_context_base>();
+        auto ep = boost::asio::ip::tcp::endpoint{boost::asio::ip::address::from_string("127.0.0.1"),8080};
+
+        boost::asio::io_context io;
+        boost::asio::ip::tcp::socket socket(io);
+
+        std::vector<std::shared_ptr<bzn::asio::Mockio_context_base>> reactors;
+        std::vector<bzn::asio::accept_handler> handlers(2);
+
+        for (size_t i = 0; i < 2; ++i)
+        {
+            auto reactor = std::make_shared<bzn::asio::Mockio_context_base>();
+
+            // every reactor listens on the same endpoint...
+            EXPECT_CALL(*reactor, make_unique_tcp_acceptor(ep)).WillOnce(Invoke(
+                [&handlers, i](auto)
+                {
+                    auto acceptor = std::make_unique<bzn::asio::Mocktcp_acceptor_base>();
+                    EXPECT_CALL(*acceptor, async_accept(_,_)).WillRepeatedly(Invoke(
+                        [&handlers, i](auto&, auto handler)
+                        {
+                            handlers[i] = handler;
+                        }));
+                    return acceptor;
+                }));
+
+            EXPECT_CALL(*reactor, make_unique_tcp_socket()).WillRepeatedly(Invoke(
+                [&]()
+                {
+                    auto mock_tcp_socket = std::make_unique<NiceMock<bzn::asio::Mocktcp_socket_base>>();
+                    ON_CALL(*mock_tcp_socket, remote_endpoint()).WillByDefault(Return(ep));
+                    ON_CALL(*mock_tcp_socket, get_tcp_socket()).WillByDefault(ReturnRef(socket));
+                    return mock_tcp_socket;
+                }));
+
+            reactors.push_back(reactor);
+        }
+
+        // ...and the connection accepted by the second is owned by it
+        EXPECT_CALL(*reactors[0], make_unique_steady_timer()).Times(0);
+        EXPECT_CALL(*reactors[1], make_unique_steady_timer()).WillOnce(Invoke(
+            []()
+            {
+                return std::make_unique<NiceMock<bzn::asio::Mocksteady_timer_base>>();
+            }));
+
+        auto server = std::make_shared<bzn::http::server>(mock_io_context, nullptr, ep,
+            std::vector<std::shared_ptr<bzn::asio::io_context_base>>{reactors[0], reactors[1]});
+
+        server->start();
+
+        ASSERT_TRUE(handlers[0] && handlers[1]);
+
+        handlers[1](boost::system::error_code());
+    }
 }
@@ -94,6 +94,9 @@ namespace bzn::asio
 
         virtual bzn::asio::close_handler wrap(close_handler handler) = 0;
 
+        // runs the task on the strand: straight away if called from it, otherwise as soon as it's free
+        virtual void dispatch(bzn::asio::task task) = 0;
+
         virtual boost::asio::io_context::strand& get_strand() = 0;
     };
 
@@ -179,9 +182,20 @@ namespace bzn::asio
     class tcp_acceptor final : public tcp_acceptor_base
     {
     public:
-        explicit tcp_acceptor(boost::asio::io_context& io_context, const boost::asio::ip::tcp::endpoint& ep)
-            : acceptor(io_context, ep)
+        explicit tcp_acceptor(boost::asio::io_context& io_context, const boost::asio::ip::tcp::endpoint& ep, bool reuse_port = false)
+            : acceptor(io_context)
         {
+            this->acceptor.open(ep.protocol());
+            this->acceptor.set_option(boost::asio::ip::tcp::acceptor::reuse_address(true));
+
+            // so an acceptor per io_context can listen on the same port, with the kernel spreading connections over them...
+            if (reuse_port)
+            {
+                this->acceptor.set_option(boost::asio::detail::socket_option::boolean<SOL_SOCKET, SO_REUSEPORT>(true));
+            }
+
+            this->acceptor.bind(ep);
+            this->acceptor.listen();
         }
 
         void async_accept(bzn::asio::tcp_socket_base& socket, bzn::asio::accept_handler handler) override
@@ -252,6 +266,11 @@ namespace bzn::asio
             return this->s.wrap(std::move(handler));
         }
 
+        void dispatch(bzn::asio::task task) override
+        {
+            boost::asio::dispatch(this->s, std::move(task));
+        }
+
         boost::asio::io_context::strand& get_strand() override
         {
             return this->s;
@@ -266,29 +285,35 @@ namespace bzn::asio
     class io_context final : public io_context_base
     {
     public:
+        // reuse_port lets acceptors made by other io_contexts listen on the same endpoints
+        explicit io_context(bool reuse_port = false)
+            : reuse_port(reuse_port)
+        {
+        }
+
         std::unique_ptr<bzn::asio::tcp_acceptor_base> make_unique_tcp_acceptor(const boost::asio::ip::tcp::endpoint& ep) override
         {
-            return std::make_unique<bzn::asio::tcp_acceptor>(this->io_context, ep);
+            return std::make_unique<bzn::asio::tcp_acceptor>(this->context, ep, this->reuse_port);
         }
 
         std::unique_ptr<bzn::asio::tcp_socket_base> make_unique_tcp_socket() override
         {
-            return std::make_unique<bzn::asio::tcp_socket>(this->io_context);
+            return std::make_unique<bzn::asio::tcp_socket>(this->context);
         }
 
         std::unique_ptr<bzn::asio::udp_socket_base> make_unique_udp_socket() override
         {
-            return std::make_unique<bzn::asio::udp_socket>(this->io_context);
+            return std::make_unique<bzn::asio::udp_socket>(this->context);
         }
 
         std::unique_ptr<bzn::asio::steady_timer_base> make_unique_steady_timer() override
         {
-            return std::make_unique<bzn::asio::steady_timer>(this->io_context);
+            return std::make_unique<bzn::asio::steady_timer>(this->context);
         }
 
         std::unique_ptr<bzn::asio::strand_base> make_unique_strand() override
         {
-            return std::make_unique<bzn::asio::strand>(this->io_context);
+            return std::make_unique<bzn::asio::strand>(this->context);
         }
 
         void post(bzn::asio::task func) override
@@ -298,21 +323,22 @@ namespace bzn::asio
 
         boost::asio::io_context::count_type run() override
         {
-            return this->io_context.run();
+            return this->context.run();
         }
 
         void stop() override
         {
-            this->io_context.stop();
+            this->context.stop();
         }
 
         boost::asio::io_context& get_io_context() override
         {
-            return this->io_context;
+            return this->context;
         }
 
     private:
-        boost::asio::io_context io_context;
+        boost::asio::io_context context;
+        const bool reuse_port;
     };
 
 } // bzn::asio
@@ -322,6 +348,7 @@ namespace bzn::beast
 {
     // types...
     using handshake_handler = std::function<void(const boost::system::error_code& ec)>;
+    using deflate_chooser = std::function<boost::beast::websocket::permessage_deflate(boost::beast::string_view target)>;
     using read_handler  = std::function<void(const boost::beast::error_code& ec, std::size_t bytes_transferred)>;
     using write_handler = std::function<void(const boost::beast::error_code& ec, std::size_t bytes_transferred)>;
     using close_handler = std::function<void(const boost::system::error_code& ec)>;
@@ -386,7 +413,13 @@ namespace bzn::beast
 
         virtual void async_accept(bzn::asio::accept_handler handler) = 0;
 
-        virtual void async_read(boost::beast::multi_buffer& buffer, bzn::asio::read_handler handler) = 0;
+        // reads the upgrade request first and accepts with the permessage-deflate settings chosen for its target
+        virtual void async_accept(bzn::beast::deflate_chooser choose_deflate, bzn::asio::accept_handler handler) = 0;
+
+        virtual void async_read(boost::beast::flat_buffer& buffer, bzn::asio::read_handler handler) = 0;
+
+        // whether the last message read was a text frame
+        virtual bool got_text() = 0;
 
         virtual void async_write(const boost::asio::mutable_buffers_1& buffer, bzn::asio::write_handler handler) = 0;
 
@@ -397,6 +430,9 @@ namespace bzn::beast
         virtual void async_handshake(const std::string& host, const std::string& target, bzn::beast::handshake_handler handler) = 0;
 
         virtual bool is_open() = 0;
+
+        // whether both ends agreed on permessage-deflate when the connection was accepted or handshaken
+        virtual bool is_deflate_negotiated() = 0;
     };
 
     ///////////////////////////////////////////////////////////////////////////
@@ -419,11 +455,35 @@ namespace bzn::beast
             this->websocket.async_accept(handler);
         }
 
-        void async_read(boost::beast::multi_buffer& buffer, bzn::asio::read_handler handler) override
+        void async_accept(bzn::beast::deflate_chooser choose_deflate, bzn::asio::accept_handler handler) override
+        {
+            boost::beast::http::async_read(this->websocket.next_layer(), this->upgrade_buffer, this->upgrade_request,
+                [this, choose_deflate, handler](const boost::beast::error_code& ec, std::size_t /*bytes_transferred*/)
+                {
+                    if (ec)
+                    {
+                        handler(ec);
+                        return;
+                    }
+
+                    const auto options = choose_deflate(this->upgrade_request.target());
+                    this->websocket.set_option(options);
+                    this->deflate_negotiated = options.server_enable && offers_deflate(this->upgrade_request);
+
+                    this->websocket.async_accept(this->upgrade_request, handler);
+                });
+        }
+
+        void async_read(boost::beast::flat_buffer& buffer, bzn::asio::read_handler handler) override
         {
             this->websocket.async_read(buffer, handler);
         }
 
+        bool got_text() override
+        {
+            return this->websocket.got_text();
+        }
+
         void async_write(const boost::asio::mutable_buffers_1& buffer, bzn::asio::write_handler handler) override
         {
             this->websocket.async_write(buffer, handler);
@@ -441,7 +501,12 @@ namespace bzn::beast
 
         void async_handshake(const std::string& host, const std::string& target, bzn::beast::handshake_handler handler) override
         {
-            this->websocket.async_handshake(host, target, handler);
+            this->websocket.async_handshake(this->handshake_response, host, target,
+                [this, handler](const boost::beast::error_code& ec)
+                {
+                    this->deflate_negotiated = !ec && offers_deflate(this->handshake_response);
+                    handler(ec);
+                });
         }
 
         bool is_open() override
@@ -449,8 +514,23 @@ namespace bzn::beast
             return this->websocket.is_open();
         }
 
+        bool is_deflate_negotiated() override
+        {
+            return this->deflate_negotiated;
+        }
+
     private:
+        template<typename Message>
+        static bool offers_deflate(const Message& msg)
+        {
+            return msg[boost::beast::http::field::sec_websocket_extensions].find("permessage-deflate") != boost::beast::string_view::npos;
+        }
+
         boost::beast::websocket::stream<boost::asio::ip::tcp::socket> websocket;
+        boost::beast::flat_buffer upgrade_buffer;
+        boost::beast::http::request<boost::beast::http::string_body> upgrade_request;
+        boost::beast::websocket::response_type handshake_response;
+        bool deflate_negotiated = false;
     };
 
     ///////////////////////////////////////////////////////////////////////////
@@ -85,6 +85,8 @@ namespace bzn::asio {
             bzn::asio::write_handler(write_handler handler));
         MOCK_METHOD1(wrap,
             bzn::asio::close_handler(close_handler handler));
+        MOCK_METHOD1(dispatch,
+            void(bzn::asio::task task));
         MOCK_METHOD0(get_strand,
             boost::asio::io_context::strand&());
     };
@@ -144,8 +146,12 @@ namespace bzn::beast {
             boost::beast::websocket::stream<boost::asio::ip::tcp::socket>&());
         MOCK_METHOD1(async_accept,
             void(bzn::asio::accept_handler handler));
+        MOCK_METHOD2(async_accept,
+            void(bzn::beast::deflate_chooser choose_deflate, bzn::asio::accept_handler handler));
         MOCK_METHOD2(async_read,
-            void(boost::beast::multi_buffer& buffer, bzn::asio::read_handler handler));
+            void(boost::beast::flat_buffer& buffer, bzn::asio::read_handler handler));
+        MOCK_METHOD0(got_text,
+            bool());
         MOCK_METHOD2(async_write,
             void(const boost::asio::mutable_buffers_1& buffer, bzn::asio::write_handler handler));
         MOCK_METHOD2(write,
@@ -156,6 +162,8 @@ namespace bzn::beast {
             void(const std::string& host, const std::string& target, bzn::beast::handshake_handler handler));
         MOCK_METHOD0(is_open,
             bool());
+        MOCK_METHOD0(is_deflate_negotiated,
+            bool());
     };
 
 }  // namespace bzn::beast
@@ -42,6 +42,14 @@ namespace bzn {
             void(const database_msg& request, const std::shared_ptr<bzn::session_base>& session));
         MOCK_METHOD0(start,
             void());
+        MOCK_METHOD1(query,
+            std::optional<database_response>(const database_msg& request));
+        MOCK_METHOD0(save_state,
+            bool());
+        MOCK_METHOD2(get_saved_state_chunk,
+            std::shared_ptr<std::string>(size_t chunk, size_t chunk_count));
+        MOCK_METHOD3(load_state_chunk,
+            bool(size_t chunk, size_t chunk_count, const std::string& data));
     };
 
 }  // namespace bzn
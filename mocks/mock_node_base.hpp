@@ -28,6 +28,8 @@ class Mocknode_base : public node_base {
       bool(const std::string& msg_type, bzn::message_handler message_handler));
   MOCK_METHOD2(register_for_message,
       bool(const bzn_envelope::PayloadCase msg_type, bzn::protobuf_handler message_handler));
+  MOCK_METHOD3(register_backlog,
+      void(const std::string& name, std::function<size_t()> depth, size_t limit));
   MOCK_METHOD0(start,
       void());
   MOCK_METHOD2(send_message,
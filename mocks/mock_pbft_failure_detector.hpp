@@ -25,7 +25,9 @@ namespace bzn
     public:
         MOCK_METHOD1(request_seen, void(const pbft_request& req));
 
-        MOCK_METHOD1(request_executed, void(const pbft_request& req));
+        MOCK_METHOD2(request_executed, void(const pbft_request& req, uint64_t sequence));
+
+        MOCK_METHOD1(stable_checkpoint_reached, void(uint64_t sequence));
 
         MOCK_METHOD1(register_failure_handler, void(std::function<void()> handler));
     };
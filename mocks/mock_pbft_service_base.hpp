@@ -24,8 +24,8 @@ namespace bzn {
      public:
       MOCK_METHOD2(apply_operation,
           void(const pbft_request& request, uint64_t sequence_number));
-      MOCK_CONST_METHOD2(query,
-          void(const pbft_request& request, uint64_t sequence_number));
+      MOCK_CONST_METHOD1(query,
+          database_response(const pbft_request& request));
       MOCK_CONST_METHOD1(service_state_hash,
           bzn::hash_t(uint64_t sequence_number));
       MOCK_METHOD1(consolidate_log,
@@ -34,6 +34,18 @@ namespace bzn {
           void(std::function<void(const pbft_request&, uint64_t)> handler));
       MOCK_METHOD1(apply_operation,
           void(const std::shared_ptr<pbft_operation>&));
+      MOCK_METHOD1(apply_operation_tentatively,
+          void(const std::shared_ptr<pbft_operation>&));
+      MOCK_METHOD0(rollback_tentative_operations,
+          std::vector<pbft_request>());
+      MOCK_CONST_METHOD1(service_state_chunk_hashes,
+          std::vector<bzn::hash_t>(uint64_t sequence_number));
+      MOCK_CONST_METHOD2(get_service_state_chunk,
+          std::shared_ptr<std::string>(uint64_t sequence_number, size_t chunk));
+      MOCK_METHOD1(changed_service_state_chunks,
+          std::vector<size_t>(const std::vector<bzn::hash_t>& chunk_hashes));
+      MOCK_METHOD3(set_service_state,
+          bool(uint64_t sequence_number, const bzn::hash_t& state_hash, const std::map<size_t, std::string>& chunks));
     };
 
 }  // namespace bzn
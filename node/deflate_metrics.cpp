@@ -0,0 +1,112 @@
+// Copyright (C) 2018 Bluzelle
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU Affero General Public License, version 3,
+// as published by the Free Software Foundation.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU Affero General Public License for more details.
+//
+// You should have received a copy of the GNU Affero General Public License
+// along with this program. If not, see <http://www.gnu.org/licenses/>.
+
+#include <node/deflate_metrics.hpp>
+#include <boost/beast/zlib/deflate_stream.hpp>
+
+using namespace bzn;
+
+namespace
+{
+    // what beast's permessage_deflate uses by default
+    const int DEFLATE_MEM_LEVEL = 4;
+}
+
+
+boost::beast::websocket::permessage_deflate
+deflate_options::to_permessage_deflate(bool server) const
+{
+    boost::beast::websocket::permessage_deflate pmd;
+
+    pmd.server_enable = server && this->enabled;
+    pmd.client_enable = !server && this->enabled;
+    pmd.server_max_window_bits = this->window_bits;
+    pmd.client_max_window_bits = this->window_bits;
+    pmd.compLevel = this->level;
+
+    return pmd;
+}
+
+
+deflate_metrics::deflate_metrics(const deflate_options& options)
+    : options(options)
+{
+}
+
+
+void
+deflate_metrics::message_sent(const bzn::encoded_message& msg)
+{
+    this->bytes += msg.size();
+
+    if (this->messages++ % SAMPLE_INTERVAL)
+    {
+        return;
+    }
+
+    const auto sample = this->compress(msg);
+
+    std::lock_guard<std::mutex> lock(this->sample_lock);
+
+    ++this->sampled_messages;
+    this->sampled_bytes += msg.size();
+    this->sampled_compressed_bytes += sample.first;
+    this->sampled_time += sample.second;
+}
+
+
+std::pair<size_t, std::chrono::nanoseconds>
+deflate_metrics::compress(const bzn::encoded_message& msg) const
+{
+    const auto start = std::chrono::steady_clock::now();
+
+    boost::beast::zlib::deflate_stream stream;
+    stream.reset(this->options.level, this->options.window_bits, DEFLATE_MEM_LEVEL, boost::beast::zlib::Strategy::normal);
+
+    std::string out(stream.upper_bound(msg.size()), '\0');
+
+    boost::beast::zlib::z_params zs;
+    zs.next_in = msg.data();
+    zs.avail_in = msg.size();
+    zs.next_out = &out[0];
+    zs.avail_out = out.size();
+
+    // as the websocket does at the end of each message...
+    boost::beast::error_code ec;
+    stream.write(zs, boost::beast::zlib::Flush::sync, ec);
+
+    return {ec ? msg.size() : zs.total_out, std::chrono::steady_clock::now() - start};
+}
+
+
+bzn::json_message
+deflate_metrics::get_status() const
+{
+    bzn::json_message status;
+
+    std::lock_guard<std::mutex> lock(this->sample_lock);
+
+    const double ratio = this->sampled_bytes ? double(this->sampled_compressed_bytes) / this->sampled_bytes : 1.0;
+    const double ns_per_byte = this->sampled_bytes ? double(this->sampled_time.count()) / this->sampled_bytes : 0.0;
+
+    status["messages"] = static_cast<Json::UInt64>(this->messages);
+    status["bytes"] = static_cast<Json::UInt64>(this->bytes);
+    status["sampled"] = static_cast<Json::UInt64>(this->sampled_messages);
+    status["ratio"] = ratio;
+    status["estimated_bytes_saved"] = static_cast<Json::UInt64>(this->bytes * (1.0 - ratio));
+    status["compress_ns_per_byte"] = ns_per_byte;
+    status["estimated_compress_ms"] = static_cast<Json::UInt64>(this->bytes * ns_per_byte / 1e6);
+
+    return status;
+}
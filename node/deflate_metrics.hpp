@@ -0,0 +1,68 @@
+// Copyright (C) 2018 Bluzelle
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU Affero General Public License, version 3,
+// as published by the Free Software Foundation.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU Affero General Public License for more details.
+//
+// You should have received a copy of the GNU Affero General Public License
+// along with this program. If not, see <http://www.gnu.org/licenses/>.
+
+#pragma once
+
+#include <include/bluzelle.hpp>
+#include <include/boost_asio_beast.hpp>
+#include <atomic>
+#include <chrono>
+#include <mutex>
+
+
+namespace bzn
+{
+    // permessage-deflate settings for one kind of link
+    struct deflate_options
+    {
+        bool enabled = false;
+        int level = 6;
+        int window_bits = 15;
+
+        // what to offer (client) or accept (server) during the websocket handshake
+        boost::beast::websocket::permessage_deflate to_permessage_deflate(bool server) const;
+    };
+
+
+    // Counts what is sent compressed on one kind of link. Beast compresses inside the write and reports nothing, so
+    // every SAMPLE_INTERVAL'th message is compressed again here, on its own, to estimate the ratio and the CPU it costs.
+    // The estimate is conservative: the stream also reuses its window across messages.
+    class deflate_metrics final
+    {
+    public:
+        static const size_t SAMPLE_INTERVAL = 32;
+
+        explicit deflate_metrics(const deflate_options& options);
+
+        void message_sent(const bzn::encoded_message& msg);
+
+        bzn::json_message get_status() const;
+
+    private:
+        // compressed size and time taken
+        std::pair<size_t, std::chrono::nanoseconds> compress(const bzn::encoded_message& msg) const;
+
+        const deflate_options options;
+
+        std::atomic<uint64_t> messages{0};
+        std::atomic<uint64_t> bytes{0};
+
+        mutable std::mutex sample_lock;
+        uint64_t sampled_messages = 0;
+        uint64_t sampled_bytes = 0;
+        uint64_t sampled_compressed_bytes = 0;
+        std::chrono::nanoseconds sampled_time{0};
+    };
+
+} // namespace bzn
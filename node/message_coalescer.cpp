@@ -0,0 +1,215 @@
+// Copyright (C) 2018 Bluzelle
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU Affero General Public License, version 3,
+// as published by the Free Software Foundation.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU Affero General Public License for more details.
+//
+// You should have received a copy of the GNU Affero General Public License
+// along with this program. If not, see <http://www.gnu.org/licenses/>.
+
+#include <node/message_coalescer.hpp>
+
+using namespace bzn;
+
+namespace
+{
+    // protobuf writes fields in order of number, so only an envelope holding nothing but a batch starts with its tag
+    const char BATCH_TAG = static_cast<char>((bzn_envelope::kBatchFieldNumber << 3) | 2 /* length delimited */);
+}
+
+
+message_coalescer::message_coalescer(std::shared_ptr<bzn::asio::io_context_base> io_context, std::chrono::milliseconds window, size_t max_bytes,
+    send_handler send)
+    : io_context(std::move(io_context))
+    , window(window)
+    , max_bytes(max_bytes)
+    , send_frame(std::move(send))
+{
+}
+
+
+void
+message_coalescer::send(const boost::asio::ip::tcp::endpoint& ep, std::shared_ptr<bzn::encoded_message> msg)
+{
+    std::lock_guard<std::mutex> lock(this->lock);
+
+    ++this->messages;
+
+    auto& p = this->peers[ep];
+
+    if (!p.window_open)
+    {
+        ++this->frames;
+        this->send_frame(ep, std::move(msg));
+        this->open_window(ep, p);
+        return;
+    }
+
+    p.pending_bytes += msg->size();
+    p.pending.push_back(std::move(msg));
+
+    if (p.pending_bytes >= this->max_bytes)
+    {
+        this->flush(ep, p);
+    }
+}
+
+
+void
+message_coalescer::open_window(const boost::asio::ip::tcp::endpoint& ep, peer& p)
+{
+    if (!p.timer)
+    {
+        p.timer = this->io_context->make_unique_steady_timer();
+    }
+
+    p.window_open = true;
+
+    p.timer->expires_from_now(this->window);
+    p.timer->async_wait(
+        [weak_self = weak_from_this(), ep](const boost::system::error_code& ec)
+        {
+            auto self = weak_self.lock();
+
+            if (!ec && self)
+            {
+                self->window_closed(ep);
+            }
+        });
+}
+
+
+void
+message_coalescer::window_closed(const boost::asio::ip::tcp::endpoint& ep)
+{
+    std::lock_guard<std::mutex> lock(this->lock);
+
+    auto it = this->peers.find(ep);
+    if (it == this->peers.end())
+    {
+        return;
+    }
+
+    auto& p = it->second;
+
+    if (p.pending.empty())
+    {
+        // quiet again, so the next message goes straight out...
+        p.window_open = false;
+        return;
+    }
+
+    this->flush(ep, p);
+    this->open_window(ep, p);
+}
+
+
+void
+message_coalescer::flush(const boost::asio::ip::tcp::endpoint& ep, peer& p)
+{
+    if (p.pending.empty())
+    {
+        return;
+    }
+
+    ++this->frames;
+
+    if (p.pending.size() == 1)
+    {
+        this->send_frame(ep, std::move(p.pending.front()));
+    }
+    else
+    {
+        ++this->batches;
+        this->batched_messages += p.pending.size();
+        this->send_frame(ep, pack(p.pending));
+    }
+
+    p.pending.clear();
+    p.pending_bytes = 0;
+}
+
+
+std::shared_ptr<bzn::encoded_message>
+message_coalescer::pack(const std::vector<std::shared_ptr<bzn::encoded_message>>& msgs)
+{
+    bzn_envelope_batch batch;
+
+    for (const auto& msg : msgs)
+    {
+        // merged rather than nested; the envelopes in it are moved over as they are, without parsing any of them...
+        if (bzn_envelope outer; is_batch(*msg) && outer.ParseFromString(*msg))
+        {
+            if (bzn_envelope_batch inner; inner.ParseFromString(outer.batch()))
+            {
+                for (auto& envelope : *inner.mutable_envelopes())
+                {
+                    batch.add_envelopes(std::move(envelope));
+                }
+
+                continue;
+            }
+        }
+
+        batch.add_envelopes(*msg);
+    }
+
+    bzn_envelope envelope;
+    envelope.set_batch(batch.SerializeAsString());
+
+    return std::make_shared<bzn::encoded_message>(envelope.SerializeAsString());
+}
+
+
+bool
+message_coalescer::is_batch(const bzn::encoded_message& msg)
+{
+    return !msg.empty() && msg.front() == BATCH_TAG;
+}
+
+
+bool
+message_coalescer::unpack(const bzn_envelope& batch, std::vector<bzn_envelope>& envelopes)
+{
+    bzn_envelope_batch msgs;
+
+    if (!msgs.ParseFromString(batch.batch()))
+    {
+        return false;
+    }
+
+    envelopes.resize(msgs.envelopes_size());
+
+    for (int i = 0; i < msgs.envelopes_size(); ++i)
+    {
+        if (!envelopes[i].ParseFromString(msgs.envelopes(i)))
+        {
+            return false;
+        }
+    }
+
+    return true;
+}
+
+
+bzn::json_message
+message_coalescer::get_status() const
+{
+    std::lock_guard<std::mutex> lock(this->lock);
+
+    bzn::json_message status;
+
+    status["window_ms"] = static_cast<Json::UInt64>(this->window.count());
+    status["messages"] = static_cast<Json::UInt64>(this->messages);
+    status["frames"] = static_cast<Json::UInt64>(this->frames);
+    status["batches"] = static_cast<Json::UInt64>(this->batches);
+    status["batched_messages"] = static_cast<Json::UInt64>(this->batched_messages);
+    status["messages_per_frame"] = this->frames ? double(this->messages) / this->frames : 0.0;
+
+    return status;
+}
@@ -0,0 +1,85 @@
+// Copyright (C) 2018 Bluzelle
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU Affero General Public License, version 3,
+// as published by the Free Software Foundation.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU Affero General Public License for more details.
+//
+// You should have received a copy of the GNU Affero General Public License
+// along with this program. If not, see <http://www.gnu.org/licenses/>.
+
+#pragma once
+
+#include <include/bluzelle.hpp>
+#include <include/boost_asio_beast.hpp>
+#include <proto/bluzelle.pb.h>
+#include <chrono>
+#include <map>
+#include <mutex>
+#include <vector>
+
+
+namespace bzn
+{
+    // Packs bursts of envelopes for the same peer into one frame. The first message to a peer goes out at once and
+    // opens a window; what is sent to it during the window goes out together when the window closes, or as soon as it
+    // reaches the size limit, and opens the next. A peer sent to only now and then never waits.
+    class message_coalescer final : public std::enable_shared_from_this<message_coalescer>
+    {
+    public:
+        using send_handler = std::function<void(const boost::asio::ip::tcp::endpoint& ep, std::shared_ptr<bzn::encoded_message> msg)>;
+
+        message_coalescer(std::shared_ptr<bzn::asio::io_context_base> io_context, std::chrono::milliseconds window, size_t max_bytes, send_handler send);
+
+        // msg is a serialized bzn_envelope
+        void send(const boost::asio::ip::tcp::endpoint& ep, std::shared_ptr<bzn::encoded_message> msg);
+
+        bzn::json_message get_status() const;
+
+        // one envelope carrying the serialized envelopes given; batches among them have their envelopes carried
+        // instead, as batches within batches aren't unpacked
+        static std::shared_ptr<bzn::encoded_message> pack(const std::vector<std::shared_ptr<bzn::encoded_message>>& msgs);
+
+        // whether msg is a batch made by pack, told from its first byte without parsing it
+        static bool is_batch(const bzn::encoded_message& msg);
+
+        // the envelopes a batch envelope carries, false if any of them can't be parsed
+        static bool unpack(const bzn_envelope& batch, std::vector<bzn_envelope>& envelopes);
+
+    private:
+        struct peer
+        {
+            std::vector<std::shared_ptr<bzn::encoded_message>> pending;
+            size_t pending_bytes = 0;
+            bool window_open = false;
+            std::unique_ptr<bzn::asio::steady_timer_base> timer;
+        };
+
+        // needs lock
+        void open_window(const boost::asio::ip::tcp::endpoint& ep, peer& p);
+
+        void window_closed(const boost::asio::ip::tcp::endpoint& ep);
+
+        // needs lock
+        void flush(const boost::asio::ip::tcp::endpoint& ep, peer& p);
+
+        const std::shared_ptr<bzn::asio::io_context_base> io_context;
+        const std::chrono::milliseconds window;
+        const size_t max_bytes;
+        const send_handler send_frame;
+
+        // held while sending too, so a peer's messages keep their order...
+        mutable std::mutex lock;
+        std::map<boost::asio::ip::tcp::endpoint, peer> peers;
+
+        uint64_t messages = 0;
+        uint64_t frames = 0;
+        uint64_t batches = 0;
+        uint64_t batched_messages = 0;
+    };
+
+} // namespace bzn
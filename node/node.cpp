@@ -15,54 +15,233 @@
 #include <include/bluzelle.hpp>
 #include <node/node.hpp>
 #include <node/session.hpp>
+#include <algorithm>
 
 using namespace bzn;
 
 namespace
 {
     const std::string BZN_API_KEY = "bzn-api";
+    const std::string NODE_STATUS_NAME = "node";
+
+
+    // which queue a handler waits in, going by what it was registered for...
+    bzn::traffic_class
+    classify(const std::string& api)
+    {
+        if (api == "raft")
+        {
+            return bzn::traffic_class::protocol;
+        }
+
+        if (api == "status" || api == "audit" || api == "metrics")
+        {
+            return bzn::traffic_class::telemetry;
+        }
+
+        return bzn::traffic_class::client;
+    }
+
+
+    bzn::traffic_class
+    classify(bzn_envelope::PayloadCase type)
+    {
+        switch (type)
+        {
+            case bzn_envelope::kPbft:
+            case bzn_envelope::kPbftMembership:
+                return bzn::traffic_class::protocol;
+
+            case bzn_envelope::kAudit:
+            case bzn_envelope::kStatusRequest:
+                return bzn::traffic_class::telemetry;
+
+            default:
+                return bzn::traffic_class::client;
+        }
+    }
 }
 
 
 node::node(std::shared_ptr<bzn::asio::io_context_base> io_context, std::shared_ptr<bzn::beast::websocket_base> websocket, std::shared_ptr<chaos_base> chaos, const std::chrono::milliseconds& ws_idle_timeout,
-    const boost::asio::ip::tcp::endpoint& ep, std::shared_ptr<bzn::crypto_base> crypto, std::shared_ptr<bzn::options_base> options)
-    : tcp_acceptor(io_context->make_unique_tcp_acceptor(ep))
-    , io_context(std::move(io_context))
+    const boost::asio::ip::tcp::endpoint& ep, std::shared_ptr<bzn::crypto_base> crypto, std::shared_ptr<bzn::options_base> options,
+    std::vector<std::shared_ptr<bzn::asio::io_context_base>> network_reactors)
+    : io_context(std::move(io_context))
+    , network_reactors(std::move(network_reactors))
     , websocket(std::move(websocket))
     , chaos(std::move(chaos))
     , ws_idle_timeout(ws_idle_timeout)
     , crypto(std::move(crypto))
     , options(std::move(options))
 {
+    // each network reactor listens on the port itself...
+    for (const auto& reactor : this->network_reactors.empty() ? std::vector<std::shared_ptr<bzn::asio::io_context_base>>{this->io_context} : this->network_reactors)
+    {
+        this->listeners.push_back(std::make_shared<listener>(listener{reactor, reactor->make_unique_tcp_acceptor(ep), nullptr}));
+    }
+
+    if (this->options)
+    {
+        if (auto size = this->options->get_simple_options().get<size_t>(bzn::option_names::WS_WRITE_QUEUE_SIZE))
+        {
+            this->ws_write_queue_size = size;
+        }
+
+        const auto overflow = this->options->get_simple_options().get<std::string>(bzn::option_names::WS_WRITE_QUEUE_OVERFLOW);
+
+        if (overflow == "drop_newest")
+        {
+            this->ws_write_overflow = bzn::session::write_overflow_policy::drop_newest;
+        }
+        else if (overflow == "close")
+        {
+            this->ws_write_overflow = bzn::session::write_overflow_policy::close;
+        }
+        else if (!overflow.empty() && overflow != "drop_oldest")
+        {
+            LOG(error) << "unknown " << bzn::option_names::WS_WRITE_QUEUE_OVERFLOW << " '" << overflow << "', dropping oldest messages";
+        }
+
+        if (this->options->get_simple_options().has(bzn::option_names::WS_MAX_IN_FLIGHT_MESSAGES))
+        {
+            this->ws_max_in_flight_messages = this->options->get_simple_options().get<size_t>(bzn::option_names::WS_MAX_IN_FLIGHT_MESSAGES);
+        }
+
+        if (this->options->get_simple_options().has(bzn::option_names::WS_MAX_IN_FLIGHT_BYTES))
+        {
+            this->ws_max_in_flight_bytes = this->options->get_simple_options().get<size_t>(bzn::option_names::WS_MAX_IN_FLIGHT_BYTES);
+        }
+
+        this->peer_deflate.enabled = this->options->get_simple_options().get<bool>(bzn::option_names::WS_DEFLATE_PEERS);
+        this->client_deflate.enabled = this->options->get_simple_options().get<bool>(bzn::option_names::WS_DEFLATE_CLIENTS);
+
+        // out of range settings are rejected when the options are validated...
+        if (this->options->get_simple_options().has(bzn::option_names::WS_DEFLATE_LEVEL))
+        {
+            this->peer_deflate.level = this->options->get_simple_options().get<int>(bzn::option_names::WS_DEFLATE_LEVEL);
+        }
+
+        if (this->options->get_simple_options().has(bzn::option_names::WS_DEFLATE_WINDOW_BITS))
+        {
+            this->peer_deflate.window_bits = this->options->get_simple_options().get<int>(bzn::option_names::WS_DEFLATE_WINDOW_BITS);
+        }
+
+        this->client_deflate.level = this->peer_deflate.level;
+        this->client_deflate.window_bits = this->peer_deflate.window_bits;
+    }
+
+    if (this->peer_deflate.enabled)
+    {
+        this->peer_deflate_metrics = std::make_shared<bzn::deflate_metrics>(this->peer_deflate);
+    }
+
+    if (this->client_deflate.enabled)
+    {
+        this->client_deflate_metrics = std::make_shared<bzn::deflate_metrics>(this->client_deflate);
+    }
+
+    this->connection_pool = std::make_shared<bzn::peer_connection_pool>(this->io_context, this->websocket,
+        [this](std::shared_ptr<bzn::asio::io_context_base> io_context, std::shared_ptr<bzn::beast::websocket_stream_base> ws)
+        {
+            // a pbft message can't just be dropped, so a peer link that falls behind is closed and the pool reconnects...
+            auto session = this->make_session(std::move(io_context), std::move(ws), this->peer_deflate_metrics,
+                bzn::session::write_overflow_policy::close);
+            session->set_gather_writes(true);
+            session->start(std::bind(&node::priv_msg_handler, shared_from_this(), std::placeholders::_1, std::placeholders::_2),
+                           std::bind(&node::priv_protobuf_handler, shared_from_this(), std::placeholders::_1, std::placeholders::_2));
+            return session;
+        });
+
+    this->connection_pool->set_deflate(this->peer_deflate);
+    this->connection_pool->set_reactors(this->network_reactors);
+
+    if (this->options && this->options->get_simple_options().get<size_t>(bzn::option_names::WS_COALESCE_WINDOW_MS))
+    {
+        this->coalescer = std::make_shared<bzn::message_coalescer>(this->io_context,
+            std::chrono::milliseconds(this->options->get_simple_options().get<size_t>(bzn::option_names::WS_COALESCE_WINDOW_MS)),
+            this->options->get_simple_options().get<size_t>(bzn::option_names::WS_COALESCE_MAX_BYTES),
+            [pool = this->connection_pool](const boost::asio::ip::tcp::endpoint& ep, std::shared_ptr<bzn::encoded_message> msg)
+            {
+                pool->send(ep, std::move(msg));
+            });
+    }
+
+    if (this->options && this->options->get_simple_options().get<bool>(bzn::option_names::TRAFFIC_SCHEDULING))
+    {
+        this->traffic_scheduler = std::make_shared<bzn::traffic_scheduler>(this->io_context,
+            this->options->get_simple_options().get<size_t>(bzn::option_names::TRAFFIC_CLIENT_WEIGHT),
+            this->options->get_simple_options().get<size_t>(bzn::option_names::TRAFFIC_TELEMETRY_WEIGHT));
+    }
+
+    if (this->crypto && this->options && this->options->get_simple_options().get<bool>(bzn::option_names::CRYPTO_ENABLED_INCOMING))
+    {
+        const auto queue_size = this->options->get_simple_options().get<size_t>(bzn::option_names::CRYPTO_VERIFY_QUEUE_SIZE);
+
+        // reads pause once the queue size is reached, which leaves room for the frames already being read by other
+        // sessions; the pool only turns messages away past twice that...
+        this->verification_pool = std::make_shared<bzn::verification_pool>(this->crypto,
+            this->options->get_simple_options().get<size_t>(bzn::option_names::CRYPTO_VERIFY_THREADS),
+            2 * queue_size);
+
+        this->verification_pool->start();
+
+        this->register_backlog("verification",
+            [pool = std::weak_ptr<bzn::verification_pool>(this->verification_pool)]()
+            {
+                auto strong_pool = pool.lock();
+                return strong_pool ? strong_pool->get_queue_depth() : size_t(0);
+            },
+            queue_size);
+    }
+}
+
+
+node::~node()
+{
+    if (this->verification_pool)
+    {
+        this->verification_pool->stop();
+    }
 }
 
 
 void
 node::start()
 {
-    std::call_once(this->start_once, &node::do_accept, this);
+    std::call_once(this->start_once,
+        [this]()
+        {
+            for (const auto& l : this->listeners)
+            {
+                this->do_accept(l);
+            }
+        });
 }
 
 
 bool
 node::register_for_message(const std::string& msg_type, bzn::message_handler msg_handler)
 {
-    std::lock_guard<std::mutex> lock(this->message_map_mutex);
-
     // never allow!
     if (!msg_handler)
     {
         return false;
     }
 
-    if (this->message_map.find(msg_type) != this->message_map.end())
+    std::lock_guard<std::mutex> lock(this->register_mutex);
+
+    auto tables = std::make_shared<handler_tables>(*this->get_handlers());
+
+    if (tables->message_map.find(msg_type) != tables->message_map.end())
     {
         LOG(debug) << msg_type << " message type already registered";
 
         return false;
     }
 
-    this->message_map[msg_type] = std::move(msg_handler);
+    tables->message_map[msg_type] = std::move(msg_handler);
+
+    std::atomic_store(&this->handlers, std::shared_ptr<const handler_tables>(std::move(tables)));
 
     return true;
 }
@@ -71,34 +250,70 @@ node::register_for_message(const std::string& msg_type, bzn::message_handler msg
 bool
 node::register_for_message(const bzn_envelope::PayloadCase type, bzn::protobuf_handler msg_handler)
 {
-    std::lock_guard<std::mutex> lock(this->message_map_mutex);
-
     // never allow!
     if (!msg_handler)
     {
         return false;
     }
 
-    if (this->protobuf_map.find(type) != this->protobuf_map.end())
+    std::lock_guard<std::mutex> lock(this->register_mutex);
+
+    auto tables = std::make_shared<handler_tables>(*this->get_handlers());
+
+    if (tables->protobuf_map.find(type) != tables->protobuf_map.end())
     {
         LOG(debug) << type << " message type already registered";
 
         return false;
     }
 
-    this->protobuf_map[type] = std::move(msg_handler);
+    tables->protobuf_map[type] = std::move(msg_handler);
+
+    std::atomic_store(&this->handlers, std::shared_ptr<const handler_tables>(std::move(tables)));
 
     return true;
 }
 
 
 void
-node::do_accept()
+node::register_backlog(const std::string& name, std::function<size_t()> depth, size_t limit)
+{
+    std::lock_guard<std::mutex> lock(this->register_mutex);
+
+    auto updated = std::make_shared<std::vector<backlog>>(*std::atomic_load(&this->backlogs));
+    updated->push_back({name, std::move(depth), limit});
+
+    std::atomic_store(&this->backlogs, std::shared_ptr<const std::vector<backlog>>(std::move(updated)));
+}
+
+
+bool
+node::downstream_saturated() const
 {
-    this->acceptor_socket = this->io_context->make_unique_tcp_socket();
+    const auto current = std::atomic_load(&this->backlogs);
 
-    this->tcp_acceptor->async_accept(*this->acceptor_socket,
-        [self = shared_from_this()](const boost::system::error_code& ec)
+    return std::any_of(current->begin(), current->end(),
+        [](const backlog& b)
+        {
+            return b.limit && b.depth() >= b.limit;
+        });
+}
+
+
+std::shared_ptr<const node::handler_tables>
+node::get_handlers() const
+{
+    return std::atomic_load(&this->handlers);
+}
+
+
+void
+node::do_accept(std::shared_ptr<listener> l)
+{
+    l->acceptor_socket = l->io_context->make_unique_tcp_socket();
+
+    l->tcp_acceptor->async_accept(*l->acceptor_socket,
+        [self = shared_from_this(), l](const boost::system::error_code& ec)
         {
             if (ec)
             {
@@ -106,20 +321,52 @@ node::do_accept()
             }
             else
             {
-                auto ep = self->acceptor_socket->remote_endpoint();
+                auto ep = l->acceptor_socket->remote_endpoint();
 
                 LOG(debug) << "connection from: " << ep.address() << ":" << ep.port();
 
                 auto ws = self->websocket->make_unique_websocket_stream(
-                    self->acceptor_socket->get_tcp_socket());
+                    l->acceptor_socket->get_tcp_socket());
+
+                // writes on accepted connections are mostly responses to clients...
+                auto session = self->make_session(l->io_context, std::move(ws), self->client_deflate_metrics, self->ws_write_overflow);
+
+                if (self->peer_deflate.enabled || self->client_deflate.enabled)
+                {
+                    session->set_accept_deflate(
+                        [peers = self->peer_deflate, clients = self->client_deflate](boost::beast::string_view target)
+                        {
+                            return (target == bzn::peer_connection_pool::PEER_TARGET ? peers : clients).to_permessage_deflate(true);
+                        });
+                }
 
-                std::make_shared<bzn::session>(self->io_context, ++self->session_id_counter, std::move(ws), self->chaos, self->ws_idle_timeout)->start(
+                session->start(
                         std::bind(&node::priv_msg_handler, self, std::placeholders::_1, std::placeholders::_2),
                         std::bind(&node::priv_protobuf_handler, self, std::placeholders::_1, std::placeholders::_2));
             }
 
-            self->do_accept();
+            self->do_accept(l);
+        });
+}
+
+
+std::shared_ptr<bzn::session>
+node::make_session(std::shared_ptr<bzn::asio::io_context_base> io_context, std::shared_ptr<bzn::beast::websocket_stream_base> ws,
+    std::shared_ptr<bzn::deflate_metrics> deflate_metrics, bzn::session::write_overflow_policy overflow_policy)
+{
+    auto session = std::make_shared<bzn::session>(std::move(io_context), ++this->session_id_counter, std::move(ws), this->chaos, this->ws_idle_timeout,
+        this->ws_write_queue_size, overflow_policy);
+
+    session->set_deflate_metrics(std::move(deflate_metrics));
+
+    session->set_flow_control(this->ws_max_in_flight_messages, this->ws_max_in_flight_bytes,
+        [weak_self = weak_from_this()]()
+        {
+            auto self = weak_self.lock();
+            return self && self->downstream_saturated();
         });
+
+    return session;
 }
 
 
@@ -128,11 +375,18 @@ node::priv_msg_handler(const Json::Value& msg, std::shared_ptr<bzn::session_base
 {
     if (msg.isMember(BZN_API_KEY))
     {
-        std::lock_guard<std::mutex> lock(this->message_map_mutex);
+        const auto tables = this->get_handlers();
 
-        if (auto it = this->message_map.find(msg[BZN_API_KEY].asString()); it != this->message_map.end())
+        if (auto it = tables->message_map.find(msg[BZN_API_KEY].asString()); it != tables->message_map.end())
         {
-            it->second(msg, std::move(session));
+            if (!this->is_deferred())
+            {
+                it->second(msg, std::move(session));
+            }
+            else
+            {
+                this->post_handler(classify(it->first), session, session->hold_read_credit(), std::bind(it->second, msg, session));
+            }
             return;
         }
     }
@@ -145,28 +399,156 @@ node::priv_msg_handler(const Json::Value& msg, std::shared_ptr<bzn::session_base
 void
 node::priv_protobuf_handler(const bzn_envelope& msg, std::shared_ptr<bzn::session_base> session)
 {
-    std::lock_guard<std::mutex> lock(this->message_map_mutex);
+    if (msg.payload_case() == bzn_envelope::kBatch)
+    {
+        // each was signed on its own, so each is verified and dispatched on its own...
+        std::vector<bzn_envelope> envelopes;
+        if (!bzn::message_coalescer::unpack(msg, envelopes))
+        {
+            LOG(error) << "Dropping malformed batch of envelopes";
+            return;
+        }
+
+        for (const auto& envelope : envelopes)
+        {
+            if (envelope.payload_case() != bzn_envelope::kBatch)
+            {
+                this->priv_protobuf_handler(envelope, session);
+            }
+        }
 
-    if (this->options->get_simple_options().get<bool>(bzn::option_names::CRYPTO_ENABLED_INCOMING)
-        && (!msg.sender().empty())
-        && (!this->crypto->verify(msg))
-    )
+        return;
+    }
+
+    if (this->verification_pool && !msg.sender().empty())
     {
-        LOG(error) << "Dropping message with invalid signature: " << msg.ShortDebugString().substr(0, MAX_MESSAGE_SIZE);
+        // verified on the pool and dispatched from there in per sender order...
+        // the message keeps its session's read credit until it has been verified and dispatched...
+        const bool accepted = this->verification_pool->submit(msg,
+            [weak_self = weak_from_this(), credit = session->hold_read_credit(), session](const bzn_envelope& msg, bool valid)
+            {
+                if (!valid)
+                {
+                    LOG(error) << "Dropping message with invalid signature: " << msg.ShortDebugString().substr(0, MAX_MESSAGE_SIZE);
+                    return;
+                }
+
+                if (auto self = weak_self.lock())
+                {
+                    self->dispatch_protobuf(msg, session, credit);
+                }
+            });
+
+        if (!accepted)
+        {
+            LOG(warning) << "Dropping message, verification queue is full: " << msg.ShortDebugString().substr(0, MAX_MESSAGE_SIZE);
+        }
+
         return;
     }
 
-    if (auto it = this->protobuf_map.find(msg.payload_case()); it != this->protobuf_map.end())
+    this->dispatch_protobuf(msg, session, session->hold_read_credit());
+}
+
+
+void
+node::dispatch_protobuf(const bzn_envelope& msg, std::shared_ptr<bzn::session_base> session, std::shared_ptr<void> credit)
+{
+    const auto tables = this->get_handlers();
+
+    if (auto it = tables->protobuf_map.find(msg.payload_case()); it != tables->protobuf_map.end())
     {
-        it->second(msg, std::move(session));
+        if (!this->is_deferred())
+        {
+            it->second(msg, std::move(session));
+        }
+        else
+        {
+            this->post_handler(classify(it->first), session, std::move(credit), std::bind(it->second, msg, session));
+        }
     }
     else
     {
         LOG(debug) << "no handler for message type " << msg.payload_case();
     }
+}
+
 
+bool
+node::is_deferred() const
+{
+    return this->traffic_scheduler || !this->network_reactors.empty();
 }
 
+
+void
+node::post_handler(bzn::traffic_class traffic, const std::shared_ptr<bzn::session_base>& session, std::shared_ptr<void> credit, std::function<void()> handler)
+{
+    auto run = [credit = std::move(credit), handler = std::move(handler)]()
+        {
+            handler();
+        };
+
+    if (this->traffic_scheduler)
+    {
+        // handlers of a session run in the order its messages arrived...
+        this->traffic_scheduler->submit(traffic, session->get_session_id(), std::move(run));
+        return;
+    }
+
+    boost::asio::post(this->io_context->get_io_context(), std::move(run));
+}
+
+
+std::string
+node::get_name()
+{
+    return NODE_STATUS_NAME;
+}
+
+
+bzn::json_message
+node::get_status()
+{
+    bzn::json_message status;
+
+    if (this->verification_pool)
+    {
+        status["verification"] = this->verification_pool->get_status();
+    }
+
+    status["connections"] = this->connection_pool->get_status();
+
+    if (this->coalescer)
+    {
+        status["coalescing"] = this->coalescer->get_status();
+    }
+
+    if (this->traffic_scheduler)
+    {
+        status["traffic"] = this->traffic_scheduler->get_status();
+    }
+
+    if (this->peer_deflate_metrics)
+    {
+        status["deflate"]["peers"] = this->peer_deflate_metrics->get_status();
+    }
+
+    if (this->client_deflate_metrics)
+    {
+        status["deflate"]["clients"] = this->client_deflate_metrics->get_status();
+    }
+
+    for (const auto& b : *std::atomic_load(&this->backlogs))
+    {
+        status["backlogs"][b.name]["depth"] = static_cast<Json::UInt64>(b.depth());
+        status["backlogs"][b.name]["limit"] = static_cast<Json::UInt64>(b.limit);
+    }
+
+    return status;
+}
+
+
 void
 node::send_message_str(const boost::asio::ip::tcp::endpoint& ep, std::shared_ptr<bzn::encoded_message> msg)
 {
@@ -182,39 +564,14 @@ node::send_message_str(const boost::asio::ip::tcp::endpoint& ep, std::shared_ptr
         return;
     }
 
-    std::shared_ptr<bzn::asio::tcp_socket_base> socket = this->io_context->make_unique_tcp_socket();
-
-    socket->async_connect(ep,
-            [self = shared_from_this(), socket, ep, msg](const boost::system::error_code& ec)
-            {
-                if (ec)
-                {
-                    LOG(error) << "failed to connect to: " << ep.address().to_string() << ":" << ep.port() << " - " << ec.message();
-
-                    return;
-                }
-
-                // we've completed the handshake...
-                std::shared_ptr<bzn::beast::websocket_stream_base> ws = self->websocket->make_unique_websocket_stream(socket->get_tcp_socket());
+    // only envelopes can be coalesced; JSON goes out as it is...
+    if (this->coalescer && bzn::session::classify_frame(false, msg->data(), msg->size()) == bzn::session::frame_type::protobuf)
+    {
+        this->coalescer->send(ep, std::move(msg));
+        return;
+    }
 
-                ws->async_handshake(ep.address().to_string(), "/",
-                        [self, ws, msg](const boost::system::error_code& ec)
-                        {
-                            if (ec)
-                            {
-                                LOG(error) << "handshake failed: " << ec.message();
-
-                                return;
-                            }
-
-                            auto session = std::make_shared<bzn::session>(self->io_context, ++self->session_id_counter, ws, self->chaos, self->ws_idle_timeout);
-                            session->start(std::bind(&node::priv_msg_handler, self, std::placeholders::_1, std::placeholders::_2),
-                                           std::bind(&node::priv_protobuf_handler, self, std::placeholders::_1, std::placeholders::_2));
-                            
-                            // send the message requested...
-                            session->send_message(msg, false);
-                        });
-            });
+    this->connection_pool->send(ep, std::move(msg));
 }
 
 void
@@ -16,9 +16,14 @@
 
 #include <include/boost_asio_beast.hpp>
 #include <node/node_base.hpp>
+#include <node/verification_pool.hpp>
+#include <node/message_coalescer.hpp>
+#include <node/peer_connection_pool.hpp>
+#include <node/traffic_scheduler.hpp>
 #include <chaos/chaos_base.hpp>
 #include <crypto/crypto_base.hpp>
 #include <options/options_base.hpp>
+#include <status/status_provider_base.hpp>
 #include <json/json.h>
 #include <mutex>
 #include <atomic>
@@ -28,16 +33,21 @@
 
 namespace bzn
 {
-    class node final : public bzn::node_base, public std::enable_shared_from_this<node>
+    class node final : public bzn::node_base, public bzn::status_provider_base, public std::enable_shared_from_this<node>
     {
     public:
         node(std::shared_ptr<bzn::asio::io_context_base> io_context, std::shared_ptr<bzn::beast::websocket_base> websocket, std::shared_ptr<bzn::chaos_base> chaos, const std::chrono::milliseconds& ws_idle_timeout,
-            const boost::asio::ip::tcp::endpoint& ep, std::shared_ptr<bzn::crypto_base> crypto, std::shared_ptr<bzn::options_base> options);
+            const boost::asio::ip::tcp::endpoint& ep, std::shared_ptr<bzn::crypto_base> crypto, std::shared_ptr<bzn::options_base> options,
+            std::vector<std::shared_ptr<bzn::asio::io_context_base>> network_reactors = {});
+
+        ~node();
 
         bool register_for_message(const std::string& msg_type, bzn::message_handler msg_handler) override;
 
         bool register_for_message(const bzn_envelope::PayloadCase type, bzn::protobuf_handler msg_handler) override;
 
+        void register_backlog(const std::string& name, std::function<size_t()> depth, size_t limit) override;
+
         void start() override;
 
         void send_message(const boost::asio::ip::tcp::endpoint& ep, std::shared_ptr<bzn::json_message> msg) override;
@@ -46,25 +56,80 @@ namespace bzn
 
         void send_message_str(const boost::asio::ip::tcp::endpoint& ep, std::shared_ptr<bzn::encoded_message> msg) override;
 
+        std::string get_name() override;
+
+        bzn::json_message get_status() override;
+
     private:
         FRIEND_TEST(node, test_that_registered_message_handler_is_invoked);
+        FRIEND_TEST(node, test_that_handlers_can_be_registered_while_messages_are_dispatched);
+        FRIEND_TEST(node, test_that_backlogs_are_reported_and_saturate_at_their_limit);
         FRIEND_TEST(node, test_that_wrongly_signed_messages_are_dropped);
+        FRIEND_TEST(node, test_that_signed_messages_are_verified_off_the_calling_thread);
+        FRIEND_TEST(node, test_that_handlers_run_on_the_node_io_context_with_network_reactors);
+        FRIEND_TEST(node, test_that_batched_envelopes_are_each_dispatched);
+        FRIEND_TEST(node, test_that_protocol_messages_are_handled_before_queued_client_requests);
+
+        // an acceptor, and the reactor that owns the sessions it accepts
+        struct listener
+        {
+            std::shared_ptr<bzn::asio::io_context_base> io_context;
+            std::unique_ptr<bzn::asio::tcp_acceptor_base> tcp_acceptor;
+            std::unique_ptr<bzn::asio::tcp_socket_base> acceptor_socket;
+        };
 
-        void do_accept();
+        void do_accept(std::shared_ptr<listener> l);
+
+        std::shared_ptr<bzn::session> make_session(std::shared_ptr<bzn::asio::io_context_base> io_context, std::shared_ptr<bzn::beast::websocket_stream_base> ws,
+            std::shared_ptr<bzn::deflate_metrics> deflate_metrics, bzn::session::write_overflow_policy overflow_policy);
 
         void priv_msg_handler(const bzn::json_message& msg, std::shared_ptr<bzn::session_base> session);
         void priv_protobuf_handler(const bzn_envelope& msg, std::shared_ptr<bzn::session_base> session);
+        void dispatch_protobuf(const bzn_envelope& msg, std::shared_ptr<bzn::session_base> session, std::shared_ptr<void> credit);
+
+        // with traffic scheduling or network reactors, handlers run later on this node's io_context rather than on
+        // the thread that read the message, which keeps its read credit until then
+        bool is_deferred() const;
+        void post_handler(bzn::traffic_class traffic, const std::shared_ptr<bzn::session_base>& session, std::shared_ptr<void> credit, std::function<void()> handler);
 
-        std::unique_ptr<bzn::asio::tcp_acceptor_base> tcp_acceptor;
         std::shared_ptr<bzn::asio::io_context_base>   io_context;
-        std::unique_ptr<bzn::asio::tcp_socket_base>   acceptor_socket;
+        const std::vector<std::shared_ptr<bzn::asio::io_context_base>> network_reactors;
+        std::vector<std::shared_ptr<listener>>        listeners;
         std::shared_ptr<bzn::beast::websocket_base>   websocket;
         std::shared_ptr<bzn::chaos_base>              chaos;
         const std::chrono::milliseconds               ws_idle_timeout;
-
-        std::unordered_map<std::string, bzn::message_handler> message_map;
-        std::unordered_map<bzn_envelope::PayloadCase, bzn::protobuf_handler> protobuf_map;
-        std::mutex message_map_mutex;
+        size_t                                        ws_write_queue_size = bzn::session::DEFAULT_MAX_WRITE_QUEUE;
+        bzn::session::write_overflow_policy           ws_write_overflow = bzn::session::write_overflow_policy::drop_oldest;
+        size_t                                        ws_max_in_flight_messages = bzn::session::DEFAULT_MAX_IN_FLIGHT_MESSAGES;
+        size_t                                        ws_max_in_flight_bytes = bzn::session::DEFAULT_MAX_IN_FLIGHT_BYTES;
+        bzn::deflate_options                          peer_deflate;
+        bzn::deflate_options                          client_deflate;
+        std::shared_ptr<bzn::deflate_metrics>         peer_deflate_metrics;
+        std::shared_ptr<bzn::deflate_metrics>         client_deflate_metrics;
+
+        // Registration copies the tables and publishes the copy, so dispatch only has to load the current pointer
+        // and never waits on a lock held by another io thread...
+        struct handler_tables
+        {
+            std::unordered_map<std::string, bzn::message_handler> message_map;
+            std::unordered_map<bzn_envelope::PayloadCase, bzn::protobuf_handler> protobuf_map;
+        };
+
+        std::shared_ptr<const handler_tables> get_handlers() const;
+
+        struct backlog
+        {
+            std::string name;
+            std::function<size_t()> depth;
+            size_t limit;
+        };
+
+        // whether any registered backlog is at its limit
+        bool downstream_saturated() const;
+
+        std::shared_ptr<const handler_tables> handlers = std::make_shared<handler_tables>(); // only via atomic load/store
+        std::shared_ptr<const std::vector<backlog>> backlogs = std::make_shared<std::vector<backlog>>(); // likewise
+        std::mutex register_mutex;
 
         std::once_flag start_once;
 
@@ -72,6 +137,11 @@ namespace bzn
 
         std::shared_ptr<bzn::crypto_base> crypto;
         std::shared_ptr<bzn::options_base> options;
+
+        std::shared_ptr<bzn::verification_pool> verification_pool;
+        std::shared_ptr<bzn::peer_connection_pool> connection_pool;
+        std::shared_ptr<bzn::message_coalescer> coalescer;
+        std::shared_ptr<bzn::traffic_scheduler> traffic_scheduler;
     };
 
 } // bzn
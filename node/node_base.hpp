@@ -43,6 +43,14 @@ namespace bzn
          */
         virtual bool register_for_message(const bzn_envelope::PayloadCase type, bzn::protobuf_handler msg_handler) = 0;
 
+        /**
+         * Report a queue that incoming messages feed, so reading from connections pauses while it is full
+         * @param name          name shown in the node's status
+         * @param depth         current number of entries, called from io threads
+         * @param limit         depth at which reads pause
+         */
+        virtual void register_backlog(const std::string& name, std::function<size_t()> depth, size_t limit) = 0;
+
         /**
          * Start server's listener etc.
          */
@@ -0,0 +1,432 @@
+// Copyright (C) 2018 Bluzelle
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU Affero General Public License, version 3,
+// as published by the Free Software Foundation.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU Affero General Public License for more details.
+//
+// You should have received a copy of the GNU Affero General Public License
+// along with this program. If not, see <http://www.gnu.org/licenses/>.
+
+#include <node/peer_connection_pool.hpp>
+#include <sstream>
+
+using namespace bzn;
+
+namespace
+{
+    // one attempt at connecting to a peer; whichever of it finishing and its deadline comes first settles it
+    struct connect_state
+    {
+        std::mutex lock;
+        std::shared_ptr<bzn::beast::websocket_stream_base> ws;
+        bool settled = false;
+    };
+
+
+    std::string
+    to_string(const boost::asio::ip::tcp::endpoint& ep)
+    {
+        std::stringstream ss;
+        ss << ep;
+        return ss.str();
+    }
+}
+
+
+peer_connection_pool::peer_connection_pool(std::shared_ptr<bzn::asio::io_context_base> io_context, std::shared_ptr<bzn::beast::websocket_base> websocket,
+    session_factory make_session, std::chrono::milliseconds idle_timeout, std::chrono::milliseconds min_backoff, std::chrono::milliseconds max_backoff,
+    std::chrono::milliseconds connect_timeout)
+    : io_context(std::move(io_context))
+    , websocket(std::move(websocket))
+    , make_session(std::move(make_session))
+    , idle_timeout(idle_timeout)
+    , min_backoff(min_backoff)
+    , max_backoff(max_backoff)
+    , connect_timeout(connect_timeout)
+{
+}
+
+
+void
+peer_connection_pool::set_deflate(const bzn::deflate_options& options)
+{
+    this->deflate = options;
+}
+
+
+void
+peer_connection_pool::set_reactors(std::vector<std::shared_ptr<bzn::asio::io_context_base>> reactors)
+{
+    this->reactors = std::move(reactors);
+}
+
+
+void
+peer_connection_pool::send(const boost::asio::ip::tcp::endpoint& ep, std::shared_ptr<bzn::encoded_message> msg)
+{
+    const auto now = std::chrono::steady_clock::now();
+
+    std::shared_ptr<bzn::session> session;
+    std::vector<std::shared_ptr<bzn::session>> idle;
+    std::shared_ptr<bzn::asio::io_context_base> reactor;
+    uint64_t attempt = 0;
+    {
+        std::lock_guard<std::mutex> lock(this->lock);
+
+        auto& conn = this->connections[ep];
+        conn.last_used = now;
+
+        if (conn.session && !conn.session->is_open())
+        {
+            LOG(debug) << "connection to " << to_string(ep) << " was closed";
+            conn.session.reset();
+        }
+
+        if (conn.session)
+        {
+            session = conn.session;
+            ++conn.sent;
+            ++this->messages_sent;
+            ++this->messages_reused;
+        }
+        else
+        {
+            conn.pending.push_back(std::move(msg));
+
+            if (conn.pending.size() > MAX_PENDING_MESSAGES)
+            {
+                conn.pending.pop_front();
+                ++this->messages_dropped;
+            }
+
+            if (!conn.connecting && now >= conn.retry_after)
+            {
+                conn.connecting = true;
+                conn.connect_started = now;
+                attempt = ++conn.attempt;
+                reactor = this->next_connection_reactor();
+            }
+        }
+
+        if (now - this->last_eviction >= this->idle_timeout)
+        {
+            idle = this->evict_idle(now);
+            this->last_eviction = now;
+        }
+    }
+
+    for (const auto& idle_session : idle)
+    {
+        idle_session->close();
+    }
+
+    if (session)
+    {
+        session->send_message(std::move(msg), false);
+    }
+    else if (attempt)
+    {
+        this->connect(std::move(reactor), ep, attempt);
+    }
+}
+
+
+void
+peer_connection_pool::connect(std::shared_ptr<bzn::asio::io_context_base> reactor, const boost::asio::ip::tcp::endpoint& ep, uint64_t attempt)
+{
+    std::shared_ptr<bzn::asio::tcp_socket_base> socket = reactor->make_unique_tcp_socket();
+    std::shared_ptr<bzn::asio::steady_timer_base> deadline = reactor->make_unique_steady_timer();
+    auto state = std::make_shared<connect_state>();
+
+    // a peer that accepts but never answers would otherwise leave us connecting for good...
+    deadline->expires_from_now(this->connect_timeout);
+    deadline->async_wait(
+        [weak_self = weak_from_this(), socket, state, ep, attempt](const boost::system::error_code& ec)
+        {
+            {
+                std::lock_guard<std::mutex> lock(state->lock);
+
+                if (ec || state->settled)
+                {
+                    return;
+                }
+
+                state->settled = true;
+
+                boost::system::error_code ignored;
+                (state->ws ? state->ws->get_websocket().next_layer() : socket->get_tcp_socket()).close(ignored);
+            }
+
+            if (auto self = weak_self.lock())
+            {
+                self->connect_failed(ep, attempt, "timed out");
+            }
+        });
+
+    socket->async_connect(ep,
+        [self = shared_from_this(), reactor, socket, deadline, state, ep, attempt](const boost::system::error_code& ec)
+        {
+            std::lock_guard<std::mutex> lock(state->lock);
+
+            if (state->settled)
+            {
+                return;
+            }
+
+            if (ec)
+            {
+                state->settled = true;
+                deadline->cancel();
+                self->connect_failed(ep, attempt, ec.message());
+                return;
+            }
+
+            std::shared_ptr<bzn::beast::websocket_stream_base> ws = self->websocket->make_unique_websocket_stream(socket->get_tcp_socket());
+            state->ws = ws;
+
+            if (self->deflate.enabled)
+            {
+                ws->get_websocket().set_option(self->deflate.to_permessage_deflate(false));
+            }
+
+            ws->async_handshake(ep.address().to_string(), PEER_TARGET,
+                [self, reactor, ws, deadline, state, ep, attempt](const boost::system::error_code& ec)
+                {
+                    {
+                        std::lock_guard<std::mutex> lock(state->lock);
+
+                        if (state->settled)
+                        {
+                            return;
+                        }
+
+                        state->settled = true;
+                        deadline->cancel();
+                    }
+
+                    if (ec)
+                    {
+                        self->connect_failed(ep, attempt, "handshake failed: " + ec.message());
+                        return;
+                    }
+
+                    self->connected(ep, attempt, self->make_session(reactor, ws));
+                });
+        });
+}
+
+
+void
+peer_connection_pool::connected(const boost::asio::ip::tcp::endpoint& ep, uint64_t attempt, std::shared_ptr<bzn::session> session)
+{
+    bool first = true;
+
+    // what was queued goes out first; the session is only handed out once nothing is left, to keep the order...
+    while (true)
+    {
+        std::deque<std::shared_ptr<bzn::encoded_message>> pending;
+        {
+            std::lock_guard<std::mutex> lock(this->lock);
+
+            auto it = this->connections.find(ep);
+            if (it == this->connections.end() || it->second.attempt != attempt)
+            {
+                LOG(debug) << "dropping superseded connection to " << to_string(ep);
+                break;
+            }
+
+            auto& conn = it->second;
+
+            if (first)
+            {
+                LOG(debug) << "connected to " << to_string(ep);
+                conn.failures = 0;
+                ++this->connects;
+                first = false;
+            }
+
+            if (conn.pending.empty())
+            {
+                conn.session = std::move(session);
+                conn.connecting = false;
+                return;
+            }
+
+            pending.swap(conn.pending);
+            conn.sent += pending.size();
+            this->messages_sent += pending.size();
+        }
+
+        for (auto& msg : pending)
+        {
+            session->send_message(std::move(msg), false);
+        }
+    }
+
+    session->close();
+}
+
+
+void
+peer_connection_pool::connect_failed(const boost::asio::ip::tcp::endpoint& ep, uint64_t attempt, const std::string& reason)
+{
+    std::lock_guard<std::mutex> lock(this->lock);
+
+    auto it = this->connections.find(ep);
+    if (it == this->connections.end() || it->second.attempt != attempt || !it->second.connecting)
+    {
+        return;
+    }
+
+    auto& conn = it->second;
+    conn.connecting = false;
+    ++this->connect_failures;
+
+    const auto backoff = std::min(this->max_backoff, this->min_backoff * (1u << std::min<size_t>(conn.failures++, 16)));
+    conn.retry_after = std::chrono::steady_clock::now() + backoff;
+
+    LOG(error) << "failed to connect to: " << to_string(ep) << " - " << reason << " (" << conn.pending.size()
+        << " messages waiting, retrying after " << backoff.count() << "ms)";
+
+    // what's waiting would otherwise sit there until something else is sent to the peer...
+    if (!conn.retry_timer)
+    {
+        conn.retry_timer = this->io_context->make_unique_steady_timer();
+    }
+
+    conn.retry_timer->expires_from_now(backoff);
+    conn.retry_timer->async_wait(
+        [weak_self = weak_from_this(), ep, attempt](const boost::system::error_code& ec)
+        {
+            auto self = weak_self.lock();
+            if (!ec && self)
+            {
+                self->retry(ep, attempt);
+            }
+        });
+}
+
+
+void
+peer_connection_pool::retry(const boost::asio::ip::tcp::endpoint& ep, uint64_t attempt)
+{
+    std::shared_ptr<bzn::asio::io_context_base> reactor;
+    {
+        std::lock_guard<std::mutex> lock(this->lock);
+
+        auto it = this->connections.find(ep);
+
+        // a send may have got there first, or there's nothing left to deliver...
+        if (it == this->connections.end() || it->second.attempt != attempt || it->second.connecting || it->second.session
+            || it->second.pending.empty())
+        {
+            return;
+        }
+
+        it->second.connecting = true;
+        it->second.connect_started = std::chrono::steady_clock::now();
+        attempt = ++it->second.attempt;
+        reactor = this->next_connection_reactor();
+    }
+
+    this->connect(std::move(reactor), ep, attempt);
+}
+
+
+std::shared_ptr<bzn::asio::io_context_base>
+peer_connection_pool::next_connection_reactor()
+{
+    return this->reactors.empty() ? this->io_context : this->reactors[this->next_reactor++ % this->reactors.size()];
+}
+
+
+std::vector<std::shared_ptr<bzn::session>>
+peer_connection_pool::evict_idle(std::chrono::steady_clock::time_point now)
+{
+    std::vector<std::shared_ptr<bzn::session>> idle;
+
+    for (auto it = this->connections.begin(); it != this->connections.end();)
+    {
+        // an attempt past its deadline is as good as failed, and doesn't keep the entry...
+        if (now - it->second.last_used < this->idle_timeout
+            || (it->second.connecting && now - it->second.connect_started < this->connect_timeout))
+        {
+            ++it;
+            continue;
+        }
+
+        if (it->second.session)
+        {
+            idle.push_back(std::move(it->second.session));
+        }
+
+        if (it->second.retry_timer)
+        {
+            it->second.retry_timer->cancel();
+        }
+
+        this->messages_dropped += it->second.pending.size();
+        ++this->evictions;
+
+        it = this->connections.erase(it);
+    }
+
+    return idle;
+}
+
+
+bzn::json_message
+peer_connection_pool::get_status() const
+{
+    std::lock_guard<std::mutex> lock(this->lock);
+
+    bzn::json_message status;
+
+    const auto now = std::chrono::steady_clock::now();
+    size_t open = 0;
+
+    for (const auto& entry : this->connections)
+    {
+        const auto& conn = entry.second;
+
+        auto& peer = status["peers"][to_string(entry.first)];
+
+        if (conn.session && conn.session->is_open())
+        {
+            peer["state"] = "connected";
+            ++open;
+        }
+        else if (conn.connecting)
+        {
+            peer["state"] = now - conn.connect_started < this->connect_timeout ? "connecting" : "stalled";
+        }
+        else if (conn.failures)
+        {
+            peer["state"] = now < conn.retry_after ? "backoff" : "unreachable";
+        }
+        else
+        {
+            peer["state"] = "closed";
+        }
+
+        peer["failures"] = static_cast<Json::UInt64>(conn.failures);
+        peer["pending"] = static_cast<Json::UInt64>(conn.pending.size());
+        peer["sent"] = static_cast<Json::UInt64>(conn.sent);
+    }
+
+    status["open"] = static_cast<Json::UInt64>(open);
+    status["connects"] = static_cast<Json::UInt64>(this->connects);
+    status["connect_failures"] = static_cast<Json::UInt64>(this->connect_failures);
+    status["messages_sent"] = static_cast<Json::UInt64>(this->messages_sent);
+    status["messages_reused"] = static_cast<Json::UInt64>(this->messages_reused);
+    status["messages_dropped"] = static_cast<Json::UInt64>(this->messages_dropped);
+    status["evictions"] = static_cast<Json::UInt64>(this->evictions);
+    status["reuse_ratio"] = this->messages_sent ? double(this->messages_reused) / this->messages_sent : 0.0;
+
+    return status;
+}
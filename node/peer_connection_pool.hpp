@@ -0,0 +1,113 @@
+// Copyright (C) 2018 Bluzelle
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU Affero General Public License, version 3,
+// as published by the Free Software Foundation.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU Affero General Public License for more details.
+//
+// You should have received a copy of the GNU Affero General Public License
+// along with this program. If not, see <http://www.gnu.org/licenses/>.
+
+#pragma once
+
+#include <include/bluzelle.hpp>
+#include <include/boost_asio_beast.hpp>
+#include <node/deflate_metrics.hpp>
+#include <node/session.hpp>
+#include <chrono>
+#include <deque>
+#include <map>
+#include <mutex>
+
+
+namespace bzn
+{
+    // One long-lived websocket connection per peer endpoint, shared by every message sent there. Messages sent while
+    // the connection is being made are queued and go out in order once it is up. A peer that can't be reached is
+    // tried again with exponential backoff for as long as messages are waiting for it, as is one whose connect and
+    // handshake take longer than the connect timeout. Connections that nothing has been sent on for a while are closed.
+    //
+    // With deflate enabled, the connection offers permessage-deflate when it is made.
+    class peer_connection_pool final : public std::enable_shared_from_this<peer_connection_pool>
+    {
+    public:
+        // makes and starts the session for a freshly handshaken outbound websocket, owned by the given io_context
+        using session_factory = std::function<std::shared_ptr<bzn::session>(std::shared_ptr<bzn::asio::io_context_base> io_context,
+            std::shared_ptr<bzn::beast::websocket_stream_base> websocket)>;
+
+        static const size_t MAX_PENDING_MESSAGES = 1000;
+
+        // what peers connect to, so their connections can be told apart from clients' when accepted
+        static constexpr const char* PEER_TARGET = "/peer";
+
+        peer_connection_pool(std::shared_ptr<bzn::asio::io_context_base> io_context, std::shared_ptr<bzn::beast::websocket_base> websocket,
+            session_factory make_session,
+            std::chrono::milliseconds idle_timeout = std::chrono::seconds(60),
+            std::chrono::milliseconds min_backoff = std::chrono::milliseconds(100),
+            std::chrono::milliseconds max_backoff = std::chrono::seconds(10),
+            std::chrono::milliseconds connect_timeout = std::chrono::seconds(10));
+
+        // set before the first send
+        void set_deflate(const bzn::deflate_options& options);
+
+        // connections are spread over these rather than all made on the pool's io_context; set before the first send
+        void set_reactors(std::vector<std::shared_ptr<bzn::asio::io_context_base>> reactors);
+
+        void send(const boost::asio::ip::tcp::endpoint& ep, std::shared_ptr<bzn::encoded_message> msg);
+
+        bzn::json_message get_status() const;
+
+    private:
+        struct connection
+        {
+            std::shared_ptr<bzn::session> session;
+            std::deque<std::shared_ptr<bzn::encoded_message>> pending;
+            bool connecting = false;
+            std::chrono::steady_clock::time_point connect_started;
+            uint64_t attempt = 0;
+            size_t failures = 0; // since the last successful connect
+            std::chrono::steady_clock::time_point retry_after;
+            std::shared_ptr<bzn::asio::steady_timer_base> retry_timer;
+            std::chrono::steady_clock::time_point last_used;
+            uint64_t sent = 0;
+        };
+
+        void connect(std::shared_ptr<bzn::asio::io_context_base> reactor, const boost::asio::ip::tcp::endpoint& ep, uint64_t attempt);
+        void connected(const boost::asio::ip::tcp::endpoint& ep, uint64_t attempt, std::shared_ptr<bzn::session> session);
+        void connect_failed(const boost::asio::ip::tcp::endpoint& ep, uint64_t attempt, const std::string& reason);
+        void retry(const boost::asio::ip::tcp::endpoint& ep, uint64_t attempt);
+
+        // the reactor for the next connection; needs lock
+        std::shared_ptr<bzn::asio::io_context_base> next_connection_reactor();
+
+        // drop connections idle for longer than the timeout, returning their sessions to be closed; needs lock
+        std::vector<std::shared_ptr<bzn::session>> evict_idle(std::chrono::steady_clock::time_point now);
+
+        const std::shared_ptr<bzn::asio::io_context_base> io_context;
+        const std::shared_ptr<bzn::beast::websocket_base> websocket;
+        const session_factory make_session;
+        const std::chrono::milliseconds idle_timeout;
+        const std::chrono::milliseconds min_backoff;
+        const std::chrono::milliseconds max_backoff;
+        const std::chrono::milliseconds connect_timeout;
+        bzn::deflate_options deflate;
+        std::vector<std::shared_ptr<bzn::asio::io_context_base>> reactors;
+
+        mutable std::mutex lock;
+        std::map<boost::asio::ip::tcp::endpoint, connection> connections;
+        std::chrono::steady_clock::time_point last_eviction = std::chrono::steady_clock::now();
+
+        uint64_t connects = 0;
+        uint64_t connect_failures = 0;
+        uint64_t messages_sent = 0;
+        uint64_t messages_reused = 0;
+        uint64_t messages_dropped = 0;
+        uint64_t evictions = 0;
+        uint64_t next_reactor = 0;
+    };
+
+} // namespace bzn
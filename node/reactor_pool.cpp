@@ -0,0 +1,114 @@
+// Copyright (C) 2018 Bluzelle
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU Affero General Public License, version 3,
+// as published by the Free Software Foundation.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU Affero General Public License for more details.
+//
+// You should have received a copy of the GNU Affero General Public License
+// along with this program. If not, see <http://www.gnu.org/licenses/>.
+
+#include <node/reactor_pool.hpp>
+#include <include/bluzelle.hpp>
+#include <algorithm>
+#include <cstring>
+#include <pthread.h>
+
+using namespace bzn;
+
+
+reactor_pool::reactor_pool(size_t network_reactors)
+    : consensus_reactor(std::make_shared<bzn::asio::io_context>())
+{
+    for (size_t i = 0; i < std::max<size_t>(network_reactors, 1); ++i)
+    {
+        this->network_reactors.push_back(std::make_shared<bzn::asio::io_context>(true));
+    }
+
+    this->work.push_back(boost::asio::make_work_guard(this->consensus_reactor->get_io_context()));
+
+    for (const auto& reactor : this->network_reactors)
+    {
+        this->work.push_back(boost::asio::make_work_guard(reactor->get_io_context()));
+    }
+}
+
+
+reactor_pool::~reactor_pool()
+{
+    this->stop();
+}
+
+
+const std::vector<std::shared_ptr<bzn::asio::io_context_base>>&
+reactor_pool::get_network_reactors() const
+{
+    return this->network_reactors;
+}
+
+
+std::shared_ptr<bzn::asio::io_context_base>
+reactor_pool::get_consensus_reactor() const
+{
+    return this->consensus_reactor;
+}
+
+
+void
+reactor_pool::run()
+{
+    std::vector<std::thread> threads;
+
+    // the consensus reactor gets the first core...
+    threads.emplace_back(&reactor_pool::run_reactor, this, this->consensus_reactor, 0);
+
+    for (size_t i = 0; i < this->network_reactors.size(); ++i)
+    {
+        threads.emplace_back(&reactor_pool::run_reactor, this, this->network_reactors[i], i + 1);
+    }
+
+    // wait for shutdown...
+    for (auto& t : threads)
+    {
+        t.join();
+    }
+}
+
+
+void
+reactor_pool::stop()
+{
+    for (auto& guard : this->work)
+    {
+        guard.reset();
+    }
+
+    this->consensus_reactor->stop();
+
+    for (const auto& reactor : this->network_reactors)
+    {
+        reactor->stop();
+    }
+}
+
+
+void
+reactor_pool::run_reactor(const std::shared_ptr<bzn::asio::io_context_base>& reactor, size_t core)
+{
+    const size_t cores = std::max(std::thread::hardware_concurrency(), 1u);
+
+    cpu_set_t cpus;
+    CPU_ZERO(&cpus);
+    CPU_SET(core % cores, &cpus);
+
+    if (int err = pthread_setaffinity_np(pthread_self(), sizeof(cpus), &cpus))
+    {
+        LOG(warning) << "failed to pin reactor to core " << core % cores << ": " << std::strerror(err);
+    }
+
+    reactor->run();
+}
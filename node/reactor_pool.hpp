@@ -0,0 +1,55 @@
+// Copyright (C) 2018 Bluzelle
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU Affero General Public License, version 3,
+// as published by the Free Software Foundation.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU Affero General Public License for more details.
+//
+// You should have received a copy of the GNU Affero General Public License
+// along with this program. If not, see <http://www.gnu.org/licenses/>.
+
+#pragma once
+
+#include <include/boost_asio_beast.hpp>
+#include <memory>
+#include <thread>
+#include <vector>
+
+
+namespace bzn
+{
+    // A set of io_contexts each run by a single thread pinned to its own core, instead of one io_context run by a
+    // thread per core. The network reactors each listen on the shared ports and own the sessions they accept or
+    // connect; the consensus reactor runs the message handlers and everything else, so that work never waits behind
+    // socket I/O.
+    class reactor_pool final
+    {
+    public:
+        explicit reactor_pool(size_t network_reactors);
+
+        ~reactor_pool();
+
+        const std::vector<std::shared_ptr<bzn::asio::io_context_base>>& get_network_reactors() const;
+
+        std::shared_ptr<bzn::asio::io_context_base> get_consensus_reactor() const;
+
+        // runs every reactor until stop() is called
+        void run();
+
+        void stop();
+
+    private:
+        void run_reactor(const std::shared_ptr<bzn::asio::io_context_base>& reactor, size_t core);
+
+        std::vector<std::shared_ptr<bzn::asio::io_context_base>> network_reactors;
+        std::shared_ptr<bzn::asio::io_context_base> consensus_reactor;
+
+        // reactors with nothing to do yet must not return from run()...
+        std::vector<boost::asio::executor_work_guard<boost::asio::io_context::executor_type>> work;
+    };
+
+} // namespace bzn
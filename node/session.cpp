@@ -13,24 +13,54 @@
 // along with this program. If not, see <http://www.gnu.org/licenses/>.
 
 #include <node/session.hpp>
-#include <sstream>
+#include <node/message_coalescer.hpp>
+#include <algorithm>
 
 namespace
 {
     const std::chrono::seconds DEFAULT_WS_TIMEOUT_MS{10};
+
+    // a read buffer that grew past this for one big message is given back once that message is handled...
+    const size_t MAX_RETAINED_READ_BUFFER = 1024 * 1024;
+
+    // how often a session paused for saturated downstream queues checks whether it can read again
+    const std::chrono::milliseconds DOWNSTREAM_RETRY_INTERVAL{20};
+
+    // queued envelopes gathered into one write stop short of this, unless the first is bigger on its own
+    const size_t MAX_GATHERED_WRITE_BYTES = 1024 * 1024;
+
+
+    bool
+    starts_json_object(const char* data, size_t size)
+    {
+        const char* first = std::find_if_not(data, data + size, [](char c) { return c == ' ' || c == '\t' || c == '\r' || c == '\n'; });
+
+        return first != data + size && *first == '{';
+    }
+
+
+    bool
+    is_envelope(const bzn::encoded_message& msg)
+    {
+        return bzn::session::classify_frame(false, msg.data(), msg.size()) == bzn::session::frame_type::protobuf;
+    }
 }
 
 
 using namespace bzn;
 
 
-session::session(std::shared_ptr<bzn::asio::io_context_base> io_context, const bzn::session_id session_id, std::shared_ptr<bzn::beast::websocket_stream_base> websocket, std::shared_ptr<bzn::chaos_base> chaos, const std::chrono::milliseconds& ws_idle_timeout)
-    : strand(io_context->make_unique_strand())
+session::session(std::shared_ptr<bzn::asio::io_context_base> io_context, const bzn::session_id session_id, std::shared_ptr<bzn::beast::websocket_stream_base> websocket, std::shared_ptr<bzn::chaos_base> chaos, const std::chrono::milliseconds& ws_idle_timeout,
+    size_t max_write_queue, write_overflow_policy overflow_policy)
+    : io_context(io_context)
+    , strand(io_context->make_unique_strand())
     , session_id(session_id)
     , websocket(std::move(websocket))
     , idle_timer(io_context->make_unique_steady_timer())
     , chaos(std::move(chaos))
     , ws_idle_timeout(ws_idle_timeout.count() ? ws_idle_timeout : DEFAULT_WS_TIMEOUT_MS)
+    , max_write_queue(std::max<size_t>(max_write_queue, 1))
+    , overflow_policy(overflow_policy)
 {
 }
 
@@ -44,8 +74,7 @@ session::start(bzn::message_handler handler, bzn::protobuf_handler proto_handler
     // If we haven't completed a handshake then we are accepting one...
     if (!this->websocket->is_open())
     {
-        this->websocket->async_accept(
-            [self = shared_from_this()](boost::system::error_code ec)
+        auto accepted = [self = shared_from_this()](boost::system::error_code ec)
             {
                 if (ec)
                 {
@@ -55,8 +84,16 @@ session::start(bzn::message_handler handler, bzn::protobuf_handler proto_handler
 
                 // schedule read...
                 self->do_read();
-            }
-        );
+            };
+
+        if (this->choose_deflate)
+        {
+            this->websocket->async_accept(this->choose_deflate, accepted);
+        }
+        else
+        {
+            this->websocket->async_accept(accepted);
+        }
     }
 }
 
@@ -64,14 +101,67 @@ session::start(bzn::message_handler handler, bzn::protobuf_handler proto_handler
 void
 session::do_read()
 {
-    auto buffer = std::make_shared<boost::beast::multi_buffer>();
+    if (this->closed)
+    {
+        return;
+    }
+
+    bool downstream_full = false;
+    bool start_read = false;
+    {
+        std::lock_guard<std::mutex> lock(this->flow_lock);
+
+        // a websocket allows one read at a time, and once started the reads carry on by themselves...
+        if (this->reading || this->paused)
+        {
+            return;
+        }
+
+        downstream_full = this->downstream_saturated && this->downstream_saturated();
+
+        if (downstream_full || this->read_limit_reached())
+        {
+            // resumed when credit comes back, or by polling downstream...
+            this->paused = true;
+        }
+        else
+        {
+            this->reading = true;
+            start_read = true;
+        }
+    }
+
+    if (downstream_full)
+    {
+        this->schedule_resume();
+    }
+
+    if (!start_read)
+    {
+        return;
+    }
+
+    // the stream is only touched from the strand, whichever thread asked for the read...
+    this->strand->dispatch(std::bind(&session::start_async_read, shared_from_this()));
+}
+
+
+void
+session::start_async_read()
+{
+    if (this->closed)
+    {
+        std::lock_guard<std::mutex> lock(this->flow_lock);
+        this->reading = false;
+        return;
+    }
 
     this->start_idle_timeout();
 
-    // todo: strand may not be needed...
-    this->websocket->async_read(*buffer,
+    // the one read buffer is reused for every message, and is only touched by the read in progress...
+    this->websocket->async_read(this->read_buffer,
         this->strand->wrap(
-        [self = shared_from_this(), buffer](boost::system::error_code ec, auto /*bytes_transferred*/)
+        [self = shared_from_this()](boost::system::error_code ec, auto /*bytes_transferred*/)
         {
             self->idle_timer->cancel();
 
@@ -82,79 +172,289 @@ session::do_read()
                 {
                     LOG(error) << "websocket read failed: " << ec.message();
                 }
+
+                self->closed = true;
+
+                std::lock_guard<std::mutex> lock(self->flow_lock);
+                self->reading = false;
                 return;
             }
 
-            // get the message...
-            std::stringstream ss;
-            ss << boost::beast::buffers(buffer->data());
+            auto credit = self->take_read_credit(self->read_buffer.size());
 
-            Json::Value msg;
-            Json::Reader reader;
+            self->handling_credit = credit;
+            self->handle_frame(self->read_buffer, self->websocket->got_text());
+            self->handling_credit.reset();
 
-            bzn_envelope proto_msg;
+            self->read_buffer.consume(self->read_buffer.size());
+            if (self->read_buffer.capacity() > MAX_RETAINED_READ_BUFFER)
+            {
+                self->read_buffer.shrink_to_fit();
+            }
 
-            if (reader.parse(ss.str(), msg))
+            // only now may another read use the buffer...
             {
-                self->handler(msg, self);
+                std::lock_guard<std::mutex> lock(self->flow_lock);
+                self->reading = false;
             }
-            else if (proto_msg.ParseFromIstream(&ss))
+
+            // handled, unless a handler is holding on to it...
+            credit.reset();
+
+            // peers keep the connection open for further messages...
+            self->do_read();
+        }));
+}
+
+
+void
+session::set_flow_control(size_t max_messages, size_t max_bytes, std::function<bool()> downstream_saturated)
+{
+    std::lock_guard<std::mutex> lock(this->flow_lock);
+
+    this->max_in_flight_messages = max_messages;
+    this->max_in_flight_bytes = max_bytes;
+    this->downstream_saturated = std::move(downstream_saturated);
+}
+
+
+std::shared_ptr<void>
+session::hold_read_credit()
+{
+    return this->handling_credit;
+}
+
+
+void
+session::set_deflate_metrics(std::shared_ptr<bzn::deflate_metrics> metrics)
+{
+    this->deflate_metrics = std::move(metrics);
+}
+
+
+void
+session::set_gather_writes(bool setting)
+{
+    this->gather_writes = setting;
+}
+
+
+void
+session::set_accept_deflate(bzn::beast::deflate_chooser choose_deflate)
+{
+    this->choose_deflate = std::move(choose_deflate);
+}
+
+
+size_t
+session::in_flight_messages() const
+{
+    std::lock_guard<std::mutex> lock(this->flow_lock);
+
+    return this->in_flight_count;
+}
+
+
+bool
+session::is_read_paused() const
+{
+    std::lock_guard<std::mutex> lock(this->flow_lock);
+
+    return this->paused;
+}
+
+
+std::shared_ptr<void>
+session::take_read_credit(size_t bytes)
+{
+    {
+        std::lock_guard<std::mutex> lock(this->flow_lock);
+
+        ++this->in_flight_count;
+        this->in_flight_bytes += bytes;
+    }
+
+    return std::shared_ptr<void>(nullptr,
+        [weak_self = weak_from_this(), bytes](void*)
+        {
+            if (auto self = weak_self.lock())
             {
-                self->proto_handler(proto_msg, self);
+                self->release_read_credit(bytes);
             }
-            else
+        });
+}
+
+
+void
+session::release_read_credit(size_t bytes)
+{
+    bool resume = false;
+    {
+        std::lock_guard<std::mutex> lock(this->flow_lock);
+
+        --this->in_flight_count;
+        this->in_flight_bytes -= bytes;
+
+        resume = this->paused && !this->read_limit_reached();
+    }
+
+    if (resume)
+    {
+        this->resume_read();
+    }
+}
+
+
+bool
+session::read_limit_reached() const
+{
+    return (this->max_in_flight_messages && this->in_flight_count >= this->max_in_flight_messages)
+        || (this->max_in_flight_bytes && this->in_flight_bytes >= this->max_in_flight_bytes);
+}
+
+
+void
+session::schedule_resume()
+{
+    std::lock_guard<std::mutex> lock(this->flow_lock);
+
+    if (this->resume_scheduled)
+    {
+        return;
+    }
+
+    // made on first use, most sessions never need it...
+    if (!this->resume_timer)
+    {
+        this->resume_timer = this->io_context->make_unique_steady_timer();
+    }
+
+    this->resume_scheduled = true;
+    this->resume_timer->expires_from_now(DOWNSTREAM_RETRY_INTERVAL);
+    this->resume_timer->async_wait(
+        [self = shared_from_this()](const boost::system::error_code& ec)
+        {
             {
-                LOG(error) << "Failed to parse: " << reader.getFormattedErrorMessages();
+                std::lock_guard<std::mutex> lock(self->flow_lock);
+                self->resume_scheduled = false;
             }
-        }));
+
+            if (ec != boost::asio::error::operation_aborted)
+            {
+                self->resume_read();
+            }
+        });
 }
 
 
 void
-session::send_message(std::shared_ptr<bzn::json_message> msg, const bool end_session)
+session::resume_read()
 {
-    this->send_message(std::make_shared<bzn::encoded_message>(msg->toStyledString()), end_session);
+    {
+        std::lock_guard<std::mutex> lock(this->flow_lock);
+
+        if (!this->paused)
+        {
+            return;
+        }
+
+        this->paused = false;
+    }
+
+    this->do_read();
+}
+
+
+session::frame_type
+session::classify_frame(bool text, const char* data, size_t size)
+{
+    // a serialized bzn_envelope can't start with '{' (it would be a group tag), so that's all it takes to tell JSON
+    // sent in binary frames from protobuf...
+    if (text || (size && data[0] == '{'))
+    {
+        return frame_type::json;
+    }
+
+    return frame_type::protobuf;
 }
 
 
 void
-session::send_message(std::shared_ptr<bzn::encoded_message> msg, const bool end_session)
+session::handle_frame(const boost::beast::flat_buffer& buffer, bool text)
 {
-    if (this->chaos->is_message_delayed())
+    // decoded in place; nothing handed on refers back into the buffer...
+    const char* data = static_cast<const char*>(buffer.data().data());
+    const size_t size = buffer.size();
+
+    if (classify_frame(text, data, size) == frame_type::json)
     {
-        this->chaos->reschedule_message(std::bind(static_cast<void(session::*)(std::shared_ptr<std::string>, const bool)>(&session::send_message), shared_from_this(), std::move(msg), end_session));
+        this->handle_json_frame(data, size);
         return;
     }
 
-    if (this->chaos->is_message_dropped())
+    bzn_envelope proto_msg;
+    const bool parsed = proto_msg.ParseFromArray(data, static_cast<int>(size));
+
+    // JSON with whitespace before its opening brace gets this far, and may even pass for an envelope without a payload...
+    if ((!parsed || proto_msg.payload_case() == bzn_envelope::PAYLOAD_NOT_SET) && starts_json_object(data, size))
     {
+        this->handle_json_frame(data, size);
         return;
     }
 
-    this->idle_timer->cancel(); // kill timer for duration of write...
+    if (!parsed)
+    {
+        LOG(error) << "Failed to parse protobuf message of " << size << " bytes";
+        return;
+    }
 
-    std::lock_guard<std::mutex> lock(this->write_lock);
+    this->proto_handler(proto_msg, shared_from_this());
+}
 
-    this->websocket->get_websocket().binary(true);
 
-    boost::beast::error_code ec;
-    this->websocket->write(boost::asio::buffer(*msg), ec);
+void
+session::handle_json_frame(const char* data, size_t size)
+{
+    Json::Value msg;
+    Json::Reader reader;
 
-    if (ec)
+    if (!reader.parse(data, data + size, msg))
     {
-        LOG(error) << "websocket write failed: " << ec.message();
+        LOG(error) << "Failed to parse: " << reader.getFormattedErrorMessages();
+        return;
+    }
 
-        this->close();
+    this->handler(msg, shared_from_this());
+}
+
+
+void
+session::send_message(std::shared_ptr<bzn::json_message> msg, const bool end_session)
+{
+    this->send_message(std::make_shared<bzn::encoded_message>(msg->toStyledString()), end_session);
+}
+
+
+void
+session::send_message(std::shared_ptr<bzn::encoded_message> msg, const bool end_session)
+{
+    if (this->chaos->is_message_delayed())
+    {
+        this->chaos->reschedule_message(std::bind(static_cast<void(session::*)(std::shared_ptr<std::string>, const bool)>(&session::send_message), shared_from_this(), std::move(msg), end_session));
         return;
     }
 
-    if (end_session)
+    if (this->chaos->is_message_dropped())
     {
-        this->close();
         return;
     }
 
-    this->do_read();
+    this->enqueue_write(std::move(msg), end_session);
+
+    if (!end_session)
+    {
+        this->do_read();
+    }
 }
 
 
@@ -172,37 +472,214 @@ session::send_datagram(std::shared_ptr<bzn::encoded_message> msg)
         return;
     }
 
-    std::lock_guard<std::mutex> lock(this->write_lock);
+    this->enqueue_write(std::move(msg), false);
+}
+
+
+void
+session::enqueue_write(std::shared_ptr<bzn::encoded_message> msg, bool end_session)
+{
+    std::shared_ptr<bzn::encoded_message> next;
+    bool overflowed = false;
+    {
+        std::lock_guard<std::mutex> lock(this->write_lock);
+
+        if (this->closed || this->close_when_written)
+        {
+            return;
+        }
+
+        if (this->write_queue.size() >= this->max_write_queue)
+        {
+            ++this->dropped;
+
+            switch (this->overflow_policy)
+            {
+                case write_overflow_policy::drop_oldest:
+                    this->write_queue.pop_front();
+                    break;
+
+                case write_overflow_policy::drop_newest:
+                    msg.reset();
+                    break;
+
+                case write_overflow_policy::close:
+                    // nothing more goes out, and close() below drops what was queued...
+                    msg.reset();
+                    this->closed = true;
+                    overflowed = true;
+                    break;
+            }
+        }
+
+        if (msg)
+        {
+            this->write_queue.push_back(std::move(msg));
+        }
+
+        this->close_when_written = end_session;
+
+        if (!this->writing && !this->write_queue.empty() && !this->closed)
+        {
+            this->writing = true;
+            next = std::move(this->write_queue.front());
+            this->write_queue.pop_front();
+        }
+    }
+
+    if (overflowed)
+    {
+        LOG(error) << "closing session " << this->session_id << ": " << this->max_write_queue << " messages waiting to be written";
+        this->close();
+        return;
+    }
+
+    if (next)
+    {
+        // the stream is only touched from the strand, whichever thread is sending...
+        this->strand->dispatch(std::bind(&session::do_write, shared_from_this(), std::move(next)));
+    }
+}
+
+
+void
+session::do_write(std::shared_ptr<bzn::encoded_message> msg)
+{
+    this->idle_timer->cancel(); // kill timer for duration of write...
 
     this->websocket->get_websocket().binary(true);
 
-    boost::beast::error_code ec;
-    this->websocket->write(boost::asio::buffer(*msg), ec);
+    if (this->deflate_metrics && this->websocket->is_deflate_negotiated())
+    {
+        this->deflate_metrics->message_sent(*msg);
+    }
+
+    // the message is held by the handler until the write is done...
+    this->websocket->async_write(boost::asio::buffer(*msg),
+        this->strand->wrap(
+        [self = shared_from_this(), msg](const boost::system::error_code& ec, auto /*bytes_transferred*/)
+        {
+            self->write_done(ec);
+        }));
+}
+
+
+void
+session::write_done(const boost::system::error_code& ec)
+{
+    if (this->closed)
+    {
+        return;
+    }
 
     if (ec)
     {
         LOG(error) << "websocket write failed: " << ec.message();
+
+        this->close();
+        return;
+    }
+
+    // whatever was queued meanwhile goes out from here, not from the threads that queued it...
+    std::vector<std::shared_ptr<bzn::encoded_message>> next;
+    bool finished = false;
+    {
+        std::lock_guard<std::mutex> lock(this->write_lock);
+
+        if (this->write_queue.empty())
+        {
+            this->writing = false;
+            finished = this->close_when_written;
+        }
+        else
+        {
+            this->take_writes(next);
+        }
+    }
+
+    if (!next.empty())
+    {
+        // packed here, on the strand, rather than holding up the threads queueing messages...
+        this->do_write(next.size() == 1 ? next.front() : bzn::message_coalescer::pack(next));
+    }
+    else if (finished)
+    {
         this->close();
     }
 }
 
 
+void
+session::take_writes(std::vector<std::shared_ptr<bzn::encoded_message>>& msgs)
+{
+    size_t bytes = 0;
+
+    // JSON is never gathered, and keeps its place between the envelopes on either side of it...
+    do
+    {
+        bytes += this->write_queue.front()->size();
+        msgs.push_back(std::move(this->write_queue.front()));
+        this->write_queue.pop_front();
+    }
+    while (this->gather_writes && !this->write_queue.empty() && bytes + this->write_queue.front()->size() <= MAX_GATHERED_WRITE_BYTES
+        && is_envelope(*msgs.front()) && is_envelope(*this->write_queue.front()));
+}
+
+
+size_t
+session::write_queue_size() const
+{
+    std::lock_guard<std::mutex> lock(this->write_lock);
+
+    return this->write_queue.size();
+}
+
+
+bool
+session::is_open() const
+{
+    return !this->closed && this->websocket->is_open();
+}
+
+
 void
 session::close()
 {
+    {
+        std::lock_guard<std::mutex> lock(this->write_lock);
+
+        this->closed = true;
+        this->write_queue.clear();
+    }
+
     this->idle_timer->cancel();
 
-    if (this->websocket->is_open())
     {
-        this->websocket->async_close(boost::beast::websocket::close_code::normal,
-            [self = shared_from_this()](auto ec)
+        std::lock_guard<std::mutex> lock(this->flow_lock);
+
+        if (this->resume_timer)
+        {
+            this->resume_timer->cancel();
+        }
+    }
+
+    this->strand->dispatch(
+        [self = shared_from_this()]()
+        {
+            if (!self->websocket->is_open())
             {
-                if (ec)
+                return;
+            }
+
+            self->websocket->async_close(boost::beast::websocket::close_code::normal,
+                [self](auto ec)
                 {
-                    LOG(error) << "failed to close websocket: " << ec.message();
-                }
-            });
-    }
+                    if (ec)
+                    {
+                        LOG(error) << "failed to close websocket: " << ec.message();
+                    }
+                });
+        });
 }
 
 
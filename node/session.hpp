@@ -15,12 +15,15 @@
 #pragma once
 
 #include <include/boost_asio_beast.hpp>
+#include <node/deflate_metrics.hpp>
 #include <node/node_base.hpp>
 #include <node/session_base.hpp>
 #include <options/options_base.hpp>
 #include <chaos/chaos.hpp>
 #include <memory>
 #include <mutex>
+#include <atomic>
+#include <deque>
 #include <list>
 
 #include <gtest/gtest_prod.h>
@@ -28,10 +31,39 @@
 
 namespace bzn
 {
+    // Outgoing messages are queued and written asynchronously, one write in flight at a time, so a slow reader never
+    // blocks the thread that sent to it. When the queue is full the overflow policy decides what gives.
+    //
+    // Incoming messages take a credit each until they've been handled. Reading stops while the session is out of
+    // credit or the queues its messages feed are full, and carries on once they've drained.
     class session final : public bzn::session_base, public std::enable_shared_from_this<session>
     {
     public:
-        session(std::shared_ptr<bzn::asio::io_context_base> io_context, bzn::session_id session_id, std::shared_ptr<bzn::beast::websocket_stream_base> websocket, std::shared_ptr<bzn::chaos_base> chaos, const std::chrono::milliseconds& ws_idle_timeout);
+        enum class write_overflow_policy
+        {
+            drop_oldest,
+            drop_newest,
+            close
+        };
+
+        static const size_t DEFAULT_MAX_WRITE_QUEUE = 1000;
+
+        static const size_t DEFAULT_MAX_IN_FLIGHT_MESSAGES = 64;
+        static const size_t DEFAULT_MAX_IN_FLIGHT_BYTES = 64 * 1024 * 1024;
+
+        // which decoder a received frame goes to
+        enum class frame_type
+        {
+            json,
+            protobuf
+        };
+
+        // text frames are JSON, as are binary frames starting with '{'; any other binary frame is taken for a
+        // bzn_envelope, and only decoded as JSON after all if that fails and it starts with '{' past any whitespace
+        static frame_type classify_frame(bool text, const char* data, size_t size);
+
+        session(std::shared_ptr<bzn::asio::io_context_base> io_context, bzn::session_id session_id, std::shared_ptr<bzn::beast::websocket_stream_base> websocket, std::shared_ptr<bzn::chaos_base> chaos, const std::chrono::milliseconds& ws_idle_timeout,
+            size_t max_write_queue = DEFAULT_MAX_WRITE_QUEUE, write_overflow_policy overflow_policy = write_overflow_policy::drop_oldest);
 
         void start(bzn::message_handler handler, bzn::protobuf_handler proto_handler) override;
 
@@ -43,13 +75,71 @@ namespace bzn
 
         void close() override;
 
+        // false once the connection has failed or been closed by either end
+        bool is_open() const;
+
         bzn::session_id get_session_id() override { return this->session_id; }
 
+        // messages waiting to be written, not counting the one being written
+        size_t write_queue_size() const;
+
+        // limits on messages (and their bytes) received but not yet handled, 0 for none, and what says whether
+        // downstream is saturated; set before start()
+        void set_flow_control(size_t max_messages, size_t max_bytes, std::function<bool()> downstream_saturated);
+
+        std::shared_ptr<void> hold_read_credit() override;
+
+        // where messages written compressed are counted, if deflate was negotiated; set before start()
+        void set_deflate_metrics(std::shared_ptr<bzn::deflate_metrics> metrics);
+
+        // whether envelopes queued back to back are gathered into one batch envelope (see message_coalescer) and
+        // written together; only for connections to peers, as clients don't unpack batches. Set before start()
+        void set_gather_writes(bool setting);
+
+        // what picks the deflate settings for a connection being accepted, by handshake target; set before start()
+        void set_accept_deflate(bzn::beast::deflate_chooser choose_deflate);
+
+        size_t in_flight_messages() const;
+
+        bool is_read_paused() const;
+
+        // messages dropped because the write queue was full
+        uint64_t dropped_messages() const { return this->dropped; }
+
     private:
         void do_read();
 
+        // on the strand
+        void start_async_read();
+
+        void handle_frame(const boost::beast::flat_buffer& buffer, bool text);
+
+        void handle_json_frame(const char* data, size_t size);
+
+        std::shared_ptr<void> take_read_credit(size_t bytes);
+
+        void release_read_credit(size_t bytes);
+
+        // needs flow_lock
+        bool read_limit_reached() const;
+
+        void schedule_resume();
+
+        void resume_read();
+
+        void enqueue_write(std::shared_ptr<bzn::encoded_message> msg, bool end_session);
+
+        // on the strand, as is everything else that touches the websocket once started
+        void do_write(std::shared_ptr<bzn::encoded_message> msg);
+
+        void write_done(const boost::system::error_code& ec);
+
+        // take the next message to write, and any envelopes to go with it; needs write_lock
+        void take_writes(std::vector<std::shared_ptr<bzn::encoded_message>>& msgs);
+
         void start_idle_timeout();
 
+        const std::shared_ptr<bzn::asio::io_context_base> io_context;
         std::unique_ptr<bzn::asio::strand_base> strand;
         const bzn::session_id session_id;
 
@@ -62,7 +152,33 @@ namespace bzn
         bzn::message_handler handler;
         bzn::protobuf_handler proto_handler;
 
-        std::mutex write_lock;
+        const size_t max_write_queue;
+        const write_overflow_policy overflow_policy;
+
+        mutable std::mutex write_lock;
+        std::deque<std::shared_ptr<bzn::encoded_message>> write_queue;
+        bool writing = false;
+        bool close_when_written = false;
+        bool gather_writes = false;
+        std::atomic<uint64_t> dropped{0};
+        std::shared_ptr<bzn::deflate_metrics> deflate_metrics;
+        bzn::beast::deflate_chooser choose_deflate;
+
+        boost::beast::flat_buffer read_buffer;
+        std::shared_ptr<void> handling_credit; // of the message being handled, only touched by the read handler
+        std::atomic<bool> closed{false};
+
+        // guards the read state and credit below
+        mutable std::mutex flow_lock;
+        bool reading = false;
+        bool paused = false;
+        size_t max_in_flight_messages = 0;
+        size_t max_in_flight_bytes = 0;
+        std::function<bool()> downstream_saturated;
+        size_t in_flight_count = 0;
+        size_t in_flight_bytes = 0;
+        std::unique_ptr<bzn::asio::steady_timer_base> resume_timer;
+        bool resume_scheduled = false;
     };
 
 } // blz
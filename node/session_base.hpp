@@ -72,6 +72,13 @@ namespace bzn
          * @return id
          */
         virtual bzn::session_id get_session_id() = 0;
+
+        /**
+         * Keep the message being handled counted against the session's flow control after the handler returns, for
+         * handlers that finish the work elsewhere. Only valid from within a message handler.
+         * @return released when the last copy is dropped; null if the session has no flow control
+         */
+        virtual std::shared_ptr<void> hold_read_credit() { return nullptr; }
     };
 
 } // bzn
@@ -0,0 +1,81 @@
+// Copyright (C) 2018 Bluzelle
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU Affero General Public License, version 3,
+// as published by the Free Software Foundation.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU Affero General Public License for more details.
+//
+// You should have received a copy of the GNU Affero General Public License
+// along with this program. If not, see <http://www.gnu.org/licenses/>.
+
+#include <node/deflate_metrics.hpp>
+#include <gmock/gmock.h>
+#include <random>
+
+using namespace ::testing;
+
+
+TEST(deflate_metrics, test_that_deflate_is_offered_or_accepted_only_when_enabled)
+{
+    bzn::deflate_options options;
+    options.level = 3;
+    options.window_bits = 12;
+
+    auto pmd = options.to_permessage_deflate(true);
+    EXPECT_FALSE(pmd.server_enable);
+    EXPECT_FALSE(pmd.client_enable);
+
+    options.enabled = true;
+
+    pmd = options.to_permessage_deflate(true);
+    EXPECT_TRUE(pmd.server_enable);
+    EXPECT_FALSE(pmd.client_enable);
+    EXPECT_EQ(pmd.compLevel, 3);
+    EXPECT_EQ(pmd.server_max_window_bits, 12);
+    EXPECT_EQ(pmd.client_max_window_bits, 12);
+
+    pmd = options.to_permessage_deflate(false);
+    EXPECT_FALSE(pmd.server_enable);
+    EXPECT_TRUE(pmd.client_enable);
+}
+
+
+TEST(deflate_metrics, test_that_messages_are_sampled_for_ratio_and_cost)
+{
+    bzn::deflate_metrics metrics(bzn::deflate_options{true, 6, 15});
+
+    const std::string compressible(10000, 'v');
+
+    for (size_t i = 0; i < bzn::deflate_metrics::SAMPLE_INTERVAL + 1; ++i)
+    {
+        metrics.message_sent(compressible);
+    }
+
+    auto status = metrics.get_status();
+    EXPECT_EQ(status["messages"].asUInt64(), bzn::deflate_metrics::SAMPLE_INTERVAL + 1);
+    EXPECT_EQ(status["bytes"].asUInt64(), (bzn::deflate_metrics::SAMPLE_INTERVAL + 1) * compressible.size());
+    EXPECT_EQ(status["sampled"].asUInt64(), 2u);
+    EXPECT_LT(status["ratio"].asDouble(), 0.05);
+    EXPECT_GT(status["estimated_bytes_saved"].asUInt64(), 0.9 * status["bytes"].asUInt64());
+    EXPECT_GT(status["compress_ns_per_byte"].asDouble(), 0.0);
+
+    // random bytes don't compress, which is what the ratio should show...
+    bzn::deflate_metrics random_metrics(bzn::deflate_options{true, 6, 15});
+
+    std::mt19937 gen(42);
+    std::string random(10000, '\0');
+    for (auto& c : random)
+    {
+        c = static_cast<char>(gen());
+    }
+
+    random_metrics.message_sent(random);
+
+    status = random_metrics.get_status();
+    EXPECT_EQ(status["sampled"].asUInt64(), 1u);
+    EXPECT_GT(status["ratio"].asDouble(), 0.99);
+}
@@ -0,0 +1,183 @@
+// Copyright (C) 2018 Bluzelle
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU Affero General Public License, version 3,
+// as published by the Free Software Foundation.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU Affero General Public License for more details.
+//
+// You should have received a copy of the GNU Affero General Public License
+// along with this program. If not, see <http://www.gnu.org/licenses/>.
+
+#include <node/message_coalescer.hpp>
+#include <mocks/mock_boost_asio_beast.hpp>
+#include <gmock/gmock.h>
+
+using namespace ::testing;
+
+
+namespace
+{
+    const boost::asio::ip::tcp::endpoint PEER_A{boost::asio::ip::address_v4::from_string("127.0.0.1"), 8081};
+    const boost::asio::ip::tcp::endpoint PEER_B{boost::asio::ip::address_v4::from_string("127.0.0.1"), 8082};
+
+    // Records the frames sent, and lets the test close the window for each peer.
+    class message_coalescer_test : public Test
+    {
+    public:
+        message_coalescer_test()
+        {
+            ON_CALL(*this->io_context, make_unique_steady_timer()).WillByDefault(Invoke(
+                [this]()
+                {
+                    const size_t index = this->windows.size();
+                    this->windows.emplace_back();
+
+                    auto timer = std::make_unique<NiceMock<bzn::asio::Mocksteady_timer_base>>();
+                    ON_CALL(*timer, async_wait(_)).WillByDefault(Invoke(
+                        [this, index](auto handler)
+                        {
+                            this->windows[index] = handler;
+                        }));
+                    return timer;
+                }));
+        }
+
+        std::shared_ptr<bzn::message_coalescer>
+        make_coalescer(size_t max_bytes = 1000)
+        {
+            return std::make_shared<bzn::message_coalescer>(this->io_context, std::chrono::milliseconds(1), max_bytes,
+                [this](const auto& ep, auto msg)
+                {
+                    this->frames.emplace_back(ep, *msg);
+                });
+        }
+
+        static std::shared_ptr<bzn::encoded_message>
+        envelope(const std::string& payload)
+        {
+            bzn_envelope env;
+            env.set_sender("sender");
+            env.set_pbft(payload);
+            return std::make_shared<bzn::encoded_message>(env.SerializeAsString());
+        }
+
+        // the pbft payloads a frame carries
+        static std::vector<std::string>
+        payloads(const std::string& frame)
+        {
+            bzn_envelope env;
+            EXPECT_TRUE(env.ParseFromString(frame));
+
+            if (env.payload_case() != bzn_envelope::kBatch)
+            {
+                return {env.pbft()};
+            }
+
+            std::vector<bzn_envelope> envelopes;
+            EXPECT_TRUE(bzn::message_coalescer::unpack(env, envelopes));
+
+            std::vector<std::string> result;
+            for (const auto& e : envelopes)
+            {
+                result.push_back(e.pbft());
+            }
+            return result;
+        }
+
+        void
+        close_window(size_t index)
+        {
+            auto handler = std::move(this->windows[index]);
+            ASSERT_TRUE(handler);
+            handler(boost::system::error_code());
+        }
+
+        std::shared_ptr<bzn::asio::Mockio_context_base> io_context = std::make_shared<NiceMock<bzn::asio::Mockio_context_base>>();
+        std::deque<bzn::asio::wait_handler> windows;
+        std::vector<std::pair<boost::asio::ip::tcp::endpoint, std::string>> frames;
+    };
+}
+
+
+TEST_F(message_coalescer_test, test_that_a_message_to_a_quiet_peer_goes_out_at_once)
+{
+    auto coalescer = this->make_coalescer();
+
+    coalescer->send(PEER_A, envelope("1"));
+    ASSERT_EQ(this->frames.size(), 1u);
+    EXPECT_EQ(payloads(this->frames[0].second), std::vector<std::string>({"1"}));
+
+    // nothing else came along, so the window closes and the next one goes out at once as well...
+    this->close_window(0);
+
+    coalescer->send(PEER_A, envelope("2"));
+    ASSERT_EQ(this->frames.size(), 2u);
+    EXPECT_EQ(payloads(this->frames[1].second), std::vector<std::string>({"2"}));
+}
+
+
+TEST_F(message_coalescer_test, test_that_messages_sent_during_the_window_go_out_together)
+{
+    auto coalescer = this->make_coalescer();
+
+    coalescer->send(PEER_A, envelope("1"));
+    coalescer->send(PEER_A, envelope("2"));
+    coalescer->send(PEER_A, envelope("3"));
+    coalescer->send(PEER_B, envelope("b"));
+
+    // each peer has its own window...
+    ASSERT_EQ(this->frames.size(), 2u);
+    EXPECT_EQ(this->frames[1].first, PEER_B);
+
+    this->close_window(0);
+
+    ASSERT_EQ(this->frames.size(), 3u);
+    EXPECT_EQ(this->frames[2].first, PEER_A);
+    EXPECT_EQ(payloads(this->frames[2].second), std::vector<std::string>({"2", "3"}));
+
+    // a lone message held back is sent as it is...
+    coalescer->send(PEER_A, envelope("4"));
+    this->close_window(0);
+
+    ASSERT_EQ(this->frames.size(), 4u);
+    bzn_envelope env;
+    ASSERT_TRUE(env.ParseFromString(this->frames[3].second));
+    EXPECT_EQ(env.payload_case(), bzn_envelope::kPbft);
+
+    const auto status = coalescer->get_status();
+    EXPECT_EQ(status["messages"].asUInt64(), 5u);
+    EXPECT_EQ(status["frames"].asUInt64(), 4u);
+    EXPECT_EQ(status["batches"].asUInt64(), 1u);
+    EXPECT_EQ(status["batched_messages"].asUInt64(), 2u);
+}
+
+
+TEST_F(message_coalescer_test, test_that_reaching_the_size_limit_sends_without_waiting)
+{
+    auto coalescer = this->make_coalescer(50);
+
+    coalescer->send(PEER_A, envelope("first"));
+    coalescer->send(PEER_A, envelope(std::string(20, 'a')));
+    EXPECT_EQ(this->frames.size(), 1u);
+
+    coalescer->send(PEER_A, envelope(std::string(20, 'b')));
+    ASSERT_EQ(this->frames.size(), 2u);
+    EXPECT_EQ(payloads(this->frames[1].second), std::vector<std::string>({std::string(20, 'a'), std::string(20, 'b')}));
+}
+
+
+TEST_F(message_coalescer_test, test_that_batches_packed_again_have_their_envelopes_merged)
+{
+    auto batch = bzn::message_coalescer::pack({envelope("b"), envelope("c")});
+
+    EXPECT_TRUE(bzn::message_coalescer::is_batch(*batch));
+    EXPECT_FALSE(bzn::message_coalescer::is_batch(*envelope("a")));
+    EXPECT_FALSE(bzn::message_coalescer::is_batch(""));
+
+    auto packed = bzn::message_coalescer::pack({envelope("a"), batch, envelope("d")});
+    EXPECT_EQ(payloads(*packed), std::vector<std::string>({"a", "b", "c", "d"}));
+}
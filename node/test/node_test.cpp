@@ -19,12 +19,14 @@
 #include <include/bluzelle.hpp>
 #include <mocks/mock_session_base.hpp>
 #include <mocks/mock_chaos_base.hpp>
+#include <mocks/mock_crypto_base.hpp>
 
 #include <options/options.hpp>
 #include <chaos/chaos.hpp>
 #include <crypto/crypto.hpp>
 
 #include <proto/bluzelle.pb.h>
+#include <thread>
 
 using namespace ::testing;
 
@@ -171,12 +173,96 @@ namespace  bzn
         EXPECT_EQ(msg_type, "asdf");
     }
 
+
+    TEST(node, test_that_handlers_can_be_registered_while_messages_are_dispatched)
+    {
+        auto mock_chaos = std::make_shared<NiceMock<bzn::mock_chaos_base>>();
+        auto mock_io_context = std::make_shared<NiceMock<bzn::asio::Mockio_context_base>>();
+        auto options = std::shared_ptr<bzn::options>();
+        auto crypto = std::shared_ptr<bzn::crypto>();
+        auto node = std::make_shared<bzn::node>(mock_io_context, nullptr, mock_chaos, std::chrono::milliseconds(0), TEST_ENDPOINT, crypto, options);
+
+        // a handler registering another one from inside dispatch...
+        std::atomic<size_t> late_calls{0};
+        ASSERT_TRUE(node->register_for_message("early", [&](const auto&, auto)
+        {
+            node->register_for_message("late", [&](const auto&, auto){ ++late_calls; });
+        }));
+
+        auto mock_session = std::make_shared<NiceMock<bzn::Mocksession_base>>();
+        Json::Value early;
+        early["bzn-api"] = "early";
+        node->priv_msg_handler(early, mock_session);
+
+        Json::Value late;
+        late["bzn-api"] = "late";
+        node->priv_msg_handler(late, mock_session);
+        EXPECT_EQ(late_calls, 1u);
+
+        // dispatching on several threads while more handlers come and go in...
+        std::atomic<size_t> pbft_calls{0};
+        ASSERT_TRUE(node->register_for_message(bzn_envelope::kPbft, [&](const auto&, auto){ ++pbft_calls; }));
+
+        bzn_envelope envelope;
+        envelope.set_pbft("payload");
+
+        std::vector<std::thread> threads;
+        for (size_t t = 0; t < 4; ++t)
+        {
+            threads.emplace_back([&]()
+            {
+                for (size_t i = 0; i < 1000; ++i)
+                {
+                    node->priv_protobuf_handler(envelope, mock_session);
+                    node->priv_msg_handler(late, mock_session);
+                }
+            });
+        }
+
+        for (size_t i = 0; i < 100; ++i)
+        {
+            ASSERT_TRUE(node->register_for_message("type" + std::to_string(i), [](const auto&, auto){}));
+        }
+
+        for (auto& thread : threads)
+        {
+            thread.join();
+        }
+
+        EXPECT_EQ(pbft_calls, 4000u);
+        EXPECT_EQ(late_calls, 4001u);
+    }
+
+
+    TEST(node, test_that_backlogs_are_reported_and_saturate_at_their_limit)
+    {
+        auto mock_chaos = std::make_shared<NiceMock<bzn::mock_chaos_base>>();
+        auto mock_io_context = std::make_shared<NiceMock<bzn::asio::Mockio_context_base>>();
+        auto options = std::shared_ptr<bzn::options>();
+        auto crypto = std::shared_ptr<bzn::crypto>();
+        auto node = std::make_shared<bzn::node>(mock_io_context, nullptr, mock_chaos, std::chrono::milliseconds(0), TEST_ENDPOINT, crypto, options);
+
+        size_t depth = 5;
+        node->register_backlog("executions", [&]() { return depth; }, 10);
+
+        EXPECT_FALSE(node->downstream_saturated());
+
+        auto status = node->get_status();
+        EXPECT_EQ(status["backlogs"]["executions"]["depth"].asUInt64(), 5u);
+        EXPECT_EQ(status["backlogs"]["executions"]["limit"].asUInt64(), 10u);
+
+        depth = 10;
+        EXPECT_TRUE(node->downstream_saturated());
+    }
+
+
     TEST(node, test_that_wrongly_signed_messages_are_dropped)
     {
         auto mock_chaos = std::make_shared<NiceMock<bzn::mock_chaos_base>>();
         auto mock_io_context = std::make_shared<NiceMock<bzn::asio::Mockio_context_base>>();
         auto options = std::make_shared<bzn::options>();
         options->get_mutable_simple_options().set(bzn::option_names::CRYPTO_ENABLED_INCOMING, "true");
+        options->get_mutable_simple_options().set(bzn::option_names::TRAFFIC_SCHEDULING, "false");
         auto crypto = std::make_shared<bzn::crypto>(options);
         auto mock_session = std::make_shared<bzn::Mocksession_base>();
         auto node = std::make_shared<bzn::node>(mock_io_context, nullptr, mock_chaos, std::chrono::milliseconds(0), TEST_ENDPOINT, crypto, options);
@@ -206,6 +292,53 @@ namespace  bzn
     }
 
 
+    TEST(node, test_that_signed_messages_are_verified_off_the_calling_thread)
+    {
+        auto mock_chaos = std::make_shared<NiceMock<bzn::mock_chaos_base>>();
+        auto mock_io_context = std::make_shared<NiceMock<bzn::asio::Mockio_context_base>>();
+        auto options = std::make_shared<bzn::options>();
+        options->get_mutable_simple_options().set(bzn::option_names::CRYPTO_ENABLED_INCOMING, "true");
+        options->get_mutable_simple_options().set(bzn::option_names::TRAFFIC_SCHEDULING, "false");
+        options->get_mutable_simple_options().set(bzn::option_names::CRYPTO_VERIFY_THREADS, "2");
+        auto mock_crypto = std::make_shared<NiceMock<bzn::Mockcrypto_base>>();
+        auto mock_session = std::make_shared<bzn::Mocksession_base>();
+        auto node = std::make_shared<bzn::node>(mock_io_context, nullptr, mock_chaos, std::chrono::milliseconds(0), TEST_ENDPOINT, mock_crypto, options);
+
+        EXPECT_CALL(*mock_crypto, verify(_)).WillRepeatedly(Invoke([](const bzn_envelope& msg)
+        {
+            return msg.pbft() != "bad";
+        }));
+
+        std::mutex lock;
+        std::condition_variable delivered;
+        std::vector<std::string> received;
+        std::set<std::thread::id> handler_threads;
+
+        node->register_for_message(bzn_envelope::kPbft, [&](const auto& msg, auto)
+        {
+            std::lock_guard<std::mutex> guard(lock);
+            received.emplace_back(msg.pbft());
+            handler_threads.insert(std::this_thread::get_id());
+            delivered.notify_all();
+        });
+
+        for (const auto& payload : {"1", "bad", "2", "3"})
+        {
+            bzn_envelope msg;
+            msg.set_sender("uuid1");
+            msg.set_pbft(payload);
+            node->priv_protobuf_handler(msg, mock_session);
+        }
+
+        std::unique_lock<std::mutex> guard(lock);
+        ASSERT_TRUE(delivered.wait_for(guard, std::chrono::seconds(5), [&]() { return received.size() == 3; }));
+
+        EXPECT_EQ(received, std::vector<std::string>({"1", "2", "3"}));
+        EXPECT_EQ(handler_threads.count(std::this_thread::get_id()), 0u);
+        EXPECT_EQ(node->get_status()["verification"]["rejected"].asUInt64(), 1u);
+    }
+
+
     TEST(node, test_that_send_msg_connects_and_performs_handshake)
     {
         auto mock_chaos = std::make_shared<NiceMock<bzn::mock_chaos_base>>();
@@ -251,12 +384,18 @@ namespace  bzn
                 return std::move(mock_websocket_stream);
             }));
 
+        // the connect deadline, and any retry the pool schedules...
+        EXPECT_CALL(*mock_io_context, make_unique_steady_timer()).WillRepeatedly(Invoke(
+            []()
+            {
+                return std::make_unique<NiceMock<bzn::asio::Mocksteady_timer_base>>();
+            }));
+
         node->send_message(TEST_ENDPOINT, std::make_shared<bzn::json_message>("{}"));
 
         // call with no error to validate handshake...
         connect_handler(boost::system::error_code());
 
-        // nothing should happen...
         connect_handler(boost::asio::error::operation_aborted);
     }
 
@@ -288,4 +427,186 @@ namespace  bzn
         io_context->run();
     }
 
+
+    TEST(node, test_that_each_network_reactor_accepts_and_owns_its_sessions)
+    {
+        auto mock_chaos = std::make_shared<NiceMock<bzn::mock_chaos_base>>();
+        auto mock_io_context = std::make_shared<NiceMock<bzn::asio::Mockio_context_base>>();
+        auto mock_websocket = std::make_shared<NiceMock<bzn::beast::Mockwebsocket_base>>();
+
+        static boost::asio::io_context io;
+        static boost::asio::ip::tcp::socket socket(io);
+
+        std::vector<std::shared_ptr<bzn::asio::Mockio_context_base>> reactors;
+        std::vector<bzn::asio::accept_handler> handlers(2);
+
+        for (size_t i = 0; i < 2; ++i)
+        {
+            auto reactor = std::make_shared<NiceMock<bzn::asio::Mockio_context_base>>();
+
+            // every reactor listens on the same endpoint...
+            EXPECT_CALL(*reactor, make_unique_tcp_acceptor(TEST_ENDPOINT)).WillOnce(Invoke(
+                [&handlers, i](auto& /*ep*/)
+                {
+                    auto acceptor = std::make_unique<NiceMock<bzn::asio::Mocktcp_acceptor_base>>();
+                    ON_CALL(*acceptor, async_accept(_, _)).WillByDefault(Invoke(
+                        [&handlers, i](auto& /*socket*/, auto handler)
+                        {
+                            handlers[i] = handler;
+                        }));
+                    return acceptor;
+                }));
+
+            ON_CALL(*reactor, make_unique_tcp_socket()).WillByDefault(Invoke(
+                []()
+                {
+                    auto mock_socket = std::make_unique<NiceMock<bzn::asio::Mocktcp_socket_base>>();
+                    ON_CALL(*mock_socket, get_tcp_socket()).WillByDefault(ReturnRef(socket));
+                    return mock_socket;
+                }));
+
+            reactors.push_back(reactor);
+        }
+
+        EXPECT_CALL(*mock_io_context, make_unique_tcp_acceptor(_)).Times(0);
+
+        ON_CALL(*mock_websocket, make_unique_websocket_stream(_)).WillByDefault(Invoke(
+            [](auto& /*socket*/)
+            {
+                return std::make_unique<NiceMock<bzn::beast::Mockwebsocket_stream_base>>();
+            }));
+
+        // ...and the session accepted by the second is owned by it
+        EXPECT_CALL(*reactors[0], make_unique_strand()).Times(0);
+        EXPECT_CALL(*reactors[1], make_unique_strand()).WillOnce(Invoke(
+            []()
+            {
+                return std::make_unique<NiceMock<bzn::asio::Mockstrand_base>>();
+            }));
+
+        auto node = std::make_shared<bzn::node>(mock_io_context, mock_websocket, mock_chaos, std::chrono::milliseconds(0), TEST_ENDPOINT, nullptr, nullptr,
+            std::vector<std::shared_ptr<bzn::asio::io_context_base>>{reactors[0], reactors[1]});
+        node->start();
+
+        ASSERT_TRUE(handlers[0] && handlers[1]);
+
+        handlers[1](boost::system::error_code());
+    }
+
+
+    TEST(node, test_that_handlers_run_on_the_node_io_context_with_network_reactors)
+    {
+        auto mock_chaos = std::make_shared<NiceMock<bzn::mock_chaos_base>>();
+        auto mock_io_context = std::make_shared<NiceMock<bzn::asio::Mockio_context_base>>();
+        auto reactor = std::make_shared<NiceMock<bzn::asio::Mockio_context_base>>();
+
+        boost::asio::io_context io;
+        ON_CALL(*mock_io_context, get_io_context()).WillByDefault(ReturnRef(io));
+
+        auto node = std::make_shared<bzn::node>(mock_io_context, nullptr, mock_chaos, std::chrono::milliseconds(0), TEST_ENDPOINT, nullptr, nullptr,
+            std::vector<std::shared_ptr<bzn::asio::io_context_base>>{reactor});
+
+        size_t json_calls = 0;
+        size_t protobuf_calls = 0;
+
+        ASSERT_TRUE(node->register_for_message("crud", [&](const auto&, auto) { ++json_calls; }));
+        ASSERT_TRUE(node->register_for_message(bzn_envelope::kPbft, [&](const auto&, auto) { ++protobuf_calls; }));
+
+        auto mock_session = std::make_shared<NiceMock<bzn::Mocksession_base>>();
+
+        Json::Value msg;
+        msg["bzn-api"] = "crud";
+        node->priv_msg_handler(msg, mock_session);
+
+        bzn_envelope envelope;
+        envelope.set_pbft("x");
+        node->priv_protobuf_handler(envelope, mock_session);
+
+        // not on the reactor that read them...
+        EXPECT_EQ(json_calls, 0u);
+        EXPECT_EQ(protobuf_calls, 0u);
+
+        io.run();
+
+        EXPECT_EQ(json_calls, 1u);
+        EXPECT_EQ(protobuf_calls, 1u);
+    }
+
+
+    TEST(node, test_that_protocol_messages_are_handled_before_queued_client_requests)
+    {
+        auto mock_chaos = std::make_shared<NiceMock<bzn::mock_chaos_base>>();
+        auto mock_io_context = std::make_shared<NiceMock<bzn::asio::Mockio_context_base>>();
+        auto options = std::make_shared<bzn::options>();
+        options->get_mutable_simple_options().set(bzn::option_names::TRAFFIC_SCHEDULING, "true");
+
+        boost::asio::io_context io;
+        ON_CALL(*mock_io_context, get_io_context()).WillByDefault(ReturnRef(io));
+
+        auto node = std::make_shared<bzn::node>(mock_io_context, nullptr, mock_chaos, std::chrono::milliseconds(0), TEST_ENDPOINT, nullptr, options);
+
+        std::vector<std::string> handled;
+
+        ASSERT_TRUE(node->register_for_message("database", [&](const auto& msg, auto) { handled.push_back(msg["cmd"].asString()); }));
+        ASSERT_TRUE(node->register_for_message("status", [&](const auto&, auto) { handled.push_back("status"); }));
+        ASSERT_TRUE(node->register_for_message(bzn_envelope::kPbft, [&](const auto& msg, auto) { handled.push_back(msg.pbft()); }));
+
+        auto mock_session = std::make_shared<NiceMock<bzn::Mocksession_base>>();
+
+        for (const auto& cmd : {"create", "read"})
+        {
+            Json::Value msg;
+            msg["bzn-api"] = "database";
+            msg["cmd"] = cmd;
+            node->priv_msg_handler(msg, mock_session);
+        }
+
+        Json::Value status;
+        status["bzn-api"] = "status";
+        node->priv_msg_handler(status, mock_session);
+
+        bzn_envelope envelope;
+        envelope.set_pbft("prepare");
+        node->priv_protobuf_handler(envelope, mock_session);
+
+        EXPECT_TRUE(handled.empty());
+
+        io.run();
+
+        // the pbft message arrived last but doesn't wait behind the client requests...
+        EXPECT_EQ(handled, std::vector<std::string>({"prepare", "create", "read", "status"}));
+
+        const auto traffic = node->get_status()["traffic"];
+        EXPECT_EQ(traffic["protocol"]["served"].asUInt64(), 1u);
+        EXPECT_EQ(traffic["client"]["served"].asUInt64(), 2u);
+        EXPECT_EQ(traffic["telemetry"]["served"].asUInt64(), 1u);
+        EXPECT_EQ(traffic["client"]["max_queued"].asUInt64(), 2u);
+    }
+
+
+    TEST(node, test_that_batched_envelopes_are_each_dispatched)
+    {
+        auto mock_chaos = std::make_shared<NiceMock<bzn::mock_chaos_base>>();
+        auto mock_io_context = std::make_shared<NiceMock<bzn::asio::Mockio_context_base>>();
+        auto node = std::make_shared<bzn::node>(mock_io_context, nullptr, mock_chaos, std::chrono::milliseconds(0), TEST_ENDPOINT, nullptr, nullptr);
+
+        std::vector<std::string> received;
+        ASSERT_TRUE(node->register_for_message(bzn_envelope::kPbft, [&](const auto& msg, auto) { received.push_back(msg.pbft()); }));
+
+        std::vector<std::shared_ptr<bzn::encoded_message>> msgs;
+        for (const auto& payload : {"1", "2", "3"})
+        {
+            bzn_envelope envelope;
+            envelope.set_pbft(payload);
+            msgs.push_back(std::make_shared<bzn::encoded_message>(envelope.SerializeAsString()));
+        }
+
+        bzn_envelope batch;
+        ASSERT_TRUE(batch.ParseFromString(*bzn::message_coalescer::pack(msgs)));
+
+        node->priv_protobuf_handler(batch, std::make_shared<NiceMock<bzn::Mocksession_base>>());
+
+        EXPECT_EQ(received, std::vector<std::string>({"1", "2", "3"}));
+    }
+
 } // namespace bzn
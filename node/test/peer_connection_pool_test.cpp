@@ -0,0 +1,360 @@
+// Copyright (C) 2018 Bluzelle
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU Affero General Public License, version 3,
+// as published by the Free Software Foundation.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU Affero General Public License for more details.
+//
+// You should have received a copy of the GNU Affero General Public License
+// along with this program. If not, see <http://www.gnu.org/licenses/>.
+
+#include <node/peer_connection_pool.hpp>
+#include <mocks/mock_boost_asio_beast.hpp>
+#include <mocks/mock_chaos_base.hpp>
+#include <gmock/gmock.h>
+#include <thread>
+
+using namespace ::testing;
+
+
+namespace
+{
+    const boost::asio::ip::tcp::endpoint PEER_A{boost::asio::ip::address_v4::from_string("127.0.0.1"), 8081};
+    const boost::asio::ip::tcp::endpoint PEER_B{boost::asio::ip::address_v4::from_string("127.0.0.1"), 8082};
+
+    // Hands out mock sockets and websockets whose connects and handshakes are completed by the test, and records
+    // what is written on each connection.
+    class peer_connection_pool_test : public Test
+    {
+    public:
+        peer_connection_pool_test()
+        {
+            ON_CALL(*this->io_context, make_unique_tcp_socket()).WillByDefault(Invoke(
+                [this]()
+                {
+                    auto socket = std::make_unique<NiceMock<bzn::asio::Mocktcp_socket_base>>();
+                    ON_CALL(*socket, get_tcp_socket()).WillByDefault(ReturnRef(this->tcp_socket));
+                    ON_CALL(*socket, async_connect(_, _)).WillByDefault(Invoke(
+                        [this](const auto& ep, auto handler)
+                        {
+                            this->connects.emplace_back(ep, handler);
+                        }));
+                    return socket;
+                }));
+
+            ON_CALL(*this->io_context, make_unique_steady_timer()).WillByDefault(Invoke(
+                [this]()
+                {
+                    auto timer = std::make_unique<NiceMock<bzn::asio::Mocksteady_timer_base>>();
+                    ON_CALL(*timer, async_wait(_)).WillByDefault(Invoke(
+                        [this](auto handler)
+                        {
+                            this->timer_waits.push_back(handler);
+                        }));
+                    return timer;
+                }));
+
+            ON_CALL(*this->io_context, make_unique_strand()).WillByDefault(Invoke(
+                []()
+                {
+                    auto strand = std::make_unique<NiceMock<bzn::asio::Mockstrand_base>>();
+                    ON_CALL(*strand, wrap(An<bzn::asio::write_handler>())).WillByDefault(ReturnArg<0>());
+                    ON_CALL(*strand, dispatch(_)).WillByDefault(InvokeArgument<0>());
+                    return strand;
+                }));
+
+            ON_CALL(*this->websocket, make_unique_websocket_stream(_)).WillByDefault(Invoke(
+                [this](auto& /*socket*/)
+                {
+                    const size_t index = this->streams.size();
+                    this->streams.push_back({true, {}, nullptr, false, ""});
+
+                    auto stream = std::make_unique<NiceMock<bzn::beast::Mockwebsocket_stream_base>>();
+                    ON_CALL(*stream, get_websocket()).WillByDefault(ReturnRef(this->beast_stream));
+                    ON_CALL(*stream, is_open()).WillByDefault(Invoke([this, index]() { return this->streams[index].open; }));
+                    ON_CALL(*stream, async_handshake(_, _, _)).WillByDefault(Invoke(
+                        [this, index](const auto&, const auto& target, auto handler)
+                        {
+                            this->streams[index].target = target;
+                            this->streams[index].handshake = handler;
+                        }));
+                    ON_CALL(*stream, async_write(_, _)).WillByDefault(Invoke(
+                        [this, index](const auto& buffer, auto handler)
+                        {
+                            this->streams[index].written.emplace_back(boost::asio::buffer_cast<const char*>(buffer), boost::asio::buffer_size(buffer));
+                            handler(boost::system::error_code(), boost::asio::buffer_size(buffer));
+                        }));
+                    ON_CALL(*stream, async_close(_, _)).WillByDefault(Invoke(
+                        [this, index](auto, auto)
+                        {
+                            this->streams[index].closed = true;
+                        }));
+                    return stream;
+                }));
+        }
+
+        std::shared_ptr<bzn::peer_connection_pool>
+        make_pool(std::chrono::milliseconds idle_timeout = std::chrono::seconds(60), std::chrono::milliseconds min_backoff = std::chrono::milliseconds(100),
+            std::chrono::milliseconds connect_timeout = std::chrono::seconds(10))
+        {
+            return std::make_shared<bzn::peer_connection_pool>(this->io_context, this->websocket,
+                [this](std::shared_ptr<bzn::asio::io_context_base> io_context, std::shared_ptr<bzn::beast::websocket_stream_base> ws)
+                {
+                    auto session = std::make_shared<bzn::session>(std::move(io_context), 1, std::move(ws), this->chaos, std::chrono::milliseconds(0));
+                    session->start([](auto&, auto){}, [](auto&, auto){});
+                    return session;
+                },
+                idle_timeout, min_backoff, std::chrono::seconds(10), connect_timeout);
+        }
+
+        // complete the latest connect and its handshake
+        void
+        establish()
+        {
+            this->connects.back().second(boost::system::error_code());
+            this->streams.back().handshake(boost::system::error_code());
+        }
+
+        static std::shared_ptr<bzn::encoded_message>
+        msg(const std::string& text)
+        {
+            return std::make_shared<bzn::encoded_message>(text);
+        }
+
+        struct stream
+        {
+            bool open;
+            std::vector<std::string> written;
+            bzn::beast::handshake_handler handshake;
+            bool closed;
+            std::string target;
+        };
+
+        std::shared_ptr<bzn::asio::Mockio_context_base> io_context = std::make_shared<NiceMock<bzn::asio::Mockio_context_base>>();
+        std::shared_ptr<bzn::beast::Mockwebsocket_base> websocket = std::make_shared<NiceMock<bzn::beast::Mockwebsocket_base>>();
+        std::shared_ptr<bzn::mock_chaos_base> chaos = std::make_shared<NiceMock<bzn::mock_chaos_base>>();
+
+        std::vector<std::pair<boost::asio::ip::tcp::endpoint, bzn::asio::connect_handler>> connects;
+        std::vector<bzn::asio::wait_handler> timer_waits;
+        std::deque<stream> streams;
+
+        boost::asio::io_context io;
+        boost::asio::ip::tcp::socket tcp_socket{io};
+        boost::beast::websocket::stream<boost::asio::ip::tcp::socket> beast_stream{io};
+    };
+}
+
+
+TEST_F(peer_connection_pool_test, test_that_messages_to_a_peer_share_one_connection_in_order)
+{
+    auto pool = this->make_pool();
+
+    pool->send(PEER_A, msg("1"));
+    pool->send(PEER_A, msg("2"));
+
+    ASSERT_EQ(this->connects.size(), 1u);
+    EXPECT_EQ(this->connects[0].first, PEER_A);
+
+    this->establish();
+
+    pool->send(PEER_A, msg("3"));
+    pool->send(PEER_A, msg("4"));
+
+    EXPECT_EQ(this->connects.size(), 1u);
+    EXPECT_EQ(this->streams[0].written, std::vector<std::string>({"1", "2", "3", "4"}));
+
+    const auto status = pool->get_status();
+    EXPECT_EQ(status["open"].asUInt64(), 1u);
+    EXPECT_EQ(status["connects"].asUInt64(), 1u);
+    EXPECT_EQ(status["messages_sent"].asUInt64(), 4u);
+    EXPECT_EQ(status["messages_reused"].asUInt64(), 2u);
+    EXPECT_EQ(status["peers"]["127.0.0.1:8081"]["state"].asString(), "connected");
+}
+
+
+TEST_F(peer_connection_pool_test, test_that_unreachable_peer_is_retried_with_backoff)
+{
+    auto pool = this->make_pool(std::chrono::seconds(60), std::chrono::milliseconds(20));
+
+    pool->send(PEER_A, msg("1"));
+    this->connects.back().second(boost::asio::error::connection_refused);
+
+    EXPECT_EQ(pool->get_status()["peers"]["127.0.0.1:8081"]["state"].asString(), "backoff");
+    EXPECT_EQ(pool->get_status()["connect_failures"].asUInt64(), 1u);
+
+    // no new attempt until the backoff has passed, but the message is kept...
+    pool->send(PEER_A, msg("2"));
+    EXPECT_EQ(this->connects.size(), 1u);
+
+    std::this_thread::sleep_for(std::chrono::milliseconds(30));
+
+    pool->send(PEER_A, msg("3"));
+    ASSERT_EQ(this->connects.size(), 2u);
+
+    this->establish();
+
+    ASSERT_EQ(this->streams.size(), 1u);
+    EXPECT_EQ(this->streams[0].written, std::vector<std::string>({"1", "2", "3"}));
+    EXPECT_EQ(pool->get_status()["peers"]["127.0.0.1:8081"]["failures"].asUInt64(), 0u);
+}
+
+
+TEST_F(peer_connection_pool_test, test_that_waiting_messages_are_retried_when_the_backoff_expires)
+{
+    auto pool = this->make_pool();
+
+    pool->send(PEER_A, msg("1"));
+    this->connects.back().second(boost::asio::error::connection_refused);
+
+    // nothing else is sent to the peer, the retry timer (after the connect deadline) brings the message along...
+    ASSERT_EQ(this->timer_waits.size(), 2u);
+    this->timer_waits.back()(boost::system::error_code());
+    ASSERT_EQ(this->connects.size(), 2u);
+
+    this->establish();
+
+    ASSERT_EQ(this->streams.size(), 1u);
+    EXPECT_EQ(this->streams[0].written, std::vector<std::string>({"1"}));
+}
+
+
+TEST_F(peer_connection_pool_test, test_that_retry_timer_does_nothing_once_a_send_has_reconnected)
+{
+    auto pool = this->make_pool(std::chrono::seconds(60), std::chrono::milliseconds(20));
+
+    pool->send(PEER_A, msg("1"));
+    this->connects.back().second(boost::asio::error::connection_refused);
+    ASSERT_EQ(this->timer_waits.size(), 2u);
+
+    std::this_thread::sleep_for(std::chrono::milliseconds(30));
+
+    pool->send(PEER_A, msg("2"));
+    ASSERT_EQ(this->connects.size(), 2u);
+
+    this->timer_waits[1](boost::system::error_code());
+    EXPECT_EQ(this->connects.size(), 2u);
+}
+
+
+TEST_F(peer_connection_pool_test, test_that_a_handshake_that_never_completes_is_retried)
+{
+    auto pool = this->make_pool();
+
+    pool->send(PEER_A, msg("1"));
+    this->connects.back().second(boost::system::error_code());
+
+    // the peer accepted but never answers the handshake, so the deadline gives up on it...
+    ASSERT_EQ(this->timer_waits.size(), 1u);
+    this->timer_waits[0](boost::system::error_code());
+
+    EXPECT_EQ(pool->get_status()["peers"]["127.0.0.1:8081"]["state"].asString(), "backoff");
+    EXPECT_EQ(pool->get_status()["connect_failures"].asUInt64(), 1u);
+
+    // ...and the attempt it gave up on is ignored if it does finish
+    this->streams[0].handshake(boost::system::error_code());
+    EXPECT_EQ(pool->get_status()["open"].asUInt64(), 0u);
+
+    ASSERT_EQ(this->timer_waits.size(), 2u);
+    this->timer_waits[1](boost::system::error_code());
+    ASSERT_EQ(this->connects.size(), 2u);
+
+    this->establish();
+
+    ASSERT_EQ(this->streams.size(), 2u);
+    EXPECT_TRUE(this->streams[0].written.empty());
+    EXPECT_EQ(this->streams[1].written, std::vector<std::string>({"1"}));
+}
+
+
+TEST_F(peer_connection_pool_test, test_that_a_stalled_connect_is_reported_and_evicted)
+{
+    auto pool = this->make_pool(std::chrono::milliseconds(10), std::chrono::milliseconds(100), std::chrono::milliseconds(10));
+
+    // neither the connect nor its deadline ever comes back...
+    pool->send(PEER_A, msg("1"));
+
+    std::this_thread::sleep_for(std::chrono::milliseconds(20));
+
+    EXPECT_EQ(pool->get_status()["peers"]["127.0.0.1:8081"]["state"].asString(), "stalled");
+
+    pool->send(PEER_B, msg("2"));
+
+    const auto status = pool->get_status();
+    EXPECT_EQ(status["evictions"].asUInt64(), 1u);
+    EXPECT_EQ(status["messages_dropped"].asUInt64(), 1u);
+    EXPECT_FALSE(status["peers"].isMember("127.0.0.1:8081"));
+}
+
+
+TEST_F(peer_connection_pool_test, test_that_closed_connection_is_replaced)
+{
+    auto pool = this->make_pool();
+
+    pool->send(PEER_A, msg("1"));
+    this->establish();
+
+    // the peer hangs up...
+    this->streams[0].open = false;
+
+    pool->send(PEER_A, msg("2"));
+    ASSERT_EQ(this->connects.size(), 2u);
+
+    this->establish();
+
+    EXPECT_EQ(this->streams[0].written, std::vector<std::string>({"1"}));
+    EXPECT_EQ(this->streams[1].written, std::vector<std::string>({"2"}));
+    EXPECT_EQ(pool->get_status()["connects"].asUInt64(), 2u);
+}
+
+
+TEST_F(peer_connection_pool_test, test_that_idle_connections_are_closed)
+{
+    auto pool = this->make_pool(std::chrono::milliseconds(10));
+
+    pool->send(PEER_A, msg("1"));
+    this->establish();
+
+    std::this_thread::sleep_for(std::chrono::milliseconds(20));
+
+    pool->send(PEER_B, msg("2"));
+
+    EXPECT_TRUE(this->streams[0].closed);
+
+    const auto status = pool->get_status();
+    EXPECT_EQ(status["evictions"].asUInt64(), 1u);
+    EXPECT_FALSE(status["peers"].isMember("127.0.0.1:8081"));
+    EXPECT_TRUE(status["peers"].isMember("127.0.0.1:8082"));
+}
+
+
+TEST_F(peer_connection_pool_test, test_that_deflate_is_offered_on_the_one_connection_to_a_peer)
+{
+    auto pool = this->make_pool();
+    pool->set_deflate(bzn::deflate_options{true, 6, 15});
+
+    pool->send(PEER_A, msg("small"));
+    ASSERT_EQ(this->connects.size(), 1u);
+    this->establish();
+
+    boost::beast::websocket::permessage_deflate pmd;
+    this->beast_stream.get_option(pmd);
+    EXPECT_TRUE(pmd.client_enable);
+
+    // messages of any size share the connection, and keep their order...
+    pool->send(PEER_A, msg("rather larger than the first"));
+    pool->send(PEER_A, msg("tiny"));
+
+    EXPECT_EQ(this->connects.size(), 1u);
+    EXPECT_EQ(this->streams[0].written, std::vector<std::string>({"small", "rather larger than the first", "tiny"}));
+
+    // peers are told apart from clients by where they connect...
+    EXPECT_EQ(this->streams[0].target, bzn::peer_connection_pool::PEER_TARGET);
+
+    const auto status = pool->get_status();
+    EXPECT_EQ(status["peers"].size(), 1u);
+    EXPECT_EQ(status["peers"]["127.0.0.1:8081"]["sent"].asUInt64(), 3u);
+}
@@ -0,0 +1,74 @@
+// Copyright (C) 2018 Bluzelle
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU Affero General Public License, version 3,
+// as published by the Free Software Foundation.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU Affero General Public License for more details.
+//
+// You should have received a copy of the GNU Affero General Public License
+// along with this program. If not, see <http://www.gnu.org/licenses/>.
+
+#include <node/reactor_pool.hpp>
+#include <gmock/gmock.h>
+#include <condition_variable>
+#include <set>
+
+using namespace ::testing;
+
+
+TEST(reactor_pool, test_that_each_reactor_runs_on_a_thread_of_its_own_until_stopped)
+{
+    bzn::reactor_pool pool(2);
+
+    ASSERT_EQ(pool.get_network_reactors().size(), 2u);
+
+    std::vector<std::shared_ptr<bzn::asio::io_context_base>> reactors{pool.get_consensus_reactor()};
+    reactors.insert(reactors.end(), pool.get_network_reactors().begin(), pool.get_network_reactors().end());
+
+    std::thread runner([&]() { pool.run(); });
+
+    // reactors with nothing to do keep running...
+    std::this_thread::sleep_for(std::chrono::milliseconds(20));
+
+    std::mutex lock;
+    std::condition_variable ran;
+    std::vector<std::set<std::thread::id>> threads(reactors.size());
+    size_t count = 0;
+
+    for (size_t i = 0; i < reactors.size(); ++i)
+    {
+        for (size_t j = 0; j < 10; ++j)
+        {
+            boost::asio::post(reactors[i]->get_io_context(),
+                [&, i]()
+                {
+                    std::lock_guard<std::mutex> guard(lock);
+                    threads[i].insert(std::this_thread::get_id());
+                    ++count;
+                    ran.notify_all();
+                });
+        }
+    }
+
+    {
+        std::unique_lock<std::mutex> guard(lock);
+        ASSERT_TRUE(ran.wait_for(guard, std::chrono::seconds(5), [&]() { return count == reactors.size() * 10; }));
+    }
+
+    std::set<std::thread::id> all;
+    for (const auto& t : threads)
+    {
+        EXPECT_EQ(t.size(), 1u);
+        all.insert(t.begin(), t.end());
+    }
+
+    EXPECT_EQ(all.size(), reactors.size());
+    EXPECT_EQ(all.count(std::this_thread::get_id()), 0u);
+
+    pool.stop();
+    runner.join();
+}
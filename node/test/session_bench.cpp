@@ -0,0 +1,226 @@
+// Copyright (C) 2018 Bluzelle
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU Affero General Public License, version 3,
+// as published by the Free Software Foundation.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU Affero General Public License for more details.
+//
+// You should have received a copy of the GNU Affero General Public License
+// along with this program. If not, see <http://www.gnu.org/licenses/>.
+
+// Measures the cost of receiving and decoding one websocket frame three ways: "probe" is the original (a fresh
+// multi_buffer per read, copied into a stream, tried as JSON and parsed as protobuf from the stream when that fails),
+// "per read" decodes by frame type but still into a fresh buffer each time, and "reused" is what the session does now,
+// decoding in place from its one flat buffer. Usage:
+//
+//   session_bench [iterations]
+//
+// "allocs" and "bytes" are heap allocations per frame, including those made by the decoded message itself.
+
+#include <node/session.hpp>
+#include <proto/bluzelle.pb.h>
+#include <json/json.h>
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <new>
+#include <sstream>
+
+namespace
+{
+    std::atomic<uint64_t> allocations{0};
+    std::atomic<uint64_t> allocated_bytes{0};
+}
+
+
+// counts every allocation; kept out of line so the compiler doesn't pair the malloc and free up itself...
+__attribute__((noinline)) void*
+operator new(size_t size)
+{
+    allocations.fetch_add(1, std::memory_order_relaxed);
+    allocated_bytes.fetch_add(size, std::memory_order_relaxed);
+
+    if (void* p = std::malloc(size ? size : 1))
+    {
+        return p;
+    }
+
+    throw std::bad_alloc();
+}
+
+
+__attribute__((noinline)) void
+operator delete(void* p) noexcept
+{
+    std::free(p);
+}
+
+
+__attribute__((noinline)) void
+operator delete(void* p, size_t /*size*/) noexcept
+{
+    std::free(p);
+}
+
+
+namespace
+{
+    struct frame
+    {
+        const char* name;
+        std::string data;
+        bool text;
+    };
+
+
+    struct cost
+    {
+        double ns = 0;
+        double allocs = 0;
+        double bytes = 0;
+    };
+
+
+    std::string
+    make_envelope(size_t payload_size)
+    {
+        bzn_envelope envelope;
+        envelope.set_sender("c6a0ba6a-d8d5-4e34-9ad2-6b1ac1ad7c3e");
+        envelope.set_signature(std::string(256, 's'));
+        envelope.set_pbft(std::string(payload_size, 'p'));
+
+        return envelope.SerializeAsString();
+    }
+
+
+    // stands in for the websocket read filling the buffer
+    template<typename Buffer>
+    void
+    receive(Buffer& buffer, const std::string& data)
+    {
+        buffer.commit(boost::asio::buffer_copy(buffer.prepare(data.size()), boost::asio::buffer(data)));
+    }
+
+
+    // what session::do_read did before frames were typed and the read buffer was kept
+    bool
+    probe_read(const frame& f)
+    {
+        auto buffer = std::make_shared<boost::beast::multi_buffer>();
+        receive(*buffer, f.data);
+
+        std::stringstream ss;
+        for (const auto& b : buffer->data())
+        {
+            ss.write(static_cast<const char*>(b.data()), b.size());
+        }
+
+        Json::Value msg;
+        Json::Reader reader;
+        bzn_envelope proto_msg;
+
+        return reader.parse(ss.str(), msg) || proto_msg.ParseFromIstream(&ss);
+    }
+
+
+    // what session::do_read and session::handle_frame do now, given the session's buffer
+    bool
+    typed_read(boost::beast::flat_buffer& buffer, const frame& f)
+    {
+        receive(buffer, f.data);
+
+        const char* data = static_cast<const char*>(buffer.data().data());
+        const size_t size = buffer.size();
+
+        bool decoded;
+        if (bzn::session::classify_frame(f.text, data, size) == bzn::session::frame_type::json)
+        {
+            Json::Value msg;
+            Json::Reader reader;
+
+            decoded = reader.parse(data, data + size, msg);
+        }
+        else
+        {
+            bzn_envelope proto_msg;
+            decoded = proto_msg.ParseFromArray(data, static_cast<int>(size));
+        }
+
+        buffer.consume(buffer.size());
+
+        return decoded;
+    }
+
+
+    template<typename F>
+    cost
+    measure(size_t iterations, F&& read)
+    {
+        const auto start_allocations = allocations.load();
+        const auto start_bytes = allocated_bytes.load();
+        const auto start = std::chrono::steady_clock::now();
+
+        for (size_t i = 0; i < iterations; ++i)
+        {
+            if (!read())
+            {
+                std::fprintf(stderr, "decode failed\n");
+                return {};
+            }
+        }
+
+        cost result;
+        result.ns = std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - start).count() / iterations;
+        result.allocs = double(allocations.load() - start_allocations) / iterations;
+        result.bytes = double(allocated_bytes.load() - start_bytes) / iterations;
+
+        return result;
+    }
+}
+
+
+int
+main(int argc, const char* argv[])
+{
+    const size_t iterations = argc > 1 ? std::stoul(argv[1]) : 100000;
+
+    const std::string json = "{\"bzn-api\":\"crud\",\"cmd\":\"read\",\"data\":{\"key\":\"key0\"},\"db-uuid\":\"db0\",\"request-id\":42}";
+
+    const std::vector<frame> frames{
+        {"pbft prepare", make_envelope(120), false},
+        {"pbft preprepare 10k", make_envelope(10000), false},
+        {"json client request", json, true},
+        {"json in binary frame", json, false}};
+
+    std::printf("%-22s %6s |%23s |%23s |%23s\n", "", "", "probe", "per read", "reused");
+    std::printf("%-22s %6s |", "frame", "size");
+    for (int i = 0; i < 3; ++i)
+    {
+        std::printf(" %7s %6s %8s |", "ns", "allocs", "bytes");
+    }
+    std::printf("\n");
+
+    for (const auto& f : frames)
+    {
+        boost::beast::flat_buffer buffer;
+
+        const cost costs[] = {
+            measure(iterations, [&]() { return probe_read(f); }),
+            measure(iterations, [&]() { boost::beast::flat_buffer fresh; return typed_read(fresh, f); }),
+            measure(iterations, [&]() { return typed_read(buffer, f); })};
+
+        std::printf("%-22s %6zu |", f.name, f.data.size());
+        for (const auto& c : costs)
+        {
+            std::printf(" %7.0f %6.1f %8.0f |", c.ns, c.allocs, c.bytes);
+        }
+        std::printf("\n");
+    }
+
+    return 0;
+}
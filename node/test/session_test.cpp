@@ -50,6 +50,8 @@ namespace bzn
                 return handler;
             }));
 
+        EXPECT_CALL(*mock_strand, dispatch(_)).WillRepeatedly(InvokeArgument<0>());
+
         EXPECT_CALL(*mock_steady_timer, expires_from_now(std::chrono::milliseconds(1000)));
 
         bzn::asio::wait_handler wh;
@@ -125,6 +127,8 @@ namespace bzn
                 return handler;
             }));
 
+        EXPECT_CALL(*mock_strand, dispatch(_)).WillRepeatedly(InvokeArgument<0>());
+
         auto session = std::make_shared<bzn::session>(mock_io_context, bzn::session_id(1), websocket_stream, mock_chaos, std::chrono::milliseconds(0));
 
         bzn::asio::accept_handler accept_handler;
@@ -172,6 +176,13 @@ namespace bzn
         read_handler(boost::system::error_code(), 0);
         ASSERT_FALSE(json_handler_called);
 
+        // JSON in a binary frame may have whitespace before it...
+        write_to_buffer(" \r\n\t{\"some\": \"valid json\"}");
+
+        read_handler(boost::system::error_code(), 0);
+        ASSERT_TRUE(json_handler_called);
+        json_handler_called = false;
+
         // calling with an error should not do anything...
         json_handler_called = false;
         read_handler(boost::asio::error::operation_aborted, 0);
@@ -188,6 +199,207 @@ namespace bzn
     }
 
 
+    TEST(node_session, test_that_read_buffer_is_reused_and_not_read_into_while_handled)
+    {
+        auto mock_io_context = std::make_shared<bzn::asio::Mockio_context_base>();
+        auto websocket_stream = std::make_shared<NiceMock<bzn::beast::Mockwebsocket_stream_base>>();
+        auto mock_chaos = std::make_shared<NiceMock<bzn::mock_chaos_base>>();
+
+        EXPECT_CALL(*mock_io_context, make_unique_strand()).WillOnce(Invoke(
+            []()
+            {
+                auto strand = std::make_unique<NiceMock<bzn::asio::Mockstrand_base>>();
+                ON_CALL(*strand, wrap(An<bzn::asio::read_handler>())).WillByDefault(ReturnArg<0>());
+                ON_CALL(*strand, dispatch(_)).WillByDefault(InvokeArgument<0>());
+                return strand;
+            }));
+
+        EXPECT_CALL(*mock_io_context, make_unique_steady_timer()).WillOnce(Invoke(
+            []()
+            {
+                return std::make_unique<NiceMock<bzn::asio::Mocksteady_timer_base>>();
+            }));
+
+        boost::asio::io_context io;
+        boost::beast::websocket::stream<boost::asio::ip::tcp::socket> socket(io);
+        ON_CALL(*websocket_stream, get_websocket()).WillByDefault(ReturnRef(socket));
+        ON_CALL(*websocket_stream, is_open()).WillByDefault(Return(true));
+
+        std::vector<boost::beast::flat_buffer*> buffers;
+        bzn::asio::read_handler read_handler;
+        EXPECT_CALL(*websocket_stream, async_read(_,_)).Times(2).WillRepeatedly(Invoke(
+            [&](auto& buffer, auto handler)
+            {
+                buffers.push_back(&buffer);
+                read_handler = handler;
+            }));
+
+        auto session = std::make_shared<bzn::session>(mock_io_context, bzn::session_id(1), websocket_stream, mock_chaos, std::chrono::milliseconds(0));
+
+        // replying from the handler must not start a read into the buffer being decoded...
+        session->start([](auto&, auto session){ session->send_message(std::make_shared<bzn::json_message>("reply"), false); }, [](auto&, auto){});
+        session->send_datagram(std::make_shared<bzn::encoded_message>("x"));
+        session->send_message(std::make_shared<bzn::encoded_message>("x"), false);
+
+        ASSERT_EQ(buffers.size(), 1u);
+
+        const std::string json = "{\"some\": \"valid json\"}";
+        buffers[0]->commit(boost::asio::buffer_copy(buffers[0]->prepare(json.size()), boost::asio::buffer(json)));
+        read_handler(boost::system::error_code(), json.size());
+
+        ASSERT_EQ(buffers.size(), 2u);
+        EXPECT_EQ(buffers[0], buffers[1]);
+        EXPECT_EQ(buffers[1]->size(), 0u);
+        EXPECT_GE(buffers[1]->capacity(), json.size());
+    }
+
+
+    class node_session_flow_control : public Test
+    {
+    public:
+        node_session_flow_control()
+        {
+            ON_CALL(*this->mock_io_context, make_unique_strand()).WillByDefault(Invoke(
+                []()
+                {
+                    auto strand = std::make_unique<NiceMock<bzn::asio::Mockstrand_base>>();
+                    ON_CALL(*strand, wrap(An<bzn::asio::read_handler>())).WillByDefault(ReturnArg<0>());
+                    ON_CALL(*strand, dispatch(_)).WillByDefault(InvokeArgument<0>());
+                    return strand;
+                }));
+
+            ON_CALL(*this->mock_io_context, make_unique_steady_timer()).WillByDefault(Invoke(
+                [this]()
+                {
+                    auto timer = std::make_unique<NiceMock<bzn::asio::Mocksteady_timer_base>>();
+                    ON_CALL(*timer, async_wait(_)).WillByDefault(Invoke(
+                        [this](auto handler)
+                        {
+                            this->wait_handlers.push_back(handler);
+                        }));
+                    return timer;
+                }));
+
+            ON_CALL(*this->websocket_stream, get_websocket()).WillByDefault(ReturnRef(this->socket));
+            ON_CALL(*this->websocket_stream, is_open()).WillByDefault(Return(true));
+            ON_CALL(*this->websocket_stream, async_read(_,_)).WillByDefault(Invoke(
+                [this](auto& buffer, auto handler)
+                {
+                    this->read_buffer = &buffer;
+                    this->read_handler = handler;
+                    ++this->reads;
+                }));
+        }
+
+        // deliver an envelope to the read in progress
+        void
+        receive(const std::string& sender)
+        {
+            bzn_envelope envelope;
+            envelope.set_sender(sender);
+            const auto data = envelope.SerializeAsString();
+
+            ASSERT_TRUE(this->read_handler);
+            auto handler = std::move(this->read_handler);
+            this->read_handler = nullptr;
+
+            this->read_buffer->commit(boost::asio::buffer_copy(this->read_buffer->prepare(data.size()), boost::asio::buffer(data)));
+            handler(boost::system::error_code(), data.size());
+        }
+
+        std::shared_ptr<bzn::asio::Mockio_context_base> mock_io_context = std::make_shared<NiceMock<bzn::asio::Mockio_context_base>>();
+        std::shared_ptr<bzn::beast::Mockwebsocket_stream_base> websocket_stream = std::make_shared<NiceMock<bzn::beast::Mockwebsocket_stream_base>>();
+        std::shared_ptr<bzn::mock_chaos_base> mock_chaos = std::make_shared<NiceMock<bzn::mock_chaos_base>>();
+
+        boost::asio::io_context io;
+        boost::beast::websocket::stream<boost::asio::ip::tcp::socket> socket{io};
+
+        boost::beast::flat_buffer* read_buffer = nullptr;
+        bzn::asio::read_handler read_handler;
+        size_t reads = 0;
+        std::vector<bzn::asio::wait_handler> wait_handlers;
+    };
+
+
+    TEST_F(node_session_flow_control, test_that_reads_pause_while_messages_are_held_and_resume_when_released)
+    {
+        auto session = std::make_shared<bzn::session>(this->mock_io_context, bzn::session_id(1), this->websocket_stream, this->mock_chaos, std::chrono::milliseconds(0));
+        session->set_flow_control(2, 0, nullptr);
+
+        // the handler finishes with each message elsewhere...
+        std::vector<std::shared_ptr<void>> held;
+        session->start([](auto&, auto){}, [&](auto&, auto session){ held.push_back(session->hold_read_credit()); });
+        session->send_message(std::make_shared<bzn::encoded_message>("hello"), false);
+
+        this->receive("1");
+        this->receive("2");
+
+        EXPECT_EQ(this->reads, 2u);
+        EXPECT_EQ(session->in_flight_messages(), 2u);
+        EXPECT_TRUE(session->is_read_paused());
+
+        // a reply doesn't restart reading...
+        session->send_message(std::make_shared<bzn::encoded_message>("reply"), false);
+        EXPECT_EQ(this->reads, 2u);
+
+        held.erase(held.begin());
+
+        EXPECT_EQ(this->reads, 3u);
+        EXPECT_EQ(session->in_flight_messages(), 1u);
+        EXPECT_FALSE(session->is_read_paused());
+    }
+
+
+    TEST_F(node_session_flow_control, test_that_reads_pause_while_downstream_is_saturated)
+    {
+        auto session = std::make_shared<bzn::session>(this->mock_io_context, bzn::session_id(1), this->websocket_stream, this->mock_chaos, std::chrono::milliseconds(0));
+
+        bool saturated = false;
+        size_t handled = 0;
+        session->set_flow_control(0, 0, [&]() { return saturated; });
+        session->start([](auto&, auto){}, [&](auto&, auto){ ++handled; });
+        session->send_message(std::make_shared<bzn::encoded_message>("hello"), false);
+
+        // messages are handled and let go of at once, so only downstream can stop the reading...
+        saturated = true;
+        this->receive("1");
+
+        EXPECT_EQ(handled, 1u);
+        EXPECT_EQ(session->in_flight_messages(), 0u);
+        EXPECT_EQ(this->reads, 1u);
+        EXPECT_TRUE(session->is_read_paused());
+
+        // still saturated when the timer goes off, so it waits again...
+        const auto waits = this->wait_handlers.size();
+        this->wait_handlers.back()(boost::system::error_code());
+        EXPECT_EQ(this->reads, 1u);
+        EXPECT_EQ(this->wait_handlers.size(), waits + 1);
+
+        saturated = false;
+        this->wait_handlers.back()(boost::system::error_code());
+        EXPECT_EQ(this->reads, 2u);
+        EXPECT_FALSE(session->is_read_paused());
+    }
+
+
+    TEST(node_session, test_that_frames_are_decoded_by_opcode_and_first_byte)
+    {
+        bzn_envelope envelope;
+        envelope.set_sender("uuid");
+        envelope.set_pbft("payload");
+        const auto proto = envelope.SerializeAsString();
+        const std::string json = "{\"bzn-api\": \"raft\"}";
+
+        EXPECT_EQ(session::classify_frame(true, json.data(), json.size()), session::frame_type::json);
+        EXPECT_EQ(session::classify_frame(false, json.data(), json.size()), session::frame_type::json);
+        EXPECT_EQ(session::classify_frame(false, proto.data(), proto.size()), session::frame_type::protobuf);
+        EXPECT_EQ(session::classify_frame(false, "", 0), session::frame_type::protobuf);
+
+        // a text frame is never taken for protobuf, whatever it holds...
+        EXPECT_EQ(session::classify_frame(true, proto.data(), proto.size()), session::frame_type::json);
+    }
+
+
     TEST(node_session, test_that_response_can_be_sent)
     {
         auto mock_io_context = std::make_shared<bzn::asio::Mockio_context_base>();
@@ -207,6 +419,8 @@ namespace bzn
                 return handler;
             }));
 
+        EXPECT_CALL(*mock_strand, dispatch(_)).WillRepeatedly(InvokeArgument<0>());
+
         EXPECT_CALL(*mock_io_context, make_unique_strand()).WillOnce(Invoke(
             [&]()
             {
@@ -223,41 +437,328 @@ namespace bzn
 
         auto session = std::make_shared<bzn::session>(mock_io_context, bzn::session_id(1), mock_websocket_stream, mock_chaos, std::chrono::milliseconds(0));
 
-        EXPECT_CALL(*mock_websocket_stream, write(_,_));
-        EXPECT_CALL(*mock_websocket_stream, is_open()).WillOnce(Return(true));
+        bzn::asio::write_handler write_handler;
+        EXPECT_CALL(*mock_websocket_stream, async_write(_,_)).WillRepeatedly(Invoke(
+            [&](auto& /*buffer*/, auto handler)
+            {
+                write_handler = handler;
+            }));
 
         // expect a call to binary!
         boost::asio::io_context io;
         boost::beast::websocket::stream<boost::asio::ip::tcp::socket> socket(io);
         EXPECT_CALL(*mock_websocket_stream, get_websocket()).WillRepeatedly(ReturnRef(socket));
 
-        // no read exepected...
+        session->send_message(std::make_shared<bzn::json_message>("asdf"), true);
+
+        // no read exepected, and the session is closed once the write is done...
+        EXPECT_CALL(*mock_websocket_stream, is_open()).WillOnce(Return(true));
         EXPECT_CALL(*mock_websocket_stream, async_close(_,_));
+        write_handler(boost::system::error_code(), 4);
+    }
 
-        session->send_message(std::make_shared<bzn::json_message>("asdf"), true);
 
-        // read should be setup...
-        EXPECT_CALL(*mock_websocket_stream, async_read(_,_));
-        EXPECT_CALL(*mock_websocket_stream, write(_,_)).WillOnce(Invoke(
-            [&](auto& /*buffer*/, auto& ec)
+    TEST(node_session, test_that_stream_operations_are_started_on_the_strand)
+    {
+        auto mock_io_context = std::make_shared<bzn::asio::Mockio_context_base>();
+        auto mock_strand = std::make_unique<NiceMock<bzn::asio::Mockstrand_base>>();
+        auto mock_chaos = std::make_shared<NiceMock<bzn::mock_chaos_base>>();
+
+        // the strand is busy until the test says otherwise...
+        std::vector<bzn::asio::task> strand_tasks;
+        ON_CALL(*mock_strand, wrap(An<bzn::asio::write_handler>())).WillByDefault(ReturnArg<0>());
+        ON_CALL(*mock_strand, dispatch(_)).WillByDefault(Invoke([&](auto task) { strand_tasks.push_back(task); }));
+
+        EXPECT_CALL(*mock_io_context, make_unique_strand()).WillOnce(Invoke([&]() { return std::move(mock_strand); }));
+        EXPECT_CALL(*mock_io_context, make_unique_steady_timer()).WillOnce(Invoke(
+            []()
             {
-                ec = boost::beast::error_code();
-                return 1;
+                return std::make_unique<NiceMock<bzn::asio::Mocksteady_timer_base>>();
             }));
 
-        session->send_message(std::make_shared<bzn::json_message>("asdf"), false);
+        auto mock_websocket_stream = std::make_shared<NiceMock<bzn::beast::Mockwebsocket_stream_base>>();
+
+        boost::asio::io_context io;
+        boost::beast::websocket::stream<boost::asio::ip::tcp::socket> socket(io);
+        ON_CALL(*mock_websocket_stream, get_websocket()).WillByDefault(ReturnRef(socket));
+        ON_CALL(*mock_websocket_stream, is_open()).WillByDefault(Return(true));
+
+        auto session = std::make_shared<bzn::session>(mock_io_context, bzn::session_id(1), mock_websocket_stream, mock_chaos, std::chrono::milliseconds(0));
+
+        size_t writes = 0;
+        size_t reads = 0;
+        ON_CALL(*mock_websocket_stream, async_write(_,_)).WillByDefault(Invoke([&](auto&, auto) { ++writes; }));
+        ON_CALL(*mock_websocket_stream, async_read(_,_)).WillByDefault(Invoke([&](auto&, auto) { ++reads; }));
+
+        session->send_message(std::make_shared<bzn::encoded_message>("asdf"), false);
+
+        EXPECT_EQ(writes, 0u);
+        EXPECT_EQ(reads, 0u);
+        ASSERT_EQ(strand_tasks.size(), 2u);
+
+        for (const auto& task : strand_tasks)
+        {
+            task();
+        }
+
+        EXPECT_EQ(writes, 1u);
+        EXPECT_EQ(reads, 1u);
+
+        // closing goes through the strand too...
+        EXPECT_CALL(*mock_websocket_stream, async_close(_,_)).Times(0);
+        session->close();
+        Mock::VerifyAndClearExpectations(mock_websocket_stream.get());
 
-        // error no read should be setup...
         EXPECT_CALL(*mock_websocket_stream, async_close(_,_));
-        EXPECT_CALL(*mock_websocket_stream, is_open()).WillOnce(Return(true));
+        strand_tasks.back()();
+    }
+
+
+    TEST(node_session, test_that_failed_write_closes_session)
+    {
+        auto mock_io_context = std::make_shared<bzn::asio::Mockio_context_base>();
+        auto mock_strand = std::make_unique<NiceMock<bzn::asio::Mockstrand_base>>();
+        auto mock_steady_timer = std::make_unique<NiceMock<bzn::asio::Mocksteady_timer_base>>();
+        auto mock_chaos = std::make_shared<NiceMock<bzn::mock_chaos_base>>();
+
+        ON_CALL(*mock_strand, wrap(An<bzn::asio::write_handler>())).WillByDefault(ReturnArg<0>());
+        ON_CALL(*mock_strand, dispatch(_)).WillByDefault(InvokeArgument<0>());
+        EXPECT_CALL(*mock_io_context, make_unique_strand()).WillOnce(Invoke([&]() { return std::move(mock_strand); }));
+        EXPECT_CALL(*mock_io_context, make_unique_steady_timer()).WillOnce(Invoke([&]() { return std::move(mock_steady_timer); }));
+
+        auto mock_websocket_stream = std::make_shared<bzn::beast::Mockwebsocket_stream_base>();
 
-        EXPECT_CALL(*mock_websocket_stream, write(_,_)).WillOnce(Invoke(
-            [&](auto& /*buffer*/, auto& ec)
+        boost::asio::io_context io;
+        boost::beast::websocket::stream<boost::asio::ip::tcp::socket> socket(io);
+        EXPECT_CALL(*mock_websocket_stream, get_websocket()).WillRepeatedly(ReturnRef(socket));
+
+        auto session = std::make_shared<bzn::session>(mock_io_context, bzn::session_id(1), mock_websocket_stream, mock_chaos, std::chrono::milliseconds(0));
+
+        bzn::asio::write_handler write_handler;
+        EXPECT_CALL(*mock_websocket_stream, async_write(_,_)).WillOnce(Invoke(
+            [&](auto& /*buffer*/, auto handler)
             {
-                ec = boost::asio::error::operation_aborted;
-                return 0;
+                write_handler = handler;
             }));
+
+        // read should be setup...
+        EXPECT_CALL(*mock_websocket_stream, async_read(_,_));
+
+        session->send_message(std::make_shared<bzn::json_message>("asdf"), false);
         session->send_message(std::make_shared<bzn::json_message>("asdf"), false);
+        EXPECT_EQ(session->write_queue_size(), 1u);
+
+        // error: what was queued is dropped and nothing more is written...
+        EXPECT_CALL(*mock_websocket_stream, is_open()).WillRepeatedly(Return(true));
+        EXPECT_CALL(*mock_websocket_stream, async_close(_,_));
+        write_handler(boost::asio::error::operation_aborted, 0);
+
+        EXPECT_FALSE(session->is_open());
+        EXPECT_EQ(session->write_queue_size(), 0u);
+
+        session->send_datagram(std::make_shared<bzn::encoded_message>("asdf"));
+    }
+
+
+    class node_session_write_queue : public Test
+    {
+    public:
+        std::shared_ptr<bzn::session>
+        make_session(size_t max_write_queue, bzn::session::write_overflow_policy policy)
+        {
+            EXPECT_CALL(*this->mock_io_context, make_unique_strand()).WillOnce(Invoke(
+                []()
+                {
+                    auto strand = std::make_unique<NiceMock<bzn::asio::Mockstrand_base>>();
+                    ON_CALL(*strand, wrap(An<bzn::asio::write_handler>())).WillByDefault(ReturnArg<0>());
+                    ON_CALL(*strand, dispatch(_)).WillByDefault(InvokeArgument<0>());
+                    return strand;
+                }));
+
+            EXPECT_CALL(*this->mock_io_context, make_unique_steady_timer()).WillOnce(Invoke(
+                []()
+                {
+                    return std::make_unique<NiceMock<bzn::asio::Mocksteady_timer_base>>();
+                }));
+
+            ON_CALL(*this->mock_websocket_stream, get_websocket()).WillByDefault(ReturnRef(this->socket));
+            ON_CALL(*this->mock_websocket_stream, is_open()).WillByDefault(Return(true));
+            ON_CALL(*this->mock_websocket_stream, async_write(_,_)).WillByDefault(Invoke(
+                [this](const auto& buffer, auto handler)
+                {
+                    this->written.emplace_back(boost::asio::buffer_cast<const char*>(buffer), boost::asio::buffer_size(buffer));
+                    this->handlers.push_back(handler);
+                }));
+            ON_CALL(*this->mock_websocket_stream, async_close(_,_)).WillByDefault(Invoke(
+                [this](auto, auto)
+                {
+                    this->close_count++;
+                }));
+
+            return std::make_shared<bzn::session>(this->mock_io_context, bzn::session_id(1), this->mock_websocket_stream, this->mock_chaos,
+                std::chrono::milliseconds(0), max_write_queue, policy);
+        }
+
+        // complete the oldest write still in flight
+        void
+        complete_write()
+        {
+            auto handler = this->handlers.front();
+            this->handlers.pop_front();
+            handler(boost::system::error_code(), 0);
+        }
+
+        static std::shared_ptr<bzn::encoded_message>
+        msg(const std::string& text)
+        {
+            return std::make_shared<bzn::encoded_message>(text);
+        }
+
+        std::shared_ptr<bzn::asio::Mockio_context_base> mock_io_context = std::make_shared<bzn::asio::Mockio_context_base>();
+        std::shared_ptr<bzn::beast::Mockwebsocket_stream_base> mock_websocket_stream = std::make_shared<NiceMock<bzn::beast::Mockwebsocket_stream_base>>();
+        std::shared_ptr<bzn::mock_chaos_base> mock_chaos = std::make_shared<NiceMock<bzn::mock_chaos_base>>();
+
+        boost::asio::io_context io;
+        boost::beast::websocket::stream<boost::asio::ip::tcp::socket> socket{io};
+
+        std::vector<std::string> written;
+        std::deque<bzn::asio::write_handler> handlers;
+        size_t close_count = 0;
+    };
+
+
+    TEST_F(node_session_write_queue, test_that_one_write_is_in_flight_and_queued_messages_follow_in_order)
+    {
+        auto session = this->make_session(10, bzn::session::write_overflow_policy::drop_oldest);
+
+        session->send_datagram(msg("1"));
+        session->send_datagram(msg("2"));
+        session->send_message(msg("3"), true);
+
+        // anything sent after the end of the session is dropped...
+        session->send_datagram(msg("4"));
+
+        EXPECT_EQ(this->written, std::vector<std::string>({"1"}));
+        EXPECT_EQ(session->write_queue_size(), 2u);
+
+        this->complete_write();
+        EXPECT_EQ(this->written, std::vector<std::string>({"1", "2"}));
+
+        this->complete_write();
+        EXPECT_EQ(this->written, std::vector<std::string>({"1", "2", "3"}));
+        EXPECT_EQ(this->close_count, 0u);
+
+        this->complete_write();
+        EXPECT_EQ(this->close_count, 1u);
+        EXPECT_TRUE(this->handlers.empty());
+    }
+
+
+    TEST_F(node_session_write_queue, test_that_full_queue_drops_oldest_messages)
+    {
+        auto session = this->make_session(2, bzn::session::write_overflow_policy::drop_oldest);
+
+        for (const auto& text : {"1", "2", "3", "4", "5"})
+        {
+            session->send_datagram(msg(text));
+        }
+
+        EXPECT_EQ(session->dropped_messages(), 2u);
+
+        while (!this->handlers.empty())
+        {
+            this->complete_write();
+        }
+
+        EXPECT_EQ(this->written, std::vector<std::string>({"1", "4", "5"}));
+    }
+
+
+    TEST_F(node_session_write_queue, test_that_full_queue_drops_newest_messages)
+    {
+        auto session = this->make_session(2, bzn::session::write_overflow_policy::drop_newest);
+
+        for (const auto& text : {"1", "2", "3", "4", "5"})
+        {
+            session->send_datagram(msg(text));
+        }
+
+        EXPECT_EQ(session->dropped_messages(), 2u);
+
+        while (!this->handlers.empty())
+        {
+            this->complete_write();
+        }
+
+        EXPECT_EQ(this->written, std::vector<std::string>({"1", "2", "3"}));
+    }
+
+
+    TEST_F(node_session_write_queue, test_that_full_queue_closes_session)
+    {
+        auto session = this->make_session(2, bzn::session::write_overflow_policy::close);
+
+        for (const auto& text : {"1", "2", "3", "4"})
+        {
+            session->send_datagram(msg(text));
+        }
+
+        EXPECT_EQ(this->close_count, 1u);
+        EXPECT_FALSE(session->is_open());
+        EXPECT_EQ(session->write_queue_size(), 0u);
+
+        // the write in flight finishing doesn't start another...
+        this->complete_write();
+        EXPECT_EQ(this->written, std::vector<std::string>({"1"}));
+    }
+
+
+    TEST_F(node_session_write_queue, test_that_queued_envelopes_are_gathered_into_one_write)
+    {
+        auto session = this->make_session(10, bzn::session::write_overflow_policy::drop_oldest);
+        session->set_gather_writes(true);
+
+        auto envelope = [](const std::string& sender)
+        {
+            bzn_envelope env;
+            env.set_sender(sender);
+            env.set_pbft("payload");
+            return env.SerializeAsString();
+        };
+
+        bzn_envelope_batch coalesced;
+        coalesced.add_envelopes(envelope("c"));
+        coalesced.add_envelopes(envelope("d"));
+        bzn_envelope coalesced_envelope;
+        coalesced_envelope.set_batch(coalesced.SerializeAsString());
+
+        session->send_datagram(msg(envelope("a")));
+        session->send_datagram(msg(envelope("b")));
+        session->send_datagram(msg(coalesced_envelope.SerializeAsString()));
+        session->send_datagram(msg("{\"bzn-api\": \"status\"}"));
+        session->send_datagram(msg(envelope("e")));
+
+        // the first goes out while the rest queue up behind it...
+        EXPECT_EQ(this->written, std::vector<std::string>({envelope("a")}));
+
+        this->complete_write();
+        ASSERT_EQ(this->written.size(), 2u);
+
+        // the envelopes up to the JSON make one batch, with the coalescer's batch merged into it...
+        bzn_envelope batch_envelope;
+        bzn_envelope_batch batch;
+        ASSERT_TRUE(batch_envelope.ParseFromString(this->written[1]));
+        ASSERT_TRUE(batch.ParseFromString(batch_envelope.batch()));
+        ASSERT_EQ(batch.envelopes_size(), 3);
+        EXPECT_EQ(batch.envelopes(0), envelope("b"));
+        EXPECT_EQ(batch.envelopes(1), envelope("c"));
+        EXPECT_EQ(batch.envelopes(2), envelope("d"));
+
+        this->complete_write();
+        this->complete_write();
+        EXPECT_EQ(this->written.size(), 4u);
+        EXPECT_EQ(this->written[2], "{\"bzn-api\": \"status\"}");
+        EXPECT_EQ(this->written[3], envelope("e"));
     }
 
 } // bzn
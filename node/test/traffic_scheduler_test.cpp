@@ -0,0 +1,185 @@
+// Copyright (C) 2018 Bluzelle
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU Affero General Public License, version 3,
+// as published by the Free Software Foundation.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU Affero General Public License for more details.
+//
+// You should have received a copy of the GNU Affero General Public License
+// along with this program. If not, see <http://www.gnu.org/licenses/>.
+
+#include <node/traffic_scheduler.hpp>
+#include <mocks/mock_boost_asio_beast.hpp>
+#include <gmock/gmock.h>
+#include <future>
+#include <thread>
+
+using namespace ::testing;
+
+
+namespace
+{
+    class traffic_scheduler_test : public Test
+    {
+    public:
+        traffic_scheduler_test()
+        {
+            ON_CALL(*this->io_context, get_io_context()).WillByDefault(ReturnRef(this->io));
+        }
+
+        std::function<void()>
+        record(const std::string& name)
+        {
+            return [this, name]() { this->ran.push_back(name); };
+        }
+
+        std::shared_ptr<bzn::asio::Mockio_context_base> io_context = std::make_shared<NiceMock<bzn::asio::Mockio_context_base>>();
+        boost::asio::io_context io;
+        std::vector<std::string> ran;
+    };
+}
+
+
+TEST_F(traffic_scheduler_test, test_that_waiting_classes_are_served_by_weight)
+{
+    auto scheduler = std::make_shared<bzn::traffic_scheduler>(this->io_context, 2, 1);
+
+    for (const auto& name : {"c1", "c2", "c3", "c4", "c5"})
+    {
+        scheduler->submit(bzn::traffic_class::client, 1, this->record(name));
+    }
+
+    for (const auto& name : {"t1", "t2", "t3"})
+    {
+        scheduler->submit(bzn::traffic_class::telemetry, 1, this->record(name));
+    }
+
+    this->io.run();
+
+    // telemetry gets its share, and the rest once client traffic has dried up...
+    EXPECT_EQ(this->ran, std::vector<std::string>({"c1", "c2", "t1", "c3", "c4", "t2", "c5", "t3"}));
+
+    const auto status = scheduler->get_status();
+    EXPECT_EQ(status["client"]["served"].asUInt64(), 5u);
+    EXPECT_EQ(status["client"]["weight"].asUInt64(), 2u);
+    EXPECT_EQ(status["client"]["queued"].asUInt64(), 0u);
+    EXPECT_EQ(status["client"]["max_queued"].asUInt64(), 5u);
+    EXPECT_EQ(status["telemetry"]["served"].asUInt64(), 3u);
+    EXPECT_FALSE(status["protocol"].isMember("weight"));
+}
+
+
+TEST_F(traffic_scheduler_test, test_that_protocol_traffic_goes_ahead_of_everything_waiting)
+{
+    auto scheduler = std::make_shared<bzn::traffic_scheduler>(this->io_context, 4, 1);
+
+    scheduler->submit(bzn::traffic_class::client, 1, [this, scheduler]()
+        {
+            this->ran.push_back("c1");
+
+            // arrives while two other handlers are waiting...
+            scheduler->submit(bzn::traffic_class::protocol, 1, this->record("p2"));
+        });
+    scheduler->submit(bzn::traffic_class::telemetry, 1, this->record("t1"));
+    scheduler->submit(bzn::traffic_class::client, 1, this->record("c2"));
+    scheduler->submit(bzn::traffic_class::protocol, 1, this->record("p1"));
+
+    this->io.run();
+
+    EXPECT_EQ(this->ran, std::vector<std::string>({"p1", "c1", "p2", "c2", "t1"}));
+
+    const auto status = scheduler->get_status();
+    EXPECT_EQ(status["protocol"]["served"].asUInt64(), 2u);
+    EXPECT_EQ(status["client"]["served"].asUInt64(), 2u);
+    EXPECT_EQ(status["telemetry"]["served"].asUInt64(), 1u);
+    EXPECT_GE(status["telemetry"]["max_wait_us"].asUInt64(), status["telemetry"]["avg_wait_us"].asUInt64());
+}
+
+
+TEST_F(traffic_scheduler_test, test_that_handlers_of_a_key_run_one_at_a_time_in_order_on_many_threads)
+{
+    auto scheduler = std::make_shared<bzn::traffic_scheduler>(this->io_context, 4, 1);
+
+    const size_t KEYS = 4;
+    const size_t COUNT = 250;
+    std::array<std::atomic<size_t>, KEYS> running{};
+    std::atomic<bool> overlapped{false};
+    std::array<std::vector<size_t>, KEYS> order;
+
+    for (size_t i = 0; i < COUNT; ++i)
+    {
+        for (size_t key = 0; key < KEYS; ++key)
+        {
+            scheduler->submit(bzn::traffic_class::client, key, [&, key, i]()
+                {
+                    if (running[key]++)
+                    {
+                        overlapped = true;
+                    }
+
+                    order[key].push_back(i);
+                    --running[key];
+                });
+        }
+    }
+
+    std::vector<std::thread> threads;
+    for (size_t i = 0; i < 4; ++i)
+    {
+        threads.emplace_back([this]() { this->io.run(); });
+    }
+
+    for (auto& thread : threads)
+    {
+        thread.join();
+    }
+
+    EXPECT_FALSE(overlapped);
+
+    for (const auto& key_order : order)
+    {
+        ASSERT_EQ(key_order.size(), COUNT);
+        EXPECT_TRUE(std::is_sorted(key_order.begin(), key_order.end()));
+    }
+
+    EXPECT_EQ(scheduler->get_status()["client"]["queued"].asUInt64(), 0u);
+}
+
+
+TEST_F(traffic_scheduler_test, test_that_a_slow_handler_does_not_hold_up_other_keys)
+{
+    auto scheduler = std::make_shared<bzn::traffic_scheduler>(this->io_context, 4, 1);
+
+    std::promise<void> other_ran;
+    auto other_ran_future = other_ran.get_future();
+    std::atomic<bool> waited{false};
+
+    // the first handler of key 1 only returns once key 2's has run alongside it...
+    scheduler->submit(bzn::traffic_class::client, 1, [&]()
+        {
+            waited = other_ran_future.wait_for(std::chrono::seconds(5)) == std::future_status::ready;
+        });
+    scheduler->submit(bzn::traffic_class::client, 1, this->record("c1"));
+    scheduler->submit(bzn::traffic_class::client, 2, [&]()
+        {
+            other_ran.set_value();
+        });
+
+    std::vector<std::thread> threads;
+    for (size_t i = 0; i < 2; ++i)
+    {
+        threads.emplace_back([this]() { this->io.run(); });
+    }
+
+    for (auto& thread : threads)
+    {
+        thread.join();
+    }
+
+    EXPECT_TRUE(waited);
+    EXPECT_EQ(this->ran, std::vector<std::string>({"c1"}));
+}
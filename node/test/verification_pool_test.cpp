@@ -0,0 +1,154 @@
+// Copyright (C) 2018 Bluzelle
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU Affero General Public License, version 3,
+// as published by the Free Software Foundation.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU Affero General Public License for more details.
+//
+// You should have received a copy of the GNU Affero General Public License
+// along with this program. If not, see <http://www.gnu.org/licenses/>.
+
+#include <node/verification_pool.hpp>
+#include <mocks/mock_crypto_base.hpp>
+#include <gmock/gmock.h>
+#include <random>
+
+using namespace ::testing;
+
+
+namespace
+{
+    bzn_envelope
+    make_msg(const std::string& sender, size_t index)
+    {
+        bzn_envelope msg;
+        msg.set_sender(sender);
+        msg.set_pbft(std::to_string(index));
+
+        return msg;
+    }
+}
+
+
+namespace bzn
+{
+    TEST(verification_pool, test_that_results_are_delivered_in_order_per_sender)
+    {
+        const std::vector<std::string> senders{"uuid0", "uuid1", "uuid2"};
+        const size_t MESSAGES = 200;
+
+        auto mock_crypto = std::make_shared<NiceMock<bzn::Mockcrypto_base>>();
+        EXPECT_CALL(*mock_crypto, verify(_)).WillRepeatedly(Invoke([](const bzn_envelope& msg)
+        {
+            // uneven verification times so later messages often finish first...
+            thread_local std::mt19937 gen(std::hash<std::thread::id>{}(std::this_thread::get_id()));
+            std::this_thread::sleep_for(std::chrono::microseconds(std::uniform_int_distribution<>(0, 200)(gen)));
+
+            return std::stoul(msg.pbft()) % 10 != 0;
+        }));
+
+        auto pool = std::make_shared<bzn::verification_pool>(mock_crypto, 4, 64);
+        pool->start();
+
+        std::mutex lock;
+        std::map<std::string, std::vector<size_t>> delivered;
+        std::map<std::string, size_t> rejected;
+
+        for (size_t i = 0; i < MESSAGES; ++i)
+        {
+            for (const auto& sender : senders)
+            {
+                // hold back while it's full, the way a reader pauses on the backlog...
+                while (pool->get_queue_depth() >= 64)
+                {
+                    std::this_thread::yield();
+                }
+
+                EXPECT_TRUE(pool->submit(make_msg(sender, i), [&](const bzn_envelope& msg, bool valid)
+                {
+                    std::lock_guard<std::mutex> guard(lock);
+
+                    if (valid)
+                    {
+                        delivered[msg.sender()].emplace_back(std::stoul(msg.pbft()));
+                    }
+                    else
+                    {
+                        rejected[msg.sender()]++;
+                    }
+                }));
+            }
+        }
+
+        pool->stop();
+
+        for (const auto& sender : senders)
+        {
+            EXPECT_EQ(delivered[sender].size(), MESSAGES - MESSAGES / 10);
+            EXPECT_TRUE(std::is_sorted(delivered[sender].begin(), delivered[sender].end()));
+            EXPECT_EQ(rejected[sender], MESSAGES / 10);
+        }
+
+        auto status = pool->get_status();
+        EXPECT_EQ(status["queue_depth"].asUInt64(), 0u);
+        EXPECT_EQ(status["verified"].asUInt64(), senders.size() * (MESSAGES - MESSAGES / 10));
+        EXPECT_EQ(status["rejected"].asUInt64(), senders.size() * MESSAGES / 10);
+        EXPECT_EQ(status["threads"].asUInt64(), 4u);
+    }
+
+
+    TEST(verification_pool, test_that_submit_fails_fast_while_queue_is_full)
+    {
+        auto mock_crypto = std::make_shared<NiceMock<bzn::Mockcrypto_base>>();
+
+        std::mutex gate_lock;
+        std::condition_variable gate;
+        bool open = false;
+
+        EXPECT_CALL(*mock_crypto, verify(_)).WillRepeatedly(Invoke([&](const bzn_envelope&)
+        {
+            std::unique_lock<std::mutex> guard(gate_lock);
+            gate.wait(guard, [&]() { return open; });
+            return true;
+        }));
+
+        auto pool = std::make_shared<bzn::verification_pool>(mock_crypto, 1, 2);
+        pool->start();
+
+        std::atomic<size_t> delivered = 0;
+        auto handler = [&](const bzn_envelope&, bool) { ++delivered; };
+
+        EXPECT_TRUE(pool->submit(make_msg("uuid0", 0), handler));
+        EXPECT_TRUE(pool->submit(make_msg("uuid0", 1), handler));
+        EXPECT_EQ(pool->get_queue_depth(), 2u);
+
+        // turned away straight away rather than holding up the caller...
+        const auto start = std::chrono::steady_clock::now();
+        EXPECT_FALSE(pool->submit(make_msg("uuid0", 2), handler));
+        EXPECT_LT(std::chrono::steady_clock::now() - start, std::chrono::milliseconds(50));
+        EXPECT_EQ(pool->get_queue_depth(), 2u);
+
+        {
+            std::lock_guard<std::mutex> guard(gate_lock);
+            open = true;
+        }
+        gate.notify_all();
+
+        // and accepted again once there's room...
+        while (pool->get_queue_depth() == 2u)
+        {
+            std::this_thread::yield();
+        }
+        EXPECT_TRUE(pool->submit(make_msg("uuid0", 3), handler));
+
+        pool->stop();
+        EXPECT_EQ(delivered, 3u);
+
+        // nothing is accepted once stopped...
+        EXPECT_FALSE(pool->submit(make_msg("uuid0", 4), handler));
+    }
+}
@@ -0,0 +1,205 @@
+// Copyright (C) 2018 Bluzelle
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU Affero General Public License, version 3,
+// as published by the Free Software Foundation.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU Affero General Public License for more details.
+//
+// You should have received a copy of the GNU Affero General Public License
+// along with this program. If not, see <http://www.gnu.org/licenses/>.
+
+#include <node/traffic_scheduler.hpp>
+
+using namespace bzn;
+
+namespace
+{
+    const size_t PROTOCOL = static_cast<size_t>(bzn::traffic_class::protocol);
+    const size_t CLASS_COUNT = static_cast<size_t>(bzn::traffic_class::count);
+}
+
+
+traffic_scheduler::traffic_scheduler(std::shared_ptr<bzn::asio::io_context_base> io_context, size_t client_weight, size_t telemetry_weight)
+    : io_context(std::move(io_context))
+{
+    this->queues[static_cast<size_t>(bzn::traffic_class::client)].weight = std::max<size_t>(client_weight, 1);
+    this->queues[static_cast<size_t>(bzn::traffic_class::telemetry)].weight = std::max<size_t>(telemetry_weight, 1);
+}
+
+
+void
+traffic_scheduler::submit(bzn::traffic_class traffic, uint64_t key, std::function<void()> handler)
+{
+    {
+        std::lock_guard<std::mutex> lock(this->lock);
+
+        auto& q = this->queues[static_cast<size_t>(traffic)];
+        auto& l = q.lanes[key];
+        l.handlers.emplace_back(std::chrono::steady_clock::now(), std::move(handler));
+        q.max_depth = std::max(q.max_depth, ++q.waiting);
+
+        // a lane that is running goes back on the ready list once its handler is done...
+        if (!l.running && l.handlers.size() == 1)
+        {
+            q.ready.push_back(key);
+        }
+    }
+
+    // one run per handler; a run that finds only lanes that are busy has nothing to do...
+    this->post_run();
+}
+
+
+void
+traffic_scheduler::post_run()
+{
+    boost::asio::post(this->io_context->get_io_context(), std::bind(&traffic_scheduler::run_next, shared_from_this()));
+}
+
+
+void
+traffic_scheduler::run_next()
+{
+    size_t index;
+    uint64_t key;
+    std::function<void()> handler;
+    {
+        std::lock_guard<std::mutex> lock(this->lock);
+
+        const auto next = this->pick();
+        if (!next)
+        {
+            return;
+        }
+
+        index = *next;
+        auto& q = this->queues[index];
+
+        key = q.ready.front();
+        q.ready.pop_front();
+
+        auto& l = q.lanes[key];
+
+        const auto waited = std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - l.handlers.front().first);
+        q.total_wait += waited;
+        q.max_wait = std::max(q.max_wait, waited);
+        ++q.served;
+        --q.waiting;
+
+        handler = std::move(l.handlers.front().second);
+        l.handlers.pop_front();
+        l.running = true;
+    }
+
+    handler();
+
+    {
+        std::lock_guard<std::mutex> lock(this->lock);
+
+        auto& q = this->queues[index];
+        auto it = q.lanes.find(key);
+
+        it->second.running = false;
+
+        if (it->second.handlers.empty())
+        {
+            q.lanes.erase(it);
+            return;
+        }
+
+        q.ready.push_back(key);
+    }
+
+    // the next of this lane goes back through the io_context rather than running here, so other work on it isn't
+    // held up...
+    this->post_run();
+}
+
+
+std::optional<size_t>
+traffic_scheduler::pick()
+{
+    if (!this->queues[PROTOCOL].ready.empty())
+    {
+        return PROTOCOL;
+    }
+
+    // weighted round robin over the rest: stay with a class until its credit is spent or it has nothing waiting,
+    // and start a new round once no class with something waiting has credit left...
+    for (size_t round = 0; round < 2; ++round)
+    {
+        for (size_t i = PROTOCOL + 1; i < CLASS_COUNT; ++i)
+        {
+            const size_t current = this->turn;
+            auto& q = this->queues[current];
+
+            if (!q.ready.empty() && q.credit)
+            {
+                if (!--q.credit)
+                {
+                    this->turn = current + 1 < CLASS_COUNT ? current + 1 : PROTOCOL + 1;
+                }
+
+                return current;
+            }
+
+            this->turn = current + 1 < CLASS_COUNT ? current + 1 : PROTOCOL + 1;
+        }
+
+        for (size_t i = PROTOCOL + 1; i < CLASS_COUNT; ++i)
+        {
+            this->queues[i].credit = this->queues[i].weight;
+        }
+    }
+
+    return std::nullopt;
+}
+
+
+bzn::json_message
+traffic_scheduler::get_status() const
+{
+    std::lock_guard<std::mutex> lock(this->lock);
+
+    bzn::json_message status;
+
+    for (size_t i = 0; i < CLASS_COUNT; ++i)
+    {
+        const auto& q = this->queues[i];
+        auto& entry = status[get_name(static_cast<bzn::traffic_class>(i))];
+
+        if (i != PROTOCOL)
+        {
+            entry["weight"] = static_cast<Json::UInt64>(q.weight);
+        }
+
+        entry["queued"] = static_cast<Json::UInt64>(q.waiting);
+        entry["max_queued"] = static_cast<Json::UInt64>(q.max_depth);
+        entry["served"] = static_cast<Json::UInt64>(q.served);
+        entry["avg_wait_us"] = static_cast<Json::UInt64>(q.served ? q.total_wait.count() / q.served : 0);
+        entry["max_wait_us"] = static_cast<Json::UInt64>(q.max_wait.count());
+    }
+
+    return status;
+}
+
+
+const char*
+traffic_scheduler::get_name(bzn::traffic_class traffic)
+{
+    switch (traffic)
+    {
+        case bzn::traffic_class::protocol:
+            return "protocol";
+        case bzn::traffic_class::client:
+            return "client";
+        case bzn::traffic_class::telemetry:
+            return "telemetry";
+        default:
+            return "unknown";
+    }
+}
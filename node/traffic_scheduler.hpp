@@ -0,0 +1,89 @@
+// Copyright (C) 2018 Bluzelle
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU Affero General Public License, version 3,
+// as published by the Free Software Foundation.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU Affero General Public License for more details.
+//
+// You should have received a copy of the GNU Affero General Public License
+// along with this program. If not, see <http://www.gnu.org/licenses/>.
+
+#pragma once
+
+#include <include/bluzelle.hpp>
+#include <include/boost_asio_beast.hpp>
+#include <array>
+#include <chrono>
+#include <deque>
+#include <mutex>
+#include <optional>
+#include <unordered_map>
+
+
+namespace bzn
+{
+    enum class traffic_class : size_t
+    {
+        protocol,   // pbft and raft messages between swarm members
+        client,     // database requests
+        telemetry,  // audit and status
+        count
+    };
+
+
+    // Handlers wait in a queue per traffic class instead of running as their messages arrive, and are run on the
+    // io_context whatever should go next first: protocol traffic always goes first, and the other classes share what
+    // is left by weight, so a flood of client requests can't hold up a heartbeat. Handlers submitted with the same
+    // key (the session they arrived on) run one at a time in the order they were submitted, while those of other
+    // keys run alongside them on however many threads run the io_context.
+    class traffic_scheduler final : public std::enable_shared_from_this<traffic_scheduler>
+    {
+    public:
+        // handlers of a class run at most its weight times in a row while another class has some waiting
+        traffic_scheduler(std::shared_ptr<bzn::asio::io_context_base> io_context, size_t client_weight, size_t telemetry_weight);
+
+        void submit(bzn::traffic_class traffic, uint64_t key, std::function<void()> handler);
+
+        bzn::json_message get_status() const;
+
+        static const char* get_name(bzn::traffic_class traffic);
+
+    private:
+        struct lane
+        {
+            std::deque<std::pair<std::chrono::steady_clock::time_point, std::function<void()>>> handlers;
+            bool running = false;
+        };
+
+        struct queue
+        {
+            std::unordered_map<uint64_t, lane> lanes;
+            std::deque<uint64_t> ready; // keys with a handler waiting and none running
+            size_t waiting = 0;
+            size_t weight = 1;
+            size_t credit = 0; // left this round
+            uint64_t served = 0;
+            size_t max_depth = 0;
+            std::chrono::microseconds total_wait{0};
+            std::chrono::microseconds max_wait{0};
+        };
+
+        void post_run();
+
+        void run_next();
+
+        // needs lock
+        std::optional<size_t> pick();
+
+        const std::shared_ptr<bzn::asio::io_context_base> io_context;
+
+        mutable std::mutex lock;
+        std::array<queue, static_cast<size_t>(bzn::traffic_class::count)> queues;
+        size_t turn = static_cast<size_t>(bzn::traffic_class::client); // the weighted class being served
+    };
+
+} // namespace bzn
@@ -0,0 +1,297 @@
+// Copyright (C) 2018 Bluzelle
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU Affero General Public License, version 3,
+// as published by the Free Software Foundation.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU Affero General Public License for more details.
+//
+// You should have received a copy of the GNU Affero General Public License
+// along with this program. If not, see <http://www.gnu.org/licenses/>.
+
+#include <node/verification_pool.hpp>
+
+using namespace bzn;
+
+
+verification_pool::verification_pool(std::shared_ptr<bzn::crypto_base> crypto, size_t thread_count, size_t max_queue_depth)
+    : crypto(std::move(crypto))
+    , thread_count(std::max<size_t>(thread_count ? thread_count : std::thread::hardware_concurrency(), 1))
+    , max_queue_depth(std::max<size_t>(max_queue_depth, 1))
+{
+    for (size_t i = 0; i < this->thread_count; ++i)
+    {
+        this->queues.emplace_back(std::make_unique<worker_queue>());
+    }
+}
+
+
+verification_pool::~verification_pool()
+{
+    // the last reference may be released by one of our own workers, which can't join itself...
+    for (auto& worker : this->workers)
+    {
+        if (worker.joinable())
+        {
+            worker.detach();
+        }
+    }
+}
+
+
+void
+verification_pool::start()
+{
+    for (size_t i = 0; i < this->thread_count; ++i)
+    {
+        // workers keep the pool alive until they exit...
+        this->workers.emplace_back([self = shared_from_this(), i]()
+        {
+            self->run(i);
+        });
+    }
+}
+
+
+void
+verification_pool::stop()
+{
+    {
+        std::lock_guard<std::mutex> lock(this->wait_lock);
+        this->stopping = true;
+    }
+
+    this->work_available.notify_all();
+
+    for (auto& worker : this->workers)
+    {
+        if (worker.get_id() == std::this_thread::get_id())
+        {
+            worker.detach();
+        }
+        else if (worker.joinable())
+        {
+            worker.join();
+        }
+    }
+}
+
+
+bool
+verification_pool::submit(bzn_envelope msg, result_handler handler)
+{
+    {
+        std::lock_guard<std::mutex> lock(this->wait_lock);
+
+        // never hold up the caller, it's an io thread: readers pause on the backlog before the pool fills...
+        if (this->stopping || this->queue_depth >= this->max_queue_depth)
+        {
+            return false;
+        }
+
+        ++this->queue_depth;
+    }
+
+    auto new_job = std::make_shared<job>();
+    new_job->msg = std::move(msg);
+    new_job->handler = std::move(handler);
+
+    {
+        std::lock_guard<std::mutex> lock(this->order_lock);
+        this->senders[new_job->msg.sender()].jobs.push_back(new_job);
+    }
+
+    auto& queue = *this->queues[this->next_queue++ % this->queues.size()];
+    {
+        std::lock_guard<std::mutex> lock(queue.lock);
+        queue.jobs.push_back(new_job);
+    }
+
+    {
+        std::lock_guard<std::mutex> lock(this->wait_lock);
+        ++this->unclaimed;
+    }
+
+    this->work_available.notify_one();
+
+    return true;
+}
+
+
+size_t
+verification_pool::get_queue_depth() const
+{
+    std::lock_guard<std::mutex> lock(this->wait_lock);
+
+    return this->queue_depth;
+}
+
+
+bzn::json_message
+verification_pool::get_status() const
+{
+    bzn::json_message status;
+
+    const uint64_t verified = this->verified_count;
+    const uint64_t rejected = this->rejected_count;
+    const uint64_t total = verified + rejected;
+
+    status["threads"] = static_cast<Json::UInt64>(this->thread_count);
+    status["queue_depth"] = static_cast<Json::UInt64>(this->get_queue_depth());
+    status["max_queue_depth"] = static_cast<Json::UInt64>(this->max_queue_depth);
+    status["verified"] = static_cast<Json::UInt64>(verified);
+    status["rejected"] = static_cast<Json::UInt64>(rejected);
+    status["avg_verify_latency_us"] = static_cast<Json::UInt64>(total ? this->total_verify_us / total : 0);
+    status["max_verify_latency_us"] = static_cast<Json::UInt64>(this->max_verify_us);
+
+    return status;
+}
+
+
+void
+verification_pool::run(size_t index)
+{
+    while (true)
+    {
+        {
+            std::unique_lock<std::mutex> lock(this->wait_lock);
+
+            this->work_available.wait(lock, [&]() { return this->stopping || this->unclaimed > 0; });
+
+            // drain whatever was accepted before stopping...
+            if (this->unclaimed == 0)
+            {
+                return;
+            }
+
+            --this->unclaimed;
+        }
+
+        // a claimed job is always queued somewhere, but may be racing with its push...
+        std::shared_ptr<job> next;
+        while (!(next = this->take(index)))
+        {
+            std::this_thread::yield();
+        }
+
+        this->verify(next);
+        this->deliver(next);
+    }
+}
+
+
+std::shared_ptr<verification_pool::job>
+verification_pool::take(size_t index)
+{
+    // our own queue first (oldest first), then steal the newest work from the others...
+    for (size_t i = 0; i < this->queues.size(); ++i)
+    {
+        auto& queue = *this->queues[(index + i) % this->queues.size()];
+
+        std::lock_guard<std::mutex> lock(queue.lock);
+
+        if (!queue.jobs.empty())
+        {
+            std::shared_ptr<job> next;
+
+            if (i == 0)
+            {
+                next = std::move(queue.jobs.front());
+                queue.jobs.pop_front();
+            }
+            else
+            {
+                next = std::move(queue.jobs.back());
+                queue.jobs.pop_back();
+            }
+
+            return next;
+        }
+    }
+
+    return nullptr;
+}
+
+
+void
+verification_pool::verify(const std::shared_ptr<job>& job)
+{
+    const auto start = std::chrono::steady_clock::now();
+
+    job->valid = this->crypto->verify(job->msg);
+
+    const uint64_t elapsed = std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - start).count();
+
+    (job->valid ? this->verified_count : this->rejected_count)++;
+    this->total_verify_us += elapsed;
+
+    uint64_t current_max = this->max_verify_us;
+    while (elapsed > current_max && !this->max_verify_us.compare_exchange_weak(current_max, elapsed));
+}
+
+
+void
+verification_pool::deliver(const std::shared_ptr<job>& job)
+{
+    const bzn::uuid_t sender = job->msg.sender();
+
+    {
+        std::lock_guard<std::mutex> lock(this->order_lock);
+
+        job->finished = true;
+
+        // only one thread hands out a sender's results at a time, in submission order...
+        auto& queue = this->senders[sender];
+        if (queue.delivering)
+        {
+            return;
+        }
+
+        queue.delivering = true;
+    }
+
+    std::vector<std::shared_ptr<verification_pool::job>> ready;
+
+    while (true)
+    {
+        ready.clear();
+
+        {
+            std::lock_guard<std::mutex> lock(this->order_lock);
+
+            auto it = this->senders.find(sender);
+            while (!it->second.jobs.empty() && it->second.jobs.front()->finished)
+            {
+                ready.emplace_back(std::move(it->second.jobs.front()));
+                it->second.jobs.pop_front();
+            }
+
+            if (ready.empty())
+            {
+                if (it->second.jobs.empty())
+                {
+                    this->senders.erase(it);
+                }
+                else
+                {
+                    it->second.delivering = false;
+                }
+
+                return;
+            }
+        }
+
+        for (const auto& next : ready)
+        {
+            next->handler(next->msg, next->valid);
+        }
+
+        {
+            std::lock_guard<std::mutex> lock(this->wait_lock);
+            this->queue_depth -= ready.size();
+        }
+    }
+}
@@ -0,0 +1,108 @@
+// Copyright (C) 2018 Bluzelle
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU Affero General Public License, version 3,
+// as published by the Free Software Foundation.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU Affero General Public License for more details.
+//
+// You should have received a copy of the GNU Affero General Public License
+// along with this program. If not, see <http://www.gnu.org/licenses/>.
+
+#pragma once
+
+#include <include/bluzelle.hpp>
+#include <crypto/crypto_base.hpp>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <deque>
+#include <mutex>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+
+namespace bzn
+{
+    // Verifies incoming envelopes on a dedicated pool of threads so expensive signature checks are kept off the io
+    // threads and run in parallel. Each worker owns a queue and steals from the others when it runs dry. Results are
+    // handed back in the order the messages were submitted for each sender, so a peer's messages are never reordered.
+    class verification_pool final : public std::enable_shared_from_this<verification_pool>
+    {
+    public:
+        using result_handler = std::function<void(const bzn_envelope& msg, bool valid)>;
+
+        verification_pool(std::shared_ptr<bzn::crypto_base> crypto, size_t thread_count, size_t max_queue_depth);
+
+        ~verification_pool();
+
+        void start();
+
+        // waits for the workers to finish queued messages and exit
+        void stop();
+
+        // queue a message for verification without blocking; returns false if the pool is full or stopped
+        bool submit(bzn_envelope msg, result_handler handler);
+
+        size_t get_queue_depth() const;
+
+        bzn::json_message get_status() const;
+
+    private:
+        struct job
+        {
+            bzn_envelope msg;
+            result_handler handler;
+            bool finished = false;
+            bool valid = false;
+        };
+
+        struct worker_queue
+        {
+            std::mutex lock;
+            std::deque<std::shared_ptr<job>> jobs;
+        };
+
+        struct sender_queue
+        {
+            std::deque<std::shared_ptr<job>> jobs;
+            bool delivering = false;
+        };
+
+        void run(size_t index);
+
+        std::shared_ptr<job> take(size_t index);
+
+        void verify(const std::shared_ptr<job>& job);
+
+        void deliver(const std::shared_ptr<job>& job);
+
+        const std::shared_ptr<bzn::crypto_base> crypto;
+        const size_t thread_count;
+        const size_t max_queue_depth;
+
+        std::vector<std::unique_ptr<worker_queue>> queues;
+        std::vector<std::thread> workers;
+        std::atomic<size_t> next_queue = 0;
+
+        // guards the queue depth, unclaimed job count and stopping flag
+        mutable std::mutex wait_lock;
+        std::condition_variable work_available;
+        size_t queue_depth = 0;
+        size_t unclaimed = 0;
+        bool stopping = false;
+
+        std::mutex order_lock;
+        std::unordered_map<bzn::uuid_t, sender_queue> senders;
+
+        std::atomic<uint64_t> verified_count = 0;
+        std::atomic<uint64_t> rejected_count = 0;
+        std::atomic<uint64_t> total_verify_us = 0;
+        std::atomic<uint64_t> max_verify_us = 0;
+    };
+
+} // namespace bzn
@@ -86,9 +86,51 @@ simple_options::build_options()
                 (STATE_DIR.c_str(),
                         po::value<std::string>()->default_value("./.state/"),
                         "location for state files")
+                (IO_REACTORS.c_str(),
+                        po::value<size_t>()->default_value(0),
+                        "single threaded io_contexts for networking, each pinned to a core, plus one for consensus (0 = one io_context shared by a thread per core)")
+                (TRAFFIC_SCHEDULING.c_str(),
+                        po::value<bool>()->default_value(true),
+                        "queue message handlers by traffic class, running swarm protocol messages before client requests and telemetry")
+                (TRAFFIC_CLIENT_WEIGHT.c_str(),
+                        po::value<size_t>()->default_value(4),
+                        "client request handlers run for every traffic_telemetry_weight telemetry handlers while both are waiting")
+                (TRAFFIC_TELEMETRY_WEIGHT.c_str(),
+                        po::value<size_t>()->default_value(1),
+                        "telemetry (audit and status) handlers run for every traffic_client_weight client handlers while both are waiting")
                 (WS_IDLE_TIMEOUT.c_str(),
                         po::value<uint64_t>(),
-                        "websocket idle timeout");
+                        "websocket idle timeout")
+                (WS_WRITE_QUEUE_SIZE.c_str(),
+                        po::value<size_t>()->default_value(1000),
+                        "maximum number of messages waiting to be written on a websocket")
+                (WS_WRITE_QUEUE_OVERFLOW.c_str(),
+                        po::value<std::string>()->default_value("drop_oldest"),
+                        "what to do when a client websocket write queue is full (drop_oldest, drop_newest or close); peer links are always closed and reconnected")
+                (WS_MAX_IN_FLIGHT_MESSAGES.c_str(),
+                        po::value<size_t>()->default_value(64),
+                        "messages received on a websocket but not yet handled before reading from it pauses (0 = no limit)")
+                (WS_MAX_IN_FLIGHT_BYTES.c_str(),
+                        po::value<size_t>()->default_value(64 * 1024 * 1024),
+                        "bytes received on a websocket but not yet handled before reading from it pauses (0 = no limit)")
+                (WS_COALESCE_WINDOW_MS.c_str(),
+                        po::value<size_t>()->default_value(0),
+                        "how long messages to a peer that was just sent to are held back to go out together (0 = never; every swarm member must support it)")
+                (WS_COALESCE_MAX_BYTES.c_str(),
+                        po::value<size_t>()->default_value(64 * 1024),
+                        "bytes held back for a peer before they go out together without waiting for the window to close")
+                (WS_DEFLATE_PEERS.c_str(),
+                        po::value<bool>()->default_value(false),
+                        "compress messages to other swarm members with websocket permessage-deflate")
+                (WS_DEFLATE_CLIENTS.c_str(),
+                        po::value<bool>()->default_value(false),
+                        "compress messages to clients that offer websocket permessage-deflate")
+                (WS_DEFLATE_LEVEL.c_str(),
+                        po::value<int>()->default_value(6),
+                        "websocket deflate compression level (0-9, 0 = no compression)")
+                (WS_DEFLATE_WINDOW_BITS.c_str(),
+                        po::value<int>()->default_value(15),
+                        "websocket deflate window size as a power of two (9-15)");
 
     po::options_description logging("Logging");
     logging.add_options()
@@ -133,6 +175,15 @@ simple_options::build_options()
                 (PBFT_ENABLED.c_str(),
                         po::value<bool>()->default_value(false),
                         "use pbft consensus instead of raft (experimental)")
+                (PBFT_EXECUTION_THREADS.c_str(),
+                        po::value<size_t>()->default_value(1),
+                        "number of threads executing non-conflicting pbft requests concurrently (0 = one per core)")
+                (PBFT_MAX_CLIENTS.c_str(),
+                        po::value<size_t>()->default_value(1000000),
+                        "clients whose last pbft request is remembered so that a retry of it is not ordered again (about 200 bytes each)")
+                (PBFT_TENTATIVE_EXECUTION.c_str(),
+                        po::value<bool>()->default_value(false),
+                        "execute pbft requests once prepared and reply tentatively, a round before they commit")
                 (PEER_VALIDATION_ENABLED.c_str(),
                         po::value<bool>()->default_value(false),
                         "require signed key for new peers to join swarm")
@@ -154,7 +205,16 @@ simple_options::build_options()
                         "check signatures on incoming messages")
                 (CRYPTO_ENABLED_OUTGOING.c_str(),
                          po::value<bool>()->default_value(true),
-                        "attach signatures on outgoing messages");
+                        "attach signatures on outgoing messages")
+                (CRYPTO_MAC_AUTHENTICATORS.c_str(),
+                        po::value<bool>()->default_value(false),
+                        "use pairwise MAC authenticators instead of signatures for normal case pbft messages")
+                (CRYPTO_VERIFY_THREADS.c_str(),
+                        po::value<size_t>()->default_value(0),
+                        "number of threads verifying incoming messages (0 = one per core)")
+                (CRYPTO_VERIFY_QUEUE_SIZE.c_str(),
+                        po::value<size_t>()->default_value(4096),
+                        "maximum number of incoming messages waiting for verification");
 
 
     this->options_root.add(crypto);
@@ -233,6 +293,21 @@ simple_options::validate_options()
         errors = true;
     }
 
+    // the ranges beast accepts; it throws on anything else when a deflate stream is set up
+    auto deflate_level = this->get<int>(WS_DEFLATE_LEVEL);
+    if (deflate_level < 0 || deflate_level > 9)
+    {
+        std::cerr << "Invalid websocket deflate level " << std::to_string(deflate_level);
+        errors = true;
+    }
+
+    auto deflate_window_bits = this->get<int>(WS_DEFLATE_WINDOW_BITS);
+    if (deflate_window_bits < 9 || deflate_window_bits > 15)
+    {
+        std::cerr << "Invalid websocket deflate window bits " << std::to_string(deflate_window_bits);
+        errors = true;
+    }
+
     return !errors;
 }
 
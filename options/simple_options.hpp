@@ -42,8 +42,25 @@ namespace bzn::option_names
     const std::string NODE_PUBKEY_FILE = "public_key_file";
     const std::string NODE_PRIVATEKEY_FILE = "private_key_file";
     const std::string PBFT_ENABLED = "use_pbft";
+    const std::string PBFT_EXECUTION_THREADS = "pbft_execution_threads";
+    const std::string PBFT_MAX_CLIENTS = "pbft_max_clients";
+    const std::string PBFT_TENTATIVE_EXECUTION = "pbft_tentative_execution";
     const std::string STATE_DIR = "state_dir";
+    const std::string IO_REACTORS = "io_reactors";
+    const std::string TRAFFIC_SCHEDULING = "traffic_scheduling";
+    const std::string TRAFFIC_CLIENT_WEIGHT = "traffic_client_weight";
+    const std::string TRAFFIC_TELEMETRY_WEIGHT = "traffic_telemetry_weight";
     const std::string WS_IDLE_TIMEOUT = "ws_idle_timeout";
+    const std::string WS_WRITE_QUEUE_SIZE = "ws_write_queue_size";
+    const std::string WS_WRITE_QUEUE_OVERFLOW = "ws_write_queue_overflow";
+    const std::string WS_MAX_IN_FLIGHT_MESSAGES = "ws_max_in_flight_messages";
+    const std::string WS_MAX_IN_FLIGHT_BYTES = "ws_max_in_flight_bytes";
+    const std::string WS_COALESCE_WINDOW_MS = "ws_coalesce_window_ms";
+    const std::string WS_COALESCE_MAX_BYTES = "ws_coalesce_max_bytes";
+    const std::string WS_DEFLATE_PEERS = "ws_deflate_peers";
+    const std::string WS_DEFLATE_CLIENTS = "ws_deflate_clients";
+    const std::string WS_DEFLATE_LEVEL = "ws_deflate_level";
+    const std::string WS_DEFLATE_WINDOW_BITS = "ws_deflate_window_bits";
     const std::string PEER_VALIDATION_ENABLED = "peer_validation_enabled";
     const std::string SIGNED_KEY = "signed_key";
 
@@ -56,6 +73,9 @@ namespace bzn::option_names
 
     const std::string CRYPTO_ENABLED_OUTGOING = "crypto_enabled_outgoing";
     const std::string CRYPTO_ENABLED_INCOMING = "crypto_enabled_incoming";
+    const std::string CRYPTO_MAC_AUTHENTICATORS = "crypto_mac_authenticators";
+    const std::string CRYPTO_VERIFY_THREADS = "crypto_verify_threads";
+    const std::string CRYPTO_VERIFY_QUEUE_SIZE = "crypto_verify_queue_size";
 
 
 }
@@ -333,6 +333,19 @@ TEST_F(options_file_test, test_that_uuid_and_pubkey_conflict)
     EXPECT_FALSE(options.parse_command_line(1, NO_ARGS));
 }
 
+TEST_F(options_file_test, test_that_out_of_range_deflate_settings_are_rejected)
+{
+    this->save_options_file(compose_config_data(DEFAULT_CONFIG_CONTENT, "\"ws_deflate_level\": 10"));
+    EXPECT_FALSE(bzn::options().parse_command_line(1, NO_ARGS));
+
+    this->save_options_file(compose_config_data(DEFAULT_CONFIG_CONTENT, "\"ws_deflate_window_bits\": 8"));
+    EXPECT_FALSE(bzn::options().parse_command_line(1, NO_ARGS));
+
+    // no compression is a level too...
+    this->save_options_file(compose_config_data(DEFAULT_CONFIG_CONTENT, "\"ws_deflate_level\": 0"));
+    EXPECT_TRUE(bzn::options().parse_command_line(1, NO_ARGS));
+}
+
 TEST_F(options_file_test, test_set_option_at_runtime)
 {
     bzn::options options;
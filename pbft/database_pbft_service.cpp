@@ -14,7 +14,10 @@
 
 
 #include <pbft/database_pbft_service.hpp>
+#include <pbft/pbft.hpp>
+#include <pbft/pbft_state_transfer.hpp>
 #include <boost/lexical_cast.hpp>
+#include <algorithm>
 
 
 using namespace bzn;
@@ -22,119 +25,770 @@ using namespace bzn;
 namespace
 {
     const std::string NEXT_REQUEST_SEQUENCE_KEY{"next_request_sequence"};
+
+    // well beyond the high water mark interval that execution may be ahead of pbft's checkpoints by
+    const size_t MAX_CHECKPOINT_STATE_HASHES = 8;
 }
 
 
+// Passes the response of a tentatively executed request on to the client marked as tentative, and keeps it so that
+// it can be sent again unmarked once the request commits.
+class database_pbft_service::tentative_reply_session final : public bzn::session_base
+{
+public:
+    explicit tentative_reply_session(std::weak_ptr<bzn::session_base> target)
+        : target(std::move(target))
+    {
+    }
+
+    void start(bzn::message_handler /*handler*/, bzn::protobuf_handler /*proto_handler*/) override
+    {
+    }
+
+    void send_message(std::shared_ptr<bzn::json_message> msg, bool end_session) override
+    {
+        if (auto session = this->target.lock())
+        {
+            session->send_message(std::move(msg), end_session);
+        }
+    }
+
+    void send_message(std::shared_ptr<bzn::encoded_message> msg, bool end_session) override
+    {
+        database_response response;
+        if (response.ParseFromString(*msg))
+        {
+            this->reply = msg;
+
+            response.set_tentative(true);
+            msg = std::make_shared<bzn::encoded_message>(response.SerializeAsString());
+        }
+
+        if (auto session = this->target.lock())
+        {
+            session->send_message(std::move(msg), end_session);
+        }
+    }
+
+    void send_datagram(std::shared_ptr<bzn::encoded_message> msg) override
+    {
+        if (auto session = this->target.lock())
+        {
+            session->send_datagram(std::move(msg));
+        }
+    }
+
+    void close() override
+    {
+        if (auto session = this->target.lock())
+        {
+            session->close();
+        }
+    }
+
+    bzn::session_id get_session_id() override
+    {
+        auto session = this->target.lock();
+
+        return session ? session->get_session_id() : 0;
+    }
+
+    void confirm()
+    {
+        if (auto session = this->target.lock(); session && this->reply)
+        {
+            session->send_message(this->reply, false);
+        }
+    }
+
+private:
+    const std::weak_ptr<bzn::session_base> target;
+    std::shared_ptr<bzn::encoded_message> reply;
+};
+
+
 database_pbft_service::database_pbft_service(
     std::shared_ptr<bzn::asio::io_context_base> io_context,
     std::shared_ptr<bzn::storage_base> unstable_storage,
     std::shared_ptr<bzn::crud_base> crud,
-    bzn::uuid_t uuid)
+    bzn::uuid_t uuid,
+    size_t execution_threads)
     : io_context(std::move(io_context))
     , unstable_storage(std::move(unstable_storage))
     , crud(std::move(crud))
     , uuid(std::move(uuid))
 {
+    if (execution_threads != 1)
+    {
+        this->executor = std::make_unique<bzn::pbft_parallel_executor>(execution_threads);
+    }
+
     this->load_next_request_sequence();
+    this->load_logged_operations();
 }
 
-database_pbft_service::~database_pbft_service()
+
+void
+database_pbft_service::apply_operation(const std::shared_ptr<bzn::pbft_operation>& op)
 {
-    this->save_next_request_sequence();
+    std::lock_guard<std::mutex> lock(this->lock);
+
+    if (this->tentative_operations.erase(op->sequence))
+    {
+        this->confirm_operation(op->sequence);
+        this->process_awaiting_operations();
+        return;
+    }
+
+    if (op->sequence < this->next_request_sequence || this->awaiting_operations.count(op->sequence))
+    {
+        LOG(debug) << "ignoring already applied pbft request at sequence: " << op->sequence;
+        return;
+    }
+
+    // logged along with the rest of the batch it executes in...
+    this->awaiting_operations.emplace(op->sequence, op->request);
+
+    // store requester session for eventual response...
+    this->sessions_awaiting_response[op->sequence] = op->session();
+
+    this->process_awaiting_operations();
 }
 
 
 void
-database_pbft_service::apply_operation(const std::shared_ptr<bzn::pbft_operation>& op)
+database_pbft_service::apply_operation_tentatively(const std::shared_ptr<bzn::pbft_operation>& op)
 {
     std::lock_guard<std::mutex> lock(this->lock);
 
-    // store op...
-    if (auto result = this->unstable_storage->create(this->uuid, std::to_string(op->sequence), op->request.SerializeAsString());
+    if (op->sequence < this->next_request_sequence || this->awaiting_operations.count(op->sequence))
+    {
+        LOG(debug) << "ignoring tentative pbft request at already applied sequence: " << op->sequence;
+        return;
+    }
+
+    // nothing is logged: a tentative request is forgotten on restart and executed again once it commits...
+    this->awaiting_operations.emplace(op->sequence, op->request);
+    this->tentative_operations.insert(op->sequence);
+
+    this->sessions_awaiting_response[op->sequence] = op->session();
+
+    this->process_awaiting_operations();
+}
+
+
+void
+database_pbft_service::confirm_operation(uint64_t sequence)
+{
+    if (auto it = this->undo_log.find(sequence); it != this->undo_log.end())
+    {
+        it->second.committed = true;
+
+        if (it->second.reply)
+        {
+            it->second.reply->confirm();
+            it->second.reply = nullptr;
+        }
+
+        this->prune_undo_log();
+    }
+
+    // one committed before it got to execute is logged with its batch like any other...
+}
+
+
+std::vector<pbft_request>
+database_pbft_service::rollback_tentative_operations()
+{
+    std::unique_lock<std::mutex> lock(this->lock);
+    this->execution_done.wait(lock, [&]() { return !this->executing; });
+
+    std::vector<pbft_request> rolled_back;
+
+    if (this->tentative_operations.empty())
+    {
+        return rolled_back;
+    }
+
+    // tentative requests that have not executed yet are simply forgotten...
+    for (const auto sequence : this->tentative_operations)
+    {
+        if (auto it = this->awaiting_operations.find(sequence); it != this->awaiting_operations.end())
+        {
+            rolled_back.push_back(std::move(it->second));
+            this->awaiting_operations.erase(it);
+            this->sessions_awaiting_response.erase(sequence);
+        }
+    }
+
+    const size_t tentative_count = this->tentative_operations.size();
+    this->tentative_operations.clear();
+
+    // undo everything from the first tentative request on, newest first, and queue the committed ones again...
+    for (auto it = this->undo_log.rbegin(); it != this->undo_log.rend(); ++it)
+    {
+        for (const auto& step : it->second.undo)
+        {
+            this->crud->handle_request(step, nullptr);
+        }
+
+        if (it->second.committed)
+        {
+            // it's still in the log unless it executed tentatively, in which case it's logged with its next batch...
+            if (this->in_log(it->first))
+            {
+                this->logged_operations.insert(it->first);
+            }
+
+            this->awaiting_operations.emplace(it->first, std::move(it->second.request));
+        }
+        else
+        {
+            rolled_back.push_back(std::move(it->second.request));
+        }
+    }
+
+    if (!this->undo_log.empty())
+    {
+        this->next_request_sequence = this->undo_log.begin()->first;
+        this->undo_log.clear();
+
+        // or the requests queued again would be taken as executed after a restart...
+        this->save_next_request_sequence();
+    }
+
+    LOG(info) << "Rolled back " << tentative_count << " tentative requests, resuming execution at sequence: "
+              << this->next_request_sequence;
+
+    this->process_awaiting_operations();
+
+    return rolled_back;
+}
+
+
+std::vector<std::map<uint64_t, pbft_request>::iterator>
+database_pbft_service::next_batch()
+{
+    std::vector<std::map<uint64_t, pbft_request>::iterator> batch;
+
+    // stop at a checkpoint, as its state has to be saved before anything after it is executed...
+    for (auto it = this->awaiting_operations.begin();
+        it != this->awaiting_operations.end() && it->first == this->next_request_sequence + batch.size() && this->may_execute(it->first); ++it)
+    {
+        batch.push_back(it);
+
+        if (it->first % CHECKPOINT_INTERVAL == 0)
+        {
+            break;
+        }
+    }
+
+    return batch;
+}
+
+
+void
+database_pbft_service::log_requests(const std::vector<std::map<uint64_t, pbft_request>::iterator>& requests)
+{
+    pbft_request_log_entry entry;
+    std::vector<uint64_t> sequences;
+
+    // tentative requests are never logged: they are forgotten on restart and executed again once they commit...
+    for (const auto& it : requests)
+    {
+        if (!this->tentative_operations.count(it->first) && !this->logged_operations.count(it->first))
+        {
+            auto logged = entry.add_requests();
+            logged->set_sequence(it->first);
+            *logged->mutable_request() = it->second;
+
+            sequences.push_back(it->first);
+        }
+    }
+
+    if (sequences.empty())
+    {
+        return;
+    }
+
+    if (auto result = this->unstable_storage->create(this->uuid, std::to_string(sequences.front()), entry.SerializeAsString());
         result != bzn::storage_base::result::ok)
     {
-        LOG(fatal) << "failed to store pbft request: " << op->request.DebugString() << ", " << uint32_t(result);
+        LOG(fatal) << "failed to store pbft requests " << sequences.front() << " to " << sequences.back() << ": " << uint32_t(result);
 
         // these are fatal... something bad is going on.
         throw std::runtime_error("Failed to store pbft request! (" + std::to_string(uint8_t(result)) + ")");
     }
 
-    // store requester session for eventual response...
-    this->sessions_awaiting_response[op->sequence] = op->session();
+    this->logged_operations.insert(sequences.begin(), sequences.end());
+    this->log_entries[sequences.front()] = std::move(sequences);
+}
 
-    this->process_awaiting_operations();
+
+void
+database_pbft_service::batch_executed()
+{
+    // every committed request in the batch was logged before it ran, so a restart picks up again from the batch...
+    this->save_next_request_sequence();
+
+    if ((this->next_request_sequence - 1) % CHECKPOINT_INTERVAL == 0)
+    {
+        this->prune_log();
+    }
+}
+
+
+bool
+database_pbft_service::in_log(uint64_t sequence) const
+{
+    return std::any_of(this->log_entries.begin(), this->log_entries.upper_bound(sequence), [&](const auto& entry)
+        {
+            return std::binary_search(entry.second.begin(), entry.second.end(), sequence);
+        });
 }
 
 
 void
 database_pbft_service::process_awaiting_operations()
 {
-    while (this->unstable_storage->has(this->uuid, std::to_string(this->next_request_sequence)))
+    if (this->executor)
     {
-        const key_t key{std::to_string(this->next_request_sequence)};
+        // a batch in flight will pick these up when it finishes...
+        if (!this->executing && this->has_ready_operations())
+        {
+            this->executing = true;
+            this->executor->post(std::bind(&database_pbft_service::execute_batches, shared_from_this()));
+        }
 
-        auto result = this->unstable_storage->read(this->uuid, key);
+        return;
+    }
+
+    while (this->has_ready_operations())
+    {
+        const auto batch = this->next_batch();
 
-        if (!result)
+        // written ahead of executing any of it, so that it survives a restart however far it got...
+        this->log_requests(batch);
+
+        for (const auto& it : batch)
         {
-            // these are fatal... something bad is going on.
-            throw std::runtime_error("Failed to store pbft request!");
+            auto exec = this->prepare_execution(it);
+            this->execute_request(it->second.operation(), exec);
+            this->finish_request(it, std::move(exec));
         }
 
-        pbft_request request;
+        this->batch_executed();
+    }
+}
+
+
+void
+database_pbft_service::execute_batches()
+{
+    std::unique_lock<std::mutex> lock(this->lock);
 
-        if (!request.ParseFromString(*result))
+    while (this->has_ready_operations())
+    {
+        const auto batch = this->next_batch();
+
+        std::vector<const database_msg*> requests;
+        std::vector<execution> executions;
+
+        for (const auto& it : batch)
         {
-            // these are fatal... something bad is going on.
-            throw std::runtime_error("Failed to create pbft_request from database read!");
+            requests.push_back(&it->second.operation());
+            executions.push_back(this->prepare_execution(it));
         }
 
-        LOG(info) << "Executing request " << request.DebugString() << "..., sequence: " << key;
+        // written ahead of executing any of it, so that it survives a restart however far it got...
+        this->log_requests(batch);
 
-        if (auto session_it = this->sessions_awaiting_response.find(this->next_request_sequence); session_it != this->sessions_awaiting_response.end())
+        // batched entries stay put while unlocked; state changes wait for us to finish...
+        lock.unlock();
+
+        this->executor->execute(requests, [&](size_t i)
         {
-            // session found, but is the connection still around?
-            auto session = session_it->second.lock();
+            this->execute_request(*requests[i], executions[i]);
+        });
+
+        lock.lock();
 
-            this->crud->handle_request(request.operation(), (session) ? session : nullptr);
+        for (size_t i = 0; i < batch.size(); ++i)
+        {
+            this->finish_request(batch[i], std::move(executions[i]));
         }
-        else
+
+        this->batch_executed();
+    }
+
+    this->executing = false;
+    this->execution_done.notify_all();
+}
+
+
+bool
+database_pbft_service::has_ready_operations() const
+{
+    return !this->awaiting_operations.empty() && this->awaiting_operations.begin()->first == this->next_request_sequence
+        && this->may_execute(this->next_request_sequence);
+}
+
+
+bool
+database_pbft_service::may_execute(uint64_t sequence) const
+{
+    // the state saved at a checkpoint must only reflect committed requests...
+    return sequence % CHECKPOINT_INTERVAL != 0 || this->tentative_operations.empty() || *this->tentative_operations.begin() > sequence;
+}
+
+
+std::shared_ptr<bzn::session_base>
+database_pbft_service::take_session(uint64_t sequence)
+{
+    if (auto session_it = this->sessions_awaiting_response.find(sequence); session_it != this->sessions_awaiting_response.end())
+    {
+        // session found, but is the connection still around?
+        auto session = session_it->second.lock();
+
+        this->sessions_awaiting_response.erase(session_it);
+
+        return session;
+    }
+
+    // session not found then this was probably loaded from the database...
+    return nullptr;
+}
+
+
+database_pbft_service::execution
+database_pbft_service::prepare_execution(std::map<uint64_t, pbft_request>::iterator it)
+{
+    execution exec;
+    exec.sequence = it->first;
+    exec.session = this->take_session(it->first);
+
+    // anything executed after an uncommitted request may have to be undone along with it...
+    exec.keep_undo = !this->tentative_operations.empty() && *this->tentative_operations.begin() <= it->first;
+
+    if (exec.session && this->tentative_operations.count(it->first))
+    {
+        exec.reply = std::make_shared<tentative_reply_session>(exec.session);
+        exec.session = exec.reply;
+    }
+
+    return exec;
+}
+
+
+void
+database_pbft_service::execute_request(const database_msg& request, execution& exec)
+{
+    LOG(info) << "Executing request " << request.DebugString() << "..., sequence: " << exec.sequence;
+
+    if (exec.keep_undo)
+    {
+        exec.undo = this->undo_steps(request);
+    }
+
+    this->crud->handle_request(request, exec.session);
+}
+
+
+std::vector<database_msg>
+database_pbft_service::undo_steps(const database_msg& request) const
+{
+    const std::string* key = nullptr;
+    switch (request.msg_case())
+    {
+        case database_msg::kCreate: key = &request.create().key(); break;
+        case database_msg::kUpdate: key = &request.update().key(); break;
+        case database_msg::kDelete: key = &request.delete_().key(); break;
+        default: return {};
+    }
+
+    // restore the record to what it is now: remove it, then recreate it if it exists...
+    std::vector<database_msg> steps(1);
+    *steps[0].mutable_header() = request.header();
+    steps[0].mutable_delete_()->set_key(*key);
+
+    database_msg read;
+    *read.mutable_header() = request.header();
+    read.mutable_read()->set_key(*key);
+
+    if (auto response = this->crud->query(read); response && response->has_read())
+    {
+        steps.emplace_back();
+        *steps.back().mutable_header() = request.header();
+        steps.back().mutable_create()->set_key(*key);
+        steps.back().mutable_create()->set_value(response->read().value());
+    }
+
+    return steps;
+}
+
+
+void
+database_pbft_service::finish_request(std::map<uint64_t, pbft_request>::iterator it, execution&& exec)
+{
+    assert(it->first == this->next_request_sequence);
+
+    // it may have committed while executing...
+    const bool committed = !this->tentative_operations.count(it->first);
+
+    if (exec.reply && committed)
+    {
+        exec.reply->confirm();
+        exec.reply = nullptr;
+    }
+
+    if (exec.keep_undo)
+    {
+        this->undo_log[it->first] = executed_operation{it->second, std::move(exec.undo), committed, std::move(exec.reply)};
+        this->prune_undo_log();
+    }
+
+    // save the state so that it can be hashed and served to lagging replicas...
+    if (this->next_request_sequence % CHECKPOINT_INTERVAL == 0)
+    {
+        this->checkpoint_state_saved(this->next_request_sequence, this->save_state());
+    }
+
+    // pbft hears of an execution once it can no longer be rolled back, so only once and in order...
+    if (!exec.keep_undo)
+    {
+        this->io_context->post(std::bind(this->execute_handler, it->second, this->next_request_sequence));
+    }
+
+    this->logged_operations.erase(this->next_request_sequence);
+    this->awaiting_operations.erase(it);
+
+    ++this->next_request_sequence;
+}
+
+
+database_response
+database_pbft_service::query(const pbft_request& request) const
+{
+    std::unique_lock<std::mutex> lock(this->lock);
+    this->execution_done.wait(lock, [&]() { return !this->executing; });
+
+    // reads are served from the latest executed state...
+    if (auto response = this->crud->query(request.operation()); response)
+    {
+        // which includes requests that may yet be rolled back, so it can't be taken as final...
+        if (!this->undo_log.empty())
         {
-            // session not found then this was probably loaded from the database...
-            this->crud->handle_request(request.operation(), nullptr);
+            response->set_tentative(true);
         }
 
-        this->io_context->post(std::bind(this->execute_handler, request, this->next_request_sequence));
+        return *response;
+    }
+
+    LOG(error) << "Unable to query with non read-only request: " << request.ShortDebugString();
+
+    database_response response;
+    *response.mutable_header() = request.operation().header();
+    response.mutable_error()->set_message(bzn::MSG_INVALID_CRUD_COMMAND);
+
+    return response;
+}
+
 
-        if (auto result = this->unstable_storage->remove(uuid, key); result != bzn::storage_base::result::ok)
+bzn::hash_t
+database_pbft_service::service_state_hash(uint64_t sequence_number) const
+{
+    std::lock_guard<std::mutex> lock(this->lock);
+
+    auto it = this->checkpoint_chunk_hashes.find(sequence_number);
+
+    if (it == this->checkpoint_chunk_hashes.end() || it->second.empty())
+    {
+        return "";
+    }
+
+    return pbft_state_transfer::state_hash(it->second);
+}
+
+
+std::vector<bzn::hash_t>
+database_pbft_service::service_state_chunk_hashes(uint64_t sequence_number) const
+{
+    std::lock_guard<std::mutex> lock(this->lock);
+
+    auto it = this->checkpoint_chunk_hashes.find(sequence_number);
+
+    // only the latest saved state can be served...
+    if (sequence_number != this->saved_state_sequence || it == this->checkpoint_chunk_hashes.end())
+    {
+        return {};
+    }
+
+    return it->second;
+}
+
+
+std::shared_ptr<std::string>
+database_pbft_service::get_service_state_chunk(uint64_t sequence_number, size_t chunk) const
+{
+    std::lock_guard<std::mutex> lock(this->lock);
+
+    auto it = this->checkpoint_chunk_hashes.find(sequence_number);
+
+    if (sequence_number != this->saved_state_sequence || it == this->checkpoint_chunk_hashes.end() || it->second.empty())
+    {
+        return nullptr;
+    }
+
+    return this->crud->get_saved_state_chunk(chunk, STATE_CHUNK_COUNT);
+}
+
+
+std::vector<size_t>
+database_pbft_service::changed_service_state_chunks(const std::vector<bzn::hash_t>& chunk_hashes)
+{
+    std::unique_lock<std::mutex> lock(this->lock);
+    this->execution_done.wait(lock, [&]() { return !this->executing; });
+
+    // saving replaces the checkpoint state, which we can no longer serve anyway as we are behind...
+    const auto current_hashes = this->save_state();
+    this->saved_state_sequence = 0;
+
+    std::vector<size_t> changed;
+    for (size_t i = 0; i < chunk_hashes.size(); ++i)
+    {
+        if (i >= current_hashes.size() || current_hashes[i] != chunk_hashes[i])
         {
-            // these are fatal... something bad is going on.
-            throw std::runtime_error("Failed to remove pbft_request from database! (" + std::to_string(uint8_t(result)) + ")");
+            changed.push_back(i);
         }
+    }
 
-        ++this->next_request_sequence;
+    return changed;
+}
 
-        this->save_next_request_sequence();
+
+bool
+database_pbft_service::set_service_state(uint64_t sequence_number, const bzn::hash_t& state_hash, const std::map<size_t, std::string>& chunks)
+{
+    std::unique_lock<std::mutex> lock(this->lock);
+    this->execution_done.wait(lock, [&]() { return !this->executing; });
+
+    // our state may have moved on since the chunks were chosen, so check what loading them would give us first...
+    auto chunk_hashes = this->save_state();
+    this->saved_state_sequence = 0;
+
+    if (chunk_hashes.empty())
+    {
+        return false;
+    }
+
+    for (const auto& chunk : chunks)
+    {
+        if (chunk.first >= chunk_hashes.size())
+        {
+            LOG(error) << "state chunk " << chunk.first << " out of range for sequence: " << sequence_number;
+            return false;
+        }
+
+        chunk_hashes[chunk.first] = pbft_state_transfer::chunk_hash(chunk.second);
+    }
+
+    if (pbft_state_transfer::state_hash(chunk_hashes) != state_hash)
+    {
+        LOG(error) << "state chunks do not make up the state of the checkpoint at sequence: " << sequence_number;
+        return false;
+    }
+
+    for (auto chunk = chunks.begin(); chunk != chunks.end(); ++chunk)
+    {
+        if (!this->crud->load_state_chunk(chunk->first, STATE_CHUNK_COUNT, chunk->second))
+        {
+            LOG(error) << "failed to load state chunk " << chunk->first << " for sequence: " << sequence_number;
+
+            // put back what was already replaced from the state we just saved...
+            for (auto loaded = chunks.begin(); loaded != chunk; ++loaded)
+            {
+                auto original = this->crud->get_saved_state_chunk(loaded->first, STATE_CHUNK_COUNT);
+
+                if (!original || !this->crud->load_state_chunk(loaded->first, STATE_CHUNK_COUNT, *original))
+                {
+                    throw std::runtime_error("Failed to restore state chunk " + std::to_string(loaded->first));
+                }
+            }
+
+            return false;
+        }
+    }
+
+    // requests up to the checkpoint are covered by the new state...
+    for (; this->next_request_sequence <= sequence_number; ++this->next_request_sequence)
+    {
+        this->awaiting_operations.erase(this->next_request_sequence);
+        this->sessions_awaiting_response.erase(this->next_request_sequence);
+        this->logged_operations.erase(this->next_request_sequence);
     }
+
+    this->tentative_operations.erase(this->tentative_operations.begin(), this->tentative_operations.upper_bound(sequence_number));
+    this->undo_log.erase(this->undo_log.begin(), this->undo_log.upper_bound(sequence_number));
+
+    this->save_next_request_sequence();
+    this->prune_log();
+
+    this->checkpoint_state_saved(sequence_number, this->save_state());
+
+    LOG(info) << "Service state set to checkpoint at sequence: " << sequence_number;
+
+    this->process_awaiting_operations();
+
+    return true;
 }
 
 
 void
-database_pbft_service::query(const pbft_request& request, uint64_t sequence_number) const
+database_pbft_service::checkpoint_state_saved(uint64_t sequence, std::vector<bzn::hash_t> chunk_hashes)
 {
-    // TODO: not sure how this works...
+    this->checkpoint_chunk_hashes[sequence] = std::move(chunk_hashes);
+    this->saved_state_sequence = sequence;
 
-    LOG(info) << "Querying " << request.ShortDebugString()
-              << " against ver " << std::min(sequence_number, this->next_request_sequence - 1);
+    while (this->checkpoint_chunk_hashes.size() > MAX_CHECKPOINT_STATE_HASHES)
+    {
+        this->checkpoint_chunk_hashes.erase(this->checkpoint_chunk_hashes.begin());
+    }
 }
 
 
-bzn::hash_t
-database_pbft_service::service_state_hash(uint64_t /*sequence_number*/) const
+std::vector<bzn::hash_t>
+database_pbft_service::save_state()
 {
-    // TODO: not sure how this works...
+    std::vector<bzn::hash_t> chunk_hashes;
+
+    if (!this->crud->save_state())
+    {
+        LOG(error) << "failed to save service state";
+        return chunk_hashes;
+    }
+
+    this->hashed_chunks.resize(STATE_CHUNK_COUNT);
+
+    for (size_t i = 0; i < STATE_CHUNK_COUNT; ++i)
+    {
+        auto chunk = this->crud->get_saved_state_chunk(i, STATE_CHUNK_COUNT);
+
+        if (!chunk)
+        {
+            LOG(error) << "failed to read saved state chunk " << i;
+            return {};
+        }
+
+        // storage hands back the same chunk while nothing in it has changed, so only changed chunks are hashed...
+        if (chunk != this->hashed_chunks[i].first)
+        {
+            this->hashed_chunks[i] = std::make_pair(chunk, pbft_state_transfer::chunk_hash(*chunk));
+        }
+
+        chunk_hashes.push_back(this->hashed_chunks[i].second);
+    }
 
-    return "";
+    return chunk_hashes;
 }
 
 
@@ -145,6 +799,18 @@ database_pbft_service::consolidate_log(uint64_t sequence_number)
 }
 
 
+void
+database_pbft_service::prune_undo_log()
+{
+    // once everything up to a request has committed it can no longer be rolled back...
+    while (!this->undo_log.empty() && this->undo_log.begin()->second.committed)
+    {
+        this->io_context->post(std::bind(this->execute_handler, this->undo_log.begin()->second.request, this->undo_log.begin()->first));
+        this->undo_log.erase(this->undo_log.begin());
+    }
+}
+
+
 void
 database_pbft_service::register_execute_handler(bzn::execute_handler_t handler)
 {
@@ -155,6 +821,8 @@ database_pbft_service::register_execute_handler(bzn::execute_handler_t handler)
 uint64_t
 database_pbft_service::applied_requests_count() const
 {
+    std::lock_guard<std::mutex> lock(this->lock);
+
     return this->next_request_sequence - 1;
 }
 
@@ -194,3 +862,85 @@ database_pbft_service::save_next_request_sequence()
 
     LOG(debug) << "updated: next_request_sequence: " << this->next_request_sequence;
 }
+
+
+void
+database_pbft_service::load_logged_operations()
+{
+    for (const auto& key : this->unstable_storage->get_keys(this->uuid))
+    {
+        if (key == NEXT_REQUEST_SEQUENCE_KEY)
+        {
+            continue;
+        }
+
+        uint64_t first;
+        if (!boost::conversion::try_lexical_convert(key, first))
+        {
+            LOG(error) << "unexpected key in pbft request log: " << key;
+            continue;
+        }
+
+        auto result = this->unstable_storage->read(this->uuid, key);
+
+        pbft_request_log_entry entry;
+        if (!result || !entry.ParseFromString(*result))
+        {
+            // these are fatal... something bad is going on.
+            throw std::runtime_error("Failed to create pbft_request from database read!");
+        }
+
+        // logged on its own by an older version...
+        if (entry.requests().empty())
+        {
+            auto logged = entry.add_requests();
+            logged->set_sequence(first);
+
+            if (!logged->mutable_request()->ParseFromString(*result))
+            {
+                throw std::runtime_error("Failed to create pbft_request from database read!");
+            }
+        }
+
+        std::vector<uint64_t> sequences;
+        for (auto& logged : *entry.mutable_requests())
+        {
+            sequences.push_back(logged.sequence());
+
+            // executed before the last save of next_request_sequence...
+            if (logged.sequence() >= this->next_request_sequence)
+            {
+                this->awaiting_operations.emplace(logged.sequence(), std::move(*logged.mutable_request()));
+                this->logged_operations.insert(logged.sequence());
+            }
+        }
+
+        this->log_entries[first] = std::move(sequences);
+    }
+
+    this->prune_log();
+
+    LOG(debug) << "loaded " << this->awaiting_operations.size() << " logged pbft requests";
+}
+
+
+void
+database_pbft_service::prune_log()
+{
+    for (auto it = this->log_entries.begin(); it != this->log_entries.end();)
+    {
+        if (it->second.back() >= this->next_request_sequence)
+        {
+            ++it;
+            continue;
+        }
+
+        // anything left behind is below next_request_sequence and is dropped when the log is next loaded...
+        if (auto result = this->unstable_storage->remove(this->uuid, std::to_string(it->first)); result != bzn::storage_base::result::ok)
+        {
+            LOG(error) << "failed to remove executed pbft requests from " << it->first << " from log: " << uint32_t(result);
+        }
+
+        it = this->log_entries.erase(it);
+    }
+}
@@ -18,8 +18,12 @@
 #include <crud/crud_base.hpp>
 #include <pbft/pbft_failure_detector_base.hpp>
 #include <pbft/pbft_service_base.hpp>
+#include <pbft/pbft_parallel_executor.hpp>
 #include <storage/storage_base.hpp>
+#include <condition_variable>
+#include <map>
 #include <memory>
+#include <set>
 
 
 namespace bzn
@@ -30,13 +34,18 @@ namespace bzn
         database_pbft_service(std::shared_ptr<bzn::asio::io_context_base> io_context,
                               std::shared_ptr<bzn::storage_base> unstable_storage,
                               std::shared_ptr<bzn::crud_base> crud,
-                              bzn::uuid_t uuid);
+                              bzn::uuid_t uuid,
+                              size_t execution_threads = 1);
 
-        virtual ~database_pbft_service();
+        virtual ~database_pbft_service() = default;
 
         void apply_operation(const std::shared_ptr<bzn::pbft_operation>& op);
 
-        void query(const pbft_request& request, uint64_t sequence_number) const;
+        void apply_operation_tentatively(const std::shared_ptr<bzn::pbft_operation>& op);
+
+        std::vector<pbft_request> rollback_tentative_operations();
+
+        database_response query(const pbft_request& request) const;
 
         bzn::hash_t service_state_hash(uint64_t sequence_number) const;
 
@@ -44,26 +53,110 @@ namespace bzn
 
         void register_execute_handler(bzn::execute_handler_t handler);
 
+        std::vector<bzn::hash_t> service_state_chunk_hashes(uint64_t sequence_number) const;
+
+        std::shared_ptr<std::string> get_service_state_chunk(uint64_t sequence_number, size_t chunk) const;
+
+        std::vector<size_t> changed_service_state_chunks(const std::vector<bzn::hash_t>& chunk_hashes);
+
+        bool set_service_state(uint64_t sequence_number, const bzn::hash_t& state_hash, const std::map<size_t, std::string>& chunks);
+
         uint64_t applied_requests_count() const;
 
     private:
+        class tentative_reply_session;
+
+        // what is needed to execute one request, gathered under the lock beforehand
+        struct execution
+        {
+            uint64_t sequence = 0;
+            std::shared_ptr<bzn::session_base> session;
+            bool keep_undo = false;
+            std::vector<database_msg> undo;
+            std::shared_ptr<tentative_reply_session> reply;
+        };
+
+        // an executed request that may have to be undone by a rollback
+        struct executed_operation
+        {
+            pbft_request request;
+            std::vector<database_msg> undo;
+            bool committed = false;
+            std::shared_ptr<tentative_reply_session> reply;
+        };
+
         void process_awaiting_operations();
+        void execute_batches();
+        bool has_ready_operations() const;
+        bool may_execute(uint64_t sequence) const;
+
+        std::shared_ptr<bzn::session_base> take_session(uint64_t sequence);
+        execution prepare_execution(std::map<uint64_t, pbft_request>::iterator it);
+        void execute_request(const database_msg& request, execution& exec);
+        void finish_request(std::map<uint64_t, pbft_request>::iterator it, execution&& exec);
+
+        std::vector<database_msg> undo_steps(const database_msg& request) const;
+        void confirm_operation(uint64_t sequence);
+        void prune_undo_log();
+
+        std::vector<std::map<uint64_t, pbft_request>::iterator> next_batch();
+        void log_requests(const std::vector<std::map<uint64_t, pbft_request>::iterator>& requests);
+        void batch_executed();
+        bool in_log(uint64_t sequence) const;
+
+        std::vector<bzn::hash_t> save_state();
+        void checkpoint_state_saved(uint64_t sequence, std::vector<bzn::hash_t> chunk_hashes);
 
         void load_next_request_sequence();
         void save_next_request_sequence();
 
+        void load_logged_operations();
+        void prune_log();
+
         std::shared_ptr<bzn::asio::io_context_base> io_context;
         std::shared_ptr<bzn::storage_base> unstable_storage;
         std::shared_ptr<bzn::crud_base> crud;
         uint64_t next_request_sequence = 1;
         const bzn::uuid_t uuid;
 
+        // chunk hashes of the state at recent checkpoints, as execution may be a checkpoint or two ahead of pbft...
+        std::map<uint64_t, std::vector<bzn::hash_t>> checkpoint_chunk_hashes;
+
+        // the checkpoint whose saved state can be served to lagging replicas, or 0 if none
+        uint64_t saved_state_sequence = 0;
+
+        // the saved state chunks last hashed, and their hashes
+        std::vector<std::pair<std::shared_ptr<std::string>, bzn::hash_t>> hashed_chunks;
+
+        // committed requests waiting for an earlier sequence to be executed; these are only in memory until they are
+        // logged with the batch they execute in...
+        std::map<uint64_t, pbft_request> awaiting_operations;
+
+        // the committed requests of a batch are written to the log as one record before any of them executes, and
+        // next_request_sequence is saved once after the batch; records are kept by their first sequence, with the
+        // sequences in them, and removed at checkpoints once all of those have executed
+        std::map<uint64_t, std::vector<uint64_t>> log_entries;
+
+        // waiting requests that are in the log already...
+        std::set<uint64_t> logged_operations;
+
         std::unordered_map<uint64_t, std::weak_ptr<bzn::session_base>> sessions_awaiting_response;
 
+        // prepared but not yet committed requests, whether executed or still waiting...
+        std::set<uint64_t> tentative_operations;
+
+        // requests executed from the first uncommitted one onwards, with what it takes to undo them
+        std::map<uint64_t, executed_operation> undo_log;
+
         bzn::execute_handler_t execute_handler;
 
+        // runs non-conflicting requests concurrently; requests are executed inline when there isn't one
+        std::unique_ptr<bzn::pbft_parallel_executor> executor;
+        bool executing = false;
+        mutable std::condition_variable execution_done;
+
         std::once_flag start_once;
-        std::mutex lock;
+        mutable std::mutex lock;
     };
 
 } // bzn
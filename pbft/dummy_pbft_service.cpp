@@ -48,10 +48,27 @@ dummy_pbft_service::apply_operation(const std::shared_ptr<pbft_operation>& op)
 }
 
 void
-dummy_pbft_service::query(const pbft_request& request, uint64_t sequence_number) const
+dummy_pbft_service::apply_operation_tentatively(const std::shared_ptr<pbft_operation>& /*op*/)
+{
+    // nothing to gain from executing early here, so wait for the commit...
+}
+
+std::vector<pbft_request>
+dummy_pbft_service::rollback_tentative_operations()
+{
+    return {};
+}
+
+database_response
+dummy_pbft_service::query(const pbft_request& request) const
 {
     LOG(info) << "Querying " << request.ShortDebugString()
-              << " against ver " << std::min(sequence_number, this->next_request_sequence - 1);
+              << " against ver " << this->next_request_sequence - 1;
+
+    database_response resp;
+    resp.mutable_read()->set_value("dummy database query of " + request.ShortDebugString());
+
+    return resp;
 }
 
 void
@@ -79,6 +96,38 @@ dummy_pbft_service::service_state_hash(uint64_t sequence_number) const
     return "I don't actually have a database [" + std::to_string(sequence_number) + "]";
 }
 
+std::vector<bzn::hash_t>
+dummy_pbft_service::service_state_chunk_hashes(uint64_t /*sequence_number*/) const
+{
+    // no state to transfer
+    return {};
+}
+
+std::shared_ptr<std::string>
+dummy_pbft_service::get_service_state_chunk(uint64_t /*sequence_number*/, size_t /*chunk*/) const
+{
+    return nullptr;
+}
+
+std::vector<size_t>
+dummy_pbft_service::changed_service_state_chunks(const std::vector<bzn::hash_t>& /*chunk_hashes*/)
+{
+    return {};
+}
+
+bool
+dummy_pbft_service::set_service_state(uint64_t sequence_number, const bzn::hash_t& /*state_hash*/, const std::map<size_t, std::string>& /*chunks*/)
+{
+    std::lock_guard<std::mutex> lock(this->lock);
+
+    for (; this->next_request_sequence <= sequence_number; ++this->next_request_sequence)
+    {
+        this->waiting_operations.erase(this->next_request_sequence);
+    }
+
+    return true;
+}
+
 void
 dummy_pbft_service::send_execute_response(const std::shared_ptr<pbft_operation>& op)
 {
@@ -30,10 +30,16 @@ namespace bzn
     public:
         dummy_pbft_service(std::shared_ptr<bzn::asio::io_context_base> io_context);
         void apply_operation(const std::shared_ptr<pbft_operation>& op) override;
-        void query(const pbft_request& request, uint64_t sequence_number) const override;
+        void apply_operation_tentatively(const std::shared_ptr<pbft_operation>& op) override;
+        std::vector<pbft_request> rollback_tentative_operations() override;
+        database_response query(const pbft_request& request) const override;
         void consolidate_log(uint64_t sequence_number) override;
         void register_execute_handler(execute_handler_t handler) override;
         bzn::hash_t service_state_hash(uint64_t sequence_number) const override;
+        std::vector<bzn::hash_t> service_state_chunk_hashes(uint64_t sequence_number) const override;
+        std::shared_ptr<std::string> get_service_state_chunk(uint64_t sequence_number, size_t chunk) const override;
+        std::vector<size_t> changed_service_state_chunks(const std::vector<bzn::hash_t>& chunk_hashes) override;
+        bool set_service_state(uint64_t sequence_number, const bzn::hash_t& state_hash, const std::map<size_t, std::string>& chunks) override;
 
         uint64_t applied_requests_count();
 
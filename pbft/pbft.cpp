@@ -26,6 +26,97 @@
 
 using namespace bzn;
 
+namespace
+{
+    // most requests passed on to the primary in one message
+    const int MAX_FORWARD_BATCH_SIZE = 100;
+
+    // how long a forwarded request's client is remembered without the primary replying
+    const std::chrono::seconds FORWARDED_REQUEST_TIMEOUT{60};
+
+    // committed operations waiting to be executed before the node stops reading more messages
+    const size_t MAX_PENDING_EXECUTIONS = 1000;
+
+    // how long state requests go unanswered before they are sent again, chunks to other sources
+    const std::chrono::milliseconds STATE_TRANSFER_RETRY_INTERVAL{5000};
+
+    bool
+    is_read_only(const database_msg& msg)
+    {
+        switch (msg.msg_case())
+        {
+            case database_msg::kRead:
+            case database_msg::kHas:
+            case database_msg::kKeys:
+            case database_msg::kSize:
+                return true;
+            default:
+                return false;
+        }
+    }
+
+    // a tentative reply will be followed by the real one
+    bool
+    is_final_reply(const bzn::encoded_message& reply)
+    {
+        database_response response;
+
+        return !response.ParseFromString(reply) || !response.tentative();
+    }
+}
+
+
+// Stands in on the primary for the session of a client connected to the backup that forwarded its request: whatever
+// is sent to the client goes back to the backup, tagged with the forward id, for it to pass on.
+class pbft::forwarded_reply_session final : public bzn::session_base
+{
+public:
+    forwarded_reply_session(std::weak_ptr<pbft> owner, bzn::uuid_t peer_uuid, uint64_t forward_id)
+        : owner(std::move(owner))
+        , peer_uuid(std::move(peer_uuid))
+        , forward_id(forward_id)
+    {
+    }
+
+    void start(bzn::message_handler /*handler*/, bzn::protobuf_handler /*proto_handler*/) override
+    {
+    }
+
+    void send_message(std::shared_ptr<bzn::json_message> msg, bool end_session) override
+    {
+        this->send_message(std::make_shared<bzn::encoded_message>(msg->toStyledString()), end_session);
+    }
+
+    void send_message(std::shared_ptr<bzn::encoded_message> msg, bool /*end_session*/) override
+    {
+        if (auto pbft = this->owner.lock())
+        {
+            pbft->send_forward_reply(this->peer_uuid, this->forward_id, std::move(msg));
+        }
+    }
+
+    void send_datagram(std::shared_ptr<bzn::encoded_message> msg) override
+    {
+        this->send_message(std::move(msg), false);
+    }
+
+    void close() override
+    {
+        // the client's connection belongs to the backup...
+    }
+
+    bzn::session_id get_session_id() override
+    {
+        return 0;
+    }
+
+private:
+    const std::weak_ptr<pbft> owner;
+    const bzn::uuid_t peer_uuid;
+    const uint64_t forward_id;
+};
+
+
 pbft::pbft(
     std::shared_ptr<bzn::node_base> node
     , std::shared_ptr<bzn::asio::io_context_base> io_context
@@ -33,6 +124,7 @@ pbft::pbft(
     , bzn::uuid_t uuid
     , std::shared_ptr<pbft_service_base> service
     , std::shared_ptr<pbft_failure_detector_base> failure_detector
+    , std::shared_ptr<crypto_base> crypto
     )
     : node(std::move(node))
     , uuid(std::move(uuid))
@@ -40,6 +132,7 @@ pbft::pbft(
     , failure_detector(std::move(failure_detector))
     , io_context(io_context)
     , audit_heartbeat_timer(this->io_context->make_unique_steady_timer())
+    , crypto(std::move(crypto))
 {
     if (peers.empty())
     {
@@ -51,6 +144,7 @@ pbft::pbft(
     // TODO: stable checkpoint should be read from disk first: KEP-494
     this->low_water_mark = this->stable_checkpoint.first;
     this->high_water_mark = this->stable_checkpoint.first + std::lround(CHECKPOINT_INTERVAL*HIGH_WATER_INTERVAL_IN_CHECKPOINTS);
+    this->operations.advance(this->low_water_mark);
 }
 
 void
@@ -59,6 +153,8 @@ pbft::start()
     std::call_once(this->start_once,
             [this]()
             {
+                this->update_authenticated_peers();
+
                 this->node->register_for_message(bzn_envelope::PayloadCase::kPbft,
                         std::bind(&pbft::handle_bzn_message, shared_from_this(), std::placeholders::_1, std::placeholders::_2));
 
@@ -68,15 +164,23 @@ pbft::start()
                 this->node->register_for_message("database",
                         std::bind(&pbft::handle_database_message, shared_from_this(), std::placeholders::_1, std::placeholders::_2));
 
+                this->node->register_for_message("metrics",
+                        std::bind(&pbft::handle_metrics_message, shared_from_this(), std::placeholders::_1, std::placeholders::_2));
+
+                this->node->register_backlog("pbft_executions",
+                        [pending = this->pending_executions]() { return pending->load(); }, MAX_PENDING_EXECUTIONS);
+
                 this->audit_heartbeat_timer->expires_from_now(HEARTBEAT_INTERVAL);
                 this->audit_heartbeat_timer->async_wait(
                         std::bind(&pbft::handle_audit_heartbeat_timeout, shared_from_this(), std::placeholders::_1));
 
                 this->service->register_execute_handler(
-                        [weak_this = this->weak_from_this(), fd = this->failure_detector]
+                        [weak_this = this->weak_from_this(), fd = this->failure_detector, ct = this->client_table, metrics = this->metrics]
                                 (const pbft_request& req, uint64_t sequence)
                                         {
-                                            fd->request_executed(req);
+                                            fd->request_executed(req, sequence);
+                                            ct->record_executed(req, sequence);
+                                            metrics->operation_executed(sequence);
 
                                             if (sequence % CHECKPOINT_INTERVAL == 0)
                                             {
@@ -125,6 +229,14 @@ pbft::handle_audit_heartbeat_timeout(const boost::system::error_code& ec)
 
     }
 
+    {
+        std::lock_guard<std::mutex> lock(this->pbft_lock);
+        this->flush_audit_commits();
+    }
+
+    this->expire_pending_queries();
+    this->expire_pending_forwards();
+
     this->audit_heartbeat_timer->expires_from_now(HEARTBEAT_INTERVAL);
     this->audit_heartbeat_timer->async_wait(std::bind(&pbft::handle_audit_heartbeat_timeout, shared_from_this(), std::placeholders::_1));
 }
@@ -159,6 +271,9 @@ pbft::handle_membership_message(const bzn_envelope& msg, std::shared_ptr<bzn::se
 
     if (inner_msg.has_peer_info())
     {
+        // a new configuration is ordered like any request...
+        std::lock_guard<std::mutex> lock(this->pbft_lock);
+
         switch (inner_msg.type())
         {
             case PBFT_MMSG_JOIN:
@@ -178,12 +293,15 @@ pbft::handle_message(const pbft_msg& msg, const bzn_envelope& original_msg)
 
     LOG(debug) << "Received message: " << msg.ShortDebugString().substr(0, MAX_MESSAGE_SIZE);
 
+    this->metrics->message_received(msg.type());
+
     if (!this->preliminary_filter_msg(msg))
     {
         return;
     }
 
-    if (msg.has_request())
+    // only requests being ordered are expected to execute; queries carry one too but are answered directly...
+    if (msg.has_request() && (msg.type() == PBFT_MSG_PREPREPARE || msg.type() == PBFT_MSG_PREPARE || msg.type() == PBFT_MSG_COMMIT))
     {
         this->failure_detector->request_seen(msg.request());
     }
@@ -204,6 +322,24 @@ pbft::handle_message(const pbft_msg& msg, const bzn_envelope& original_msg)
         case PBFT_MSG_CHECKPOINT :
             this->handle_checkpoint(msg, original_msg);
             break;
+        case PBFT_MSG_GET_STATE :
+            this->handle_get_state(msg, original_msg);
+            break;
+        case PBFT_MSG_SET_STATE :
+            this->handle_set_state(msg, original_msg);
+            break;
+        case PBFT_MSG_QUERY :
+            this->handle_query(msg, original_msg);
+            break;
+        case PBFT_MSG_QUERY_REPLY :
+            this->handle_query_reply(msg, original_msg);
+            break;
+        case PBFT_MSG_FORWARD :
+            this->handle_forward(msg, original_msg);
+            break;
+        case PBFT_MSG_FORWARD_REPLY :
+            this->handle_forward_reply(msg, original_msg);
+            break;
         default :
             throw std::runtime_error("Unsupported message type");
     }
@@ -252,20 +388,28 @@ pbft::setup_request_operation(const pbft_request& msg, const std::shared_ptr<ses
 }
 
 void
-pbft::handle_request(const pbft_request& msg, const bzn::json_message& original_msg, const std::shared_ptr<session_base>& session)
+pbft::handle_request(const pbft_request& msg, const std::shared_ptr<session_base>& session)
 {
     if (!this->is_primary())
     {
-        LOG(info) << "Forwarding request to primary: " << original_msg.toStyledString();
-        this->node->send_message(bzn::make_endpoint(this->get_primary()), std::make_shared<bzn::json_message>(original_msg));
+        this->forward_request(msg, session);
         return;
     }
 
-    //TODO: conditionally discard based on timestamp - KEP-328
+    // a client retrying its last request gets the cached reply rather than having it ordered again...
+    if (std::shared_ptr<bzn::encoded_message> reply; this->client_table->is_duplicate(msg, session, reply))
+    {
+        LOG(debug) << "Not ordering duplicate request: " << msg.ShortDebugString().substr(0, MAX_MESSAGE_SIZE);
+
+        if (reply && session)
+        {
+            session->send_message(reply, false);
+        }
 
-    //TODO: keep track of what requests we've seen based on timestamp and only send preprepares once - KEP-329
+        return;
+    }
 
-    auto op = setup_request_operation(msg, session);
+    auto op = setup_request_operation(msg, this->client_table->record_ordered(msg, session));
     this->do_preprepare(op);
 }
 
@@ -380,6 +524,33 @@ pbft::broadcast(const bzn::encoded_message& msg)
     }
 }
 
+void
+pbft::broadcast(const pbft_msg& msg)
+{
+    // signed and serialized once; every remote peer is sent the same buffer...
+    auto envelope = std::make_shared<bzn_envelope>(this->make_envelope(msg));
+    auto msg_ptr = std::make_shared<bzn::encoded_message>(envelope->SerializeAsString());
+
+    for (const auto& peer : this->current_peers())
+    {
+        if (peer.uuid == this->uuid)
+        {
+            // handled once the caller has let go of pbft_lock, just as if it had come back over the network...
+            this->io_context->post([weak_this = this->weak_from_this(), msg, envelope]()
+            {
+                if (auto strong_this = weak_this.lock())
+                {
+                    strong_this->handle_message(msg, *envelope);
+                }
+            });
+
+            continue;
+        }
+
+        this->node->send_message_str(make_endpoint(peer), msg_ptr);
+    }
+}
+
 void
 pbft::maybe_advance_operation_state(const std::shared_ptr<pbft_operation>& op)
 {
@@ -413,7 +584,7 @@ pbft::do_preprepare(const std::shared_ptr<pbft_operation>& op)
 
     pbft_msg msg = this->common_message_setup(op, PBFT_MSG_PREPREPARE);
 
-    this->broadcast(this->wrap_message(msg, "preprepare"));
+    this->broadcast(msg);
 }
 
 void
@@ -423,7 +594,7 @@ pbft::do_preprepared(const std::shared_ptr<pbft_operation>& op)
 
     pbft_msg msg = this->common_message_setup(op, PBFT_MSG_PREPARE);
 
-    this->broadcast(this->wrap_message(msg, "prepare"));
+    this->broadcast(msg);
 }
 
 void
@@ -444,7 +615,13 @@ pbft::do_prepared(const std::shared_ptr<pbft_operation>& op)
 
     pbft_msg msg = this->common_message_setup(op, PBFT_MSG_COMMIT);
 
-    this->broadcast(this->wrap_message(msg, "commit"));
+    this->broadcast(msg);
+
+    // its place in the order is now fixed unless the view changes, so the client can have a tentative reply a round early...
+    if (this->tentative_execution_enabled && op->request.has_operation())
+    {
+        this->post_execution(std::bind(&pbft_service_base::apply_operation_tentatively, this->service, this->find_operation(op)));
+    }
 }
 
 void
@@ -463,25 +640,42 @@ pbft::do_committed(const std::shared_ptr<pbft_operation>& op)
 
     LOG(debug) << "Operation " << op->debug_string() << " is committed-local";
     op->end_commit_phase();
+    this->metrics->operation_committed(*op);
 
+    // audited in batches, sent on the heartbeat and at checkpoints...
     if (this->audit_enabled)
     {
-        audit_message msg;
-        msg.mutable_pbft_commit()->set_operation(pbft_operation::request_hash(op->request));
-        msg.mutable_pbft_commit()->set_sequence_number(op->sequence);
-        msg.mutable_pbft_commit()->set_sender_uuid(this->uuid);
+        this->audit_commits.add_sequence_numbers(op->sequence);
+        this->audit_commits.add_operations(pbft_operation::request_hash(op->request));
 
-        this->broadcast(this->wrap_message(msg));
+        if (static_cast<uint64_t>(this->audit_commits.operations_size()) >= CHECKPOINT_INTERVAL)
+        {
+            this->flush_audit_commits();
+        }
     }
 
     // Get a new shared pointer to the operation so that we can give pbft_service ownership on it
-    this->io_context->post(std::bind(&pbft_service_base::apply_operation, this->service, this->find_operation(op)));
+    this->post_execution(std::bind(&pbft_service_base::apply_operation, this->service, this->find_operation(op)));
+}
+
+void
+pbft::post_execution(std::function<void()> execute)
+{
+    // counted until it has run, so the node can stop taking in more work while these pile up...
+    ++*this->pending_executions;
+
+    this->io_context->post(
+        [pending = this->pending_executions, execute = std::move(execute)]()
+        {
+            execute();
+            --*pending;
+        });
 }
 
 size_t
 pbft::outstanding_operations_count() const
 {
-    return operations.size();
+    return this->operations.size();
 }
 
 bool
@@ -512,48 +706,70 @@ pbft::find_operation(const std::shared_ptr<pbft_operation>& op)
 std::shared_ptr<pbft_operation>
 pbft::find_operation(uint64_t view, uint64_t sequence, const pbft_request& request)
 {
-    auto key = bzn::operation_key_t(view, sequence, pbft_operation::request_hash(request));
+    const auto request_hash = pbft_operation::request_hash(request);
 
-    auto lookup = operations.find(key);
-    if (lookup == operations.end())
+    auto op = this->operations.find(view, sequence, request_hash);
+    if (!op)
     {
         LOG(debug) << "Creating operation for seq " << sequence << " view " << view << " req "
                    << request.ShortDebugString();
 
-        std::shared_ptr<pbft_operation> op = std::make_shared<pbft_operation>(view, sequence, request,
-                this->current_peers_ptr());
-        auto result = operations.emplace(std::piecewise_construct, std::forward_as_tuple(std::move(key)), std::forward_as_tuple(op));
-
-        assert(result.second);
-        return result.first->second;
+        op = std::make_shared<pbft_operation>(view, sequence, request, this->current_peers_ptr());
+        this->operations.insert(op, request_hash);
     }
 
-    return lookup->second;
+    return op;
 }
 
-bzn::encoded_message
-pbft::wrap_message(const pbft_msg& msg, const std::string& /*debug_info*/)
+bzn_envelope
+pbft::make_envelope(const pbft_msg& msg)
 {
     bzn_envelope result;
     result.set_pbft(msg.SerializeAsString());
     result.set_sender(this->uuid);
 
-    return result.SerializeAsString();
+    if (this->crypto)
+    {
+        // normal case messages only need to convince their receivers; anything that may be used as proof
+        // (checkpoints, state) is signed...
+        if (msg.type() == PBFT_MSG_PREPARE || msg.type() == PBFT_MSG_COMMIT)
+        {
+            std::vector<bzn::uuid_t> receivers;
+            for (const auto& peer : this->current_peers())
+            {
+                receivers.push_back(peer.uuid);
+            }
+
+            this->crypto->authenticate(result, receivers);
+        }
+        else
+        {
+            this->crypto->sign(result);
+        }
+    }
+
+    return result;
 }
 
 bzn::encoded_message
-pbft::wrap_message(const audit_message& msg, const std::string& debug_info)
+pbft::wrap_message(const pbft_msg& msg, const std::string& /*debug_info*/)
 {
-    bzn::json_message json;
+    return this->make_envelope(msg).SerializeAsString();
+}
 
-    json["bzn-api"] = "audit";
-    json["audit-data"] = boost::beast::detail::base64_encode(msg.SerializeAsString());
-    if (debug_info.length() > 0)
+bzn::encoded_message
+pbft::wrap_message(const audit_message& msg, const std::string& /*debug_info*/)
+{
+    bzn_envelope result;
+    result.set_audit(msg.SerializeAsString());
+    result.set_sender(this->uuid);
+
+    if (this->crypto)
     {
-        json["debug-info"] = debug_info;
+        this->crypto->sign(result);
     }
 
-    return json.toStyledString();
+    return result.SerializeAsString();
 }
 
 const bzn::uuid_t&
@@ -568,6 +784,33 @@ pbft::set_audit_enabled(bool setting)
     this->audit_enabled = setting;
 }
 
+void
+pbft::set_tentative_execution_enabled(bool setting)
+{
+    this->tentative_execution_enabled = setting;
+}
+
+void
+pbft::set_max_clients(size_t max_clients)
+{
+    this->client_table->set_max_clients(max_clients);
+}
+
+void
+pbft::flush_audit_commits()
+{
+    if (!this->audit_enabled || this->audit_commits.operations_size() == 0)
+    {
+        return;
+    }
+
+    audit_message msg;
+    this->audit_commits.set_sender_uuid(this->uuid);
+    msg.mutable_pbft_commit_batch()->Swap(&this->audit_commits);
+
+    this->broadcast(this->wrap_message(msg));
+}
+
 void
 pbft::notify_audit_failure_detected()
 {
@@ -584,6 +827,15 @@ pbft::handle_failure()
 {
     LOG(fatal) << "Failure detected; view changes not yet implemented\n";
     this->notify_audit_failure_detected();
+
+    // whatever the new view orders, it need not agree with what was only executed tentatively...
+    if (this->tentative_execution_enabled)
+    {
+        for (const auto& request : this->service->rollback_tentative_operations())
+        {
+            this->client_table->rolled_back(request);
+        }
+    }
     //TODO: KEP-332
 }
 
@@ -603,7 +855,8 @@ pbft::checkpoint_reached_locally(uint64_t sequence)
     cp_msg.set_sequence(sequence);
     cp_msg.set_state_hash(cp->second);
 
-    this->broadcast(this->wrap_message(cp_msg));
+    this->broadcast(cp_msg);
+    this->flush_audit_commits();
 
     this->maybe_stabilize_checkpoint(*cp);
 }
@@ -623,10 +876,262 @@ pbft::handle_checkpoint(const pbft_msg& msg, const bzn_envelope& original_msg)
               % msg.sequence()
               % original_msg.sender();
 
+    if (this->crypto && original_msg.signature().empty())
+    {
+        LOG(error) << "Ignoring unsigned checkpoint message from " << original_msg.sender();
+        return;
+    }
+
     checkpoint_t cp(msg.sequence(), msg.state_hash());
 
     this->unstable_checkpoint_proofs[cp][original_msg.sender()] = original_msg.SerializeAsString();
     this->maybe_stabilize_checkpoint(cp);
+    this->maybe_begin_state_transfer(cp);
+}
+
+void
+pbft::maybe_begin_state_transfer(const checkpoint_t& cp)
+{
+    if (cp.first <= this->stable_checkpoint.first || this->unstable_checkpoint_proofs[cp].size() < this->quorum_size())
+    {
+        return;
+    }
+
+    // a replica within one checkpoint interval of the swarm will catch up by executing the log...
+    if (cp.first <= this->latest_checkpoint().first + CHECKPOINT_INTERVAL)
+    {
+        return;
+    }
+
+    if (this->state_transfer && this->state_transfer->get_checkpoint().first >= cp.first)
+    {
+        return;
+    }
+
+    std::vector<bzn::uuid_t> sources;
+    for (const auto& proof : this->unstable_checkpoint_proofs[cp])
+    {
+        if (proof.first != this->uuid)
+        {
+            sources.push_back(proof.first);
+        }
+    }
+
+    LOG(info) << boost::format("Fell behind stable checkpoint at seq %1%; fetching state from %2% peers")
+              % cp.first
+              % sources.size();
+
+    this->state_transfer = std::make_unique<pbft_state_transfer>(cp, sources);
+    this->request_state_manifest();
+}
+
+void
+pbft::request_state_manifest()
+{
+    // any source can supply the manifest since it is verified against the checkpoint hash...
+    pbft_msg msg;
+    msg.set_type(PBFT_MSG_GET_STATE);
+    msg.set_view(this->view);
+    msg.set_sequence(this->state_transfer->get_checkpoint().first);
+    msg.set_state_hash(this->state_transfer->get_checkpoint().second);
+
+    const auto encoded_msg = this->wrap_message(msg);
+    for (const auto& source : this->state_transfer->get_sources())
+    {
+        this->send_to_peer(source, encoded_msg);
+    }
+
+    this->start_state_transfer_timer();
+}
+
+void
+pbft::start_state_transfer_timer()
+{
+    if (!this->state_transfer_timer)
+    {
+        this->state_transfer_timer = this->io_context->make_unique_steady_timer();
+    }
+
+    // restarting the timer cancels the wait before, so only the latest one goes off...
+    this->state_transfer_timer->expires_from_now(STATE_TRANSFER_RETRY_INTERVAL);
+    this->state_transfer_timer->async_wait(
+        [weak_this = this->weak_from_this(), cp = this->state_transfer->get_checkpoint()](const boost::system::error_code& ec)
+        {
+            if (auto strong_this = weak_this.lock(); strong_this && !ec)
+            {
+                strong_this->handle_state_transfer_timeout(cp);
+            }
+        });
+}
+
+void
+pbft::handle_state_transfer_timeout(const checkpoint_t& cp)
+{
+    std::lock_guard<std::mutex> lock(this->pbft_lock);
+
+    if (!this->state_transfer || this->state_transfer->get_checkpoint() != cp)
+    {
+        return;
+    }
+
+    if (!this->state_transfer->has_manifest())
+    {
+        LOG(info) << "No state manifest received for checkpoint at seq " << cp.first << "; asking again";
+        this->request_state_manifest();
+        return;
+    }
+
+    LOG(info) << "State chunks for checkpoint at seq " << cp.first << " not received; asking other sources";
+    this->state_transfer->move_outstanding_chunks();
+    this->request_state_chunks();
+}
+
+void
+pbft::handle_get_state(const pbft_msg& msg, const bzn_envelope& original_msg)
+{
+    const auto chunk_hashes = this->service->service_state_chunk_hashes(msg.sequence());
+
+    if (chunk_hashes.empty() || pbft_state_transfer::state_hash(chunk_hashes) != msg.state_hash())
+    {
+        LOG(debug) << boost::format("Ignoring state request for seq %1% from %2%; state not available")
+                   % msg.sequence()
+                   % original_msg.sender();
+        return;
+    }
+
+    pbft_msg reply;
+    reply.set_type(PBFT_MSG_SET_STATE);
+    reply.set_view(this->view);
+    reply.set_sequence(msg.sequence());
+    reply.set_state_hash(msg.state_hash());
+
+    if (msg.requested_chunks_size() == 0)
+    {
+        for (const auto& hash : chunk_hashes)
+        {
+            reply.add_chunk_hashes(hash);
+        }
+    }
+    else
+    {
+        for (const auto index : msg.requested_chunks())
+        {
+            auto data = (index < chunk_hashes.size()) ? this->service->get_service_state_chunk(msg.sequence(), index) : nullptr;
+
+            if (!data)
+            {
+                LOG(error) << boost::format("Unable to read state chunk %1% at seq %2%") % index % msg.sequence();
+                return;
+            }
+
+            auto chunk = reply.add_chunks();
+            chunk->set_index(index);
+            chunk->set_data(*data);
+        }
+    }
+
+    this->send_to_peer(original_msg.sender(), this->wrap_message(reply));
+}
+
+void
+pbft::handle_set_state(const pbft_msg& msg, const bzn_envelope& original_msg)
+{
+    if (!this->state_transfer || this->state_transfer->get_checkpoint() != checkpoint_t(msg.sequence(), msg.state_hash()))
+    {
+        LOG(debug) << "Ignoring unexpected state from " << original_msg.sender();
+        return;
+    }
+
+    if (msg.chunk_hashes_size() > 0 && !this->state_transfer->has_manifest())
+    {
+        if (!this->state_transfer->set_manifest({msg.chunk_hashes().begin(), msg.chunk_hashes().end()}))
+        {
+            return;
+        }
+
+        this->state_transfer->set_needed_chunks(this->service->changed_service_state_chunks(this->state_transfer->get_manifest()));
+        this->request_state_chunks();
+    }
+
+    for (const auto& chunk : msg.chunks())
+    {
+        this->state_transfer->add_chunk(chunk.index(), chunk.data());
+    }
+
+    if (this->state_transfer->is_complete())
+    {
+        this->finish_state_transfer();
+    }
+}
+
+void
+pbft::request_state_chunks()
+{
+    for (const auto& assignment : this->state_transfer->assign_chunks())
+    {
+        pbft_msg msg;
+        msg.set_type(PBFT_MSG_GET_STATE);
+        msg.set_view(this->view);
+        msg.set_sequence(this->state_transfer->get_checkpoint().first);
+        msg.set_state_hash(this->state_transfer->get_checkpoint().second);
+
+        for (const auto index : assignment.second)
+        {
+            msg.add_requested_chunks(index);
+        }
+
+        this->send_to_peer(assignment.first, this->wrap_message(msg));
+    }
+
+    this->start_state_transfer_timer();
+}
+
+void
+pbft::finish_state_transfer()
+{
+    const checkpoint_t cp = this->state_transfer->get_checkpoint();
+
+    LOG(info) << boost::format("Fetched %1% changed state chunks for checkpoint at seq %2%")
+              % this->state_transfer->get_chunks().size()
+              % cp.first;
+
+    const bool loaded = this->service->set_service_state(cp.first, cp.second, this->state_transfer->get_chunks());
+    this->state_transfer.reset();
+    this->state_transfer_timer->cancel();
+
+    if (!loaded)
+    {
+        // our state changed while the chunks were in flight, and was left as it was; wait for the next checkpoint to try again...
+        LOG(error) << "Fetched state chunks do not make up the checkpoint at seq " << cp.first;
+        return;
+    }
+
+    this->stable_checkpoint = cp;
+    this->stable_checkpoint_proof = this->unstable_checkpoint_proofs[cp];
+
+    this->clear_local_checkpoints_until(cp);
+    this->clear_checkpoint_messages_until(cp);
+    this->clear_operations_until(cp);
+    this->failure_detector->stable_checkpoint_reached(cp.first);
+
+    this->low_water_mark = std::max(this->low_water_mark, cp.first);
+    this->high_water_mark = std::max(this->high_water_mark, cp.first + std::lround(HIGH_WATER_INTERVAL_IN_CHECKPOINTS*CHECKPOINT_INTERVAL));
+    this->next_issued_sequence_number = std::max(this->next_issued_sequence_number, cp.first + 1);
+}
+
+void
+pbft::send_to_peer(const bzn::uuid_t& peer_uuid, const bzn::encoded_message& message)
+{
+    const auto& peers = this->current_peers();
+    auto peer = std::find_if(peers.begin(), peers.end(), [&](const auto& p){ return p.uuid == peer_uuid; });
+
+    if (peer == peers.end())
+    {
+        LOG(error) << "Unable to send message to unknown peer " << peer_uuid;
+        return;
+    }
+
+    this->node->send_message_str(make_endpoint(*peer), std::make_shared<bzn::encoded_message>(message));
 }
 
 bzn::checkpoint_t
@@ -665,6 +1170,7 @@ pbft::maybe_stabilize_checkpoint(const checkpoint_t& cp)
     this->clear_local_checkpoints_until(cp);
     this->clear_checkpoint_messages_until(cp);
     this->clear_operations_until(cp);
+    this->failure_detector->stable_checkpoint_reached(cp.first);
 
     this->low_water_mark = std::max(this->low_water_mark, cp.first);
     this->high_water_mark = std::max(this->high_water_mark, cp.first + std::lround(HIGH_WATER_INTERVAL_IN_CHECKPOINTS*CHECKPOINT_INTERVAL));
@@ -695,20 +1201,7 @@ pbft::clear_checkpoint_messages_until(const checkpoint_t& cp)
 void
 pbft::clear_operations_until(const checkpoint_t& cp)
 {
-    size_t ops_removed = 0;
-    auto it = this->operations.begin();
-    while (it != this->operations.end())
-    {
-        if(it->second->sequence <= cp.first)
-        {
-            it = this->operations.erase(it);
-            ops_removed++;
-        }
-        else
-        {
-            it++;
-        }
-    }
+    const size_t ops_removed = this->operations.advance(cp.first);
 
     LOG(debug) << boost::format("Cleared %1% old operation records") % ops_removed;
 }
@@ -733,6 +1226,8 @@ pbft::handle_database_message(const bzn::json_message& json, std::shared_ptr<bzn
 
     LOG(debug) << "got database message: " << json.toStyledString();
 
+    this->metrics->request_received();
+
     if (!json.isMember("msg"))
     {
         LOG(error) << "Invalid message: " << json.toStyledString().substr(0,MAX_MESSAGE_SIZE) << "...";
@@ -753,12 +1248,369 @@ pbft::handle_database_message(const bzn::json_message& json, std::shared_ptr<bzn
 
     pbft_request req;
     *req.mutable_operation() = msg.db();
-    req.set_timestamp(0); //TODO: KEP-611
-
-    this->handle_request(req, json, session);
+    // a retry reuses the transaction id, which clients pick at random, so without a client id the database and the
+    // transaction id name the request whichever connection or node it comes through...
+    const auto& header = msg.db().header();
+    req.set_client(header.client_id().empty() ? header.db_uuid() + "/" + std::to_string(header.transaction_id())
+        : header.client_id() + "/" + header.db_uuid());
+    req.set_timestamp(msg.db().header().transaction_id());
 
     LOG(debug) << "Sending request ack: " << response.ShortDebugString();
     session->send_message(std::make_shared<bzn::encoded_message>(response.SerializeAsString()), false);
+
+    if (is_read_only(msg.db()))
+    {
+        this->do_query(req, session);
+        return;
+    }
+
+    std::lock_guard<std::mutex> lock(this->pbft_lock);
+    this->handle_request(req, session);
+}
+
+void
+pbft::do_query(const pbft_request& request, const std::shared_ptr<session_base>& session)
+{
+    std::lock_guard<std::mutex> lock(this->pbft_lock);
+
+    const uint64_t query_id = this->next_query_id++;
+
+    auto& query = this->pending_queries[query_id];
+    query.request = request;
+    query.session = session;
+    query.started = std::chrono::steady_clock::now();
+
+    pbft_msg msg;
+    msg.set_type(PBFT_MSG_QUERY);
+    msg.set_view(this->view);
+    msg.set_query_id(query_id);
+    *msg.mutable_request() = request;
+
+    auto msg_ptr = std::make_shared<bzn::encoded_message>(this->wrap_message(msg));
+    for (const auto& peer : this->current_peers())
+    {
+        if (peer.uuid != this->uuid)
+        {
+            this->node->send_message_str(make_endpoint(peer), msg_ptr);
+        }
+    }
+
+    // the service may be busy executing, so our own answer is read once the caller has let go of pbft_lock...
+    this->io_context->post([weak_this = this->weak_from_this(), query_id, request]()
+    {
+        auto strong_this = weak_this.lock();
+        if (!strong_this)
+        {
+            return;
+        }
+
+        auto response = strong_this->service->query(request).SerializeAsString();
+
+        std::lock_guard<std::mutex> lock(strong_this->pbft_lock);
+
+        if (auto query = strong_this->pending_queries.find(query_id); query != strong_this->pending_queries.end())
+        {
+            query->second.replies[strong_this->uuid] = std::move(response);
+            strong_this->maybe_complete_query(query_id);
+        }
+    });
+}
+
+void
+pbft::handle_query(const pbft_msg& msg, const bzn_envelope& original_msg)
+{
+    // only swarm members query each other; anyone else would have us run reads on their say so...
+    const auto& peers = this->current_peers();
+    if (std::none_of(peers.begin(), peers.end(), [&](const auto& p){ return p.uuid == original_msg.sender(); }))
+    {
+        LOG(error) << "Ignoring query " << msg.query_id() << " from unknown peer " << original_msg.sender();
+        return;
+    }
+
+    if (!is_read_only(msg.request().operation()))
+    {
+        LOG(error) << "Ignoring query that is not read-only from " << original_msg.sender();
+        return;
+    }
+
+    pbft_msg reply;
+    reply.set_type(PBFT_MSG_QUERY_REPLY);
+    reply.set_view(this->view);
+    reply.set_query_id(msg.query_id());
+
+    // likewise answered without holding pbft_lock while the service finishes executing...
+    this->io_context->post([weak_this = this->weak_from_this(), reply, request = msg.request(), sender = original_msg.sender()]() mutable
+    {
+        if (auto strong_this = weak_this.lock())
+        {
+            reply.set_query_response(strong_this->service->query(request).SerializeAsString());
+
+            std::lock_guard<std::mutex> lock(strong_this->pbft_lock);
+            strong_this->send_to_peer(sender, strong_this->wrap_message(reply));
+        }
+    });
+}
+
+void
+pbft::handle_query_reply(const pbft_msg& msg, const bzn_envelope& original_msg)
+{
+    auto query = this->pending_queries.find(msg.query_id());
+
+    if (query == this->pending_queries.end())
+    {
+        LOG(debug) << "Ignoring reply to completed query " << msg.query_id() << " from " << original_msg.sender();
+        return;
+    }
+
+    // anyone can make up uuids, so only replies of swarm members count towards agreement...
+    const auto& peers = this->current_peers();
+    if (std::none_of(peers.begin(), peers.end(), [&](const auto& p){ return p.uuid == original_msg.sender(); }))
+    {
+        LOG(error) << "Ignoring reply to query " << msg.query_id() << " from unknown peer " << original_msg.sender();
+        return;
+    }
+
+    query->second.replies[original_msg.sender()] = msg.query_response();
+
+    this->maybe_complete_query(msg.query_id());
+}
+
+void
+pbft::maybe_complete_query(uint64_t query_id)
+{
+    auto& query = this->pending_queries.at(query_id);
+
+    // a replica that read state it may yet roll back can't vouch for the answer...
+    std::map<std::string, size_t> tally;
+    for (const auto& reply : query.replies)
+    {
+        if (is_final_reply(reply.second))
+        {
+            tally[reply.second]++;
+        }
+    }
+
+    auto best = std::max_element(tally.begin(), tally.end(),
+        [](const auto& lhs, const auto& rhs){ return lhs.second < rhs.second; });
+    const size_t agreeing = (best == tally.end()) ? 0 : best->second;
+
+    if (agreeing >= this->quorum_size())
+    {
+        if (auto session = query.session.lock())
+        {
+            session->send_message(std::make_shared<bzn::encoded_message>(best->first), false);
+        }
+
+        this->pending_queries.erase(query_id);
+        return;
+    }
+
+    // can the outstanding replies still produce a quorum?
+    const size_t outstanding = this->current_peers().size() - std::min(query.replies.size(), this->current_peers().size());
+    if (agreeing + outstanding >= this->quorum_size())
+    {
+        return;
+    }
+
+    LOG(info) << "Replies to read-only request do not match; falling back to ordered execution";
+
+    const auto request = query.request;
+    const auto session = query.session.lock();
+
+    this->pending_queries.erase(query_id);
+
+    this->handle_request(request, session);
+}
+
+void
+pbft::expire_pending_queries()
+{
+    std::lock_guard<std::mutex> lock(this->pbft_lock);
+
+    const auto now = std::chrono::steady_clock::now();
+
+    auto it = this->pending_queries.begin();
+    while (it != this->pending_queries.end())
+    {
+        if (now - it->second.started < HEARTBEAT_INTERVAL)
+        {
+            ++it;
+            continue;
+        }
+
+        LOG(info) << "Read-only request timed out waiting for replies; falling back to ordered execution";
+
+        const auto request = it->second.request;
+        const auto session = it->second.session.lock();
+
+        it = this->pending_queries.erase(it);
+
+        this->handle_request(request, session);
+    }
+}
+
+void
+pbft::forward_request(const pbft_request& request, const std::shared_ptr<session_base>& session)
+{
+    int batch_size;
+    {
+        std::lock_guard<std::mutex> lock(this->forward_lock);
+
+        const uint64_t forward_id = this->next_forward_id++;
+        this->pending_forwards[forward_id] = pending_forward{session, {}, std::chrono::steady_clock::now()};
+
+        auto forwarded = this->forward_batch.add_forwarded_requests();
+        forwarded->set_forward_id(forward_id);
+        *forwarded->mutable_request() = request;
+
+        batch_size = this->forward_batch.forwarded_requests_size();
+    }
+
+    if (batch_size >= MAX_FORWARD_BATCH_SIZE)
+    {
+        // any flush already posted will find nothing left to send...
+        this->flush_forwarded_requests();
+    }
+    else if (batch_size == 1)
+    {
+        this->io_context->post([weak_this = this->weak_from_this()]()
+        {
+            if (auto strong_this = weak_this.lock())
+            {
+                std::lock_guard<std::mutex> lock(strong_this->pbft_lock);
+                strong_this->flush_forwarded_requests();
+            }
+        });
+    }
+}
+
+void
+pbft::flush_forwarded_requests()
+{
+    const auto primary = this->get_primary();
+
+    pbft_msg msg;
+    {
+        std::lock_guard<std::mutex> lock(this->forward_lock);
+
+        if (this->forward_batch.forwarded_requests().empty())
+        {
+            return;
+        }
+
+        msg.Swap(&this->forward_batch);
+
+        for (const auto& forwarded : msg.forwarded_requests())
+        {
+            if (auto it = this->pending_forwards.find(forwarded.forward_id()); it != this->pending_forwards.end())
+            {
+                it->second.primary = primary.uuid;
+            }
+        }
+    }
+
+    msg.set_type(PBFT_MSG_FORWARD);
+
+    LOG(debug) << "Forwarding " << msg.forwarded_requests_size() << " requests to primary " << primary.uuid;
+
+    this->node->send_message_str(make_endpoint(primary), std::make_shared<bzn::encoded_message>(this->wrap_message(msg)));
+}
+
+void
+pbft::handle_forward(const pbft_msg& msg, const bzn_envelope& original_msg)
+{
+    // only swarm members forward; anyone else would have us hold sessions and order requests on their say so...
+    const auto& peers = this->current_peers();
+    if (std::none_of(peers.begin(), peers.end(), [&](const auto& p){ return p.uuid == original_msg.sender(); }))
+    {
+        LOG(error) << "Ignoring " << msg.forwarded_requests_size() << " forwarded requests from unknown peer " << original_msg.sender();
+        return;
+    }
+
+    const auto now = std::chrono::steady_clock::now();
+
+    for (const auto& forwarded : msg.forwarded_requests())
+    {
+        auto session = std::make_shared<forwarded_reply_session>(this->weak_from_this(), original_msg.sender(), forwarded.forward_id());
+        {
+            std::lock_guard<std::mutex> lock(this->forward_lock);
+            this->forwarded_sessions[{original_msg.sender(), forwarded.forward_id()}] = {session, now};
+        }
+
+        this->handle_request(forwarded.request(), session);
+    }
+}
+
+void
+pbft::send_forward_reply(const bzn::uuid_t& peer_uuid, uint64_t forward_id, std::shared_ptr<bzn::encoded_message> reply)
+{
+    if (is_final_reply(*reply))
+    {
+        std::lock_guard<std::mutex> lock(this->forward_lock);
+        this->forwarded_sessions.erase({peer_uuid, forward_id});
+    }
+
+    pbft_msg msg;
+    msg.set_type(PBFT_MSG_FORWARD_REPLY);
+    msg.set_forward_id(forward_id);
+    msg.set_forward_reply(*reply);
+
+    // replies come from the service's threads, or with pbft_lock already held; send once we can take it...
+    this->io_context->post([weak_this = this->weak_from_this(), peer_uuid, msg]()
+    {
+        if (auto strong_this = weak_this.lock())
+        {
+            std::lock_guard<std::mutex> lock(strong_this->pbft_lock);
+            strong_this->send_to_peer(peer_uuid, strong_this->wrap_message(msg));
+        }
+    });
+}
+
+void
+pbft::handle_forward_reply(const pbft_msg& msg, const bzn_envelope& original_msg)
+{
+    std::shared_ptr<bzn::session_base> session;
+    {
+        std::lock_guard<std::mutex> lock(this->forward_lock);
+
+        auto it = this->pending_forwards.find(msg.forward_id());
+        if (it == this->pending_forwards.end() || it->second.primary != original_msg.sender())
+        {
+            LOG(debug) << "Ignoring reply to unknown forwarded request " << msg.forward_id() << " from " << original_msg.sender();
+            return;
+        }
+
+        session = it->second.session.lock();
+
+        if (is_final_reply(msg.forward_reply()))
+        {
+            this->pending_forwards.erase(it);
+        }
+    }
+
+    if (session)
+    {
+        session->send_message(std::make_shared<bzn::encoded_message>(msg.forward_reply()), false);
+    }
+}
+
+void
+pbft::expire_pending_forwards()
+{
+    std::lock_guard<std::mutex> lock(this->forward_lock);
+
+    const auto now = std::chrono::steady_clock::now();
+
+    for (auto it = this->pending_forwards.begin(); it != this->pending_forwards.end();)
+    {
+        it = (now - it->second.started < FORWARDED_REQUEST_TIMEOUT && !it->second.session.expired())
+            ? std::next(it) : this->pending_forwards.erase(it);
+    }
+
+    for (auto it = this->forwarded_sessions.begin(); it != this->forwarded_sessions.end();)
+    {
+        it = (now - it->second.second < FORWARDED_REQUEST_TIMEOUT) ? std::next(it) : this->forwarded_sessions.erase(it);
+    }
 }
 
 uint64_t
@@ -803,6 +1655,8 @@ pbft::get_status()
     status["latest_checkpoint"]["hash"] = this->latest_checkpoint().second;
 
     status["unstable_checkpoints_count"] = uint64_t(this->unstable_checkpoints_count());
+    status["pending_queries_count"] = uint64_t(this->pending_queries.size());
+    status["pending_executions_count"] = uint64_t(this->pending_executions->load());
     status["next_issued_sequence_number"] = this->next_issued_sequence_number;
     status["view"] = this->view;
 
@@ -818,9 +1672,26 @@ pbft::get_status()
         status["peer_index"].append(peer);
     }
 
+    status["metrics"] = this->metrics->to_json();
+
     return status;
 }
 
+void
+pbft::handle_metrics_message(const bzn::json_message& json, std::shared_ptr<bzn::session_base> session)
+{
+    auto response = std::make_shared<bzn::json_message>(json);
+    (*response)["metrics"] = this->metrics->to_json();
+
+    session->send_message(response, false);
+}
+
+const bzn::pbft_metrics&
+pbft::get_metrics() const
+{
+    return *this->metrics;
+}
+
 bool
 pbft::initialize_configuration(const bzn::peers_list_t& peers)
 {
@@ -861,6 +1732,23 @@ pbft::current_peers() const
     return *(this->current_peers_ptr());
 }
 
+void
+pbft::update_authenticated_peers()
+{
+    if (!this->crypto)
+    {
+        return;
+    }
+
+    std::vector<bzn::uuid_t> uuids;
+    for (const auto& peer : this->current_peers())
+    {
+        uuids.push_back(peer.uuid);
+    }
+
+    this->crypto->set_authenticated_peers(uuids);
+}
+
 void
 pbft::broadcast_new_configuration(pbft_configuration::shared_const_ptr config)
 {
@@ -903,6 +1791,7 @@ pbft::move_to_new_configuration(hash_t config_hash)
     {
         this->configurations.set_current(config_hash);
         this->configurations.remove_prior_to(config_hash);
+        this->update_authenticated_peers();
         return true;
     }
 
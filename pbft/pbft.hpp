@@ -20,9 +20,14 @@
 #include <pbft/pbft_failure_detector.hpp>
 #include <pbft/pbft_service_base.hpp>
 #include <pbft/pbft_config_store.hpp>
+#include <pbft/pbft_state_transfer.hpp>
+#include <pbft/pbft_operation_ring.hpp>
+#include <pbft/pbft_client_table.hpp>
+#include <pbft/pbft_metrics.hpp>
 #include <status/status_provider_base.hpp>
 #include <crypto/crypto_base.hpp>
 #include <proto/audit.pb.h>
+#include <atomic>
 #include <mutex>
 #include <gtest/gtest_prod.h>
 
@@ -37,7 +42,6 @@ namespace
 namespace bzn
 {
     using request_hash_t = std::string;
-    using checkpoint_t = std::pair<uint64_t, bzn::hash_t>;
 
     class pbft final : public bzn::pbft_base, public bzn::status_provider_base, public std::enable_shared_from_this<pbft>
     {
@@ -49,6 +53,7 @@ namespace bzn
             , bzn::uuid_t uuid
             , std::shared_ptr<pbft_service_base> service
             , std::shared_ptr<pbft_failure_detector_base> failure_detector
+            , std::shared_ptr<crypto_base> crypto = nullptr
             );
 
         void start() override;
@@ -57,6 +62,8 @@ namespace bzn
 
         void handle_database_message(const bzn::json_message& json, std::shared_ptr<bzn::session_base> session);
 
+        void handle_metrics_message(const bzn::json_message& json, std::shared_ptr<bzn::session_base> session);
+
         size_t outstanding_operations_count() const;
 
         bool is_primary() const override;
@@ -69,6 +76,11 @@ namespace bzn
 
         void set_audit_enabled(bool setting);
 
+        // execute requests once prepared and reply tentatively, rolling them back if the view changes
+        void set_tentative_execution_enabled(bool setting);
+
+        void set_max_clients(size_t max_clients);
+
         checkpoint_t latest_stable_checkpoint() const;
 
         checkpoint_t latest_checkpoint() const;
@@ -83,6 +95,8 @@ namespace bzn
 
         bzn::json_message get_status() override;
 
+        const bzn::pbft_metrics& get_metrics() const;
+
     private:
         std::shared_ptr<pbft_operation> find_operation(uint64_t view, uint64_t sequence, const pbft_request& request);
         std::shared_ptr<pbft_operation> find_operation(const pbft_msg& msg);
@@ -90,11 +104,30 @@ namespace bzn
 
         bool preliminary_filter_msg(const pbft_msg& msg);
 
-        void handle_request(const pbft_request& msg, const bzn::json_message& original_msg, const std::shared_ptr<session_base>& session = nullptr);
+        // order a request if we are primary, or forward it to the primary; needs pbft_lock like anything that issues
+        // a sequence number
+        void handle_request(const pbft_request& msg, const std::shared_ptr<session_base>& session = nullptr);
         void handle_preprepare(const pbft_msg& msg, const bzn_envelope& original_msg);
         void handle_prepare(const pbft_msg& msg, const bzn_envelope& original_msg);
         void handle_commit(const pbft_msg& msg, const bzn_envelope& original_msg);
         void handle_checkpoint(const pbft_msg& msg, const bzn_envelope& original_msg);
+        void handle_get_state(const pbft_msg& msg, const bzn_envelope& original_msg);
+        void handle_set_state(const pbft_msg& msg, const bzn_envelope& original_msg);
+        void handle_query(const pbft_msg& msg, const bzn_envelope& original_msg);
+        void handle_query_reply(const pbft_msg& msg, const bzn_envelope& original_msg);
+        void handle_forward(const pbft_msg& msg, const bzn_envelope& original_msg);
+        void handle_forward_reply(const pbft_msg& msg, const bzn_envelope& original_msg);
+
+        void do_query(const pbft_request& request, const std::shared_ptr<session_base>& session);
+        void maybe_complete_query(uint64_t query_id);
+        void expire_pending_queries();
+
+        // queue a request for the primary; everything queued in one pass of the io_context goes in one message. Both
+        // need pbft_lock
+        void forward_request(const pbft_request& request, const std::shared_ptr<session_base>& session);
+        void flush_forwarded_requests();
+        void send_forward_reply(const bzn::uuid_t& peer_uuid, uint64_t forward_id, std::shared_ptr<bzn::encoded_message> reply);
+        void expire_pending_forwards();
         void handle_join_or_leave(const pbft_membership_msg& msg);
         void handle_config_message(const pbft_msg& msg, const std::shared_ptr<pbft_operation>& op);
 
@@ -104,8 +137,12 @@ namespace bzn
         void do_prepared(const std::shared_ptr<pbft_operation>& op);
         void do_committed(const std::shared_ptr<pbft_operation>& op);
 
+        // run an operation on the service from the io_context, keeping count until it has
+        void post_execution(std::function<void()> execute);
+
         void handle_bzn_message(const bzn_envelope& msg, std::shared_ptr<bzn::session_base> session);
         void handle_membership_message(const bzn_envelope& msg, std::shared_ptr<bzn::session_base> session = nullptr);
+        bzn_envelope make_envelope(const pbft_msg& message);
         bzn::encoded_message wrap_message(const pbft_msg& message, const std::string& debug_info = "");
         bzn::encoded_message wrap_message(const audit_message& message, const std::string& debug_info = "");
         
@@ -115,12 +152,25 @@ namespace bzn
 
         void broadcast(const bzn::encoded_message& message);
 
+        // send to every peer, handing our own copy straight to handle_message rather than through the network
+        void broadcast(const pbft_msg& message);
+
         void handle_audit_heartbeat_timeout(const boost::system::error_code& ec);
 
         void notify_audit_failure_detected();
 
+        // send the commits accumulated since the last batch to the audit channel; needs pbft_lock
+        void flush_audit_commits();
+
         void checkpoint_reached_locally(uint64_t sequence);
         void maybe_stabilize_checkpoint(const checkpoint_t& cp);
+        void maybe_begin_state_transfer(const checkpoint_t& cp);
+        void request_state_manifest();
+        void request_state_chunks();
+        void start_state_transfer_timer();
+        void handle_state_transfer_timeout(const checkpoint_t& cp);
+        void finish_state_transfer();
+        void send_to_peer(const bzn::uuid_t& peer_uuid, const bzn::encoded_message& message);
 
         inline size_t quorum_size() const;
         inline size_t max_faulty_nodes() const;
@@ -132,6 +182,10 @@ namespace bzn
         bool initialize_configuration(const bzn::peers_list_t& peers);
         std::shared_ptr<const std::vector<bzn::peer_address_t>> current_peers_ptr() const;
         const std::vector<bzn::peer_address_t>& current_peers() const;
+
+        // agree the keys for authenticators with the current members
+        void update_authenticated_peers();
+
         void broadcast_new_configuration(pbft_configuration::shared_const_ptr config);
         bool is_configuration_acceptable_in_new_view(hash_t config_hash);
         bool move_to_new_configuration(hash_t config_hash);
@@ -150,10 +204,12 @@ namespace bzn
         std::shared_ptr<pbft_service_base> service;
 
         std::shared_ptr<pbft_failure_detector_base> failure_detector;
+        const std::shared_ptr<bzn::pbft_client_table> client_table = std::make_shared<bzn::pbft_client_table>();
+        const std::shared_ptr<bzn::pbft_metrics> metrics = std::make_shared<bzn::pbft_metrics>();
 
         std::mutex pbft_lock;
 
-        std::map<bzn::operation_key_t, std::shared_ptr<bzn::pbft_operation>> operations;
+        bzn::pbft_operation_ring operations{0, static_cast<size_t>(std::lround(CHECKPOINT_INTERVAL*HIGH_WATER_INTERVAL_IN_CHECKPOINTS))};
         std::map<bzn::log_key_t, bzn::operation_key_t> accepted_preprepares;
 
         std::once_flag start_once;
@@ -162,12 +218,49 @@ namespace bzn
         std::unique_ptr<bzn::asio::steady_timer_base> audit_heartbeat_timer;
 
         bool audit_enabled = true;
+        pbft_commit_batch audit_commits;
+        bool tentative_execution_enabled = false;
 
         checkpoint_t stable_checkpoint{0, INITIAL_CHECKPOINT_HASH};
         std::unordered_map<uuid_t, std::string> stable_checkpoint_proof;
 
         std::set<checkpoint_t> local_unstable_checkpoints;
         std::map<checkpoint_t, std::unordered_map<uuid_t, std::string>> unstable_checkpoint_proofs;
+        std::unique_ptr<pbft_state_transfer> state_transfer;
+        std::unique_ptr<bzn::asio::steady_timer_base> state_transfer_timer; // made once a transfer starts
+
+        // read-only requests executed directly on every replica, awaiting a quorum of matching replies
+        struct pending_query
+        {
+            pbft_request request;
+            std::weak_ptr<bzn::session_base> session;
+            std::unordered_map<uuid_t, std::string> replies;
+            std::chrono::steady_clock::time_point started;
+        };
+
+        std::map<uint64_t, pending_query> pending_queries;
+        uint64_t next_query_id = 1;
+
+        // executions posted and not yet run, shared with the posted tasks and the node's backlog check
+        const std::shared_ptr<std::atomic<size_t>> pending_executions = std::make_shared<std::atomic<size_t>>(0);
+
+        class forwarded_reply_session;
+
+        // requests this backup has passed on to the primary, by forward id, awaiting the primary's reply
+        struct pending_forward
+        {
+            std::weak_ptr<bzn::session_base> session;
+            bzn::uuid_t primary;
+            std::chrono::steady_clock::time_point started;
+        };
+
+        std::mutex forward_lock;
+        pbft_msg forward_batch;
+        std::map<uint64_t, pending_forward> pending_forwards;
+        uint64_t next_forward_id = 1;
+
+        // requests forwarded to us as primary, by forwarding peer and forward id; nothing else holds on to their sessions
+        std::map<std::pair<bzn::uuid_t, uint64_t>, std::pair<std::shared_ptr<forwarded_reply_session>, std::chrono::steady_clock::time_point>> forwarded_sessions;
         pbft_config_store configurations;
 
         FRIEND_TEST(pbft_test, join_request_generates_new_config_preprepare);
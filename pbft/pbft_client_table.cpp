@@ -0,0 +1,366 @@
+// Copyright (C) 2018 Bluzelle
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU Affero General Public License, version 3,
+// as published by the Free Software Foundation.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU Affero General Public License for more details.
+//
+// You should have received a copy of the GNU Affero General Public License
+// along with this program. If not, see <http://www.gnu.org/licenses/>.
+
+#include <pbft/pbft_client_table.hpp>
+#include <proto/database.pb.h>
+#include <openssl/sha.h>
+
+using namespace bzn;
+
+
+// Stands in for the client's session while its request executes: the reply is recorded on the way through, and a
+// retry of the request can take over delivery if the original connection has gone.
+class pbft_client_table::reply_session final : public bzn::session_base
+{
+public:
+    reply_session(std::weak_ptr<pbft_client_table> table, std::string client, uint64_t timestamp, std::weak_ptr<bzn::session_base> target)
+        : timestamp(timestamp)
+        , table(std::move(table))
+        , client(std::move(client))
+        , target(std::move(target))
+    {
+    }
+
+    void start(std::function<void(const json_message&, std::shared_ptr<session_base>)> /*handler*/, bzn::protobuf_handler /*proto_handler*/) override
+    {
+    }
+
+    void send_message(std::shared_ptr<bzn::json_message> msg, bool end_session) override
+    {
+        if (auto session = this->get_target())
+        {
+            session->send_message(std::move(msg), end_session);
+        }
+    }
+
+    void send_message(std::shared_ptr<bzn::encoded_message> msg, bool end_session) override
+    {
+        // a response marked tentative may yet be rolled back, so only the one sent once the request commits is kept...
+        if (auto table = this->table.lock(); table && !is_tentative(*msg))
+        {
+            table->record_reply(this->client, this->timestamp, msg);
+        }
+
+        if (auto session = this->get_target())
+        {
+            session->send_message(std::move(msg), end_session);
+        }
+    }
+
+    void send_datagram(std::shared_ptr<bzn::encoded_message> msg) override
+    {
+        if (auto session = this->get_target())
+        {
+            session->send_datagram(std::move(msg));
+        }
+    }
+
+    void close() override
+    {
+        if (auto session = this->get_target())
+        {
+            session->close();
+        }
+    }
+
+    bzn::session_id get_session_id() override
+    {
+        auto session = this->get_target();
+
+        return session ? session->get_session_id() : 0;
+    }
+
+    void set_target(std::weak_ptr<bzn::session_base> session)
+    {
+        std::lock_guard<std::mutex> lock(this->target_lock);
+
+        this->target = std::move(session);
+    }
+
+    const uint64_t timestamp;
+
+private:
+    static bool is_tentative(const bzn::encoded_message& msg)
+    {
+        database_response response;
+
+        return response.ParseFromString(msg) && response.tentative();
+    }
+
+    std::shared_ptr<bzn::session_base> get_target()
+    {
+        std::lock_guard<std::mutex> lock(this->target_lock);
+
+        return this->target.lock();
+    }
+
+    const std::weak_ptr<pbft_client_table> table;
+    const std::string client;
+
+    std::mutex target_lock;
+    std::weak_ptr<bzn::session_base> target;
+};
+
+
+pbft_client_table::pbft_client_table(size_t max_clients)
+    : max_clients(std::max<size_t>(max_clients, 1))
+{
+}
+
+
+bool
+pbft_client_table::is_duplicate(const pbft_request& request, const std::shared_ptr<bzn::session_base>& session,
+    std::shared_ptr<bzn::encoded_message>& reply)
+{
+    if (request.client().empty())
+    {
+        return false;
+    }
+
+    std::lock_guard<std::mutex> lock(this->lock);
+
+    const auto& key = request.client();
+
+    auto it = this->clients.find(key);
+    if (it == this->clients.end() || it->second.timestamp != request.timestamp() || it->second.digest != request_digest(request))
+    {
+        return false;
+    }
+
+    reply = it->second.reply;
+
+    // still executing, so the retry's connection should get the reply...
+    if (auto executing_it = this->executing.find(key); executing_it != this->executing.end() && session)
+    {
+        executing_it->second->set_target(session);
+    }
+
+    return true;
+}
+
+
+std::shared_ptr<bzn::session_base>
+pbft_client_table::record_ordered(const pbft_request& request, std::shared_ptr<bzn::session_base> session)
+{
+    if (request.client().empty())
+    {
+        return session;
+    }
+
+    std::lock_guard<std::mutex> lock(this->lock);
+
+    auto& client = this->find_or_add(request.client());
+    this->reset(client, request, request_digest(request));
+
+    auto wrapper = std::make_shared<reply_session>(weak_from_this(), *client.key, request.timestamp(), session);
+    this->executing[*client.key] = wrapper;
+
+    return wrapper;
+}
+
+
+void
+pbft_client_table::record_executed(const pbft_request& request, uint64_t sequence)
+{
+    if (request.client().empty())
+    {
+        return;
+    }
+
+    std::lock_guard<std::mutex> lock(this->lock);
+
+    const auto& key = request.client();
+
+    if (auto it = this->executing.find(key); it != this->executing.end() && it->second->timestamp == request.timestamp())
+    {
+        this->executing.erase(it);
+    }
+
+    // requests can be executed without having been ordered here, e.g. on a backup...
+    auto& client = this->find_or_add(key);
+    const auto digest = request_digest(request);
+    if (client.timestamp != request.timestamp() || client.digest != digest)
+    {
+        this->reset(client, request, digest);
+    }
+
+    this->unlink(client);
+    client.executed_sequence = sequence;
+    this->link_newest(client);
+
+    this->forget_clients();
+}
+
+
+void
+pbft_client_table::set_max_clients(size_t max_clients)
+{
+    std::lock_guard<std::mutex> lock(this->lock);
+
+    this->max_clients = std::max<size_t>(max_clients, 1);
+    this->forget_clients();
+}
+
+
+pbft_client_table::entry&
+pbft_client_table::find_or_add(const std::string& key)
+{
+    auto it = this->clients.try_emplace(key).first;
+
+    // the map's own copy of the key, which stays put for as long as the entry does...
+    it->second.key = &it->first;
+
+    return it->second;
+}
+
+
+void
+pbft_client_table::reset(entry& client, const pbft_request& request, const digest_t& digest)
+{
+    this->unlink(client);
+
+    if (client.reply)
+    {
+        --this->reply_count;
+        client.reply = nullptr;
+    }
+
+    client.timestamp = request.timestamp();
+    client.digest = digest;
+    client.executed_sequence = 0;
+}
+
+
+void
+pbft_client_table::link_newest(entry& client)
+{
+    client.older = this->newest;
+    client.newer = nullptr;
+    (this->newest ? this->newest->newer : this->oldest) = &client;
+    this->newest = &client;
+}
+
+
+void
+pbft_client_table::unlink(entry& client)
+{
+    if (!client.executed_sequence)
+    {
+        return;
+    }
+
+    (client.older ? client.older->newer : this->oldest) = client.newer;
+    (client.newer ? client.newer->older : this->newest) = client.older;
+    client.older = client.newer = nullptr;
+    client.executed_sequence = 0;
+}
+
+
+void
+pbft_client_table::erase(entry& client)
+{
+    this->unlink(client);
+
+    if (client.reply)
+    {
+        --this->reply_count;
+    }
+
+    this->clients.erase(*client.key);
+}
+
+
+void
+pbft_client_table::forget_clients()
+{
+    // clients still executing aren't in the execution order, and are kept...
+    while (this->oldest && this->clients.size() > this->max_clients)
+    {
+        this->erase(*this->oldest);
+    }
+}
+
+
+void
+pbft_client_table::record_reply(const std::string& client, uint64_t timestamp, std::shared_ptr<bzn::encoded_message> reply)
+{
+    std::lock_guard<std::mutex> lock(this->lock);
+
+    if (auto it = this->clients.find(client); it != this->clients.end() && it->second.timestamp == timestamp && !it->second.reply)
+    {
+        it->second.reply = std::move(reply);
+        ++this->reply_count;
+    }
+}
+
+
+void
+pbft_client_table::rolled_back(const pbft_request& request)
+{
+    if (request.client().empty())
+    {
+        return;
+    }
+
+    std::lock_guard<std::mutex> lock(this->lock);
+
+    const auto& key = request.client();
+
+    if (auto it = this->executing.find(key); it != this->executing.end() && it->second->timestamp == request.timestamp())
+    {
+        this->executing.erase(it);
+    }
+
+    // unless the client has moved on to a newer request since...
+    if (auto it = this->clients.find(key); it != this->clients.end() && it->second.timestamp == request.timestamp()
+        && it->second.digest == request_digest(request))
+    {
+        this->erase(it->second);
+    }
+}
+
+
+size_t
+pbft_client_table::clients_count() const
+{
+    std::lock_guard<std::mutex> lock(this->lock);
+
+    return this->clients.size();
+}
+
+
+size_t
+pbft_client_table::cached_replies_count() const
+{
+    std::lock_guard<std::mutex> lock(this->lock);
+
+    return this->reply_count;
+}
+
+
+pbft_client_table::digest_t
+pbft_client_table::request_digest(const pbft_request& request)
+{
+    const std::string serialized = request.SerializeAsString();
+
+    static_assert(std::tuple_size<digest_t>::value == SHA256_DIGEST_LENGTH);
+
+    digest_t digest;
+    SHA256_CTX context;
+    SHA256_Init(&context);
+    SHA256_Update(&context, serialized.data(), serialized.size());
+    SHA256_Final(digest.data(), &context);
+
+    return digest;
+}
@@ -0,0 +1,124 @@
+// Copyright (C) 2018 Bluzelle
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU Affero General Public License, version 3,
+// as published by the Free Software Foundation.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU Affero General Public License for more details.
+//
+// You should have received a copy of the GNU Affero General Public License
+// along with this program. If not, see <http://www.gnu.org/licenses/>.
+
+#pragma once
+
+#include <include/bluzelle.hpp>
+#include <node/session_base.hpp>
+#include <proto/pbft.pb.h>
+#include <array>
+#include <memory>
+#include <mutex>
+#include <unordered_map>
+
+
+namespace bzn
+{
+    using hash_t = std::string;
+
+    // Remembers the last request ordered for each client (KEP-328/329) so a retry of it is not ordered again. The
+    // final reply to the request (not one marked tentative) is cached until the client sends a newer request, so a
+    // client whose reply was lost can always get it by retrying. At most max_clients clients are remembered,
+    // forgetting those whose requests executed longest ago first. Each client's id is held once, as its key; the
+    // execution order that clients are forgotten in links the entries.
+    class pbft_client_table final : public std::enable_shared_from_this<pbft_client_table>
+    {
+    public:
+        static const size_t DEFAULT_MAX_CLIENTS = 1000000;
+
+        explicit pbft_client_table(size_t max_clients = DEFAULT_MAX_CLIENTS);
+
+        /**
+         * Check whether a request is a retry of the last one ordered for its client
+         * @param request   the request
+         * @param session   session of the retry, which will receive the reply if the request is still executing
+         * @param reply     set to the cached reply if the request has executed and it is still available
+         * @return true if the request must not be ordered again
+         */
+        bool is_duplicate(const pbft_request& request, const std::shared_ptr<bzn::session_base>& session,
+            std::shared_ptr<bzn::encoded_message>& reply);
+
+        /**
+         * Record that a request has been ordered
+         * @param request   the request
+         * @param session   session waiting for the reply
+         * @return session to attach to the operation, which captures the reply on its way to the client
+         */
+        std::shared_ptr<bzn::session_base> record_ordered(const pbft_request& request, std::shared_ptr<bzn::session_base> session);
+
+        void record_executed(const pbft_request& request, uint64_t sequence);
+
+        // forget a request whose tentative execution was rolled back, so that a retry of it is ordered again
+        void rolled_back(const pbft_request& request);
+
+        // change how many clients are remembered, forgetting some at once if there are more
+        void set_max_clients(size_t max_clients);
+
+        size_t clients_count() const;
+
+        size_t cached_replies_count() const;
+
+    private:
+        class reply_session;
+
+        using digest_t = std::array<uint8_t, 32>;
+
+        struct entry
+        {
+            uint64_t timestamp = 0;
+            digest_t digest{};
+            uint64_t executed_sequence = 0; // 0 while executing
+            std::shared_ptr<bzn::encoded_message> reply;
+
+            // the client's key in the table, and its neighbours in execution order once executed
+            const std::string* key = nullptr;
+            entry* older = nullptr;
+            entry* newer = nullptr;
+        };
+
+        static digest_t request_digest(const pbft_request& request);
+
+        void record_reply(const std::string& client, uint64_t timestamp, std::shared_ptr<bzn::encoded_message> reply);
+
+        // the client's entry, made empty if there is none; needs lock
+        entry& find_or_add(const std::string& key);
+
+        // start the client over on a new request, taking it out of the execution order; needs lock
+        void reset(entry& client, const pbft_request& request, const digest_t& digest);
+
+        // needs lock
+        void link_newest(entry& client);
+        void unlink(entry& client);
+        void erase(entry& client);
+
+        // forget clients that executed longest ago while there are too many; needs lock
+        void forget_clients();
+
+        size_t max_clients;
+
+        mutable std::mutex lock;
+
+        std::unordered_map<std::string, entry> clients;
+
+        // reply sessions of requests still executing, by client
+        std::unordered_map<std::string, std::shared_ptr<reply_session>> executing;
+
+        // executed clients, oldest first
+        entry* oldest = nullptr;
+        entry* newest = nullptr;
+
+        size_t reply_count = 0;
+    };
+
+} // namespace bzn
@@ -13,6 +13,9 @@
 // along with this program. If not, see <http://www.gnu.org/licenses/>.
 
 #include <pbft/pbft_failure_detector.hpp>
+#include <boost/algorithm/hex.hpp>
+#include <openssl/sha.h>
+#include <algorithm>
 
 namespace
 {
@@ -21,15 +24,18 @@ namespace
 
 using namespace bzn;
 
-pbft_failure_detector::pbft_failure_detector(std::shared_ptr<bzn::asio::io_context_base> io_context)
+pbft_failure_detector::pbft_failure_detector(std::shared_ptr<bzn::asio::io_context_base> io_context, size_t completed_request_window)
         : io_context(std::move(io_context))
         , request_progress_timer(this->io_context->make_unique_steady_timer())
+        , completed_request_window(std::max<size_t>(completed_request_window, 1))
 {
+    this->completed_requests.reserve(this->completed_request_window);
 }
 
 void
 pbft_failure_detector::start_timer()
 {
+    this->timer_running = true;
     this->request_progress_timer->expires_from_now(operation_timeout);
     this->request_progress_timer->async_wait(std::bind(&pbft_failure_detector::handle_timeout, shared_from_this(), std::placeholders::_1));
 }
@@ -39,24 +45,31 @@ pbft_failure_detector::handle_timeout(boost::system::error_code /*ec*/)
 {
     std::lock_guard<std::mutex> lock(this->lock);
 
-    if (this->completed_requests.count(pbft_operation::request_hash(this->ordered_requests.front())) == 0)
+    // anything no longer outstanding has been executed, whether or not we still remember it...
+    if (!this->ordered_requests.empty() && this->outstanding_requests.count(this->ordered_requests.front()) > 0)
     {
-        LOG(error) << "Failure detector detected unexecuted request " << this->ordered_requests.front().ShortDebugString() << '\n';
+        LOG(error) << "Failure detector detected unexecuted request " << boost::algorithm::hex(this->ordered_requests.front()) << '\n';
         this->start_timer();
         this->io_context->post(std::bind(this->failure_handler));
         return;
     }
 
     while (this->ordered_requests.size() > 0 &&
-           this->completed_requests.count(pbft_operation::request_hash(this->ordered_requests.front())) > 0)
+           this->outstanding_requests.count(this->ordered_requests.front()) == 0)
     {
         this->ordered_requests.pop_front();
     }
 
+    this->admit_waiting_requests();
+
     if (this->ordered_requests.size() > 0)
     {
         this->start_timer();
     }
+    else
+    {
+        this->timer_running = false;
+    }
 }
 
 void
@@ -64,15 +77,40 @@ pbft_failure_detector::request_seen(const pbft_request& req)
 {
     std::lock_guard<std::mutex> lock(this->lock);
 
-    hash_t req_hash = pbft_operation::request_hash(req);
+    hash_t req_hash = request_digest(req);
 
     if (this->outstanding_requests.count(req_hash) == 0 && this->completed_requests.count(req_hash) == 0)
     {
+        if (this->ordered_requests.size() >= this->completed_request_window || !this->waiting_order.empty())
+        {
+            if (this->waiting_requests.count(req_hash) > 0)
+            {
+                return;
+            }
+
+            // a flood of requests (or of made up ones) mustn't grow what's held, nor keep the requests after it from
+            // ever being timed; the oldest waiting make way, and the front of what's timed already shows whether the
+            // primary makes progress...
+            if (this->waiting_order.size() >= this->completed_request_window)
+            {
+                LOG(debug) << "Failure detector dropping oldest request waiting beyond a full queue" << '\n';
+                this->waiting_requests.erase(this->waiting_order.front());
+                this->waiting_order.pop_front();
+            }
+
+            LOG(debug) << "Failure detector queueing request beyond the window " << req.ShortDebugString() << '\n';
+            this->waiting_requests.insert(req_hash);
+            this->waiting_order.emplace_back(std::move(req_hash));
+
+            return;
+        }
+
+
         LOG(debug) << "Failure detector recording new request " << req.ShortDebugString() << '\n';
-        this->ordered_requests.emplace_back(req);
-        this->outstanding_requests.emplace(req_hash);
+        this->ordered_requests.emplace_back(req_hash);
+        this->outstanding_requests.emplace(std::move(req_hash));
 
-        if (this->ordered_requests.size() == 1)
+        if (!this->timer_running)
         {
             this->start_timer();
         }
@@ -80,15 +118,93 @@ pbft_failure_detector::request_seen(const pbft_request& req)
 }
 
 void
-pbft_failure_detector::request_executed(const pbft_request& req)
+pbft_failure_detector::request_executed(const pbft_request& req, uint64_t sequence)
 {
     std::lock_guard<std::mutex> lock(this->lock);
 
-    hash_t req_hash = pbft_operation::request_hash(req);
+    hash_t req_hash = request_digest(req);
 
     this->outstanding_requests.erase(req_hash);
-    this->completed_requests.emplace(req_hash);
-    // TODO KEP-538: Need to garbage collect completed_requests eventually
+
+    if (this->waiting_requests.erase(req_hash) > 0)
+    {
+        this->waiting_order.erase(std::find(this->waiting_order.begin(), this->waiting_order.end(), req_hash));
+    }
+
+    // executed requests at the front no longer need timing, and would otherwise hold their place until the timeout...
+    while (!this->ordered_requests.empty() && this->outstanding_requests.count(this->ordered_requests.front()) == 0)
+    {
+        this->ordered_requests.pop_front();
+    }
+
+    this->admit_waiting_requests();
+
+    if (this->completed_requests.emplace(req_hash).second)
+    {
+        this->completed_order.emplace_back(sequence, std::move(req_hash));
+    }
+
+    // checkpoints should keep us inside the window, but don't grow without bound if they stall...
+    while (this->completed_order.size() > this->completed_request_window)
+    {
+        this->completed_requests.erase(this->completed_order.front().second);
+        this->completed_order.pop_front();
+    }
+}
+
+void
+pbft_failure_detector::admit_waiting_requests()
+{
+    while (this->ordered_requests.size() < this->completed_request_window && !this->waiting_order.empty())
+    {
+        auto req_hash = std::move(this->waiting_order.front());
+        this->waiting_order.pop_front();
+        this->waiting_requests.erase(req_hash);
+
+        this->ordered_requests.emplace_back(req_hash);
+        this->outstanding_requests.emplace(std::move(req_hash));
+    }
+
+    if (!this->ordered_requests.empty() && !this->timer_running)
+    {
+        this->start_timer();
+    }
+}
+
+void
+pbft_failure_detector::stable_checkpoint_reached(uint64_t sequence)
+{
+    std::lock_guard<std::mutex> lock(this->lock);
+
+    while (!this->completed_order.empty() && this->completed_order.front().first <= sequence)
+    {
+        this->completed_requests.erase(this->completed_order.front().second);
+        this->completed_order.pop_front();
+    }
+}
+
+size_t
+pbft_failure_detector::tracked_requests_count()
+{
+    std::lock_guard<std::mutex> lock(this->lock);
+
+    return this->ordered_requests.size() + this->outstanding_requests.size() + this->completed_requests.size()
+        + this->waiting_order.size() + this->waiting_requests.size();
+}
+
+bzn::hash_t
+pbft_failure_detector::request_digest(const pbft_request& req)
+{
+    const std::string serialized = req.SerializeAsString();
+
+    // the one-shot SHA256() looks the digest up again on every call; this is on the path of every message...
+    unsigned char digest[SHA256_DIGEST_LENGTH];
+    SHA256_CTX context;
+    SHA256_Init(&context);
+    SHA256_Update(&context, serialized.data(), serialized.size());
+    SHA256_Final(digest, &context);
+
+    return bzn::hash_t(reinterpret_cast<const char*>(digest), sizeof(digest));
 }
 
 void
@@ -17,6 +17,8 @@
 #include <pbft/pbft_failure_detector_base.hpp>
 #include <include/boost_asio_beast.hpp>
 #include <pbft/pbft_operation.hpp>
+#include <deque>
+#include <unordered_set>
 
 namespace bzn
 {
@@ -24,27 +26,52 @@ namespace bzn
     class pbft_failure_detector : public std::enable_shared_from_this<pbft_failure_detector>, public bzn::pbft_failure_detector_base
     {
     public:
-        pbft_failure_detector(std::shared_ptr<bzn::asio::io_context_base>);
+        // completed_request_window should cover the sequences between the low and high water marks; requests are
+        // remembered by digest until a stable checkpoint passes them, and never more than the window at once. No
+        // more than that many are timed at once either; up to as many again seen beyond it wait in turn until there's
+        // room, and beyond that the oldest waiting are dropped to make way for newer ones
+        pbft_failure_detector(std::shared_ptr<bzn::asio::io_context_base>, size_t completed_request_window = DEFAULT_COMPLETED_REQUEST_WINDOW);
 
         void request_seen(const pbft_request& req) override;
 
-        void request_executed(const pbft_request& req) override;
+        void request_executed(const pbft_request& req, uint64_t sequence) override;
+
+        void stable_checkpoint_reached(uint64_t sequence) override;
 
         void register_failure_handler(std::function<void()> handler) override;
 
+        size_t tracked_requests_count();
+
+        static constexpr size_t DEFAULT_COMPLETED_REQUEST_WINDOW = 200;
+
     private:
 
         void start_timer();
         void handle_timeout(boost::system::error_code ec);
 
+        // time waiting requests while there's room in the window; needs lock
+        void admit_waiting_requests();
+
+        static bzn::hash_t request_digest(const pbft_request& req);
+
         std::shared_ptr<bzn::asio::io_context_base> io_context;
 
         std::unique_ptr<bzn::asio::steady_timer_base> request_progress_timer;
+        bool timer_running = false;
+
+        const size_t completed_request_window;
 
-        std::list<pbft_request> ordered_requests;
+        std::deque<bzn::hash_t> ordered_requests;
         std::unordered_set<bzn::hash_t> outstanding_requests;
         std::unordered_set<bzn::hash_t> completed_requests;
 
+        // requests seen while the window was full, in order, until there's room for them or they execute
+        std::deque<bzn::hash_t> waiting_order;
+        std::unordered_set<bzn::hash_t> waiting_requests;
+
+        // sequence each completed request executed at, oldest first
+        std::deque<std::pair<uint64_t, bzn::hash_t>> completed_order;
+
         std::function<void()> failure_handler;
 
         std::mutex lock;
@@ -26,7 +26,10 @@ namespace bzn
 
         virtual void request_seen(const pbft_request& req) = 0;
 
-        virtual void request_executed(const pbft_request& req) = 0;
+        virtual void request_executed(const pbft_request& req, uint64_t sequence) = 0;
+
+        // requests executed at or below a stable checkpoint can no longer be seen again, so their records are dropped
+        virtual void stable_checkpoint_reached(uint64_t sequence) = 0;
 
         virtual void register_failure_handler(std::function<void()> handler) = 0;
 
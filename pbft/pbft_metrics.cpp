@@ -0,0 +1,297 @@
+// Copyright (C) 2018 Bluzelle
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU Affero General Public License, version 3,
+// as published by the Free Software Foundation.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU Affero General Public License for more details.
+//
+// You should have received a copy of the GNU Affero General Public License
+// along with this program. If not, see <http://www.gnu.org/licenses/>.
+
+#include <pbft/pbft_metrics.hpp>
+#include <cmath>
+
+using namespace bzn;
+
+namespace
+{
+    const std::string COUNT_KEY{"count"};
+    const std::string MEAN_KEY{"mean_us"};
+    const std::string MAX_KEY{"max_us"};
+    const std::string PER_SECOND_KEY{"per_second"};
+    const std::string PHASES_KEY{"phases"};
+    const std::string MESSAGES_KEY{"messages"};
+    const std::string REQUESTS_KEY{"requests"};
+
+    const std::vector<std::pair<std::string, double>> PERCENTILES{
+        {"p50_us", 0.5}, {"p90_us", 0.9}, {"p99_us", 0.99}, {"p999_us", 0.999}};
+
+    int64_t
+    to_ticks(const std::chrono::steady_clock::time_point& time)
+    {
+        return std::chrono::duration_cast<std::chrono::nanoseconds>(time.time_since_epoch()).count();
+    }
+}
+
+
+void
+latency_histogram::record(std::chrono::nanoseconds latency)
+{
+    const uint64_t micros = std::max<int64_t>(std::chrono::duration_cast<std::chrono::microseconds>(latency).count(), 0);
+
+    this->buckets[bucket_index(micros)].fetch_add(1, std::memory_order_relaxed);
+    this->total_count.fetch_add(1, std::memory_order_relaxed);
+    this->total_micros.fetch_add(micros, std::memory_order_relaxed);
+
+    auto current_max = this->max_micros.load(std::memory_order_relaxed);
+    while (micros > current_max && !this->max_micros.compare_exchange_weak(current_max, micros, std::memory_order_relaxed));
+}
+
+
+uint64_t
+latency_histogram::count() const
+{
+    return this->total_count.load(std::memory_order_relaxed);
+}
+
+
+std::chrono::microseconds
+latency_histogram::percentile(double fraction) const
+{
+    const auto count = this->count();
+    if (!count)
+    {
+        return std::chrono::microseconds(0);
+    }
+
+    const auto target = std::max<uint64_t>(1, uint64_t(std::ceil(fraction * count)));
+
+    uint64_t seen = 0;
+    for (size_t i = 0; i < BUCKETS; ++i)
+    {
+        seen += this->buckets[i].load(std::memory_order_relaxed);
+        if (seen >= target)
+        {
+            // no sense reporting more than was ever recorded...
+            return std::chrono::microseconds(std::min(bucket_upper_bound(i), this->max_micros.load(std::memory_order_relaxed)));
+        }
+    }
+
+    return this->max();
+}
+
+
+std::chrono::microseconds
+latency_histogram::max() const
+{
+    return std::chrono::microseconds(this->max_micros.load(std::memory_order_relaxed));
+}
+
+
+bzn::json_message
+latency_histogram::to_json() const
+{
+    bzn::json_message json;
+
+    const auto count = this->count();
+
+    json[COUNT_KEY] = count;
+    json[MEAN_KEY] = count ? this->total_micros.load(std::memory_order_relaxed) / count : 0;
+
+    for (const auto& p : PERCENTILES)
+    {
+        json[p.first] = int64_t(this->percentile(p.second).count());
+    }
+
+    json[MAX_KEY] = int64_t(this->max().count());
+
+    return json;
+}
+
+
+size_t
+latency_histogram::bucket_index(uint64_t micros)
+{
+    if (micros < SUB_BUCKETS)
+    {
+        return micros;
+    }
+
+    const size_t exponent = 63 - __builtin_clzll(micros);
+    if (exponent > MAX_EXPONENT)
+    {
+        return BUCKETS - 1;
+    }
+
+    const size_t sub_bucket = (micros >> (exponent - SUB_BUCKET_BITS)) - SUB_BUCKETS;
+
+    return SUB_BUCKETS + (exponent - SUB_BUCKET_BITS) * SUB_BUCKETS + sub_bucket;
+}
+
+
+uint64_t
+latency_histogram::bucket_upper_bound(size_t index)
+{
+    if (index < SUB_BUCKETS)
+    {
+        return index;
+    }
+
+    const size_t shift = (index - SUB_BUCKETS) / SUB_BUCKETS;
+    const uint64_t sub_bucket = (index - SUB_BUCKETS) % SUB_BUCKETS;
+
+    return ((SUB_BUCKETS + sub_bucket + 1) << shift) - 1;
+}
+
+
+pbft_metrics::pbft_metrics(std::chrono::milliseconds rate_window)
+    : started(std::chrono::steady_clock::now())
+    , rate_window(rate_window)
+    , window_start(started)
+{
+}
+
+
+void
+pbft_metrics::message_received(pbft_msg_type type)
+{
+    this->messages[static_cast<size_t>(type) % MESSAGE_TYPES].fetch_add(1, std::memory_order_relaxed);
+}
+
+
+void
+pbft_metrics::request_received()
+{
+    this->requests.fetch_add(1, std::memory_order_relaxed);
+}
+
+
+void
+pbft_metrics::operation_committed(const pbft_operation& op)
+{
+    const auto& times = op.timestamps();
+
+    this->histograms[static_cast<size_t>(phase::preprepare)].record(times.preprepared - times.created);
+    this->histograms[static_cast<size_t>(phase::prepare)].record(times.prepared - times.preprepared);
+    this->histograms[static_cast<size_t>(phase::commit)].record(times.committed - times.prepared);
+
+    // the sequence is written last and checked on both sides of reading the times, like a seqlock...
+    auto& slot = this->committed_slots[op.sequence % COMMITTED_SLOTS];
+    slot.sequence.store(0, std::memory_order_release);
+    slot.created.store(to_ticks(times.created), std::memory_order_relaxed);
+    slot.committed.store(to_ticks(times.committed), std::memory_order_relaxed);
+    slot.sequence.store(op.sequence, std::memory_order_release);
+}
+
+
+void
+pbft_metrics::operation_executed(uint64_t sequence)
+{
+    auto& slot = this->committed_slots[sequence % COMMITTED_SLOTS];
+
+    if (slot.sequence.load(std::memory_order_acquire) != sequence)
+    {
+        return;
+    }
+
+    const auto created = slot.created.load(std::memory_order_relaxed);
+    const auto committed = slot.committed.load(std::memory_order_relaxed);
+
+    if (slot.sequence.exchange(0, std::memory_order_acq_rel) != sequence)
+    {
+        return;
+    }
+
+    const auto now = to_ticks(std::chrono::steady_clock::now());
+
+    this->histograms[static_cast<size_t>(phase::execute)].record(std::chrono::nanoseconds(now - committed));
+    this->histograms[static_cast<size_t>(phase::total)].record(std::chrono::nanoseconds(now - created));
+}
+
+
+const latency_histogram&
+pbft_metrics::histogram(phase p) const
+{
+    return this->histograms[static_cast<size_t>(p)];
+}
+
+
+uint64_t
+pbft_metrics::messages_received(pbft_msg_type type) const
+{
+    return this->messages[static_cast<size_t>(type) % MESSAGE_TYPES].load(std::memory_order_relaxed);
+}
+
+
+bzn::json_message
+pbft_metrics::to_json()
+{
+    bzn::json_message json;
+
+    for (size_t p = 0; p < static_cast<size_t>(phase::count); ++p)
+    {
+        json[PHASES_KEY][phase_name(static_cast<phase>(p))] = this->histograms[p].to_json();
+    }
+
+    std::lock_guard<std::mutex> lock(this->snapshot_lock);
+
+    const auto now = std::chrono::steady_clock::now();
+    const double elapsed = std::max(std::chrono::duration<double>(now - this->window_start).count(), 1e-9);
+
+    // windows only roll over with time, so readers polling at different intervals don't skew each other's rates...
+    if (now - this->window_start >= this->rate_window)
+    {
+        for (size_t type = 0; type < MESSAGE_TYPES; ++type)
+        {
+            const auto count = this->messages[type].load(std::memory_order_relaxed);
+            this->message_rates[type] = (count - this->window_messages[type]) / elapsed;
+            this->window_messages[type] = count;
+        }
+
+        const auto requests = this->requests.load(std::memory_order_relaxed);
+        this->request_rate = (requests - this->window_requests) / elapsed;
+        this->window_requests = requests;
+
+        this->window_start = now;
+        this->have_rates = true;
+    }
+
+    for (size_t type = 0; type < MESSAGE_TYPES; ++type)
+    {
+        if (!pbft_msg_type_IsValid(type) || type == PBFT_MSG_UNDEFINED)
+        {
+            continue;
+        }
+
+        const auto count = this->messages[type].load(std::memory_order_relaxed);
+
+        auto& entry = json[MESSAGES_KEY][pbft_msg_type_Name(static_cast<pbft_msg_type>(type))];
+        entry[COUNT_KEY] = count;
+        entry[PER_SECOND_KEY] = this->have_rates ? this->message_rates[type] : (count - this->window_messages[type]) / elapsed;
+    }
+
+    const auto requests = this->requests.load(std::memory_order_relaxed);
+    json[REQUESTS_KEY][COUNT_KEY] = requests;
+    json[REQUESTS_KEY][PER_SECOND_KEY] = this->have_rates ? this->request_rate : (requests - this->window_requests) / elapsed;
+
+    return json;
+}
+
+
+const char*
+pbft_metrics::phase_name(phase p)
+{
+    switch (p)
+    {
+        case phase::preprepare: return "preprepare";
+        case phase::prepare: return "prepare";
+        case phase::commit: return "commit";
+        case phase::execute: return "execute";
+        case phase::total: return "total";
+        default: return "unknown";
+    }
+}
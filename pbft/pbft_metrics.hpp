@@ -0,0 +1,134 @@
+// Copyright (C) 2018 Bluzelle
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU Affero General Public License, version 3,
+// as published by the Free Software Foundation.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU Affero General Public License for more details.
+//
+// You should have received a copy of the GNU Affero General Public License
+// along with this program. If not, see <http://www.gnu.org/licenses/>.
+
+#pragma once
+
+#include <include/bluzelle.hpp>
+#include <pbft/pbft_operation.hpp>
+#include <proto/pbft.pb.h>
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <mutex>
+
+
+namespace bzn
+{
+    // Latency histogram in the manner of HdrHistogram: each power of two range of microseconds is split into 16
+    // linear sub-buckets, so any recorded value is reported within 1/16 of itself from microseconds up to hours.
+    // Recording is a few relaxed atomic increments and never blocks; readers see a consistent enough picture for
+    // monitoring.
+    class latency_histogram final
+    {
+    public:
+        void record(std::chrono::nanoseconds latency);
+
+        uint64_t count() const;
+
+        // upper bound of the bucket holding the given fraction (0..1] of recorded values
+        std::chrono::microseconds percentile(double fraction) const;
+
+        std::chrono::microseconds max() const;
+
+        bzn::json_message to_json() const;
+
+    private:
+        static const size_t SUB_BUCKET_BITS = 4;
+        static const size_t SUB_BUCKETS = 1 << SUB_BUCKET_BITS;
+        static const size_t MAX_EXPONENT = 40;
+        static const size_t BUCKETS = SUB_BUCKETS + (MAX_EXPONENT - SUB_BUCKET_BITS + 1) * SUB_BUCKETS;
+
+        static size_t bucket_index(uint64_t micros);
+        static uint64_t bucket_upper_bound(size_t index);
+
+        std::array<std::atomic<uint64_t>, BUCKETS> buckets{};
+        std::atomic<uint64_t> total_count{0};
+        std::atomic<uint64_t> total_micros{0};
+        std::atomic<uint64_t> max_micros{0};
+    };
+
+
+    // Where pbft spends its time: latency of each protocol phase of every committed operation, and the rate of
+    // incoming messages of each type. Everything on the recording side is lock-free, as it is called on every
+    // message from the io threads.
+    class pbft_metrics final
+    {
+    public:
+        enum class phase
+        {
+            preprepare,     // operation created until its preprepare was accepted
+            prepare,        // preprepare accepted until prepared
+            commit,         // prepared until committed-local
+            execute,        // committed-local until executed by the service
+            total,          // operation created until executed
+            count
+        };
+
+        // message rates are measured over consecutive windows of this length
+        explicit pbft_metrics(std::chrono::milliseconds rate_window = std::chrono::seconds(10));
+
+        void message_received(pbft_msg_type type);
+
+        void request_received();
+
+        void operation_committed(const pbft_operation& op);
+
+        void operation_executed(uint64_t sequence);
+
+        const latency_histogram& histogram(phase p) const;
+
+        uint64_t messages_received(pbft_msg_type type) const;
+
+        /**
+         * Snapshot of the histograms and counters, with message rates over the last full rate window (or the one
+         * under way, until the first has passed). Taking a snapshot doesn't affect what any other reader sees.
+         * @return json object
+         */
+        bzn::json_message to_json();
+
+    private:
+        static const size_t MESSAGE_TYPES = 16;
+        static const size_t COMMITTED_SLOTS = 4096;
+
+        // committed operations awaiting execution, indexed by sequence; a slot overwritten before its operation
+        // executed just loses that sample
+        struct committed_slot
+        {
+            std::atomic<uint64_t> sequence{0};
+            std::atomic<int64_t> created{0};
+            std::atomic<int64_t> committed{0};
+        };
+
+        static const char* phase_name(phase p);
+
+        std::array<latency_histogram, static_cast<size_t>(phase::count)> histograms;
+        std::array<committed_slot, COMMITTED_SLOTS> committed_slots;
+
+        std::array<std::atomic<uint64_t>, MESSAGE_TYPES> messages{};
+        std::atomic<uint64_t> requests{0};
+
+        const std::chrono::steady_clock::time_point started;
+        const std::chrono::milliseconds rate_window;
+
+        // counts at the start of the current window, and the rates over the last full one
+        std::mutex snapshot_lock;
+        std::chrono::steady_clock::time_point window_start;
+        std::array<uint64_t, MESSAGE_TYPES> window_messages{};
+        uint64_t window_requests = 0;
+        bool have_rates = false;
+        std::array<double, MESSAGE_TYPES> message_rates{};
+        double request_rate = 0;
+    };
+
+} // namespace bzn
@@ -24,11 +24,17 @@ pbft_operation::pbft_operation(uint64_t view, uint64_t sequence, pbft_request re
           , request(std::move(request))
           , peers(std::move(peers))
 {
+    this->times.created = std::chrono::steady_clock::now();
 }
 
 void
 pbft_operation::record_preprepare(const bzn_envelope& /*encoded_preprepare*/)
 {
+    if (!this->preprepare_seen)
+    {
+        this->times.preprepared = std::chrono::steady_clock::now();
+    }
+
     this->preprepare_seen = true;
 }
 
@@ -78,6 +84,7 @@ pbft_operation::begin_commit_phase()
     }
 
     this->state = pbft_operation_state::commit;
+    this->times.prepared = std::chrono::steady_clock::now();
 }
 
 void
@@ -89,6 +96,13 @@ pbft_operation::end_commit_phase()
     }
 
     this->state = pbft_operation_state::committed;
+    this->times.committed = std::chrono::steady_clock::now();
+}
+
+const pbft_operation::timestamps_t&
+pbft_operation::timestamps() const
+{
+    return this->times;
 }
 
 operation_key_t
@@ -17,6 +17,7 @@
 #include <include/bluzelle.hpp>
 #include <proto/pbft.pb.h>
 #include <bootstrap/bootstrap_peers_base.hpp>
+#include <chrono>
 #include <cstdint>
 #include <string>
 #include <node/session_base.hpp>
@@ -39,6 +40,14 @@ namespace bzn
     class pbft_operation
     {
     public:
+        // when the operation was created and when it reached each state, for latency metrics
+        struct timestamps_t
+        {
+            std::chrono::steady_clock::time_point created;
+            std::chrono::steady_clock::time_point preprepared;
+            std::chrono::steady_clock::time_point prepared;
+            std::chrono::steady_clock::time_point committed;
+        };
 
         pbft_operation(uint64_t view, uint64_t sequence, pbft_request msg, std::shared_ptr<const std::vector<peer_address_t>> peers);
 
@@ -61,6 +70,8 @@ namespace bzn
         void begin_commit_phase();
         void end_commit_phase();
 
+        const timestamps_t& timestamps() const;
+
         std::weak_ptr<bzn::session_base> session();
 
         const uint64_t view;
@@ -82,5 +93,7 @@ namespace bzn
 
         std::weak_ptr<bzn::session_base> listener_session;
 
+        timestamps_t times;
+
     };
 }
@@ -0,0 +1,140 @@
+// Copyright (C) 2018 Bluzelle
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU Affero General Public License, version 3,
+// as published by the Free Software Foundation.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU Affero General Public License for more details.
+//
+// You should have received a copy of the GNU Affero General Public License
+// along with this program. If not, see <http://www.gnu.org/licenses/>.
+
+#include <pbft/pbft_operation_ring.hpp>
+
+using namespace bzn;
+
+
+pbft_operation_ring::pbft_operation_ring(uint64_t low_water_mark, size_t capacity)
+    : slots(std::max<size_t>(capacity, 1))
+    , low_water_mark(low_water_mark)
+{
+}
+
+
+std::shared_ptr<pbft_operation>
+pbft_operation_ring::find(uint64_t view, uint64_t sequence, const bzn::hash_t& request_hash) const
+{
+    const slot_t* entries = nullptr;
+
+    if (this->in_window(sequence))
+    {
+        entries = &this->slot(sequence);
+    }
+    else if (auto it = this->overflow.find(sequence); it != this->overflow.end())
+    {
+        entries = &it->second;
+    }
+
+    if (entries)
+    {
+        for (const auto& e : *entries)
+        {
+            if (e.view == view && e.request_hash == request_hash)
+            {
+                return e.op;
+            }
+        }
+    }
+
+    return nullptr;
+}
+
+
+void
+pbft_operation_ring::insert(const std::shared_ptr<pbft_operation>& op, const bzn::hash_t& request_hash)
+{
+    auto& entries = this->in_window(op->sequence) ? this->slot(op->sequence) : this->overflow[op->sequence];
+
+    entries.push_back(entry{op->view, request_hash, op});
+    this->count++;
+}
+
+
+size_t
+pbft_operation_ring::advance(uint64_t new_low_water_mark)
+{
+    if (new_low_water_mark <= this->low_water_mark)
+    {
+        return 0;
+    }
+
+    size_t removed = 0;
+
+    // release the slots leaving the window; past a full lap every slot is being released...
+    const uint64_t last = std::min<uint64_t>(new_low_water_mark, this->low_water_mark + this->slots.size());
+    for (uint64_t sequence = this->low_water_mark + 1; sequence <= last; sequence++)
+    {
+        auto& entries = this->slot(sequence);
+        removed += entries.size();
+        entries.clear();
+    }
+
+    this->low_water_mark = new_low_water_mark;
+
+    // drop stale overflow records and pull in the ones the window now covers...
+    auto it = this->overflow.begin();
+    while (it != this->overflow.end() && it->first <= new_low_water_mark)
+    {
+        removed += it->second.size();
+        it = this->overflow.erase(it);
+    }
+
+    while (it != this->overflow.end() && this->in_window(it->first))
+    {
+        auto& entries = this->slot(it->first);
+        std::move(it->second.begin(), it->second.end(), std::back_inserter(entries));
+        it = this->overflow.erase(it);
+    }
+
+    this->count -= removed;
+
+    return removed;
+}
+
+
+size_t
+pbft_operation_ring::size() const
+{
+    return this->count;
+}
+
+
+uint64_t
+pbft_operation_ring::get_low_water_mark() const
+{
+    return this->low_water_mark;
+}
+
+
+bool
+pbft_operation_ring::in_window(uint64_t sequence) const
+{
+    return sequence > this->low_water_mark && sequence <= this->low_water_mark + this->slots.size();
+}
+
+
+pbft_operation_ring::slot_t&
+pbft_operation_ring::slot(uint64_t sequence)
+{
+    return this->slots[sequence % this->slots.size()];
+}
+
+
+const pbft_operation_ring::slot_t&
+pbft_operation_ring::slot(uint64_t sequence) const
+{
+    return this->slots[sequence % this->slots.size()];
+}
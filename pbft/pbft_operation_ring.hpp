@@ -0,0 +1,68 @@
+// Copyright (C) 2018 Bluzelle
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU Affero General Public License, version 3,
+// as published by the Free Software Foundation.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU Affero General Public License for more details.
+//
+// You should have received a copy of the GNU Affero General Public License
+// along with this program. If not, see <http://www.gnu.org/licenses/>.
+
+#pragma once
+
+#include <pbft/pbft_operation.hpp>
+#include <map>
+#include <memory>
+#include <vector>
+
+namespace bzn
+{
+    // Operation records for the live sequence window (low water mark, low water mark + capacity], stored in a
+    // fixed ring of slots indexed by sequence number. Each slot holds the (usually single) operation per view and
+    // request digest seen for that sequence, so lookups are O(1) and advancing the low water mark only touches the
+    // slots being released. Operations outside the window (e.g. issued by a primary that has run ahead of the high
+    // water mark) are kept in an overflow map until the window reaches them.
+    class pbft_operation_ring
+    {
+    public:
+        pbft_operation_ring(uint64_t low_water_mark, size_t capacity);
+
+        std::shared_ptr<pbft_operation> find(uint64_t view, uint64_t sequence, const bzn::hash_t& request_hash) const;
+
+        // store a new operation record; the caller guarantees it isn't already present
+        void insert(const std::shared_ptr<pbft_operation>& op, const bzn::hash_t& request_hash);
+
+        // discard operations at or below the new low water mark; returns the number removed
+        size_t advance(uint64_t low_water_mark);
+
+        size_t size() const;
+
+        uint64_t get_low_water_mark() const;
+
+    private:
+        struct entry
+        {
+            uint64_t view;
+            bzn::hash_t request_hash;
+            std::shared_ptr<pbft_operation> op;
+        };
+
+        using slot_t = std::vector<entry>;
+
+        bool in_window(uint64_t sequence) const;
+
+        slot_t& slot(uint64_t sequence);
+
+        const slot_t& slot(uint64_t sequence) const;
+
+        std::vector<slot_t> slots;
+        std::map<uint64_t, slot_t> overflow;
+
+        uint64_t low_water_mark;
+        size_t count = 0;
+    };
+}
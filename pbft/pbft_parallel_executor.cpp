@@ -0,0 +1,234 @@
+// Copyright (C) 2018 Bluzelle
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU Affero General Public License, version 3,
+// as published by the Free Software Foundation.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU Affero General Public License for more details.
+//
+// You should have received a copy of the GNU Affero General Public License
+// along with this program. If not, see <http://www.gnu.org/licenses/>.
+
+#include <pbft/pbft_parallel_executor.hpp>
+#include <algorithm>
+#include <map>
+
+using namespace bzn;
+
+
+pbft_parallel_executor::pbft_parallel_executor(size_t thread_count)
+    : thread_count(std::max<size_t>(thread_count ? thread_count : std::thread::hardware_concurrency(), 1))
+    , state(std::make_shared<shared_state>())
+{
+    for (size_t i = 0; i < this->thread_count; ++i)
+    {
+        this->workers.emplace_back(std::bind(&pbft_parallel_executor::run, this->state));
+    }
+}
+
+
+pbft_parallel_executor::~pbft_parallel_executor()
+{
+    {
+        std::lock_guard<std::mutex> lock(this->state->lock);
+        this->state->stopping = true;
+    }
+
+    this->state->work_available.notify_all();
+
+    for (auto& worker : this->workers)
+    {
+        if (worker.get_id() == std::this_thread::get_id())
+        {
+            worker.detach();
+        }
+        else
+        {
+            worker.join();
+        }
+    }
+}
+
+
+void
+pbft_parallel_executor::post(std::function<void()> task)
+{
+    {
+        std::lock_guard<std::mutex> lock(this->state->lock);
+        this->state->tasks.emplace_back(std::move(task));
+    }
+
+    this->state->work_available.notify_one();
+}
+
+
+void
+pbft_parallel_executor::execute(const std::vector<const database_msg*>& requests, const std::function<void(size_t)>& execute_one)
+{
+    struct completion
+    {
+        std::mutex lock;
+        std::condition_variable done;
+        size_t remaining = 0;
+    };
+
+    for (const auto& wave : schedule(requests))
+    {
+        if (wave.size() == 1 || this->thread_count == 1)
+        {
+            std::for_each(wave.begin(), wave.end(), execute_one);
+            continue;
+        }
+
+        auto wave_completion = std::make_shared<completion>();
+        wave_completion->remaining = wave.size() - 1;
+
+        for (size_t i = 1; i < wave.size(); ++i)
+        {
+            this->post([wave_completion, &execute_one, index = wave[i]]()
+            {
+                execute_one(index);
+
+                std::lock_guard<std::mutex> lock(wave_completion->lock);
+                if (--wave_completion->remaining == 0)
+                {
+                    wave_completion->done.notify_all();
+                }
+            });
+        }
+
+        execute_one(wave[0]);
+
+        // help out rather than sit idle until the rest of the wave is done...
+        while (true)
+        {
+            {
+                std::lock_guard<std::mutex> lock(wave_completion->lock);
+                if (wave_completion->remaining == 0)
+                {
+                    break;
+                }
+            }
+
+            if (!run_one(*this->state))
+            {
+                std::unique_lock<std::mutex> lock(wave_completion->lock);
+                wave_completion->done.wait(lock, [&]() { return wave_completion->remaining == 0; });
+            }
+        }
+    }
+}
+
+
+size_t
+pbft_parallel_executor::get_thread_count() const
+{
+    return this->thread_count;
+}
+
+
+std::vector<std::vector<size_t>>
+pbft_parallel_executor::schedule(const std::vector<const database_msg*>& requests)
+{
+    std::vector<std::vector<size_t>> waves;
+
+    // wave (1 based) of the last request touching a key, any key of a db, or all keys of a db...
+    std::map<std::pair<std::string, std::string>, size_t> key_waves;
+    std::map<std::string, size_t> db_any_waves;
+    std::map<std::string, size_t> db_wide_waves;
+    size_t barrier_wave = 0;
+
+    for (size_t i = 0; i < requests.size(); ++i)
+    {
+        const auto& request = *requests[i];
+        const auto& db = request.header().db_uuid();
+
+        const std::string* key = nullptr;
+        switch (request.msg_case())
+        {
+            case database_msg::kCreate: key = &request.create().key(); break;
+            case database_msg::kRead:   key = &request.read().key(); break;
+            case database_msg::kUpdate: key = &request.update().key(); break;
+            case database_msg::kDelete: key = &request.delete_().key(); break;
+            case database_msg::kHas:    key = &request.has().key(); break;
+            default: break;
+        }
+
+        size_t wave;
+
+        if (key)
+        {
+            auto& key_wave = key_waves[{db, *key}];
+            wave = 1 + std::max({barrier_wave, db_wide_waves[db], key_wave});
+            key_wave = wave;
+            db_any_waves[db] = std::max(db_any_waves[db], wave);
+        }
+        else if (request.msg_case() == database_msg::kKeys || request.msg_case() == database_msg::kSize)
+        {
+            wave = 1 + std::max(barrier_wave, db_any_waves[db]);
+            db_wide_waves[db] = wave;
+            db_any_waves[db] = wave;
+        }
+        else
+        {
+            // unknown to us, so it must not overlap with anything...
+            wave = waves.size() + 1;
+            barrier_wave = wave;
+        }
+
+        if (waves.size() < wave)
+        {
+            waves.resize(wave);
+        }
+
+        waves[wave - 1].push_back(i);
+    }
+
+    return waves;
+}
+
+
+void
+pbft_parallel_executor::run(const std::shared_ptr<shared_state>& state)
+{
+    while (true)
+    {
+        {
+            std::unique_lock<std::mutex> lock(state->lock);
+            state->work_available.wait(lock, [&]() { return state->stopping || !state->tasks.empty(); });
+
+            if (state->tasks.empty())
+            {
+                return;
+            }
+        }
+
+        run_one(*state);
+    }
+}
+
+
+bool
+pbft_parallel_executor::run_one(shared_state& state)
+{
+    std::function<void()> task;
+
+    {
+        std::lock_guard<std::mutex> lock(state.lock);
+
+        if (state.tasks.empty())
+        {
+            return false;
+        }
+
+        task = std::move(state.tasks.front());
+        state.tasks.pop_front();
+    }
+
+    task();
+
+    return true;
+}
@@ -0,0 +1,70 @@
+// Copyright (C) 2018 Bluzelle
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU Affero General Public License, version 3,
+// as published by the Free Software Foundation.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU Affero General Public License for more details.
+//
+// You should have received a copy of the GNU Affero General Public License
+// along with this program. If not, see <http://www.gnu.org/licenses/>.
+
+#pragma once
+
+#include <proto/bluzelle.pb.h>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+
+namespace bzn
+{
+    // Executes batches of committed database requests with the same outcome as running them one after another in
+    // sequence order. Each batch is split into waves: a request goes into the wave after the last earlier request
+    // it conflicts with (same db and key, or any key of the db for db-wide requests), so requests within a wave are
+    // independent and run concurrently on the pool while the waves themselves run in order.
+    class pbft_parallel_executor final
+    {
+    public:
+        explicit pbft_parallel_executor(size_t thread_count);
+
+        ~pbft_parallel_executor();
+
+        // run a task on one of the pool's threads
+        void post(std::function<void()> task);
+
+        // call execute_one(i) for every request, returning once all have finished
+        void execute(const std::vector<const database_msg*>& requests, const std::function<void(size_t)>& execute_one);
+
+        size_t get_thread_count() const;
+
+        // indices of the requests in each wave, in execution order
+        static std::vector<std::vector<size_t>> schedule(const std::vector<const database_msg*>& requests);
+
+    private:
+        // owned jointly with the workers so the last reference to the executor may be dropped by one of its tasks
+        struct shared_state
+        {
+            std::mutex lock;
+            std::condition_variable work_available;
+            std::deque<std::function<void()>> tasks;
+            bool stopping = false;
+        };
+
+        static void run(const std::shared_ptr<shared_state>& state);
+
+        static bool run_one(shared_state& state);
+
+        const size_t thread_count;
+        const std::shared_ptr<shared_state> state;
+        std::vector<std::thread> workers;
+    };
+
+} // namespace bzn
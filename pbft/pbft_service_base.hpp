@@ -18,6 +18,8 @@
 #include <include/bluzelle.hpp>
 #include <proto/bluzelle.pb.h>
 #include <pbft/pbft_operation.hpp>
+#include <map>
+#include <vector>
 
 namespace bzn
 {
@@ -37,26 +39,20 @@ namespace bzn
          * - If apply_operation(x, y) is called, then apply_operation(x2, y) will never be called with x != x2
          * - If apply_operation(_, y) is called and y != 0, then apply_operation(_, y-1) will be called at least once
          *     (may be before or after apply_operation(_, y).
-         * - If consolidate_log(y) is called, then no subsequenent call to query(x, y2) will have y2 < y
-         *     (so the service may consolidate all the updates before y into a single version of the service on disk)
          * - consolidate_log(y) is called if forall y2<y, apply_operation(_, y2) has already been called
-         * - After consolidate_log(y) is called, no future call apply_operation(_, y2) or query(_, y2)
-         *     or consolidate_log(y2) will have y2 < y
+         * - After consolidate_log(y) is called, no future call apply_operation(_, y2) or consolidate_log(y2)
+         *     will have y2 < y
+         *     (so the service may consolidate all the updates before y into a single version of the service on disk)
          *
          * Implementation must guarantee:
          * - If apply_operation(x, y) is called with y != 0, the request will not be executed until after the request
          *     supplied in the call apply_operation(x2, y-1).
-         * - When apply_operation(x, y) is called, it will be persisted to disk before the method returns even if
-         *     x cannot yet be executed due to the first constraint
-         * - The result of query(x, y) is the result of applying x against the version of the service where every
-         *   operation with sequence number <= y has been applied, except operations that cannot yet be applied
-         *   due to the first constraint. So, where cp is the last call to consolidate_log(cp) and curr is the last
-         *   executed request sequence number, when query(x, y) is called, assuming the service is crud:
-         *      if y >= curr, use the most up to date version of the key you have applied (still obeying constraint 1)
-         *      if curr > y > cp, use the most up to date version of the key written before y, or the stable checkpoint
-         *        if it hasn't been written to in that interval
-         *      if cp == y, use the version of the key from the stable checkpoint
-         *      if cp > y, the caller has broken a constraint
+         * - When apply_operation(x, y) is called, x will be persisted to disk before it is executed. If x cannot yet
+         *     be executed due to the first constraint it is only held in memory, and is lost if the service restarts
+         *     first; the replica then relies on its peers to recover it, by state transfer once they have a stable
+         *     checkpoint past y
+         * - The result of query(x) is the result of applying x against the most up to date version of the service,
+         *   with every operation applied that can be so far (still obeying the first constraint)
          * - Operations are applied at most once (crud operations are idempotent anyway)
          *
          * Notably not guarenteed:
@@ -71,15 +67,30 @@ namespace bzn
         virtual void apply_operation(const std::shared_ptr<pbft_operation>& op) = 0;
 
         /*
-         * Apply some read-only operation to the history of the service at some particular sequence number (either the
-         * sequence number is >= any the service has seen before because we want the most recent version, or we are
-         * querying some stable checkpoint to introduce a new node).
+         * PBFT has concluded that an operation is prepared, so its place in the order is fixed unless the view
+         * changes. The service may execute it once all earlier operations have been executed and reply to the client
+         * with a response marked tentative; the operation is later confirmed by apply_operation(op). Tentative
+         * executions are not made durable and are never part of a checkpoint's state.
+         */
+        virtual void apply_operation_tentatively(const std::shared_ptr<pbft_operation>& op) = 0;
+
+        /*
+         * Undo every operation executed tentatively that has not been confirmed since, along with anything executed
+         * after it, as the view is changing and the order of those operations may change. Confirmed operations that
+         * were undone are executed again; the requests of the others are returned, as they won't be unless ordered
+         * again.
          */
-        virtual void query(const pbft_request& request, uint64_t sequence_number) const = 0;
+        virtual std::vector<pbft_request> rollback_tentative_operations() = 0;
+
+        /*
+         * Apply some read-only operation to the latest state of the service and return the result, marked tentative if
+         * it was read from state that includes tentatively executed operations.
+         */
+        virtual database_response query(const pbft_request& request) const = 0;
 
         /*
          * Get the hash of the database state (presumably this will be a merkle tree root, but the details don't matter
-         * for now)- same semantics as query
+         * for now) at the checkpoint with the given sequence number
          */
         virtual bzn::hash_t service_state_hash(uint64_t sequence_number) const = 0;
 
@@ -90,10 +101,36 @@ namespace bzn
 
         /*
          * Callback when a request is executed (not committed, since the service is responsible for the difference
-         * between the two). Should only be called once for each sequence number, in strictly increasing order.
+         * between the two). Should only be called once for each sequence number, in strictly increasing order. A
+         * tentative execution is only reported once it can no longer be rolled back.
          */
         virtual void register_execute_handler(bzn::execute_handler_t handler) = 0;
 
+        /*
+         * The service state at a checkpoint is split into a fixed number of chunks so that a lagging replica only
+         * needs to fetch the chunks that differ from its own state. service_state_hash of that sequence number must
+         * be the hash of this list (see pbft_state_transfer::state_hash). Empty if the state at sequence_number is
+         * not available.
+         */
+        virtual std::vector<bzn::hash_t> service_state_chunk_hashes(uint64_t sequence_number) const = 0;
+
+        /*
+         * Serialized chunk of the service state at a checkpoint, or nullptr if it is not available.
+         */
+        virtual std::shared_ptr<std::string> get_service_state_chunk(uint64_t sequence_number, size_t chunk) const = 0;
+
+        /*
+         * Indices of the chunks of our current state that differ from the given chunk hashes.
+         */
+        virtual std::vector<size_t> changed_service_state_chunks(const std::vector<bzn::hash_t>& chunk_hashes) = 0;
+
+        /*
+         * Replace the changed chunks of the current state with ones fetched from peers, making the service state that
+         * of the checkpoint at sequence_number. Execution resumes at sequence_number + 1. Nothing is changed, and
+         * false returned, unless the resulting state would hash to state_hash.
+         */
+        virtual bool set_service_state(uint64_t sequence_number, const bzn::hash_t& state_hash, const std::map<size_t, std::string>& chunks) = 0;
+
     };
 
 }
@@ -0,0 +1,203 @@
+// Copyright (C) 2018 Bluzelle
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU Affero General Public License, version 3,
+// as published by the Free Software Foundation.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU Affero General Public License for more details.
+//
+// You should have received a copy of the GNU Affero General Public License
+// along with this program. If not, see <http://www.gnu.org/licenses/>.
+
+#include <pbft/pbft_state_transfer.hpp>
+#include <openssl/sha.h>
+#include <iomanip>
+#include <sstream>
+
+using namespace bzn;
+
+namespace
+{
+    bzn::hash_t
+    to_hex(const unsigned char* digest, size_t length)
+    {
+        std::stringstream ss;
+        for (size_t i = 0; i < length; ++i)
+        {
+            ss << std::hex << std::setw(2) << std::setfill('0') << int(digest[i]);
+        }
+
+        return ss.str();
+    }
+}
+
+
+pbft_state_transfer::pbft_state_transfer(checkpoint_t checkpoint, std::vector<bzn::uuid_t> sources)
+    : checkpoint(std::move(checkpoint))
+    , sources(std::move(sources))
+{
+}
+
+
+const checkpoint_t&
+pbft_state_transfer::get_checkpoint() const
+{
+    return this->checkpoint;
+}
+
+
+const std::vector<bzn::uuid_t>&
+pbft_state_transfer::get_sources() const
+{
+    return this->sources;
+}
+
+
+bool
+pbft_state_transfer::has_manifest() const
+{
+    return this->manifest_received;
+}
+
+
+const std::vector<bzn::hash_t>&
+pbft_state_transfer::get_manifest() const
+{
+    return this->manifest;
+}
+
+
+bool
+pbft_state_transfer::set_manifest(const std::vector<bzn::hash_t>& chunk_hashes)
+{
+    if (this->manifest_received)
+    {
+        return false;
+    }
+
+    if (chunk_hashes.size() != STATE_CHUNK_COUNT || pbft_state_transfer::state_hash(chunk_hashes) != this->checkpoint.second)
+    {
+        LOG(error) << "Rejecting state manifest that does not match checkpoint at seq " << this->checkpoint.first;
+        return false;
+    }
+
+    this->manifest = chunk_hashes;
+    this->manifest_received = true;
+
+    return true;
+}
+
+
+void
+pbft_state_transfer::set_needed_chunks(const std::vector<size_t>& chunks)
+{
+    this->needed_chunks.clear();
+
+    for (const auto chunk : chunks)
+    {
+        if (chunk < this->manifest.size())
+        {
+            this->needed_chunks.insert(chunk);
+        }
+    }
+}
+
+
+std::map<bzn::uuid_t, std::vector<size_t>>
+pbft_state_transfer::assign_chunks()
+{
+    std::map<bzn::uuid_t, std::vector<size_t>> assignments;
+
+    if (this->sources.empty())
+    {
+        return assignments;
+    }
+
+    for (const auto chunk : this->needed_chunks)
+    {
+        if (this->received_chunks.count(chunk) == 0)
+        {
+            auto source = this->chunk_sources.emplace(chunk, this->next_source % this->sources.size());
+            if (source.second)
+            {
+                ++this->next_source;
+            }
+
+            assignments[this->sources[source.first->second]].push_back(chunk);
+        }
+    }
+
+    return assignments;
+}
+
+
+void
+pbft_state_transfer::move_outstanding_chunks()
+{
+    for (auto& chunk_source : this->chunk_sources)
+    {
+        chunk_source.second = (chunk_source.second + 1) % this->sources.size();
+    }
+}
+
+
+bool
+pbft_state_transfer::add_chunk(size_t index, const std::string& data)
+{
+    if (this->needed_chunks.count(index) == 0)
+    {
+        LOG(debug) << "Ignoring unrequested state chunk " << index;
+        return false;
+    }
+
+    if (pbft_state_transfer::chunk_hash(data) != this->manifest[index])
+    {
+        LOG(error) << "Rejecting state chunk " << index << " that does not match checkpoint at seq " << this->checkpoint.first;
+        return false;
+    }
+
+    this->received_chunks[index] = data;
+    this->chunk_sources.erase(index);
+
+    return true;
+}
+
+
+bool
+pbft_state_transfer::is_complete() const
+{
+    return this->manifest_received && this->received_chunks.size() == this->needed_chunks.size();
+}
+
+
+const std::map<size_t, std::string>&
+pbft_state_transfer::get_chunks() const
+{
+    return this->received_chunks;
+}
+
+
+bzn::hash_t
+pbft_state_transfer::chunk_hash(const std::string& data)
+{
+    unsigned char digest[SHA256_DIGEST_LENGTH];
+    SHA256(reinterpret_cast<const unsigned char*>(data.data()), data.size(), digest);
+
+    return to_hex(digest, sizeof(digest));
+}
+
+
+bzn::hash_t
+pbft_state_transfer::state_hash(const std::vector<bzn::hash_t>& chunk_hashes)
+{
+    std::string manifest;
+    for (const auto& hash : chunk_hashes)
+    {
+        manifest += hash;
+    }
+
+    return pbft_state_transfer::chunk_hash(manifest);
+}
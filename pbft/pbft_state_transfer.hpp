@@ -0,0 +1,90 @@
+// Copyright (C) 2018 Bluzelle
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU Affero General Public License, version 3,
+// as published by the Free Software Foundation.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU Affero General Public License for more details.
+//
+// You should have received a copy of the GNU Affero General Public License
+// along with this program. If not, see <http://www.gnu.org/licenses/>.
+
+#pragma once
+
+#include <include/bluzelle.hpp>
+#include <map>
+#include <set>
+#include <vector>
+
+namespace
+{
+    // number of chunks the service state is divided into for state transfer; only chunks that changed since the last
+    // checkpoint are serialized and hashed again, so the split can be fine enough for a lagging replica to fetch
+    // little more than what changed
+    const size_t STATE_CHUNK_COUNT = 1024;
+}
+
+namespace bzn
+{
+    using hash_t = std::string;
+    using checkpoint_t = std::pair<uint64_t, bzn::hash_t>;
+
+    // Tracks the fetch of a stable checkpoint's service state by a replica that has fallen behind. The state is
+    // divided into chunks; the list of chunk hashes (the manifest) is verified against the checkpoint's state hash,
+    // and each chunk is verified against the manifest, so only data matching the checkpoint proof is accepted.
+    class pbft_state_transfer
+    {
+    public:
+        pbft_state_transfer(checkpoint_t checkpoint, std::vector<bzn::uuid_t> sources);
+
+        const checkpoint_t& get_checkpoint() const;
+
+        const std::vector<bzn::uuid_t>& get_sources() const;
+
+        bool has_manifest() const;
+
+        const std::vector<bzn::hash_t>& get_manifest() const;
+
+        // accept the manifest if it hashes to the checkpoint's state hash
+        bool set_manifest(const std::vector<bzn::hash_t>& chunk_hashes);
+
+        // the chunks that differ from our local state and must be fetched
+        void set_needed_chunks(const std::vector<size_t>& chunks);
+
+        // spread the outstanding chunks across the sources so they are fetched in parallel; a chunk stays with its
+        // source until moved
+        std::map<bzn::uuid_t, std::vector<size_t>> assign_chunks();
+
+        // move each outstanding chunk to the source after the one it was asked of, as that one hasn't answered
+        void move_outstanding_chunks();
+
+        // accept a chunk if it is needed and matches its manifest hash
+        bool add_chunk(size_t index, const std::string& data);
+
+        bool is_complete() const;
+
+        const std::map<size_t, std::string>& get_chunks() const;
+
+        static bzn::hash_t chunk_hash(const std::string& data);
+
+        static bzn::hash_t state_hash(const std::vector<bzn::hash_t>& chunk_hashes);
+
+    private:
+        const checkpoint_t checkpoint;
+        const std::vector<bzn::uuid_t> sources;
+
+        std::vector<bzn::hash_t> manifest;
+        bool manifest_received = false;
+
+        std::set<size_t> needed_chunks;
+        std::map<size_t, std::string> received_chunks;
+
+        // index into sources of the one each outstanding chunk was asked of
+        std::map<size_t, size_t> chunk_sources;
+        size_t next_source = 0;
+    };
+
+} // namespace bzn
@@ -15,8 +15,11 @@
 #include <mocks/mock_storage_base.hpp>
 #include <mocks/mock_session_base.hpp>
 #include <pbft/database_pbft_service.hpp>
+#include <pbft/pbft.hpp>
 #include <storage/mem_storage.hpp>
 #include <mocks/mock_crud_base.hpp>
+#include <crud/crud.hpp>
+#include <numeric>
 
 using namespace ::testing;
 
@@ -24,6 +27,17 @@ namespace
 {
     const std::string TEST_UUID{"uuid"};
     const std::string DEFAULT_NEXT_REQUEST_SEQUENCE{"1"};
+
+    std::shared_ptr<bzn::pbft_operation>
+    make_create_operation(uint64_t sequence, const std::string& key, const std::string& value)
+    {
+        pbft_request msg;
+        msg.mutable_operation()->mutable_header()->set_db_uuid(TEST_UUID);
+        msg.mutable_operation()->mutable_create()->set_key(key);
+        msg.mutable_operation()->mutable_create()->set_value(value);
+
+        return std::make_shared<bzn::pbft_operation>(0, sequence, msg, nullptr);
+    }
 }
 
 
@@ -33,7 +47,9 @@ TEST(database_pbft_service, test_that_on_construction_if_next_request_sequence_d
 
     EXPECT_CALL(*mock_storage, read(_, _)).WillOnce(Return(std::optional<bzn::value_t>()));
     EXPECT_CALL(*mock_storage, create(_, _, DEFAULT_NEXT_REQUEST_SEQUENCE)).WillOnce(Return(bzn::storage_base::result::ok));
-    EXPECT_CALL(*mock_storage, update(_, _, DEFAULT_NEXT_REQUEST_SEQUENCE)).WillOnce(Return(bzn::storage_base::result::ok));
+
+    // nothing is written on shutdown...
+    EXPECT_CALL(*mock_storage, update(_, _, _)).Times(0);
 
     bzn::database_pbft_service dps(std::make_shared<bzn::asio::Mockio_context_base>(), mock_storage, std::make_shared<bzn::Mockcrud_base>(), TEST_UUID);
 }
@@ -44,7 +60,7 @@ TEST(database_pbft_service, test_that_on_construction_if_next_request_sequence_e
     auto mock_storage = std::make_shared<bzn::Mockstorage_base>();
 
     EXPECT_CALL(*mock_storage, read(_, _)).WillOnce(Return(std::optional<bzn::value_t>("123")));
-    EXPECT_CALL(*mock_storage, update(_, _, "123")).WillOnce(Return(bzn::storage_base::result::ok));
+    EXPECT_CALL(*mock_storage, update(_, _, _)).Times(0);
 
     bzn::database_pbft_service dps(std::make_shared<bzn::asio::Mockio_context_base>(), mock_storage, std::make_shared<bzn::Mockcrud_base>(), TEST_UUID);
 }
@@ -70,9 +86,10 @@ TEST(database_pbft_service, test_that_failed_storing_of_operation_throws)
 
     bzn::database_pbft_service dps(std::make_shared<bzn::asio::Mockio_context_base>(), mock_storage, std::make_shared<bzn::Mockcrud_base>(), TEST_UUID);
 
-    EXPECT_CALL(*mock_storage, create(_, _, _)).WillOnce(Return(bzn::storage_base::result::exists));
-    EXPECT_CALL(*mock_storage, update(_, _, _)).WillOnce(Return(bzn::storage_base::result::ok));
+    EXPECT_CALL(*mock_storage, create(_, _, _)).WillRepeatedly(Return(bzn::storage_base::result::exists));
+    EXPECT_CALL(*mock_storage, update(_, _, _)).WillRepeatedly(Return(bzn::storage_base::result::ok));
 
+    // every committed operation is stored before it executes, and the strict crud mock fails if it does...
     pbft_request msg;
     auto operation = std::make_shared<bzn::pbft_operation>(0, 1, msg, nullptr);
 
@@ -158,3 +175,570 @@ TEST(database_pbft_service, test_that_stored_operation_is_executed_in_order_and_
 
     ASSERT_EQ(uint64_t(3), dps.applied_requests_count());
 }
+
+
+TEST(database_pbft_service, test_that_a_batch_is_logged_as_one_record_before_executing_and_its_sequence_saved_once_after)
+{
+    auto mock_storage = std::make_shared<bzn::Mockstorage_base>();
+    auto mock_io_context = std::make_shared<NiceMock<bzn::asio::Mockio_context_base>>();
+    auto mock_crud = std::make_shared<NiceMock<bzn::Mockcrud_base>>();
+
+    EXPECT_CALL(*mock_storage, read(_, _)).WillOnce(Return(std::optional<bzn::value_t>("1")));
+    EXPECT_CALL(*mock_storage, get_keys(_)).WillOnce(Return(std::vector<bzn::key_t>{}));
+
+    bzn::database_pbft_service dps(mock_io_context, mock_storage, mock_crud, TEST_UUID);
+
+    EXPECT_CALL(*mock_storage, has(_, _)).Times(0);
+
+    {
+        InSequence dummy;
+
+        // requests waiting on an earlier one are written with it...
+        EXPECT_CALL(*mock_storage, create(TEST_UUID, "1", _)).WillOnce(Invoke(
+            [](auto, auto, const bzn::value_t& value)
+            {
+                pbft_request_log_entry entry;
+                EXPECT_TRUE(entry.ParseFromString(value));
+                EXPECT_EQ(3, entry.requests_size());
+
+                for (int i = 0; i < entry.requests_size(); ++i)
+                {
+                    EXPECT_EQ(uint64_t(i + 1), entry.requests(i).sequence());
+                }
+
+                return bzn::storage_base::result::ok;
+            }));
+
+        EXPECT_CALL(*mock_crud, handle_request(_, _)).Times(3);
+        EXPECT_CALL(*mock_storage, update(_, _, "4")).WillOnce(Return(bzn::storage_base::result::ok));
+    }
+
+    // the executed record goes at the next checkpoint, not on shutdown...
+    EXPECT_CALL(*mock_storage, remove(_, _)).Times(0);
+
+    pbft_request msg;
+    for (uint64_t sequence = 3; sequence >= 1; --sequence)
+    {
+        dps.apply_operation(std::make_shared<bzn::pbft_operation>(0, sequence, msg, nullptr));
+    }
+
+    EXPECT_EQ(uint64_t(3), dps.applied_requests_count());
+}
+
+
+TEST(database_pbft_service, test_that_operation_interrupted_by_a_restart_is_executed_again)
+{
+    auto mem_storage = std::make_shared<bzn::mem_storage>();
+    auto mock_io_context = std::make_shared<NiceMock<bzn::asio::Mockio_context_base>>();
+    auto mock_crud = std::make_shared<NiceMock<bzn::Mockcrud_base>>();
+
+    pbft_request msg;
+    msg.mutable_operation()->mutable_create()->set_key("key1");
+
+    {
+        bzn::database_pbft_service dps(mock_io_context, mem_storage, mock_crud, TEST_UUID);
+
+        // the node goes down while executing the request...
+        EXPECT_CALL(*mock_crud, handle_request(_, _)).WillOnce(Throw(std::runtime_error("crashed")));
+        EXPECT_THROW(dps.apply_operation(std::make_shared<bzn::pbft_operation>(0, 1, msg, nullptr)), std::runtime_error);
+    }
+
+    EXPECT_TRUE(mem_storage->has(TEST_UUID, "1"));
+    EXPECT_EQ("1", *mem_storage->read(TEST_UUID, "next_request_sequence"));
+
+    {
+        InSequence dummy;
+
+        EXPECT_CALL(*mock_crud, handle_request(_, _)).WillOnce(Invoke(
+            [](const database_msg& request, auto)
+            {
+                EXPECT_EQ(request.create().key(), "key1");
+            }));
+
+        EXPECT_CALL(*mock_crud, handle_request(_, _)).WillOnce(Invoke(
+            [](const database_msg& request, auto)
+            {
+                EXPECT_EQ(request.create().key(), "key2");
+            }));
+    }
+
+    bzn::database_pbft_service dps(mock_io_context, mem_storage, mock_crud, TEST_UUID);
+
+    msg.mutable_operation()->mutable_create()->set_key("key2");
+    dps.apply_operation(std::make_shared<bzn::pbft_operation>(0, 2, msg, nullptr));
+
+    EXPECT_EQ(uint64_t(2), dps.applied_requests_count());
+}
+
+
+TEST(database_pbft_service, test_that_waiting_operations_are_not_kept_across_a_restart)
+{
+    auto mem_storage = std::make_shared<bzn::mem_storage>();
+    auto mock_io_context = std::make_shared<NiceMock<bzn::asio::Mockio_context_base>>();
+    auto mock_crud = std::make_shared<NiceMock<bzn::Mockcrud_base>>();
+
+    pbft_request msg;
+    msg.mutable_operation()->mutable_create()->set_key("key2");
+
+    {
+        bzn::database_pbft_service dps(mock_io_context, mem_storage, mock_crud, TEST_UUID);
+        dps.apply_operation(std::make_shared<bzn::pbft_operation>(0, 2, msg, nullptr));
+        EXPECT_EQ(uint64_t(0), dps.applied_requests_count());
+    }
+
+    // held in memory until its batch executes; peers and state transfer make up for it after a restart...
+    EXPECT_FALSE(mem_storage->has(TEST_UUID, "2"));
+
+    bzn::database_pbft_service dps(mock_io_context, mem_storage, mock_crud, TEST_UUID);
+
+    EXPECT_CALL(*mock_crud, handle_request(_, _)).WillOnce(Invoke(
+        [](const database_msg& request, auto)
+        {
+            EXPECT_EQ(request.create().key(), "key1");
+        }));
+
+    msg.mutable_operation()->mutable_create()->set_key("key1");
+    dps.apply_operation(std::make_shared<bzn::pbft_operation>(0, 1, msg, nullptr));
+
+    EXPECT_EQ(uint64_t(1), dps.applied_requests_count());
+}
+
+
+TEST(database_pbft_service, test_that_tentative_operation_waiting_behind_a_gap_is_not_replayed_after_restart)
+{
+    auto mem_storage = std::make_shared<bzn::mem_storage>();
+    auto mock_io_context = std::make_shared<NiceMock<bzn::asio::Mockio_context_base>>();
+    auto mock_crud = std::make_shared<NiceMock<bzn::Mockcrud_base>>();
+
+    pbft_request msg;
+    msg.mutable_operation()->mutable_create()->set_key("key2");
+
+    {
+        bzn::database_pbft_service dps(mock_io_context, mem_storage, mock_crud, TEST_UUID);
+        dps.apply_operation_tentatively(std::make_shared<bzn::pbft_operation>(0, 2, msg, nullptr));
+        EXPECT_EQ(uint64_t(0), dps.applied_requests_count());
+    }
+
+    EXPECT_FALSE(mem_storage->has(TEST_UUID, "2"));
+
+    bzn::database_pbft_service dps(mock_io_context, mem_storage, mock_crud, TEST_UUID);
+
+    // only the request that committed is executed; the one at 2 was never committed...
+    EXPECT_CALL(*mock_crud, handle_request(_, _)).WillOnce(Invoke(
+        [](const database_msg& request, auto)
+        {
+            EXPECT_EQ(request.create().key(), "key1");
+        }));
+
+    msg.mutable_operation()->mutable_create()->set_key("key1");
+    dps.apply_operation(std::make_shared<bzn::pbft_operation>(0, 1, msg, nullptr));
+
+    EXPECT_EQ(uint64_t(1), dps.applied_requests_count());
+}
+
+TEST(database_pbft_service, test_that_request_logged_on_its_own_by_an_older_version_is_loaded)
+{
+    auto mem_storage = std::make_shared<bzn::mem_storage>();
+    auto mock_io_context = std::make_shared<NiceMock<bzn::asio::Mockio_context_base>>();
+    auto mock_crud = std::make_shared<NiceMock<bzn::Mockcrud_base>>();
+
+    pbft_request msg;
+    msg.mutable_operation()->mutable_create()->set_key("key1");
+    msg.set_timestamp(123);
+
+    mem_storage->create(TEST_UUID, "1", msg.SerializeAsString());
+
+    {
+        InSequence dummy;
+
+        EXPECT_CALL(*mock_crud, handle_request(_, _)).WillOnce(Invoke(
+            [](const database_msg& request, auto)
+            {
+                EXPECT_EQ(request.create().key(), "key1");
+            }));
+
+        EXPECT_CALL(*mock_crud, handle_request(_, _)).WillOnce(Invoke(
+            [](const database_msg& request, auto)
+            {
+                EXPECT_EQ(request.create().key(), "key2");
+            }));
+    }
+
+    bzn::database_pbft_service dps(mock_io_context, mem_storage, mock_crud, TEST_UUID);
+
+    msg.mutable_operation()->mutable_create()->set_key("key2");
+    dps.apply_operation(std::make_shared<bzn::pbft_operation>(0, 2, msg, nullptr));
+
+    EXPECT_EQ(uint64_t(2), dps.applied_requests_count());
+}
+
+
+TEST(database_pbft_service, test_that_set_service_state_loads_chunks_and_skips_covered_requests)
+{
+    auto mem_storage = std::make_shared<bzn::mem_storage>();
+    auto mock_io_context = std::make_shared<bzn::asio::Mockio_context_base>();
+    auto mock_crud = std::make_shared<bzn::Mockcrud_base>();
+
+    bzn::database_pbft_service dps(mock_io_context, mem_storage, mock_crud, TEST_UUID);
+
+    EXPECT_CALL(*mock_crud, load_state_chunk(3, STATE_CHUNK_COUNT, "chunk 3")).WillOnce(Return(true));
+    EXPECT_CALL(*mock_crud, save_state()).Times(2).WillRepeatedly(Return(true));
+    EXPECT_CALL(*mock_crud, get_saved_state_chunk(_, STATE_CHUNK_COUNT)).WillRepeatedly(Invoke(
+        [](auto, auto)
+        {
+            return std::make_shared<std::string>("data");
+        }));
+
+    std::vector<bzn::hash_t> expected(STATE_CHUNK_COUNT, bzn::pbft_state_transfer::chunk_hash("data"));
+    expected[3] = bzn::pbft_state_transfer::chunk_hash("chunk 3");
+
+    ASSERT_TRUE(dps.set_service_state(CHECKPOINT_INTERVAL, bzn::pbft_state_transfer::state_hash(expected), {{3, "chunk 3"}}));
+
+    EXPECT_EQ(CHECKPOINT_INTERVAL, dps.applied_requests_count());
+    EXPECT_EQ(STATE_CHUNK_COUNT, dps.service_state_chunk_hashes(CHECKPOINT_INTERVAL).size());
+    EXPECT_EQ(bzn::pbft_state_transfer::state_hash(std::vector<bzn::hash_t>(STATE_CHUNK_COUNT, bzn::pbft_state_transfer::chunk_hash("data"))),
+        dps.service_state_hash(CHECKPOINT_INTERVAL));
+    EXPECT_TRUE(dps.service_state_chunk_hashes(CHECKPOINT_INTERVAL - 1).empty());
+}
+
+
+
+TEST(database_pbft_service, test_that_state_not_making_up_the_checkpoint_is_not_loaded)
+{
+    auto mock_io_context = std::make_shared<NiceMock<bzn::asio::Mockio_context_base>>();
+    auto source_crud = std::make_shared<bzn::crud>(std::make_shared<bzn::mem_storage>(), nullptr);
+    auto target_storage = std::make_shared<bzn::mem_storage>();
+    auto target_crud = std::make_shared<bzn::crud>(target_storage, nullptr);
+
+    bzn::database_pbft_service source(mock_io_context, std::make_shared<bzn::mem_storage>(), source_crud, TEST_UUID);
+    bzn::database_pbft_service target(mock_io_context, std::make_shared<bzn::mem_storage>(), target_crud, TEST_UUID);
+
+    for (uint64_t sequence = 1; sequence <= CHECKPOINT_INTERVAL; ++sequence)
+    {
+        source.apply_operation(make_create_operation(sequence, "key" + std::to_string(sequence), "value"));
+    }
+
+    const auto state_hash = source.service_state_hash(CHECKPOINT_INTERVAL);
+    ASSERT_FALSE(state_hash.empty());
+
+    std::map<size_t, std::string> chunks;
+    for (const auto index : target.changed_service_state_chunks(source.service_state_chunk_hashes(CHECKPOINT_INTERVAL)))
+    {
+        chunks[index] = *source.get_service_state_chunk(CHECKPOINT_INTERVAL, index);
+    }
+
+    ASSERT_FALSE(chunks.empty());
+
+    // nothing is touched unless the chunks make up the checkpoint's state...
+    EXPECT_FALSE(target.set_service_state(CHECKPOINT_INTERVAL, "not the state hash", chunks));
+    EXPECT_EQ(0u, target.applied_requests_count());
+    EXPECT_FALSE(target_storage->has(TEST_UUID, "key1"));
+
+    EXPECT_TRUE(target.set_service_state(CHECKPOINT_INTERVAL, state_hash, chunks));
+    EXPECT_EQ(CHECKPOINT_INTERVAL, target.applied_requests_count());
+    EXPECT_TRUE(target_storage->has(TEST_UUID, "key1"));
+    EXPECT_EQ(state_hash, target.service_state_hash(CHECKPOINT_INTERVAL));
+}
+
+
+TEST(database_pbft_service, test_that_chunks_already_loaded_are_restored_if_a_later_one_fails)
+{
+    auto mem_storage = std::make_shared<bzn::mem_storage>();
+    auto mock_io_context = std::make_shared<bzn::asio::Mockio_context_base>();
+    auto mock_crud = std::make_shared<bzn::Mockcrud_base>();
+
+    bzn::database_pbft_service dps(mock_io_context, mem_storage, mock_crud, TEST_UUID);
+
+    EXPECT_CALL(*mock_crud, save_state()).WillOnce(Return(true));
+    EXPECT_CALL(*mock_crud, get_saved_state_chunk(_, STATE_CHUNK_COUNT)).WillRepeatedly(Invoke(
+        [](auto chunk, auto)
+        {
+            return std::make_shared<std::string>("data " + std::to_string(chunk));
+        }));
+
+    std::vector<bzn::hash_t> expected;
+    for (size_t i = 0; i < STATE_CHUNK_COUNT; ++i)
+    {
+        expected.push_back(bzn::pbft_state_transfer::chunk_hash("data " + std::to_string(i)));
+    }
+    expected[1] = bzn::pbft_state_transfer::chunk_hash("chunk 1");
+    expected[2] = bzn::pbft_state_transfer::chunk_hash("chunk 2");
+
+    {
+        InSequence dummy;
+
+        EXPECT_CALL(*mock_crud, load_state_chunk(1, STATE_CHUNK_COUNT, "chunk 1")).WillOnce(Return(true));
+        EXPECT_CALL(*mock_crud, load_state_chunk(2, STATE_CHUNK_COUNT, "chunk 2")).WillOnce(Return(false));
+        EXPECT_CALL(*mock_crud, load_state_chunk(1, STATE_CHUNK_COUNT, "data 1")).WillOnce(Return(true));
+    }
+
+    EXPECT_FALSE(dps.set_service_state(CHECKPOINT_INTERVAL, bzn::pbft_state_transfer::state_hash(expected), {{1, "chunk 1"}, {2, "chunk 2"}}));
+    EXPECT_EQ(0u, dps.applied_requests_count());
+}
+
+
+TEST(database_pbft_service, test_that_state_hash_of_a_checkpoint_outlives_the_next_checkpoint)
+{
+    auto mock_io_context = std::make_shared<NiceMock<bzn::asio::Mockio_context_base>>();
+    auto crud = std::make_shared<bzn::crud>(std::make_shared<bzn::mem_storage>(), nullptr);
+
+    bzn::database_pbft_service dps(mock_io_context, std::make_shared<bzn::mem_storage>(), crud, TEST_UUID);
+
+    for (uint64_t sequence = 1; sequence <= 2 * CHECKPOINT_INTERVAL; ++sequence)
+    {
+        dps.apply_operation(make_create_operation(sequence, "key" + std::to_string(sequence), "value"));
+    }
+
+    // pbft may only get round to the first checkpoint once execution has passed the second...
+    EXPECT_FALSE(dps.service_state_hash(CHECKPOINT_INTERVAL).empty());
+    EXPECT_FALSE(dps.service_state_hash(2 * CHECKPOINT_INTERVAL).empty());
+    EXPECT_NE(dps.service_state_hash(CHECKPOINT_INTERVAL), dps.service_state_hash(2 * CHECKPOINT_INTERVAL));
+
+    // though only the latest state can be served...
+    EXPECT_TRUE(dps.service_state_chunk_hashes(CHECKPOINT_INTERVAL).empty());
+    EXPECT_EQ(STATE_CHUNK_COUNT, dps.service_state_chunk_hashes(2 * CHECKPOINT_INTERVAL).size());
+}
+
+
+TEST(database_pbft_service, test_that_parallel_execution_applies_every_operation_in_order_per_key)
+{
+    const uint64_t OPERATIONS = 3 * CHECKPOINT_INTERVAL;
+
+    auto mem_storage = std::make_shared<bzn::mem_storage>();
+    auto mock_io_context = std::make_shared<NiceMock<bzn::asio::Mockio_context_base>>();
+    auto mock_crud = std::make_shared<NiceMock<bzn::Mockcrud_base>>();
+
+    std::mutex lock;
+    std::map<std::string, std::vector<std::string>> values_by_key;
+    std::vector<uint64_t> executed_sequences;
+
+    EXPECT_CALL(*mock_crud, handle_request(_, _)).WillRepeatedly(Invoke(
+        [&](const database_msg& request, auto)
+        {
+            std::lock_guard<std::mutex> guard(lock);
+            values_by_key[request.update().key()].push_back(request.update().value());
+        }));
+
+    // the execute handler is posted in sequence order...
+    EXPECT_CALL(*mock_io_context, post(_)).WillRepeatedly(Invoke(
+        [&](auto handler)
+        {
+            handler();
+        }));
+
+    auto dps = std::make_shared<bzn::database_pbft_service>(mock_io_context, mem_storage, mock_crud, TEST_UUID, 4);
+    dps->register_execute_handler([&](const pbft_request&, uint64_t sequence)
+        {
+            std::lock_guard<std::mutex> guard(lock);
+            executed_sequences.push_back(sequence);
+        });
+
+    for (uint64_t sequence = 1; sequence <= OPERATIONS; ++sequence)
+    {
+        pbft_request msg;
+        msg.mutable_operation()->mutable_header()->set_db_uuid(TEST_UUID);
+        msg.mutable_operation()->mutable_update()->set_key("key" + std::to_string(sequence % 7));
+        msg.mutable_operation()->mutable_update()->set_value(std::to_string(sequence));
+
+        dps->apply_operation(std::make_shared<bzn::pbft_operation>(0, sequence, msg, nullptr));
+    }
+
+    for (size_t i = 0; i < 500 && dps->applied_requests_count() < OPERATIONS; ++i)
+    {
+        std::this_thread::sleep_for(std::chrono::milliseconds(10));
+    }
+
+    ASSERT_EQ(OPERATIONS, dps->applied_requests_count());
+
+    std::lock_guard<std::mutex> guard(lock);
+
+    std::vector<uint64_t> expected(OPERATIONS);
+    std::iota(expected.begin(), expected.end(), 1);
+    EXPECT_EQ(expected, executed_sequences);
+
+    for (const auto& key : values_by_key)
+    {
+        EXPECT_TRUE(std::is_sorted(key.second.begin(), key.second.end(),
+            [](const auto& a, const auto& b) { return std::stoul(a) < std::stoul(b); }));
+    }
+}
+
+
+TEST(database_pbft_service, test_that_tentative_reply_is_marked_and_sent_again_on_commit)
+{
+    auto mock_io_context = std::make_shared<NiceMock<bzn::asio::Mockio_context_base>>();
+    auto crud = std::make_shared<bzn::crud>(std::make_shared<bzn::mem_storage>(), nullptr);
+
+    bzn::database_pbft_service dps(mock_io_context, std::make_shared<bzn::mem_storage>(), crud, TEST_UUID);
+
+    auto mock_session = std::make_shared<bzn::Mocksession_base>();
+    std::vector<database_response> replies;
+
+    EXPECT_CALL(*mock_session, send_message(Matcher<std::shared_ptr<bzn::encoded_message>>(_), false)).Times(2).WillRepeatedly(Invoke(
+        [&](auto msg, auto)
+        {
+            replies.emplace_back();
+            EXPECT_TRUE(replies.back().ParseFromString(*msg));
+        }));
+
+    auto operation = make_create_operation(1, "key", "value");
+    operation->set_session(mock_session);
+
+    dps.apply_operation_tentatively(operation);
+
+    EXPECT_EQ(uint64_t(1), dps.applied_requests_count());
+    ASSERT_EQ(1u, replies.size());
+    EXPECT_TRUE(replies[0].tentative());
+
+    dps.apply_operation(operation);
+
+    EXPECT_EQ(uint64_t(1), dps.applied_requests_count());
+    ASSERT_EQ(2u, replies.size());
+    EXPECT_FALSE(replies[1].tentative());
+    EXPECT_EQ(replies[0].header().db_uuid(), replies[1].header().db_uuid());
+}
+
+
+TEST(database_pbft_service, test_that_execute_handler_is_called_once_per_request_when_it_can_no_longer_be_rolled_back)
+{
+    auto mock_io_context = std::make_shared<NiceMock<bzn::asio::Mockio_context_base>>();
+    auto crud = std::make_shared<bzn::crud>(std::make_shared<bzn::mem_storage>(), nullptr);
+
+    EXPECT_CALL(*mock_io_context, post(_)).WillRepeatedly(Invoke(
+        [](auto handler)
+        {
+            handler();
+        }));
+
+    auto dps = std::make_shared<bzn::database_pbft_service>(mock_io_context, std::make_shared<bzn::mem_storage>(), crud, TEST_UUID);
+
+    std::vector<uint64_t> executed;
+    dps->register_execute_handler([&](const pbft_request&, uint64_t sequence)
+        {
+            executed.push_back(sequence);
+        });
+
+    auto operation1 = make_create_operation(1, "key1", "value");
+    auto operation2 = make_create_operation(2, "key2", "value");
+    auto operation3 = make_create_operation(3, "key3", "value");
+
+    dps->apply_operation_tentatively(operation1);
+    dps->apply_operation_tentatively(operation2);
+    dps->apply_operation(operation3);
+
+    EXPECT_EQ(uint64_t(3), dps->applied_requests_count());
+    EXPECT_TRUE(executed.empty());
+
+    // 2 is still tentative, so 3 waits for it along with it...
+    dps->apply_operation(operation1);
+    EXPECT_EQ(std::vector<uint64_t>({1}), executed);
+
+    // rolled back and executed again once committed, but reported just the once...
+    dps->rollback_tentative_operations();
+    EXPECT_EQ(std::vector<uint64_t>({1}), executed);
+
+    dps->apply_operation(operation2);
+    EXPECT_EQ(std::vector<uint64_t>({1, 2, 3}), executed);
+}
+
+TEST(database_pbft_service, test_that_query_of_state_including_tentative_requests_is_marked_tentative)
+{
+    auto mock_io_context = std::make_shared<NiceMock<bzn::asio::Mockio_context_base>>();
+    auto crud = std::make_shared<bzn::crud>(std::make_shared<bzn::mem_storage>(), nullptr);
+
+    bzn::database_pbft_service dps(mock_io_context, std::make_shared<bzn::mem_storage>(), crud, TEST_UUID);
+
+    pbft_request read;
+    read.mutable_operation()->mutable_header()->set_db_uuid(TEST_UUID);
+    read.mutable_operation()->mutable_read()->set_key("key");
+
+    auto operation = make_create_operation(1, "key", "value");
+    dps.apply_operation_tentatively(operation);
+
+    auto response = dps.query(read);
+    EXPECT_EQ("value", response.read().value());
+    EXPECT_TRUE(response.tentative());
+
+    dps.apply_operation(operation);
+
+    response = dps.query(read);
+    EXPECT_EQ("value", response.read().value());
+    EXPECT_FALSE(response.tentative());
+}
+
+TEST(database_pbft_service, test_that_rollback_undoes_tentative_requests_and_reexecutes_committed_ones)
+{
+    auto mock_io_context = std::make_shared<NiceMock<bzn::asio::Mockio_context_base>>();
+    auto storage = std::make_shared<bzn::mem_storage>();
+    auto crud = std::make_shared<bzn::crud>(storage, nullptr);
+
+    bzn::database_pbft_service dps(mock_io_context, std::make_shared<bzn::mem_storage>(), crud, TEST_UUID);
+
+    dps.apply_operation(make_create_operation(1, "key1", "committed"));
+    dps.apply_operation_tentatively(make_create_operation(2, "key2", "tentative"));
+    dps.apply_operation_tentatively(make_create_operation(3, "key1", "overwritten?"));
+
+    pbft_request update;
+    update.mutable_operation()->mutable_header()->set_db_uuid(TEST_UUID);
+    update.mutable_operation()->mutable_update()->set_key("key1");
+    update.mutable_operation()->mutable_update()->set_value("updated");
+    auto operation4 = std::make_shared<bzn::pbft_operation>(0, 4, update, nullptr);
+
+    // committed, but after a request that is still tentative...
+    dps.apply_operation_tentatively(operation4);
+    dps.apply_operation(operation4);
+
+    EXPECT_EQ(uint64_t(4), dps.applied_requests_count());
+    EXPECT_EQ("updated", *storage->read(TEST_UUID, "key1"));
+    EXPECT_TRUE(storage->has(TEST_UUID, "key2"));
+
+    const auto rolled_back = dps.rollback_tentative_operations();
+
+    // 2 and 3 only executed tentatively, so they are handed back to be ordered again...
+    ASSERT_EQ(rolled_back.size(), 2u);
+    EXPECT_EQ(rolled_back[0].operation().create().key(), "key1");
+    EXPECT_EQ(rolled_back[1].operation().create().key(), "key2");
+
+    // back to the state after the last request committed in order; 4 waits for the new 2 and 3...
+    EXPECT_EQ(uint64_t(1), dps.applied_requests_count());
+    EXPECT_EQ("committed", *storage->read(TEST_UUID, "key1"));
+    EXPECT_FALSE(storage->has(TEST_UUID, "key2"));
+
+    dps.apply_operation(make_create_operation(2, "key3", "value3"));
+    dps.apply_operation(make_create_operation(3, "key4", "value4"));
+
+    EXPECT_EQ(uint64_t(4), dps.applied_requests_count());
+    EXPECT_EQ("updated", *storage->read(TEST_UUID, "key1"));
+    EXPECT_FALSE(storage->has(TEST_UUID, "key2"));
+    EXPECT_TRUE(storage->has(TEST_UUID, "key3"));
+    EXPECT_TRUE(storage->has(TEST_UUID, "key4"));
+}
+
+
+TEST(database_pbft_service, test_that_checkpoint_state_only_includes_committed_requests)
+{
+    auto mock_io_context = std::make_shared<NiceMock<bzn::asio::Mockio_context_base>>();
+    auto crud = std::make_shared<bzn::crud>(std::make_shared<bzn::mem_storage>(), nullptr);
+
+    bzn::database_pbft_service dps(mock_io_context, std::make_shared<bzn::mem_storage>(), crud, TEST_UUID);
+
+    for (uint64_t sequence = 1; sequence < CHECKPOINT_INTERVAL - 1; ++sequence)
+    {
+        dps.apply_operation(make_create_operation(sequence, "key" + std::to_string(sequence), "value"));
+    }
+
+    auto before_checkpoint = make_create_operation(CHECKPOINT_INTERVAL - 1, "before", "value");
+    auto checkpoint = make_create_operation(CHECKPOINT_INTERVAL, "checkpoint", "value");
+
+    // the request before the checkpoint may run tentatively, but the checkpoint waits for it to commit...
+    dps.apply_operation_tentatively(before_checkpoint);
+    dps.apply_operation(checkpoint);
+
+    EXPECT_EQ(CHECKPOINT_INTERVAL - 1, dps.applied_requests_count());
+    EXPECT_TRUE(dps.service_state_chunk_hashes(CHECKPOINT_INTERVAL).empty());
+
+    dps.apply_operation(before_checkpoint);
+
+    EXPECT_EQ(CHECKPOINT_INTERVAL, dps.applied_requests_count());
+    EXPECT_EQ(STATE_CHUNK_COUNT, dps.service_state_chunk_hashes(CHECKPOINT_INTERVAL).size());
+}
@@ -15,34 +15,73 @@
 
 namespace bzn::test
 {
-    TEST_F(pbft_test, test_local_commit_sends_audit_messages)
+    TEST_F(pbft_test, test_local_commits_are_audited_in_batches)
     {
         EXPECT_CALL(*mock_node, send_message_str(_, ResultOf(is_audit, Eq(false))))
                 .Times(AnyNumber());
-        EXPECT_CALL(*mock_node, send_message_str(_, ResultOf(is_audit, Eq(true))))
-                .Times(Exactly(TEST_PEER_LIST.size()));
 
         this->build_pbft();
         this->pbft->set_audit_enabled(true);
 
-        bzn_envelope dummy_original_msg;
-        pbft_msg preprepare = pbft_msg(this->preprepare_msg);
-        preprepare.set_sequence(1);
-        this->pbft->handle_message(preprepare, dummy_original_msg);
+        // nothing is sent per commit...
+        EXPECT_CALL(*mock_node, send_message_str(_, ResultOf(is_audit, Eq(true))))
+                .Times(Exactly(0));
 
-        for (const auto& peer : TEST_PEER_LIST)
+        for (uint64_t sequence : {1, 2})
         {
-            pbft_msg prepare = pbft_msg(preprepare);
-            bzn_envelope prepare_wrap;
-            pbft_msg commit = pbft_msg(preprepare);
-            bzn_envelope commit_wrap;
-            prepare.set_type(PBFT_MSG_PREPARE);
-            prepare_wrap.set_sender(peer.uuid);
-            commit.set_type(PBFT_MSG_COMMIT);
-            commit_wrap.set_sender(peer.uuid);
-            this->pbft->handle_message(prepare, prepare_wrap);
-            this->pbft->handle_message(commit, commit_wrap);
+            bzn_envelope dummy_original_msg;
+            pbft_msg preprepare = pbft_msg(this->preprepare_msg);
+            preprepare.set_sequence(sequence);
+            this->pbft->handle_message(preprepare, dummy_original_msg);
+
+            for (const auto& peer : TEST_PEER_LIST)
+            {
+                pbft_msg prepare = pbft_msg(preprepare);
+                bzn_envelope prepare_wrap;
+                pbft_msg commit = pbft_msg(preprepare);
+                bzn_envelope commit_wrap;
+                prepare.set_type(PBFT_MSG_PREPARE);
+                prepare_wrap.set_sender(peer.uuid);
+                commit.set_type(PBFT_MSG_COMMIT);
+                commit_wrap.set_sender(peer.uuid);
+                this->pbft->handle_message(prepare, prepare_wrap);
+                this->pbft->handle_message(commit, commit_wrap);
+            }
         }
+
+        Mock::VerifyAndClearExpectations(mock_node.get());
+
+        // ... but one batch holding both goes to every peer on the next heartbeat
+        std::vector<std::shared_ptr<std::string>> batches;
+        EXPECT_CALL(*mock_node, send_message_str(_, ResultOf(is_audit_commit_batch, Eq(false))))
+                .Times(AnyNumber());
+        EXPECT_CALL(*mock_node, send_message_str(_, ResultOf(is_audit_commit_batch, Eq(true))))
+                .Times(Exactly(TEST_PEER_LIST.size()))
+                .WillRepeatedly(Invoke([&](auto, auto msg){ batches.push_back(msg); }));
+
+        this->audit_heartbeat_timer_callback(boost::system::error_code());
+
+        ASSERT_FALSE(batches.empty());
+
+        bzn_envelope envelope;
+        audit_message audit;
+        ASSERT_TRUE(envelope.ParseFromString(*batches.front()));
+        ASSERT_TRUE(audit.ParseFromString(envelope.audit()));
+        EXPECT_EQ(envelope.sender(), TEST_NODE_UUID);
+        EXPECT_EQ(audit.pbft_commit_batch().sender_uuid(), TEST_NODE_UUID);
+        ASSERT_EQ(audit.pbft_commit_batch().sequence_numbers_size(), 2);
+        EXPECT_EQ(audit.pbft_commit_batch().sequence_numbers(0), 1u);
+        EXPECT_EQ(audit.pbft_commit_batch().sequence_numbers(1), 2u);
+        EXPECT_EQ(audit.pbft_commit_batch().operations_size(), 2);
+
+        // and it is not sent again
+        Mock::VerifyAndClearExpectations(mock_node.get());
+        EXPECT_CALL(*mock_node, send_message_str(_, ResultOf(is_audit_commit_batch, Eq(false))))
+                .Times(AnyNumber());
+        EXPECT_CALL(*mock_node, send_message_str(_, ResultOf(is_audit_commit_batch, Eq(true))))
+                .Times(Exactly(0));
+
+        this->audit_heartbeat_timer_callback(boost::system::error_code());
     }
 
     TEST_F(pbft_test, primary_sends_primary_status)
@@ -0,0 +1,143 @@
+// Copyright (C) 2018 Bluzelle
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU Affero General Public License, version 3,
+// as published by the Free Software Foundation.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU Affero General Public License for more details.
+//
+// You should have received a copy of the GNU Affero General Public License
+// along with this program. If not, see <http://www.gnu.org/licenses/>.
+
+// Runs a simulated pbft cluster under a closed loop of clients and reports throughput and commit latency as the
+// cluster size, the number of requests in flight and the value size vary. Usage:
+//
+//   pbft_bench [requests] [seed] [loss]
+//
+// "ops/s (sim)" is throughput in virtual time, i.e. what the protocol sustains over the simulated network;
+// "ops/s (cpu)" is what this process managed in wall time running every replica of the cluster on one thread.
+
+#include <pbft/test/pbft_simulator.hpp>
+#include <boost/log/core.hpp>
+#include <algorithm>
+#include <cstdio>
+#include <iostream>
+
+using namespace bzn::test;
+
+namespace
+{
+    struct bench_result
+    {
+        size_t completed = 0;
+        std::chrono::nanoseconds elapsed{0};
+        std::chrono::nanoseconds wall{0};
+        std::vector<std::chrono::nanoseconds> latencies;
+        uint64_t messages = 0;
+        uint64_t bytes = 0;
+    };
+
+
+    bench_result
+    run(const sim_config& config, size_t requests, size_t batch, size_t value_size)
+    {
+        pbft_simulator sim(config);
+        bench_result result;
+
+        const std::string value(value_size, 'x');
+        const auto wall_start = std::chrono::steady_clock::now();
+        const auto start = sim.now();
+
+        uint64_t next_transaction = 1;
+        while (next_transaction <= requests)
+        {
+            // a batch is one request from each of as many clients; the next one starts when all have been answered...
+            const size_t in_flight = std::min(batch, requests - next_transaction + 1);
+            size_t answered = 0;
+
+            for (size_t i = 0; i < in_flight; ++i, ++next_transaction)
+            {
+                sim.submit("client" + std::to_string(i), next_transaction, "key" + std::to_string(next_transaction), value,
+                    [&](uint64_t /*txn*/, std::chrono::nanoseconds latency)
+                    {
+                        result.latencies.push_back(latency);
+                        ++answered;
+                    });
+            }
+
+            if (!sim.run_until([&]() { return answered == in_flight; }, std::chrono::seconds(10)))
+            {
+                std::cerr << "stalled after " << result.latencies.size() << " requests\n";
+                break;
+            }
+        }
+
+        result.completed = result.latencies.size();
+        result.elapsed = sim.now() - start;
+        result.wall = std::chrono::steady_clock::now() - wall_start;
+        result.messages = sim.network().messages_sent();
+        result.bytes = sim.network().bytes_sent();
+
+        return result;
+    }
+
+
+    double
+    percentile_ms(std::vector<std::chrono::nanoseconds> latencies, double p)
+    {
+        if (latencies.empty())
+        {
+            return 0;
+        }
+
+        std::sort(latencies.begin(), latencies.end());
+        const auto index = std::min(latencies.size() - 1, size_t(p * latencies.size()));
+
+        return latencies[index].count() / 1e6;
+    }
+}
+
+
+int
+main(int argc, const char* argv[])
+{
+    const size_t requests = argc > 1 ? std::stoul(argv[1]) : 500;
+    const uint64_t seed = argc > 2 ? std::stoull(argv[2]) : 1;
+    const double loss = argc > 3 ? std::stod(argv[3]) : 0.0;
+
+    boost::log::core::get()->set_logging_enabled(false);
+
+    std::printf("%4s %6s %7s %12s %12s %9s %9s %10s %12s\n",
+        "n", "batch", "value", "ops/s (sim)", "ops/s (cpu)", "p50 ms", "p99 ms", "msgs/op", "bytes/op");
+
+    for (size_t replicas : {4, 7, 10})
+    {
+        for (size_t batch : {1, 10, 50})
+        {
+            for (size_t value_size : {100, 10000})
+            {
+                sim_config config;
+                config.replicas = replicas;
+                config.seed = seed;
+                config.link.loss = loss;
+
+                const auto result = run(config, requests, batch, value_size);
+                const auto ops = std::max<size_t>(result.completed, 1);
+
+                std::printf("%4zu %6zu %7zu %12.0f %12.0f %9.3f %9.3f %10.1f %12.0f\n",
+                    replicas, batch, value_size,
+                    result.completed / (result.elapsed.count() / 1e9),
+                    result.completed / (result.wall.count() / 1e9),
+                    percentile_ms(result.latencies, 0.50),
+                    percentile_ms(result.latencies, 0.99),
+                    double(result.messages) / ops,
+                    double(result.bytes) / ops);
+            }
+        }
+    }
+
+    return 0;
+}
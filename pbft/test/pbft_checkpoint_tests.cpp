@@ -47,7 +47,7 @@ namespace bzn::test
     TEST_F(pbft_checkpoint_test, test_checkpoint_messages_sent_on_execute)
     {
         EXPECT_CALL(*mock_node, send_message_str(_, ResultOf(is_checkpoint, Eq(true))))
-                .Times(Exactly(TEST_PEER_LIST.size()));
+                .Times(Exactly(TEST_PEER_LIST.size() - 1));
 
         this->build_pbft();
         this->service_execute_handler(this->request_msg, CHECKPOINT_INTERVAL);
@@ -205,4 +205,156 @@ namespace bzn::test
         EXPECT_GT(this->pbft->get_high_water_mark(), initial_high);
         EXPECT_GT(this->pbft->get_low_water_mark(), initial_low);
     }
+
+    TEST_F(pbft_checkpoint_test, lagging_replica_requests_state_from_checkpoint_signers)
+    {
+        const checkpoint_t cp3(CHECKPOINT_INTERVAL*3, "db state hash cp 3");
+
+        EXPECT_CALL(*mock_node, send_message_str(_, ResultOf([&](auto wrapped_msg)
+            {
+                pbft_msg msg = extract_pbft_msg(*wrapped_msg);
+                return msg.type() == PBFT_MSG_GET_STATE && msg.sequence() == cp3.first && msg.state_hash() == cp3.second
+                    && msg.requested_chunks_size() == 0;
+            }, Eq(true)))).Times(Exactly(TEST_PEER_LIST.size() - 1));
+
+        this->build_pbft();
+        for (const auto& peer : TEST_PEER_LIST)
+        {
+            if (peer.uuid == TEST_NODE_UUID)
+            {
+                continue;
+            }
+
+            pbft_msg msg = cp1_msg;
+            msg.set_sequence(cp3.first);
+            msg.set_state_hash(cp3.second);
+            this->pbft->handle_message(msg, from(peer.uuid));
+        }
+
+        EXPECT_EQ(0u, this->pbft->latest_stable_checkpoint().first);
+    }
+
+    TEST_F(pbft_checkpoint_test, unanswered_state_requests_are_sent_again_and_chunks_to_other_sources)
+    {
+        std::vector<bzn::hash_t> manifest;
+        for (size_t i = 0; i < STATE_CHUNK_COUNT; ++i)
+        {
+            manifest.push_back(pbft_state_transfer::chunk_hash("chunk " + std::to_string(i)));
+        }
+
+        const checkpoint_t cp3(CHECKPOINT_INTERVAL*3, pbft_state_transfer::state_hash(manifest));
+
+        size_t manifest_requests = 0;
+        std::map<size_t, std::vector<boost::asio::ip::tcp::endpoint>> chunk_requests;
+        EXPECT_CALL(*mock_node, send_message_str(_, _)).WillRepeatedly(Invoke([&](auto ep, auto wrapped_msg)
+            {
+                pbft_msg msg = extract_pbft_msg(*wrapped_msg);
+                if (msg.type() != PBFT_MSG_GET_STATE)
+                {
+                    return;
+                }
+
+                manifest_requests += msg.requested_chunks_size() == 0;
+                for (const auto index : msg.requested_chunks())
+                {
+                    chunk_requests[index].push_back(ep);
+                }
+            }));
+
+        EXPECT_CALL(*mock_service, changed_service_state_chunks(manifest)).WillOnce(Return(std::vector<size_t>{1, 2, 3}));
+
+        this->build_pbft();
+        for (const auto& peer : TEST_PEER_LIST)
+        {
+            if (peer.uuid != TEST_NODE_UUID)
+            {
+                pbft_msg msg = cp1_msg;
+                msg.set_sequence(cp3.first);
+                msg.set_state_hash(cp3.second);
+                this->pbft->handle_message(msg, from(peer.uuid));
+            }
+        }
+
+        EXPECT_EQ(TEST_PEER_LIST.size() - 1, manifest_requests);
+
+        // nobody answers...
+        this->state_transfer_timer_callback(boost::system::error_code());
+        EXPECT_EQ(2 * (TEST_PEER_LIST.size() - 1), manifest_requests);
+
+        pbft_msg set_state;
+        set_state.set_type(PBFT_MSG_SET_STATE);
+        set_state.set_sequence(cp3.first);
+        set_state.set_state_hash(cp3.second);
+        for (const auto& hash : manifest)
+        {
+            set_state.add_chunk_hashes(hash);
+        }
+        this->pbft->handle_message(set_state, from("uuid0"));
+
+        // spread across the sources...
+        ASSERT_EQ(3u, chunk_requests.size());
+        EXPECT_NE(chunk_requests[1][0], chunk_requests[2][0]);
+        EXPECT_NE(chunk_requests[2][0], chunk_requests[3][0]);
+        EXPECT_NE(chunk_requests[1][0], chunk_requests[3][0]);
+
+        pbft_msg chunk_reply;
+        chunk_reply.set_type(PBFT_MSG_SET_STATE);
+        chunk_reply.set_sequence(cp3.first);
+        chunk_reply.set_state_hash(cp3.second);
+        auto chunk = chunk_reply.add_chunks();
+        chunk->set_index(1);
+        chunk->set_data("chunk 1");
+        this->pbft->handle_message(chunk_reply, from("uuid0"));
+
+        // only the chunks still missing are asked for again, each of another source...
+        this->state_transfer_timer_callback(boost::system::error_code());
+
+        EXPECT_EQ(1u, chunk_requests[1].size());
+        for (const size_t index : {2, 3})
+        {
+            ASSERT_EQ(2u, chunk_requests[index].size());
+            EXPECT_NE(chunk_requests[index][0], chunk_requests[index][1]);
+        }
+
+        // a wait that was cancelled by a newer one does nothing...
+        this->state_transfer_timer_callback(boost::asio::error::operation_aborted);
+        EXPECT_EQ(2u, chunk_requests[2].size());
+    }
+
+    TEST_F(pbft_checkpoint_test, replica_one_checkpoint_behind_does_not_request_state)
+    {
+        EXPECT_CALL(*mock_node, send_message_str(_, _)).Times(0);
+
+        this->build_pbft();
+        for (const auto& peer : TEST_PEER_LIST)
+        {
+            pbft_msg msg = cp1_msg;
+            this->pbft->handle_message(msg, from(peer.uuid));
+        }
+    }
+
+    TEST_F(pbft_checkpoint_test, checkpoints_are_signed_and_unsigned_checkpoints_ignored)
+    {
+        this->mock_crypto = std::make_shared<NiceMock<bzn::Mockcrypto_base>>();
+
+        EXPECT_CALL(*this->mock_crypto, sign(_)).Times(Exactly(1)).WillOnce(Invoke(
+            [](bzn_envelope& msg)
+            {
+                msg.set_signature("signature");
+                return true;
+            }));
+        EXPECT_CALL(*this->mock_crypto, authenticate(_, _)).Times(Exactly(0));
+
+        this->build_pbft();
+        this->service_execute_handler(this->request_msg, CHECKPOINT_INTERVAL);
+
+        for (const auto& peer : TEST_PEER_LIST)
+        {
+            pbft_msg msg = cp1_msg;
+            this->pbft->handle_message(msg, from(peer.uuid));
+        }
+
+        EXPECT_EQ(0u, this->pbft->latest_stable_checkpoint().first);
+    }
 }
+
@@ -0,0 +1,286 @@
+// Copyright (C) 2018 Bluzelle
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU Affero General Public License, version 3,
+// as published by the Free Software Foundation.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU Affero General Public License for more details.
+//
+// You should have received a copy of the GNU Affero General Public License
+// along with this program. If not, see <http://www.gnu.org/licenses/>.
+
+#include <gtest/gtest.h>
+#include <pbft/pbft_client_table.hpp>
+#include <mocks/mock_session_base.hpp>
+#include <proto/database.pb.h>
+
+using namespace ::testing;
+
+namespace
+{
+    pbft_request
+    make_request(const std::string& client, uint64_t timestamp, const std::string& key = "key")
+    {
+        pbft_request request;
+        request.set_client(client);
+        request.set_timestamp(timestamp);
+        request.mutable_operation()->mutable_header()->set_db_uuid(client);
+        request.mutable_operation()->mutable_header()->set_transaction_id(timestamp);
+        request.mutable_operation()->mutable_create()->set_key(key);
+
+        return request;
+    }
+}
+
+
+TEST(pbft_client_table, test_that_retry_of_ordered_request_is_duplicate)
+{
+    auto table = std::make_shared<bzn::pbft_client_table>();
+    auto session = std::make_shared<NiceMock<bzn::Mocksession_base>>();
+    std::shared_ptr<bzn::encoded_message> reply;
+
+    const auto request = make_request("alice", 1);
+
+    EXPECT_FALSE(table->is_duplicate(request, session, reply));
+    table->record_ordered(request, session);
+
+    EXPECT_TRUE(table->is_duplicate(request, session, reply));
+    EXPECT_EQ(reply, nullptr);
+
+    // a new request, or different content under the same timestamp, is not a retry...
+    EXPECT_FALSE(table->is_duplicate(make_request("alice", 2), session, reply));
+    EXPECT_FALSE(table->is_duplicate(make_request("alice", 1, "other"), session, reply));
+    EXPECT_FALSE(table->is_duplicate(make_request("bob", 1), session, reply));
+}
+
+
+TEST(pbft_client_table, test_that_reply_is_cached_and_returned_to_retry)
+{
+    auto table = std::make_shared<bzn::pbft_client_table>();
+    auto session = std::make_shared<NiceMock<bzn::Mocksession_base>>();
+
+    const auto request = make_request("alice", 1);
+    const auto response = std::make_shared<bzn::encoded_message>("response");
+
+    EXPECT_CALL(*session, send_message(Matcher<std::shared_ptr<bzn::encoded_message>>(response), false));
+
+    auto wrapper = table->record_ordered(request, session);
+    table->record_executed(request, 5);
+    wrapper->send_message(response, false);
+
+    EXPECT_EQ(table->cached_replies_count(), 1u);
+
+    std::shared_ptr<bzn::encoded_message> reply;
+    EXPECT_TRUE(table->is_duplicate(request, session, reply));
+    EXPECT_EQ(reply, response);
+}
+
+
+TEST(pbft_client_table, test_that_retry_while_executing_takes_over_delivery)
+{
+    auto table = std::make_shared<bzn::pbft_client_table>();
+    auto first = std::make_shared<NiceMock<bzn::Mocksession_base>>();
+    auto second = std::make_shared<NiceMock<bzn::Mocksession_base>>();
+
+    const auto request = make_request("alice", 1);
+
+    EXPECT_CALL(*first, send_message(Matcher<std::shared_ptr<bzn::encoded_message>>(_), _)).Times(0);
+    EXPECT_CALL(*second, send_message(Matcher<std::shared_ptr<bzn::encoded_message>>(_), _)).Times(1);
+
+    auto wrapper = table->record_ordered(request, first);
+
+    std::shared_ptr<bzn::encoded_message> reply;
+    EXPECT_TRUE(table->is_duplicate(request, second, reply));
+
+    wrapper->send_message(std::make_shared<bzn::encoded_message>("response"), false);
+}
+
+
+TEST(pbft_client_table, test_that_only_the_final_reply_is_cached)
+{
+    auto table = std::make_shared<bzn::pbft_client_table>();
+    auto session = std::make_shared<NiceMock<bzn::Mocksession_base>>();
+
+    const auto request = make_request("alice", 1);
+
+    database_response response;
+    response.mutable_header()->set_db_uuid("alice");
+    response.set_tentative(true);
+    const auto tentative = std::make_shared<bzn::encoded_message>(response.SerializeAsString());
+    response.set_tentative(false);
+    const auto final = std::make_shared<bzn::encoded_message>(response.SerializeAsString());
+
+    auto wrapper = table->record_ordered(request, session);
+    wrapper->send_message(tentative, false);
+
+    EXPECT_EQ(table->cached_replies_count(), 0u);
+
+    std::shared_ptr<bzn::encoded_message> reply;
+    EXPECT_TRUE(table->is_duplicate(request, session, reply));
+    EXPECT_EQ(reply, nullptr);
+
+    table->record_executed(request, 5);
+    wrapper->send_message(final, false);
+
+    EXPECT_EQ(table->cached_replies_count(), 1u);
+    EXPECT_TRUE(table->is_duplicate(request, session, reply));
+    EXPECT_EQ(reply, final);
+}
+
+
+TEST(pbft_client_table, test_that_rolled_back_request_is_ordered_again)
+{
+    auto table = std::make_shared<bzn::pbft_client_table>();
+    auto session = std::make_shared<NiceMock<bzn::Mocksession_base>>();
+
+    const auto executed = make_request("alice", 1);
+    const auto waiting = make_request("bob", 1);
+
+    table->record_ordered(executed, session);
+    table->record_executed(executed, 5);
+    table->record_ordered(waiting, session);
+
+    // a client that has moved on keeps its newer request...
+    table->rolled_back(make_request("carol", 1));
+    table->record_ordered(make_request("carol", 2), session);
+    table->rolled_back(make_request("carol", 1));
+
+    table->rolled_back(executed);
+    table->rolled_back(waiting);
+
+    std::shared_ptr<bzn::encoded_message> reply;
+    EXPECT_FALSE(table->is_duplicate(executed, session, reply));
+    EXPECT_FALSE(table->is_duplicate(waiting, session, reply));
+    EXPECT_TRUE(table->is_duplicate(make_request("carol", 2), session, reply));
+    EXPECT_EQ(table->clients_count(), 1u);
+}
+
+
+TEST(pbft_client_table, test_that_reply_is_kept_until_the_client_sends_a_newer_request)
+{
+    auto table = std::make_shared<bzn::pbft_client_table>();
+    auto session = std::make_shared<NiceMock<bzn::Mocksession_base>>();
+
+    const auto request = make_request("alice", 1);
+
+    table->record_ordered(request, session)->send_message(std::make_shared<bzn::encoded_message>("reply"), false);
+    table->record_executed(request, 1);
+
+    // other clients' requests execute well past the checkpoints after alice's...
+    for (uint64_t sequence = 2; sequence <= 1000; ++sequence)
+    {
+        const auto other = make_request("bob", sequence);
+        table->record_ordered(other, session)->send_message(std::make_shared<bzn::encoded_message>("other"), false);
+        table->record_executed(other, sequence);
+    }
+
+    // a retry of the request whose reply was lost still gets it...
+    std::shared_ptr<bzn::encoded_message> reply;
+    EXPECT_TRUE(table->is_duplicate(request, session, reply));
+    ASSERT_TRUE(reply);
+    EXPECT_EQ(*reply, "reply");
+
+    // until alice moves on
+    table->record_ordered(make_request("alice", 2), session);
+    reply = nullptr;
+    EXPECT_FALSE(table->is_duplicate(request, session, reply));
+    EXPECT_EQ(reply, nullptr);
+    EXPECT_EQ(table->cached_replies_count(), 1u);
+}
+
+
+TEST(pbft_client_table, test_that_clients_that_executed_longest_ago_are_forgotten_first)
+{
+    auto table = std::make_shared<bzn::pbft_client_table>(2);
+    auto session = std::make_shared<NiceMock<bzn::Mocksession_base>>();
+
+    for (const auto& client : {"alice", "bob", "carol"})
+    {
+        const auto request = make_request(client, 1);
+        table->record_ordered(request, session)->send_message(std::make_shared<bzn::encoded_message>("reply"), false);
+        table->record_executed(request, table->clients_count() + 1);
+    }
+
+    EXPECT_EQ(table->clients_count(), 2u);
+    EXPECT_EQ(table->cached_replies_count(), 2u);
+
+    std::shared_ptr<bzn::encoded_message> reply;
+    EXPECT_FALSE(table->is_duplicate(make_request("alice", 1), session, reply));
+    EXPECT_TRUE(table->is_duplicate(make_request("bob", 1), session, reply));
+    EXPECT_TRUE(table->is_duplicate(make_request("carol", 1), session, reply));
+
+    // and at once when the limit is lowered...
+    table->set_max_clients(1);
+
+    EXPECT_EQ(table->clients_count(), 1u);
+    EXPECT_EQ(table->cached_replies_count(), 1u);
+    EXPECT_FALSE(table->is_duplicate(make_request("bob", 1), session, reply));
+    EXPECT_TRUE(table->is_duplicate(make_request("carol", 1), session, reply));
+}
+
+
+TEST(pbft_client_table, test_that_a_client_moves_to_the_back_when_it_executes_again)
+{
+    auto table = std::make_shared<bzn::pbft_client_table>(2);
+    auto session = std::make_shared<NiceMock<bzn::Mocksession_base>>();
+
+    table->record_ordered(make_request("alice", 1), session)->send_message(std::make_shared<bzn::encoded_message>("reply"), false);
+    table->record_executed(make_request("alice", 1), 1);
+    table->record_executed(make_request("bob", 1), 2);
+
+    // alice's new request takes her out of the order while it executes, and puts her last once it has...
+    table->record_ordered(make_request("alice", 2), session);
+    EXPECT_EQ(table->cached_replies_count(), 0u);
+    table->record_executed(make_request("alice", 2), 3);
+
+    table->record_executed(make_request("carol", 1), 4);
+
+    std::shared_ptr<bzn::encoded_message> reply;
+    EXPECT_EQ(table->clients_count(), 2u);
+    EXPECT_FALSE(table->is_duplicate(make_request("bob", 1), session, reply));
+    EXPECT_TRUE(table->is_duplicate(make_request("alice", 2), session, reply));
+    EXPECT_TRUE(table->is_duplicate(make_request("carol", 1), session, reply));
+}
+
+
+TEST(pbft_client_table, test_that_requests_without_client_are_not_tracked)
+{
+    auto table = std::make_shared<bzn::pbft_client_table>();
+    auto session = std::make_shared<NiceMock<bzn::Mocksession_base>>();
+
+    const auto request = make_request("", 0);
+
+    EXPECT_EQ(table->record_ordered(request, session), session);
+    table->record_executed(request, 1);
+
+    std::shared_ptr<bzn::encoded_message> reply;
+    EXPECT_FALSE(table->is_duplicate(request, session, reply));
+    EXPECT_EQ(table->clients_count(), 0u);
+}
+
+
+TEST(pbft_client_table, test_that_table_keeps_one_entry_per_client)
+{
+    const size_t CLIENTS = 100000;
+
+    auto table = std::make_shared<bzn::pbft_client_table>();
+
+    for (uint64_t timestamp = 1; timestamp <= 3; ++timestamp)
+    {
+        for (size_t i = 0; i < CLIENTS; ++i)
+        {
+            const auto request = make_request("client" + std::to_string(i), timestamp);
+            const uint64_t sequence = (timestamp - 1) * CLIENTS + i + 1;
+
+            table->record_ordered(request, nullptr)->send_message(std::make_shared<bzn::encoded_message>("reply"), false);
+            table->record_executed(request, sequence);
+        }
+
+        // each client's newer request takes the place of its older one, reply and all...
+        EXPECT_EQ(table->clients_count(), CLIENTS);
+        EXPECT_EQ(table->cached_replies_count(), CLIENTS);
+    }
+}
@@ -0,0 +1,88 @@
+// Copyright (C) 2018 Bluzelle
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU Affero General Public License, version 3,
+// as published by the Free Software Foundation.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU Affero General Public License for more details.
+//
+// You should have received a copy of the GNU Affero General Public License
+// along with this program. If not, see <http://www.gnu.org/licenses/>.
+
+// Feeds the failure detector requests the way pbft does, each seen, executed and passed by a stable checkpoint, and
+// reports the resident set size and the requests held as it goes; both should level off within the first report.
+// Usage:
+//
+//   pbft_failure_detector_soak [requests] [reports]
+
+#include <pbft/pbft_failure_detector.hpp>
+#include <boost/log/core.hpp>
+#include <algorithm>
+#include <cstdio>
+#include <fstream>
+#include <string>
+
+namespace
+{
+    const uint64_t CHECKPOINT_INTERVAL = 100;
+
+    size_t
+    resident_kb()
+    {
+        std::ifstream status("/proc/self/status");
+
+        for (std::string line; std::getline(status, line);)
+        {
+            if (line.compare(0, 6, "VmRSS:") == 0)
+            {
+                return std::stoul(line.substr(6));
+            }
+        }
+
+        return 0;
+    }
+}
+
+
+int
+main(int argc, const char* argv[])
+{
+    const uint64_t requests = argc > 1 ? std::stoull(argv[1]) : 10000000;
+    const uint64_t reports = argc > 2 ? std::stoull(argv[2]) : 10;
+
+    boost::log::core::get()->set_logging_enabled(false);
+
+    // the request timer is armed but never run; every request executes well inside its timeout...
+    auto io_context = std::make_shared<bzn::asio::io_context>();
+    auto failure_detector = std::make_shared<bzn::pbft_failure_detector>(io_context);
+
+    pbft_request req;
+    req.set_client("alice");
+
+    std::printf("%12s %12s %12s\n", "requests", "rss kB", "tracked");
+
+    const uint64_t report_interval = std::max<uint64_t>(requests / std::max<uint64_t>(reports, 1), 1);
+
+    for (uint64_t sequence = 1; sequence <= requests; sequence++)
+    {
+        req.set_timestamp(sequence);
+        failure_detector->request_seen(req);
+        failure_detector->request_executed(req, sequence);
+
+        // checkpoints become stable one interval behind execution...
+        if (sequence % CHECKPOINT_INTERVAL == 0 && sequence > CHECKPOINT_INTERVAL)
+        {
+            failure_detector->stable_checkpoint_reached(sequence - CHECKPOINT_INTERVAL);
+        }
+
+        if (sequence % report_interval == 0)
+        {
+            std::printf("%12llu %12zu %12zu\n", static_cast<unsigned long long>(sequence), resident_kb(), failure_detector->tracked_requests_count());
+        }
+    }
+
+    return 0;
+}
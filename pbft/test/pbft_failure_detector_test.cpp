@@ -97,7 +97,7 @@ namespace
         this->build_failure_detector();
 
         this->failure_detector->request_seen(req_a);
-        this->failure_detector->request_executed(req_a);
+        this->failure_detector->request_executed(req_a, 1);
         this->request_timer_callback(boost::system::error_code());
     }
 
@@ -107,7 +107,7 @@ namespace
         this->build_failure_detector();
 
         this->failure_detector->request_seen(req_a);
-        this->failure_detector->request_executed(req_a);
+        this->failure_detector->request_executed(req_a, 1);
         this->request_timer_callback(boost::system::error_code());
         this->failure_detector->request_seen(req_b);
     }
@@ -118,7 +118,7 @@ namespace
         this->build_failure_detector();
 
         this->failure_detector->request_seen(req_a);
-        this->failure_detector->request_executed(req_a);
+        this->failure_detector->request_executed(req_a, 1);
         this->failure_detector->request_seen(req_a);
     }
 
@@ -143,5 +143,188 @@ namespace
         this->request_timer_callback(boost::system::error_code());
     }
 
+
+    TEST_F(pbft_failure_detector_test, completed_requests_forgotten_after_stable_checkpoint)
+    {
+        EXPECT_CALL(*(this->request_timer), expires_from_now(_)).Times(Exactly(2));
+        this->build_failure_detector();
+
+        this->failure_detector->request_seen(req_a);
+        this->failure_detector->request_executed(req_a, 5);
+        this->request_timer_callback(boost::system::error_code());
+
+        this->failure_detector->stable_checkpoint_reached(4);
+        this->failure_detector->request_seen(req_a);
+        EXPECT_EQ(this->failure_detector->tracked_requests_count(), 1u);
+
+        this->failure_detector->stable_checkpoint_reached(5);
+        EXPECT_EQ(this->failure_detector->tracked_requests_count(), 0u);
+
+        // no longer remembered, so it is tracked again
+        this->failure_detector->request_seen(req_a);
+        EXPECT_EQ(this->failure_detector->tracked_requests_count(), 2u);
+    }
+
+    TEST_F(pbft_failure_detector_test, forgotten_request_does_not_trigger_failure)
+    {
+        EXPECT_CALL(*(this->mock_io_context), post(_)).Times(Exactly(0));
+        this->build_failure_detector();
+
+        this->failure_detector->request_seen(req_a);
+        this->failure_detector->request_executed(req_a, 1);
+        this->failure_detector->stable_checkpoint_reached(1);
+
+        this->request_timer_callback(boost::system::error_code());
+        EXPECT_FALSE(this->failure_detected);
+    }
+
+    TEST_F(pbft_failure_detector_test, completed_requests_bounded_by_window)
+    {
+        this->failure_detector = std::make_shared<bzn::pbft_failure_detector>(this->mock_io_context, 10);
+
+        for (uint64_t i = 0; i < 100; i++)
+        {
+            pbft_request req;
+            req.set_timestamp(i);
+            this->failure_detector->request_executed(req, i + 1);
+        }
+
+        EXPECT_EQ(this->failure_detector->tracked_requests_count(), 10u);
+    }
+
+    // a short run of what pbft_failure_detector_soak does over millions of requests, counting what's held rather
+    // than measuring memory
+    TEST_F(pbft_failure_detector_test, soak_tracked_requests_stay_flat)
+    {
+        const uint64_t REQUESTS = 100000;
+        const uint64_t CHECKPOINT_INTERVAL = 100;
+        const uint64_t REQUESTS_PER_TIMEOUT = 1000;
+
+        this->build_failure_detector();
+
+        pbft_request req;
+        req.set_client("alice");
+
+        // per request debug logging would dominate the run time; put it back for the tests after this one...
+        const bool logging_enabled = boost::log::core::get()->get_logging_enabled();
+        std::shared_ptr<void> restore_logging(nullptr, [logging_enabled](void*)
+        {
+            boost::log::core::get()->set_logging_enabled(logging_enabled);
+        });
+        boost::log::core::get()->set_logging_enabled(false);
+
+        size_t max_tracked = 0;
+        for (uint64_t sequence = 1; sequence <= REQUESTS; sequence++)
+        {
+            req.set_timestamp(sequence);
+            this->failure_detector->request_seen(req);
+            this->failure_detector->request_executed(req, sequence);
+
+            // checkpoints become stable one interval behind execution...
+            if (sequence % CHECKPOINT_INTERVAL == 0 && sequence > CHECKPOINT_INTERVAL)
+            {
+                this->failure_detector->stable_checkpoint_reached(sequence - CHECKPOINT_INTERVAL);
+            }
+
+            if (sequence % REQUESTS_PER_TIMEOUT == 0)
+            {
+                max_tracked = std::max(max_tracked, this->failure_detector->tracked_requests_count());
+                this->request_timer_callback(boost::system::error_code());
+            }
+        }
+
+        EXPECT_FALSE(this->failure_detected);
+        // executed requests leave the ordered queue straight away, so none wait; completed digests stay within the window
+        EXPECT_LE(max_tracked, bzn::pbft_failure_detector::DEFAULT_COMPLETED_REQUEST_WINDOW);
+    }
+
+    TEST_F(pbft_failure_detector_test, outstanding_requests_bounded_by_window)
+    {
+        EXPECT_CALL(*(this->mock_io_context), post(_)).WillOnce(Invoke([](auto task) { task(); }));
+        this->failure_detector = std::make_shared<bzn::pbft_failure_detector>(this->mock_io_context, 10);
+        this->failure_detector
+            ->register_failure_handler(std::bind(&pbft_failure_detector_test::failure_detect_handler, this));
+
+        for (uint64_t i = 0; i < 100; i++)
+        {
+            pbft_request req;
+            req.set_timestamp(i);
+            this->failure_detector->request_seen(req);
+        }
+
+        // ordered and outstanding, and the queue waiting behind them, each held to the window...
+        EXPECT_EQ(this->failure_detector->tracked_requests_count(), 40u);
+
+        // the ones being timed still are...
+        this->request_timer_callback(boost::system::error_code());
+        EXPECT_TRUE(this->failure_detected);
+    }
+
+    TEST_F(pbft_failure_detector_test, requests_beyond_the_window_are_timed_once_there_is_room)
+    {
+        EXPECT_CALL(*(this->mock_io_context), post(_)).WillOnce(Invoke([](auto task) { task(); }));
+        this->failure_detector = std::make_shared<bzn::pbft_failure_detector>(this->mock_io_context, 10);
+        this->failure_detector
+            ->register_failure_handler(std::bind(&pbft_failure_detector_test::failure_detect_handler, this));
+
+        std::vector<pbft_request> requests(20);
+        for (uint64_t i = 0; i < requests.size(); i++)
+        {
+            requests[i].set_timestamp(i);
+            this->failure_detector->request_seen(requests[i]);
+        }
+
+        // all but the last execute, window by window...
+        for (uint64_t i = 0; i + 1 < requests.size(); i++)
+        {
+            this->failure_detector->request_executed(requests[i], i + 1);
+        }
+
+        EXPECT_FALSE(this->failure_detected);
+
+        this->request_timer_callback(boost::system::error_code());
+        EXPECT_TRUE(this->failure_detected);
+    }
+
+
+    TEST_F(pbft_failure_detector_test, requests_beyond_a_full_queue_are_timed_once_there_is_room)
+    {
+        EXPECT_CALL(*(this->mock_io_context), post(_)).WillOnce(Invoke([](auto task) { task(); }));
+        this->failure_detector = std::make_shared<bzn::pbft_failure_detector>(this->mock_io_context, 10);
+        this->failure_detector
+            ->register_failure_handler(std::bind(&pbft_failure_detector_test::failure_detect_handler, this));
+
+        std::vector<pbft_request> requests(100);
+        for (uint64_t i = 0; i < requests.size(); i++)
+        {
+            requests[i].set_timestamp(i);
+            this->failure_detector->request_seen(requests[i]);
+        }
+
+        pbft_request late;
+        late.set_timestamp(1000);
+        this->failure_detector->request_seen(late);
+
+        // the late one pushed the oldest waiting out rather than being dropped itself...
+        EXPECT_EQ(this->failure_detector->tracked_requests_count(), 40u);
+
+        // the timed ones execute, and the newest ones waiting take their place...
+        for (uint64_t i = 0; i < 10; i++)
+        {
+            this->failure_detector->request_executed(requests[i], i + 1);
+        }
+
+        for (uint64_t i = 91; i < requests.size(); i++)
+        {
+            this->failure_detector->request_executed(requests[i], i - 80);
+        }
+
+        EXPECT_FALSE(this->failure_detected);
+
+        // ...so the late one is timed, and its not executing is noticed
+        this->request_timer_callback(boost::system::error_code());
+        EXPECT_TRUE(this->failure_detected);
+    }
+
 }
 
@@ -0,0 +1,92 @@
+// Copyright (C) 2018 Bluzelle
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU Affero General Public License, version 3,
+// as published by the Free Software Foundation.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU Affero General Public License for more details.
+//
+// You should have received a copy of the GNU Affero General Public License
+// along with this program. If not, see <http://www.gnu.org/licenses/>.
+
+// Times how fast a replica applies committed creates through database_pbft_service, crud and mem_storage, request
+// log and checkpoints included, as the number of execution threads and of databases written to vary. Usage:
+//
+//   pbft_hot_path_bench [requests]
+
+#include <pbft/database_pbft_service.hpp>
+#include <crud/crud.hpp>
+#include <storage/mem_storage.hpp>
+#include <boost/log/core.hpp>
+#include <chrono>
+#include <cstdio>
+#include <thread>
+
+namespace
+{
+    const size_t VALUE_SIZE = 100;
+
+
+    double
+    execution_ops_per_second(size_t requests, size_t threads, size_t databases)
+    {
+        auto io_context = std::make_shared<bzn::asio::io_context>();
+        auto storage = std::make_shared<bzn::mem_storage>();
+        auto service = std::make_shared<bzn::database_pbft_service>(io_context, std::make_shared<bzn::mem_storage>(),
+            std::make_shared<bzn::crud>(storage, nullptr), "bench", threads);
+        service->register_execute_handler([](const pbft_request& /*request*/, uint64_t /*sequence*/) {});
+
+        std::vector<std::shared_ptr<bzn::pbft_operation>> operations;
+        for (uint64_t sequence = 1; sequence <= requests; ++sequence)
+        {
+            pbft_request request;
+            request.set_type(PBFT_REQ_DATABASE);
+            request.mutable_operation()->mutable_header()->set_db_uuid("db" + std::to_string(sequence % databases));
+            request.mutable_operation()->mutable_create()->set_key("key" + std::to_string(sequence));
+            request.mutable_operation()->mutable_create()->set_value(std::string(VALUE_SIZE, 'x'));
+
+            operations.push_back(std::make_shared<bzn::pbft_operation>(0, sequence, request, nullptr));
+        }
+
+        const auto start = std::chrono::steady_clock::now();
+
+        for (const auto& op : operations)
+        {
+            service->apply_operation(op);
+        }
+
+        // parallel execution finishes in the background...
+        while (service->applied_requests_count() < requests)
+        {
+            std::this_thread::yield();
+        }
+
+        const auto elapsed = std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - start);
+
+        return requests / (elapsed.count() / 1e9);
+    }
+}
+
+
+int
+main(int argc, const char* argv[])
+{
+    const size_t requests = argc > 1 ? std::stoul(argv[1]) : 20000;
+
+    boost::log::core::get()->set_logging_enabled(false);
+
+    std::printf("%8s %10s %12s\n", "threads", "databases", "ops/s");
+
+    for (size_t threads : {size_t(1), size_t(2), size_t(4), size_t(std::thread::hardware_concurrency())})
+    {
+        for (size_t databases : {1, 16})
+        {
+            std::printf("%8zu %10zu %12.0f\n", threads, databases, execution_ops_per_second(requests, threads, databases));
+        }
+    }
+
+    return 0;
+}
@@ -72,7 +72,7 @@ namespace bzn
                 EXPECT_CALL(*(mock_node),
                     send_message_str(bzn::make_endpoint(p),
                         message_is_correct_type(PBFT_MSG_PREPARE, PBFT_REQ_NEW_CONFIG)))
-                    .Times(Exactly(1));
+                    .Times(Exactly(p.uuid == TEST_NODE_UUID ? 0 : 1));
             }
 
             auto wmsg = wrap_pbft_msg(preprepare);
@@ -139,7 +139,7 @@ namespace bzn
             EXPECT_CALL(*(this->mock_node),
                 send_message_str(bzn::make_endpoint(p),
                     message_is_correct_type(PBFT_MSG_PREPREPARE, PBFT_REQ_NEW_CONFIG)))
-                .Times(Exactly(1));
+                .Times(Exactly(p.uuid == TEST_NODE_UUID ? 0 : 1));
         }
 
         auto wmsg = wrap_pbft_membership_msg(join_msg);
@@ -168,7 +168,7 @@ namespace bzn
             EXPECT_CALL(*(this->mock_node),
                 send_message_str(bzn::make_endpoint(p),
                     message_is_correct_type(PBFT_MSG_PREPREPARE, PBFT_REQ_NEW_CONFIG)))
-                .Times(Exactly(1));
+                .Times(Exactly(p.uuid == TEST_NODE_UUID ? 0 : 1));
         }
 
         auto wmsg = wrap_pbft_membership_msg(leave_msg);
@@ -241,7 +241,7 @@ namespace bzn
             EXPECT_CALL(*(mock_node),
                 send_message_str(bzn::make_endpoint(p),
                     message_is_correct_type(PBFT_MSG_COMMIT, PBFT_REQ_NEW_CONFIG)))
-                .Times(Exactly(1));
+                .Times(Exactly(p.uuid == TEST_NODE_UUID ? 0 : 1));
         }
 
         bzn::peer_address_t node(*nodes++);
@@ -279,7 +279,7 @@ namespace bzn
             EXPECT_CALL(*(mock_node),
                 send_message_str(bzn::make_endpoint(p),
                     message_is_correct_type(PBFT_MSG_COMMIT, PBFT_REQ_NEW_CONFIG)))
-                .Times(Exactly(1));
+                .Times(Exactly(p.uuid == TEST_NODE_UUID ? 0 : 1));
         }
 
         for (auto const &p : TEST_PEER_LIST)
@@ -0,0 +1,188 @@
+// Copyright (C) 2018 Bluzelle
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU Affero General Public License, version 3,
+// as published by the Free Software Foundation.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU Affero General Public License for more details.
+//
+// You should have received a copy of the GNU Affero General Public License
+// along with this program. If not, see <http://www.gnu.org/licenses/>.
+
+#include <gtest/gtest.h>
+#include <pbft/pbft_metrics.hpp>
+#include <thread>
+
+using namespace ::testing;
+
+namespace
+{
+    std::shared_ptr<bzn::pbft_operation>
+    make_committed_operation(uint64_t sequence)
+    {
+        auto peers = std::make_shared<std::vector<bzn::peer_address_t>>();
+        for (size_t i = 0; i < 4; ++i)
+        {
+            peers->emplace_back("127.0.0.1", 8080 + i, 8880 + i, "name", "uuid" + std::to_string(i));
+        }
+
+        auto op = std::make_shared<bzn::pbft_operation>(1, sequence, pbft_request(), peers);
+        op->record_preprepare(bzn_envelope());
+
+        for (const auto& peer : *peers)
+        {
+            bzn_envelope msg;
+            msg.set_sender(peer.uuid);
+            op->record_prepare(msg);
+        }
+        op->begin_commit_phase();
+
+        for (const auto& peer : *peers)
+        {
+            bzn_envelope msg;
+            msg.set_sender(peer.uuid);
+            op->record_commit(msg);
+        }
+        op->end_commit_phase();
+
+        return op;
+    }
+}
+
+
+TEST(latency_histogram, test_that_percentiles_are_within_bucket_precision)
+{
+    bzn::latency_histogram histogram;
+
+    for (int64_t micros = 1; micros <= 100000; ++micros)
+    {
+        histogram.record(std::chrono::microseconds(micros));
+    }
+
+    EXPECT_EQ(histogram.count(), 100000u);
+    EXPECT_EQ(histogram.max(), std::chrono::microseconds(100000));
+
+    for (double fraction : {0.5, 0.9, 0.99, 0.999})
+    {
+        const double expected = fraction * 100000;
+        const double actual = histogram.percentile(fraction).count();
+
+        EXPECT_GE(actual, expected);
+        EXPECT_LE(actual, expected * (1 + 1.0 / 16));
+    }
+
+    EXPECT_EQ(histogram.percentile(1.0), histogram.max());
+}
+
+
+TEST(latency_histogram, test_that_small_and_huge_values_are_recorded)
+{
+    bzn::latency_histogram histogram;
+
+    EXPECT_EQ(histogram.percentile(0.5).count(), 0);
+
+    histogram.record(std::chrono::nanoseconds(-5));
+    histogram.record(std::chrono::microseconds(3));
+    histogram.record(std::chrono::hours(24 * 365 * 100));
+
+    EXPECT_EQ(histogram.count(), 3u);
+    EXPECT_EQ(histogram.percentile(0.1).count(), 0);
+    EXPECT_EQ(histogram.percentile(0.5).count(), 3);
+
+    const auto json = histogram.to_json();
+    EXPECT_EQ(json["count"].asUInt64(), 3u);
+    EXPECT_TRUE(json.isMember("p99_us"));
+}
+
+
+TEST(latency_histogram, test_that_concurrent_recording_loses_nothing)
+{
+    bzn::latency_histogram histogram;
+
+    std::vector<std::thread> threads;
+    for (int t = 0; t < 4; ++t)
+    {
+        threads.emplace_back([&histogram]()
+        {
+            for (int i = 0; i < 10000; ++i)
+            {
+                histogram.record(std::chrono::microseconds(i));
+            }
+        });
+    }
+
+    for (auto& thread : threads)
+    {
+        thread.join();
+    }
+
+    EXPECT_EQ(histogram.count(), 40000u);
+    EXPECT_EQ(histogram.max(), std::chrono::microseconds(9999));
+}
+
+
+TEST(pbft_metrics, test_that_phases_of_executed_operation_are_recorded)
+{
+    bzn::pbft_metrics metrics;
+
+    auto op = make_committed_operation(5);
+    metrics.operation_committed(*op);
+
+    EXPECT_EQ(metrics.histogram(bzn::pbft_metrics::phase::preprepare).count(), 1u);
+    EXPECT_EQ(metrics.histogram(bzn::pbft_metrics::phase::prepare).count(), 1u);
+    EXPECT_EQ(metrics.histogram(bzn::pbft_metrics::phase::commit).count(), 1u);
+    EXPECT_EQ(metrics.histogram(bzn::pbft_metrics::phase::execute).count(), 0u);
+
+    // executions of operations committed elsewhere (or long ago) have nothing to measure against...
+    metrics.operation_executed(6);
+    metrics.operation_executed(5 + 4096);
+    EXPECT_EQ(metrics.histogram(bzn::pbft_metrics::phase::execute).count(), 0u);
+
+    metrics.operation_executed(5);
+    metrics.operation_executed(5);
+    EXPECT_EQ(metrics.histogram(bzn::pbft_metrics::phase::execute).count(), 1u);
+    EXPECT_EQ(metrics.histogram(bzn::pbft_metrics::phase::total).count(), 1u);
+}
+
+
+TEST(pbft_metrics, test_that_messages_are_counted_by_type)
+{
+    bzn::pbft_metrics metrics(std::chrono::milliseconds(20));
+
+    for (int i = 0; i < 3; ++i)
+    {
+        metrics.message_received(PBFT_MSG_PREPARE);
+    }
+    metrics.message_received(PBFT_MSG_COMMIT);
+    metrics.request_received();
+
+    EXPECT_EQ(metrics.messages_received(PBFT_MSG_PREPARE), 3u);
+    EXPECT_EQ(metrics.messages_received(PBFT_MSG_COMMIT), 1u);
+    EXPECT_EQ(metrics.messages_received(PBFT_MSG_CHECKPOINT), 0u);
+
+    auto json = metrics.to_json();
+    EXPECT_EQ(json["messages"]["PBFT_MSG_PREPARE"]["count"].asUInt64(), 3u);
+    EXPECT_GT(json["messages"]["PBFT_MSG_PREPARE"]["per_second"].asDouble(), 0.0);
+    EXPECT_EQ(json["requests"]["count"].asUInt64(), 1u);
+    EXPECT_FALSE(json["messages"].isMember("PBFT_MSG_UNDEFINED"));
+    EXPECT_TRUE(json["phases"].isMember("commit"));
+
+    // another reader doesn't reset the rates...
+    json = metrics.to_json();
+    EXPECT_EQ(json["messages"]["PBFT_MSG_PREPARE"]["count"].asUInt64(), 3u);
+    EXPECT_GT(json["messages"]["PBFT_MSG_PREPARE"]["per_second"].asDouble(), 0.0);
+
+    // the window with the messages in it is reported until the next one has passed...
+    std::this_thread::sleep_for(std::chrono::milliseconds(25));
+    json = metrics.to_json();
+    EXPECT_GT(json["messages"]["PBFT_MSG_PREPARE"]["per_second"].asDouble(), 0.0);
+    EXPECT_EQ(metrics.to_json()["messages"]["PBFT_MSG_PREPARE"]["per_second"].asDouble(),
+        json["messages"]["PBFT_MSG_PREPARE"]["per_second"].asDouble());
+
+    std::this_thread::sleep_for(std::chrono::milliseconds(25));
+    json = metrics.to_json();
+    EXPECT_EQ(json["messages"]["PBFT_MSG_PREPARE"]["per_second"].asDouble(), 0.0);
+}
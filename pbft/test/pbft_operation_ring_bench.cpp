@@ -0,0 +1,87 @@
+// Copyright (C) 2018 Bluzelle
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU Affero General Public License, version 3,
+// as published by the Free Software Foundation.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU Affero General Public License for more details.
+//
+// You should have received a copy of the GNU Affero General Public License
+// along with this program. If not, see <http://www.gnu.org/licenses/>.
+
+// Times the operation lookup and checkpoint garbage collection the pbft message handlers do for every message, with
+// operations stored in a pbft_operation_ring. Usage:
+//
+//   pbft_operation_ring_bench [requests]
+
+#include <pbft/pbft_operation_ring.hpp>
+#include <boost/log/core.hpp>
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+
+namespace
+{
+    double
+    ring_ns_per_message(size_t requests)
+    {
+        const size_t CAPACITY = 200;
+        const uint64_t INTERVAL = CAPACITY / 2;
+        const size_t PEERS = 4;
+        const size_t MESSAGES_PER_OPERATION = 2 * PEERS + 1;
+
+        bzn::pbft_operation_ring ring{0, CAPACITY};
+
+        std::vector<pbft_request> requests_in_interval(INTERVAL);
+        std::vector<bzn::hash_t> hashes;
+        for (uint64_t i = 0; i < INTERVAL; ++i)
+        {
+            requests_in_interval[i].set_timestamp(i);
+            hashes.emplace_back(bzn::pbft_operation::request_hash(requests_in_interval[i]));
+        }
+
+        const uint64_t checkpoints = std::max<uint64_t>(requests / INTERVAL, 1);
+        size_t lookups = 0;
+
+        const auto start = std::chrono::steady_clock::now();
+
+        for (uint64_t checkpoint = 0; checkpoint < checkpoints; ++checkpoint)
+        {
+            for (uint64_t i = 0; i < INTERVAL; ++i)
+            {
+                const uint64_t sequence = checkpoint * INTERVAL + i + 1;
+
+                // one lookup per preprepare, prepare and commit, as pbft::find_operation is called for each...
+                for (size_t message = 0; message < MESSAGES_PER_OPERATION; ++message, ++lookups)
+                {
+                    if (!ring.find(1, sequence, hashes[i]))
+                    {
+                        ring.insert(std::make_shared<bzn::pbft_operation>(1, sequence, requests_in_interval[i], nullptr), hashes[i]);
+                    }
+                }
+            }
+
+            ring.advance(checkpoint * INTERVAL + INTERVAL);
+        }
+
+        const auto elapsed = std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - start);
+
+        return double(elapsed.count()) / lookups;
+    }
+}
+
+
+int
+main(int argc, const char* argv[])
+{
+    const size_t requests = argc > 1 ? std::stoul(argv[1]) : 20000;
+
+    boost::log::core::get()->set_logging_enabled(false);
+
+    std::printf("%12s\n%12.1f\n", "ns/message", ring_ns_per_message(requests));
+
+    return 0;
+}
@@ -0,0 +1,190 @@
+// Copyright (C) 2018 Bluzelle
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU Affero General Public License, version 3,
+// as published by the Free Software Foundation.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU Affero General Public License for more details.
+//
+// You should have received a copy of the GNU Affero General Public License
+// along with this program. If not, see <http://www.gnu.org/licenses/>.
+
+#include <gtest/gtest.h>
+#include <include/bluzelle.hpp>
+#include <pbft/pbft_operation_ring.hpp>
+
+using namespace ::testing;
+
+namespace
+{
+    const std::vector<bzn::peer_address_t> TEST_PEER_LIST{{  "127.0.0.1", 8081, 8881, "name1", "uuid1"}
+                                           , {"127.0.0.1", 8082, 8882, "name2", "uuid2"}
+                                           , {"127.0.0.1", 8083, 8883, "name3", "uuid3"}
+                                           , {"127.0.0.1", 8084, 8884, "name4", "uuid4"}};
+
+    const size_t TEST_CAPACITY = 200;
+
+
+    class pbft_operation_ring_test : public Test
+    {
+    public:
+        bzn::pbft_operation_ring ring{0, TEST_CAPACITY};
+        std::shared_ptr<const std::vector<bzn::peer_address_t>> peers = std::make_shared<const std::vector<bzn::peer_address_t>>(TEST_PEER_LIST);
+
+        pbft_request
+        make_request(uint64_t nonce)
+        {
+            pbft_request request;
+            request.set_timestamp(nonce);
+
+            return request;
+        }
+
+        std::shared_ptr<bzn::pbft_operation>
+        add(uint64_t view, uint64_t sequence, uint64_t nonce = 0)
+        {
+            auto request = this->make_request(nonce);
+            auto op = std::make_shared<bzn::pbft_operation>(view, sequence, request, this->peers);
+            this->ring.insert(op, bzn::pbft_operation::request_hash(request));
+
+            return op;
+        }
+
+        std::shared_ptr<bzn::pbft_operation>
+        find(uint64_t view, uint64_t sequence, uint64_t nonce = 0)
+        {
+            return this->ring.find(view, sequence, bzn::pbft_operation::request_hash(this->make_request(nonce)));
+        }
+    };
+
+
+    TEST_F(pbft_operation_ring_test, finds_inserted_operations)
+    {
+        auto op1 = this->add(1, 1);
+        auto op2 = this->add(1, TEST_CAPACITY);
+
+        EXPECT_EQ(this->find(1, 1), op1);
+        EXPECT_EQ(this->find(1, TEST_CAPACITY), op2);
+        EXPECT_EQ(this->ring.size(), 2u);
+
+        EXPECT_EQ(this->find(1, 2), nullptr);
+        EXPECT_EQ(this->find(2, 1), nullptr);
+        EXPECT_EQ(this->find(1, 1, 5), nullptr);
+    }
+
+
+    TEST_F(pbft_operation_ring_test, keeps_distinct_operations_for_the_same_sequence)
+    {
+        auto op1 = this->add(1, 7, 1);
+        auto op2 = this->add(1, 7, 2);
+        auto op3 = this->add(2, 7, 1);
+
+        EXPECT_EQ(this->find(1, 7, 1), op1);
+        EXPECT_EQ(this->find(1, 7, 2), op2);
+        EXPECT_EQ(this->find(2, 7, 1), op3);
+        EXPECT_EQ(this->ring.size(), 3u);
+    }
+
+
+    TEST_F(pbft_operation_ring_test, advance_discards_operations_up_to_low_water_mark)
+    {
+        for (uint64_t sequence = 1; sequence <= 150; sequence++)
+        {
+            this->add(1, sequence);
+        }
+
+        EXPECT_EQ(this->ring.advance(100), 100u);
+        EXPECT_EQ(this->ring.get_low_water_mark(), 100u);
+        EXPECT_EQ(this->ring.size(), 50u);
+
+        EXPECT_EQ(this->find(1, 100), nullptr);
+        EXPECT_NE(this->find(1, 101), nullptr);
+
+        // the released slots are reused by the next window...
+        auto op = this->add(1, 100 + TEST_CAPACITY);
+        EXPECT_EQ(this->find(1, 100 + TEST_CAPACITY), op);
+        EXPECT_EQ(this->find(1, 100), nullptr);
+
+        // going backwards is a no-op
+        EXPECT_EQ(this->ring.advance(50), 0u);
+        EXPECT_EQ(this->ring.get_low_water_mark(), 100u);
+    }
+
+
+    TEST_F(pbft_operation_ring_test, advance_past_a_full_lap_clears_everything)
+    {
+        for (uint64_t sequence = 1; sequence <= TEST_CAPACITY; sequence++)
+        {
+            this->add(1, sequence);
+        }
+
+        EXPECT_EQ(this->ring.advance(TEST_CAPACITY * 5), TEST_CAPACITY);
+        EXPECT_EQ(this->ring.size(), 0u);
+        EXPECT_EQ(this->find(1, TEST_CAPACITY), nullptr);
+    }
+
+
+    TEST_F(pbft_operation_ring_test, operations_beyond_the_window_are_kept_until_it_arrives)
+    {
+        auto ahead = this->add(1, TEST_CAPACITY + 50);
+        auto stale = this->add(1, TEST_CAPACITY + 10);
+        EXPECT_EQ(this->ring.size(), 2u);
+        EXPECT_EQ(this->find(1, TEST_CAPACITY + 50), ahead);
+
+        EXPECT_EQ(this->ring.advance(TEST_CAPACITY + 20), 1u);
+        EXPECT_EQ(this->find(1, TEST_CAPACITY + 10), nullptr);
+        EXPECT_EQ(this->find(1, TEST_CAPACITY + 50), ahead);
+        EXPECT_EQ(this->ring.size(), 1u);
+
+        // now in the window, so it shares the slot's storage with new arrivals...
+        auto other = this->add(2, TEST_CAPACITY + 50);
+        EXPECT_EQ(this->find(1, TEST_CAPACITY + 50), ahead);
+        EXPECT_EQ(this->find(2, TEST_CAPACITY + 50), other);
+
+        EXPECT_EQ(this->ring.advance(TEST_CAPACITY + 50), 2u);
+        EXPECT_EQ(this->ring.size(), 0u);
+    }
+
+
+    // the lookups and garbage collection the pbft message handlers perform (timed by pbft_hot_path_bench)...
+    TEST_F(pbft_operation_ring_test, message_handling_over_many_checkpoints_collects_every_operation)
+    {
+        const uint64_t CHECKPOINTS = 50;
+        const uint64_t INTERVAL = TEST_CAPACITY / 2;
+        const size_t MESSAGES_PER_OPERATION = 2 * TEST_PEER_LIST.size() + 1;
+
+        std::vector<bzn::hash_t> hashes;
+        for (uint64_t sequence = 0; sequence < INTERVAL; sequence++)
+        {
+            hashes.emplace_back(bzn::pbft_operation::request_hash(this->make_request(sequence)));
+        }
+
+        size_t removed = 0;
+
+        for (uint64_t checkpoint = 0; checkpoint < CHECKPOINTS; checkpoint++)
+        {
+            for (uint64_t i = 0; i < INTERVAL; i++)
+            {
+                const uint64_t sequence = checkpoint * INTERVAL + i + 1;
+                const auto& hash = hashes[i];
+
+                // one lookup per preprepare, prepare and commit, as pbft::find_operation is called for each...
+                for (size_t message = 0; message < MESSAGES_PER_OPERATION; message++)
+                {
+                    if (!this->ring.find(1, sequence, hash))
+                    {
+                        this->ring.insert(std::make_shared<bzn::pbft_operation>(1, sequence, this->make_request(i), this->peers), hash);
+                    }
+                }
+            }
+
+            removed += this->ring.advance(checkpoint * INTERVAL + INTERVAL);
+        }
+
+        EXPECT_EQ(removed, CHECKPOINTS * INTERVAL);
+        EXPECT_EQ(this->ring.size(), 0u);
+    }
+}
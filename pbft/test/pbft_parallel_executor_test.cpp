@@ -0,0 +1,207 @@
+// Copyright (C) 2018 Bluzelle
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU Affero General Public License, version 3,
+// as published by the Free Software Foundation.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU Affero General Public License for more details.
+//
+// You should have received a copy of the GNU Affero General Public License
+// along with this program. If not, see <http://www.gnu.org/licenses/>.
+
+#include <gtest/gtest.h>
+#include <include/bluzelle.hpp>
+#include <pbft/pbft_parallel_executor.hpp>
+#include <storage/mem_storage.hpp>
+#include <chrono>
+#include <random>
+
+using namespace ::testing;
+
+namespace
+{
+    database_msg
+    make_create(const std::string& db, const std::string& key, const std::string& value = "value")
+    {
+        database_msg msg;
+        msg.mutable_header()->set_db_uuid(db);
+        msg.mutable_create()->set_key(key);
+        msg.mutable_create()->set_value(value);
+
+        return msg;
+    }
+
+
+    database_msg
+    make_update(const std::string& db, const std::string& key, const std::string& value)
+    {
+        database_msg msg;
+        msg.mutable_header()->set_db_uuid(db);
+        msg.mutable_update()->set_key(key);
+        msg.mutable_update()->set_value(value);
+
+        return msg;
+    }
+
+
+    database_msg
+    make_delete(const std::string& db, const std::string& key)
+    {
+        database_msg msg;
+        msg.mutable_header()->set_db_uuid(db);
+        msg.mutable_delete_()->set_key(key);
+
+        return msg;
+    }
+
+
+    database_msg
+    make_keys(const std::string& db)
+    {
+        database_msg msg;
+        msg.mutable_header()->set_db_uuid(db);
+        msg.mutable_keys();
+
+        return msg;
+    }
+
+
+    std::vector<const database_msg*>
+    pointers(const std::vector<database_msg>& msgs)
+    {
+        std::vector<const database_msg*> result;
+        for (const auto& msg : msgs)
+        {
+            result.push_back(&msg);
+        }
+
+        return result;
+    }
+
+
+    // the subset of crud that changes state, applied straight to storage
+    void
+    apply(bzn::storage_base& storage, const database_msg& msg)
+    {
+        const auto& db = msg.header().db_uuid();
+
+        switch (msg.msg_case())
+        {
+            case database_msg::kCreate: storage.create(db, msg.create().key(), msg.create().value()); break;
+            case database_msg::kUpdate: storage.update(db, msg.update().key(), msg.update().value()); break;
+            case database_msg::kDelete: storage.remove(db, msg.delete_().key()); break;
+            default: break;
+        }
+    }
+
+
+    std::vector<std::string>
+    state_chunks(bzn::snapshot_storage_base& storage)
+    {
+        const size_t CHUNKS = 16;
+
+        storage.create_snapshot();
+
+        std::vector<std::string> chunks;
+        for (size_t i = 0; i < CHUNKS; ++i)
+        {
+            chunks.push_back(*storage.get_snapshot_chunk(i, CHUNKS));
+        }
+
+        return chunks;
+    }
+}
+
+
+TEST(pbft_parallel_executor, test_that_independent_requests_share_a_wave)
+{
+    const std::vector<database_msg> msgs{make_create("db1", "a"), make_create("db1", "b"), make_create("db2", "a")};
+
+    const auto waves = bzn::pbft_parallel_executor::schedule(pointers(msgs));
+
+    ASSERT_EQ(waves.size(), 1u);
+    EXPECT_EQ(waves[0], std::vector<size_t>({0, 1, 2}));
+}
+
+
+TEST(pbft_parallel_executor, test_that_conflicting_requests_keep_their_order)
+{
+    const std::vector<database_msg> msgs{
+        make_create("db1", "a"),        // 0
+        make_update("db1", "a", "x"),   // 1: after 0
+        make_create("db1", "b"),        // 2
+        make_keys("db1"),               // 3: after everything in db1
+        make_create("db2", "a"),        // 4
+        make_delete("db1", "b"),        // 5: after 3
+        database_msg(),                 // 6: unknown, after everything
+        make_create("db2", "b")};       // 7: after 6
+
+    const auto waves = bzn::pbft_parallel_executor::schedule(pointers(msgs));
+
+    ASSERT_EQ(waves.size(), 6u);
+    EXPECT_EQ(waves[0], std::vector<size_t>({0, 2, 4}));
+    EXPECT_EQ(waves[1], std::vector<size_t>({1}));
+    EXPECT_EQ(waves[2], std::vector<size_t>({3}));
+    EXPECT_EQ(waves[3], std::vector<size_t>({5}));
+    EXPECT_EQ(waves[4], std::vector<size_t>({6}));
+    EXPECT_EQ(waves[5], std::vector<size_t>({7}));
+}
+
+
+TEST(pbft_parallel_executor, test_that_parallel_execution_matches_sequential_state)
+{
+    std::mt19937 gen(42);
+    std::uniform_int_distribution<> db_dist(0, 2), key_dist(0, 20), op_dist(0, 3);
+
+    std::vector<database_msg> msgs;
+    for (size_t i = 0; i < 2000; ++i)
+    {
+        const auto db = "db" + std::to_string(db_dist(gen));
+        const auto key = "key" + std::to_string(key_dist(gen));
+
+        switch (op_dist(gen))
+        {
+            case 0: msgs.push_back(make_create(db, key, std::to_string(i))); break;
+            case 1: msgs.push_back(make_update(db, key, std::to_string(i))); break;
+            case 2: msgs.push_back(make_delete(db, key)); break;
+            default: msgs.push_back(make_keys(db)); break;
+        }
+    }
+
+    bzn::mem_storage sequential;
+    for (const auto& msg : msgs)
+    {
+        apply(sequential, msg);
+    }
+
+    bzn::mem_storage parallel;
+    bzn::pbft_parallel_executor executor(4);
+    executor.execute(pointers(msgs), [&](size_t i)
+    {
+        apply(parallel, msgs[i]);
+    });
+
+    EXPECT_EQ(state_chunks(sequential), state_chunks(parallel));
+}
+
+
+TEST(pbft_parallel_executor, test_that_posted_tasks_run)
+{
+    std::mutex lock;
+    std::condition_variable done;
+    bool ran = false;
+
+    bzn::pbft_parallel_executor executor(2);
+    executor.post([&]()
+    {
+        std::lock_guard<std::mutex> guard(lock);
+        ran = true;
+        done.notify_all();
+    });
+
+    std::unique_lock<std::mutex> guard(lock);
+    EXPECT_TRUE(done.wait_for(guard, std::chrono::seconds(5), [&]() { return ran; }));
+}
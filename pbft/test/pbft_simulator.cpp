@@ -0,0 +1,556 @@
+// Copyright (C) 2018 Bluzelle
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU Affero General Public License, version 3,
+// as published by the Free Software Foundation.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU Affero General Public License for more details.
+//
+// You should have received a copy of the GNU Affero General Public License
+// along with this program. If not, see <http://www.gnu.org/licenses/>.
+
+#include <pbft/test/pbft_simulator.hpp>
+#include <pbft/pbft_failure_detector.hpp>
+#include <utils/make_endpoint.hpp>
+#include <boost/beast/core/detail/base64.hpp>
+
+using namespace bzn::test;
+
+namespace
+{
+    const uint16_t FIRST_PORT = 10000;
+
+    // Timers keep their state apart from themselves so that a wait outliving its timer is simply dropped...
+    class sim_timer final : public bzn::asio::steady_timer_base
+    {
+    public:
+        explicit sim_timer(sim_io_context& io_context)
+            : io_context(io_context)
+            , timer(io_context.get_io_context())
+            , state(std::make_shared<wait_state>())
+        {
+        }
+
+        ~sim_timer() override
+        {
+            this->state->generation++;
+        }
+
+        void async_wait(bzn::asio::wait_handler handler) override
+        {
+            this->state->pending++;
+
+            const auto delay = std::max(this->expiry - this->io_context.now(), std::chrono::nanoseconds(0));
+            this->io_context.schedule(delay, [state = std::weak_ptr<wait_state>(this->state), generation = this->state->generation, handler]()
+            {
+                auto strong_state = state.lock();
+                if (strong_state && strong_state->generation == generation)
+                {
+                    strong_state->pending--;
+                    handler(boost::system::error_code());
+                }
+            });
+
+            this->waiting.push_back(std::move(handler));
+        }
+
+        std::size_t expires_from_now(const std::chrono::milliseconds& expiry_time) override
+        {
+            const auto cancelled = this->cancel_waits();
+            this->expiry = this->io_context.now() + expiry_time;
+
+            return cancelled;
+        }
+
+        void cancel() override
+        {
+            this->cancel_waits();
+        }
+
+        boost::asio::steady_timer& get_steady_timer() override
+        {
+            return this->timer;
+        }
+
+    private:
+        struct wait_state
+        {
+            uint64_t generation = 0;
+            size_t pending = 0;
+        };
+
+        std::size_t cancel_waits()
+        {
+            const auto cancelled = this->state->pending;
+
+            // cancelled waits complete with operation_aborted, as they would with asio...
+            if (cancelled)
+            {
+                for (auto it = this->waiting.end() - cancelled; it != this->waiting.end(); ++it)
+                {
+                    this->io_context.post(std::bind(*it, boost::asio::error::operation_aborted));
+                }
+            }
+
+            this->waiting.clear();
+            this->state->generation++;
+            this->state->pending = 0;
+
+            return cancelled;
+        }
+
+        sim_io_context& io_context;
+        boost::asio::steady_timer timer;
+        const std::shared_ptr<wait_state> state;
+        std::chrono::nanoseconds expiry{0};
+        std::vector<bzn::asio::wait_handler> waiting;
+    };
+
+
+    // Session a message arrived on; nothing is ever sent back over it in the simulation...
+    class sim_null_session final : public bzn::session_base
+    {
+    public:
+        void start(bzn::message_handler /*handler*/, bzn::protobuf_handler /*proto_handler*/) override {}
+        void send_message(std::shared_ptr<bzn::json_message> /*msg*/, bool /*end_session*/) override {}
+        void send_message(std::shared_ptr<bzn::encoded_message> /*msg*/, bool /*end_session*/) override {}
+        void send_datagram(std::shared_ptr<bzn::encoded_message> /*msg*/) override {}
+        void close() override {}
+        bzn::session_id get_session_id() override { return 0; }
+    };
+
+
+    // A client's connection to a replica: the first message back is the request's ack, the second its response.
+    class sim_client_session final : public bzn::session_base
+    {
+    public:
+        explicit sim_client_session(std::function<void()> on_response)
+            : on_response(std::move(on_response))
+        {
+        }
+
+        void start(bzn::message_handler /*handler*/, bzn::protobuf_handler /*proto_handler*/) override {}
+        void send_message(std::shared_ptr<bzn::json_message> /*msg*/, bool /*end_session*/) override {}
+
+        void send_message(std::shared_ptr<bzn::encoded_message> /*msg*/, bool /*end_session*/) override
+        {
+            if (++this->received == 2)
+            {
+                this->on_response();
+            }
+        }
+
+        void send_datagram(std::shared_ptr<bzn::encoded_message> /*msg*/) override {}
+        void close() override {}
+        bzn::session_id get_session_id() override { return 0; }
+
+    private:
+        const std::function<void()> on_response;
+        size_t received = 0;
+    };
+}
+
+
+std::chrono::nanoseconds
+sim_io_context::now() const
+{
+    return this->current;
+}
+
+
+void
+sim_io_context::schedule(std::chrono::nanoseconds delay, bzn::asio::task task)
+{
+    this->events.emplace(std::make_pair(this->current + delay, this->next_event++), std::move(task));
+}
+
+
+size_t
+sim_io_context::run_until(const std::function<bool()>& done, std::chrono::nanoseconds deadline)
+{
+    size_t count = 0;
+    this->stopped = false;
+
+    while (!this->stopped && !this->events.empty() && !done())
+    {
+        auto it = this->events.begin();
+        if (it->first.first > deadline)
+        {
+            // nothing more happens before the deadline, so that is where time stands...
+            this->current = deadline;
+            break;
+        }
+
+        this->current = it->first.first;
+        auto task = std::move(it->second);
+        this->events.erase(it);
+
+        task();
+        ++count;
+    }
+
+    return count;
+}
+
+
+std::unique_ptr<bzn::asio::tcp_acceptor_base>
+sim_io_context::make_unique_tcp_acceptor(const boost::asio::ip::tcp::endpoint& /*ep*/)
+{
+    throw std::runtime_error("sockets are not simulated");
+}
+
+
+std::unique_ptr<bzn::asio::tcp_socket_base>
+sim_io_context::make_unique_tcp_socket()
+{
+    throw std::runtime_error("sockets are not simulated");
+}
+
+
+std::unique_ptr<bzn::asio::udp_socket_base>
+sim_io_context::make_unique_udp_socket()
+{
+    throw std::runtime_error("sockets are not simulated");
+}
+
+
+std::unique_ptr<bzn::asio::steady_timer_base>
+sim_io_context::make_unique_steady_timer()
+{
+    return std::make_unique<sim_timer>(*this);
+}
+
+
+std::unique_ptr<bzn::asio::strand_base>
+sim_io_context::make_unique_strand()
+{
+    // everything runs on one thread already...
+    return std::make_unique<bzn::asio::strand>(this->io_context);
+}
+
+
+void
+sim_io_context::post(bzn::asio::task func)
+{
+    this->schedule(std::chrono::nanoseconds(0), std::move(func));
+}
+
+
+boost::asio::io_context::count_type
+sim_io_context::run()
+{
+    return this->run_until([]() { return false; }, std::chrono::nanoseconds::max());
+}
+
+
+void
+sim_io_context::stop()
+{
+    this->stopped = true;
+}
+
+
+boost::asio::io_context&
+sim_io_context::get_io_context()
+{
+    return this->io_context;
+}
+
+
+sim_network::sim_network(std::shared_ptr<sim_io_context> io_context, sim_link_config config, uint64_t seed)
+    : io_context(std::move(io_context))
+    , config(config)
+    , random(seed)
+{
+}
+
+
+void
+sim_network::attach(const boost::asio::ip::tcp::endpoint& ep, std::weak_ptr<sim_node> node)
+{
+    this->nodes[ep] = std::move(node);
+}
+
+
+void
+sim_network::send(const boost::asio::ip::tcp::endpoint& from, const boost::asio::ip::tcp::endpoint& to, std::shared_ptr<bzn::encoded_message> msg)
+{
+    auto it = this->nodes.find(to);
+    if (it == this->nodes.end())
+    {
+        LOG(debug) << "no simulated node at " << to;
+        return;
+    }
+
+    auto deliver = [node = it->second, msg]()
+    {
+        if (auto strong_node = node.lock())
+        {
+            strong_node->deliver(*msg);
+        }
+    };
+
+    if (from == to)
+    {
+        this->io_context->post(std::move(deliver));
+        return;
+    }
+
+    this->sent++;
+    this->sent_bytes += msg->size();
+
+    // the link is busy while the message is transmitted, whether or not it then gets lost...
+    auto& busy_until = this->link_busy_until[{from, to}];
+    const auto transmission = std::chrono::nanoseconds(std::lround(1e9 * msg->size() / this->config.bandwidth));
+    busy_until = std::max(busy_until, this->io_context->now()) + transmission;
+
+    if (std::uniform_real_distribution<double>(0.0, 1.0)(this->random) < this->config.loss)
+    {
+        this->dropped++;
+        return;
+    }
+
+    const auto jitter = std::chrono::nanoseconds(std::uniform_int_distribution<int64_t>(0,
+        std::chrono::duration_cast<std::chrono::nanoseconds>(this->config.jitter).count())(this->random));
+
+    this->io_context->schedule(busy_until - this->io_context->now() + this->config.latency + jitter, std::move(deliver));
+}
+
+
+std::chrono::nanoseconds
+sim_network::delay(size_t bytes)
+{
+    const auto jitter = std::chrono::nanoseconds(std::uniform_int_distribution<int64_t>(0,
+        std::chrono::duration_cast<std::chrono::nanoseconds>(this->config.jitter).count())(this->random));
+
+    return std::chrono::nanoseconds(std::lround(1e9 * bytes / this->config.bandwidth)) + this->config.latency + jitter;
+}
+
+
+uint64_t
+sim_network::messages_sent() const
+{
+    return this->sent;
+}
+
+
+uint64_t
+sim_network::messages_dropped() const
+{
+    return this->dropped;
+}
+
+
+uint64_t
+sim_network::bytes_sent() const
+{
+    return this->sent_bytes;
+}
+
+
+sim_node::sim_node(std::shared_ptr<sim_network> network, boost::asio::ip::tcp::endpoint ep)
+    : network(std::move(network))
+    , ep(std::move(ep))
+{
+}
+
+
+bool
+sim_node::register_for_message(const std::string& msg_type, bzn::message_handler msg_handler)
+{
+    return this->message_map.emplace(msg_type, std::move(msg_handler)).second;
+}
+
+
+bool
+sim_node::register_for_message(const bzn_envelope::PayloadCase type, bzn::protobuf_handler msg_handler)
+{
+    return this->protobuf_map.emplace(type, std::move(msg_handler)).second;
+}
+
+
+void
+sim_node::start()
+{
+}
+
+
+void
+sim_node::send_message(const boost::asio::ip::tcp::endpoint& ep, std::shared_ptr<bzn::json_message> msg)
+{
+    this->network->send(this->ep, ep, std::make_shared<bzn::encoded_message>(msg->toStyledString()));
+}
+
+
+void
+sim_node::send_message_str(const boost::asio::ip::tcp::endpoint& ep, std::shared_ptr<bzn::encoded_message> msg)
+{
+    this->network->send(this->ep, ep, std::move(msg));
+}
+
+
+void
+sim_node::deliver(const bzn::encoded_message& msg)
+{
+    // same order of probing as a session: json first, then an envelope...
+    bzn::json_message json;
+    if (Json::Reader().parse(msg, json) && json.isMember("bzn-api"))
+    {
+        if (auto it = this->message_map.find(json["bzn-api"].asString()); it != this->message_map.end())
+        {
+            it->second(json, std::make_shared<sim_null_session>());
+        }
+
+        return;
+    }
+
+    bzn_envelope envelope;
+    if (!envelope.ParseFromString(msg))
+    {
+        LOG(error) << "simulated node failed to parse message";
+        return;
+    }
+
+    if (auto it = this->protobuf_map.find(envelope.payload_case()); it != this->protobuf_map.end())
+    {
+        it->second(envelope, std::make_shared<sim_null_session>());
+    }
+}
+
+
+pbft_simulator::pbft_simulator(const sim_config& config)
+    : io_context(std::make_shared<sim_io_context>())
+    , sim_net(std::make_shared<sim_network>(this->io_context, config.link, config.seed))
+{
+    bzn::peers_list_t peers;
+    for (size_t i = 0; i < config.replicas; ++i)
+    {
+        peers.emplace("127.0.0.1", FIRST_PORT + i, FIRST_PORT + i, "sim" + std::to_string(i), "uuid" + std::to_string(i));
+    }
+
+    for (const auto& peer : peers)
+    {
+        replica r;
+        r.uuid = peer.uuid;
+        r.node = std::make_shared<sim_node>(this->sim_net, bzn::make_endpoint(peer));
+        r.storage = std::make_shared<bzn::mem_storage>();
+        r.service = std::make_shared<bzn::database_pbft_service>(this->io_context, std::make_shared<bzn::mem_storage>(),
+            std::make_shared<bzn::crud>(r.storage, nullptr), r.uuid);
+
+        r.pbft = std::make_shared<bzn::pbft>(r.node, this->io_context, peers, r.uuid, r.service,
+            std::make_shared<bzn::pbft_failure_detector>(this->io_context), nullptr);
+        r.pbft->set_audit_enabled(false);
+        r.pbft->start();
+
+        this->sim_net->attach(bzn::make_endpoint(peer), r.node);
+        this->replicas.push_back(std::move(r));
+    }
+
+    // same order on every run, whatever the hash set did...
+    std::sort(this->replicas.begin(), this->replicas.end(), [](const auto& a, const auto& b) { return a.uuid < b.uuid; });
+}
+
+
+void
+pbft_simulator::submit(const bzn::uuid_t& client, uint64_t transaction_id, const std::string& key, const std::string& value,
+    reply_handler on_reply, std::optional<size_t> replica)
+{
+    auto entry = replica ? this->replicas.begin() + replica.value()
+        : std::find_if(this->replicas.begin(), this->replicas.end(), [](const auto& r) { return r.pbft->is_primary(); });
+    if (entry == this->replicas.end())
+    {
+        throw std::runtime_error("simulated cluster has no primary");
+    }
+
+    bzn_msg msg;
+    msg.mutable_db()->mutable_header()->set_db_uuid(client);
+    msg.mutable_db()->mutable_header()->set_transaction_id(transaction_id);
+    msg.mutable_db()->mutable_create()->set_key(key);
+    msg.mutable_db()->mutable_create()->set_value(value);
+
+    bzn::json_message request;
+    request["bzn-api"] = "database";
+    request["msg"] = boost::beast::detail::base64_encode(msg.SerializeAsString());
+
+    const auto started = this->io_context->now();
+
+    const auto id = std::make_pair(client, transaction_id);
+
+    auto session = std::make_shared<sim_client_session>([this, id, transaction_id, started, on_reply = std::move(on_reply)]()
+    {
+        // the session can't go away while it is still being used...
+        this->io_context->post([this, id]() { this->client_sessions.erase(id); });
+
+        this->io_context->schedule(this->sim_net->delay(0), [this, transaction_id, started, on_reply]()
+        {
+            on_reply(transaction_id, this->io_context->now() - started);
+        });
+    });
+
+    this->clients.insert(client);
+    this->client_sessions[id] = session;
+
+    this->io_context->schedule(this->sim_net->delay(request.toStyledString().size()),
+        [pbft = entry->pbft, request, session]()
+        {
+            pbft->handle_database_message(request, session);
+        });
+}
+
+
+bool
+pbft_simulator::run_until(const std::function<bool()>& done, std::chrono::nanoseconds timeout)
+{
+    this->io_context->run_until(done, this->io_context->now() + timeout);
+
+    return done();
+}
+
+
+std::chrono::nanoseconds
+pbft_simulator::now() const
+{
+    return this->io_context->now();
+}
+
+
+size_t
+pbft_simulator::replica_count() const
+{
+    return this->replicas.size();
+}
+
+
+uint64_t
+pbft_simulator::applied_requests_count(size_t replica) const
+{
+    return this->replicas.at(replica).service->applied_requests_count();
+}
+
+
+std::map<std::pair<bzn::uuid_t, std::string>, std::string>
+pbft_simulator::replica_state(size_t replica) const
+{
+    const auto& storage = this->replicas.at(replica).storage;
+
+    std::map<std::pair<bzn::uuid_t, std::string>, std::string> state;
+    for (const auto& client : this->clients)
+    {
+        for (const auto& key : storage->get_keys(client))
+        {
+            state[{client, key}] = storage->read(client, key).value_or("");
+        }
+    }
+
+    return state;
+}
+
+
+const sim_network&
+pbft_simulator::network() const
+{
+    return *this->sim_net;
+}
@@ -0,0 +1,204 @@
+// Copyright (C) 2018 Bluzelle
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU Affero General Public License, version 3,
+// as published by the Free Software Foundation.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU Affero General Public License for more details.
+//
+// You should have received a copy of the GNU Affero General Public License
+// along with this program. If not, see <http://www.gnu.org/licenses/>.
+
+#pragma once
+
+#include <include/bluzelle.hpp>
+#include <include/boost_asio_beast.hpp>
+#include <crud/crud.hpp>
+#include <node/node_base.hpp>
+#include <pbft/database_pbft_service.hpp>
+#include <pbft/pbft.hpp>
+#include <storage/mem_storage.hpp>
+#include <chrono>
+#include <map>
+#include <optional>
+#include <random>
+#include <set>
+#include <vector>
+
+
+namespace bzn::test
+{
+    // An io_context running in virtual time: posted tasks, timers and message deliveries are events that run in
+    // time order (and in the order they were scheduled at the same time) on the thread calling run_until. Nothing
+    // depends on the wall clock, so a simulation is fully determined by its configuration and seed.
+    class sim_io_context final : public bzn::asio::io_context_base
+    {
+    public:
+        std::chrono::nanoseconds now() const;
+
+        void schedule(std::chrono::nanoseconds delay, bzn::asio::task task);
+
+        // run events until done() is true, no events are left or the virtual deadline is passed
+        size_t run_until(const std::function<bool()>& done, std::chrono::nanoseconds deadline);
+
+        std::unique_ptr<bzn::asio::tcp_acceptor_base> make_unique_tcp_acceptor(const boost::asio::ip::tcp::endpoint& ep) override;
+        std::unique_ptr<bzn::asio::tcp_socket_base> make_unique_tcp_socket() override;
+        std::unique_ptr<bzn::asio::udp_socket_base> make_unique_udp_socket() override;
+        std::unique_ptr<bzn::asio::steady_timer_base> make_unique_steady_timer() override;
+        std::unique_ptr<bzn::asio::strand_base> make_unique_strand() override;
+
+        void post(bzn::asio::task func) override;
+
+        boost::asio::io_context::count_type run() override;
+
+        void stop() override;
+
+        boost::asio::io_context& get_io_context() override;
+
+    private:
+        std::chrono::nanoseconds current{0};
+        uint64_t next_event = 0;
+        std::map<std::pair<std::chrono::nanoseconds, uint64_t>, bzn::asio::task> events;
+        bool stopped = false;
+
+        // never run; only there to back the parts of the interface that hand out real asio objects
+        boost::asio::io_context io_context;
+    };
+
+
+    struct sim_link_config
+    {
+        std::chrono::microseconds latency{500};
+        std::chrono::microseconds jitter{100};  // uniformly distributed extra delay
+        double bandwidth = 125e6;               // bytes per second, per direction of each link
+        double loss = 0.0;                      // probability of a message being dropped
+    };
+
+
+    class sim_node;
+
+    // Point to point links between simulated nodes. Each direction of a link sends one message at a time at the
+    // configured bandwidth, after which it arrives latency plus jitter later unless it is lost. A node sending to
+    // itself skips the network altogether.
+    class sim_network final
+    {
+    public:
+        sim_network(std::shared_ptr<sim_io_context> io_context, sim_link_config config, uint64_t seed);
+
+        void attach(const boost::asio::ip::tcp::endpoint& ep, std::weak_ptr<sim_node> node);
+
+        void send(const boost::asio::ip::tcp::endpoint& from, const boost::asio::ip::tcp::endpoint& to, std::shared_ptr<bzn::encoded_message> msg);
+
+        // one way delay of a message of the given size on an idle link, for modelling client hops
+        std::chrono::nanoseconds delay(size_t bytes);
+
+        uint64_t messages_sent() const;
+        uint64_t messages_dropped() const;
+        uint64_t bytes_sent() const;
+
+    private:
+        const std::shared_ptr<sim_io_context> io_context;
+        const sim_link_config config;
+        std::mt19937_64 random;
+
+        std::map<boost::asio::ip::tcp::endpoint, std::weak_ptr<sim_node>> nodes;
+        std::map<std::pair<boost::asio::ip::tcp::endpoint, boost::asio::ip::tcp::endpoint>, std::chrono::nanoseconds> link_busy_until;
+
+        uint64_t sent = 0;
+        uint64_t dropped = 0;
+        uint64_t sent_bytes = 0;
+    };
+
+
+    // Stands in for bzn::node, dispatching delivered messages to registered handlers the way its sessions do.
+    class sim_node final : public bzn::node_base, public std::enable_shared_from_this<sim_node>
+    {
+    public:
+        sim_node(std::shared_ptr<sim_network> network, boost::asio::ip::tcp::endpoint ep);
+
+        bool register_for_message(const std::string& msg_type, bzn::message_handler msg_handler) override;
+
+        bool register_for_message(const bzn_envelope::PayloadCase type, bzn::protobuf_handler msg_handler) override;
+
+        // the simulated network delivers regardless...
+        void register_backlog(const std::string& /*name*/, std::function<size_t()> /*depth*/, size_t /*limit*/) override {}
+
+        void start() override;
+
+        void send_message(const boost::asio::ip::tcp::endpoint& ep, std::shared_ptr<bzn::json_message> msg) override;
+
+        void send_message_str(const boost::asio::ip::tcp::endpoint& ep, std::shared_ptr<bzn::encoded_message> msg) override;
+
+        void deliver(const bzn::encoded_message& msg);
+
+    private:
+        const std::shared_ptr<sim_network> network;
+        const boost::asio::ip::tcp::endpoint ep;
+
+        std::unordered_map<std::string, bzn::message_handler> message_map;
+        std::unordered_map<bzn_envelope::PayloadCase, bzn::protobuf_handler> protobuf_map;
+    };
+
+
+    struct sim_config
+    {
+        size_t replicas = 4;
+        sim_link_config link;
+        uint64_t seed = 1;
+    };
+
+
+    // A cluster of real pbft replicas, each with its own database service on in-memory storage, talking over a
+    // sim_network. Clients sit one link away from the primary.
+    class pbft_simulator final
+    {
+    public:
+        using reply_handler = std::function<void(uint64_t transaction_id, std::chrono::nanoseconds latency)>;
+
+        explicit pbft_simulator(const sim_config& config);
+
+        // send a create request to the primary, or to the given replica, on behalf of a client (one database per client,
+        // as pbft allows each client a single outstanding request); on_reply is called when the executed request's
+        // response arrives
+        void submit(const bzn::uuid_t& client, uint64_t transaction_id, const std::string& key, const std::string& value,
+            reply_handler on_reply, std::optional<size_t> replica = std::nullopt);
+
+        // advance virtual time until done() is true or the deadline (relative to now) has passed
+        bool run_until(const std::function<bool()>& done, std::chrono::nanoseconds timeout);
+
+        std::chrono::nanoseconds now() const;
+
+        size_t replica_count() const;
+
+        uint64_t applied_requests_count(size_t replica) const;
+
+        // every record stored by a replica, keyed by client and key
+        std::map<std::pair<bzn::uuid_t, std::string>, std::string> replica_state(size_t replica) const;
+
+        const sim_network& network() const;
+
+    private:
+        struct replica
+        {
+            bzn::uuid_t uuid;
+            std::shared_ptr<sim_node> node;
+            std::shared_ptr<bzn::mem_storage> storage;
+            std::shared_ptr<bzn::database_pbft_service> service;
+            std::shared_ptr<bzn::pbft> pbft;
+        };
+
+        const std::shared_ptr<sim_io_context> io_context;
+        const std::shared_ptr<sim_network> sim_net;
+
+        std::vector<replica> replicas;
+
+        std::set<bzn::uuid_t> clients;
+
+        // sessions of requests awaiting their response
+        std::map<std::pair<bzn::uuid_t, uint64_t>, std::shared_ptr<bzn::session_base>> client_sessions;
+    };
+
+} // namespace bzn::test
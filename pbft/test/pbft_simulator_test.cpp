@@ -0,0 +1,161 @@
+// Copyright (C) 2018 Bluzelle
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU Affero General Public License, version 3,
+// as published by the Free Software Foundation.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU Affero General Public License for more details.
+//
+// You should have received a copy of the GNU Affero General Public License
+// along with this program. If not, see <http://www.gnu.org/licenses/>.
+
+#include <gtest/gtest.h>
+#include <pbft/test/pbft_simulator.hpp>
+#include <boost/log/core.hpp>
+
+using namespace ::testing;
+
+namespace
+{
+    const std::chrono::seconds TIMEOUT{60};
+
+    struct run_result
+    {
+        std::vector<std::pair<uint64_t, std::chrono::nanoseconds>> replies;
+        std::vector<std::map<std::pair<bzn::uuid_t, std::string>, std::string>> states;
+        uint64_t messages_sent = 0;
+    };
+
+    run_result
+    run_requests(const bzn::test::sim_config& config, size_t requests, bool spread_clients = false)
+    {
+        bzn::test::pbft_simulator sim(config);
+        run_result result;
+
+        for (uint64_t i = 1; i <= requests; ++i)
+        {
+            sim.submit("client" + std::to_string(i), i, "key" + std::to_string(i), "value" + std::to_string(i),
+                [&result](uint64_t txn, std::chrono::nanoseconds latency)
+                {
+                    result.replies.emplace_back(txn, latency);
+                },
+                spread_clients ? std::optional<size_t>(i % sim.replica_count()) : std::nullopt);
+        }
+
+        sim.run_until([&]()
+        {
+            for (size_t r = 0; r < sim.replica_count(); ++r)
+            {
+                if (sim.applied_requests_count(r) < requests)
+                {
+                    return false;
+                }
+            }
+            return result.replies.size() == requests;
+        }, TIMEOUT);
+
+        for (size_t r = 0; r < sim.replica_count(); ++r)
+        {
+            result.states.push_back(sim.replica_state(r));
+        }
+        result.messages_sent = sim.network().messages_sent();
+
+        return result;
+    }
+
+    class pbft_simulator_test : public Test
+    {
+    public:
+        pbft_simulator_test()
+        {
+            boost::log::core::get()->set_logging_enabled(false);
+        }
+
+        ~pbft_simulator_test()
+        {
+            boost::log::core::get()->set_logging_enabled(true);
+        }
+    };
+}
+
+
+TEST_F(pbft_simulator_test, test_that_every_replica_executes_every_request)
+{
+    const size_t REQUESTS = 20;
+
+    bzn::test::sim_config config;
+    const auto result = run_requests(config, REQUESTS);
+
+    ASSERT_EQ(result.replies.size(), REQUESTS);
+    ASSERT_EQ(result.states.size(), config.replicas);
+
+    EXPECT_EQ(result.states[0].size(), REQUESTS);
+    EXPECT_EQ(result.states[0].at({"client7", "key7"}), "value7");
+
+    for (const auto& state : result.states)
+    {
+        EXPECT_EQ(state, result.states[0]);
+    }
+
+    // a commit takes at least the three message delays of the protocol plus the client hops...
+    for (const auto& reply : result.replies)
+    {
+        EXPECT_GE(reply.second, 5 * config.link.latency);
+    }
+}
+
+
+TEST_F(pbft_simulator_test, test_that_clients_of_backups_get_replies)
+{
+    const size_t REQUESTS = 20;
+
+    bzn::test::sim_config config;
+    const auto result = run_requests(config, REQUESTS, true);
+
+    // requests sent to backups make two more hops, to the primary and back...
+    ASSERT_EQ(result.replies.size(), REQUESTS);
+
+    for (const auto& state : result.states)
+    {
+        EXPECT_EQ(state.size(), REQUESTS);
+        EXPECT_EQ(state, result.states[0]);
+    }
+}
+
+
+TEST_F(pbft_simulator_test, test_that_runs_with_same_seed_are_identical)
+{
+    bzn::test::sim_config config;
+    config.replicas = 7;
+    config.seed = 42;
+
+    const auto first = run_requests(config, 10);
+    const auto second = run_requests(config, 10);
+
+    ASSERT_EQ(first.replies.size(), 10u);
+    EXPECT_EQ(first.replies, second.replies);
+    EXPECT_EQ(first.states, second.states);
+    EXPECT_EQ(first.messages_sent, second.messages_sent);
+
+    config.seed = 43;
+    EXPECT_NE(run_requests(config, 10).replies, first.replies);
+}
+
+
+TEST_F(pbft_simulator_test, test_that_lossy_network_is_deterministic)
+{
+    bzn::test::sim_config config;
+    config.link.loss = 0.02;
+    config.seed = 7;
+
+    const auto first = run_requests(config, 10);
+    const auto second = run_requests(config, 10);
+
+    // pbft has no retransmission, so a lost message may stall a request; whatever happens happens the same way...
+    EXPECT_EQ(first.replies, second.replies);
+    EXPECT_EQ(first.states, second.states);
+    EXPECT_FALSE(first.replies.empty());
+}
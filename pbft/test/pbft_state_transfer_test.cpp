@@ -0,0 +1,141 @@
+// Copyright (C) 2018 Bluzelle
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU Affero General Public License, version 3,
+// as published by the Free Software Foundation.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU Affero General Public License for more details.
+//
+// You should have received a copy of the GNU Affero General Public License
+// along with this program. If not, see <http://www.gnu.org/licenses/>.
+
+#include <pbft/pbft_state_transfer.hpp>
+#include <gtest/gtest.h>
+
+using namespace ::testing;
+
+namespace
+{
+    const std::vector<bzn::uuid_t> TEST_SOURCES{"uuid0", "uuid2", "uuid3"};
+
+    std::vector<std::string>
+    make_chunks()
+    {
+        std::vector<std::string> chunks;
+        for (size_t i = 0; i < STATE_CHUNK_COUNT; ++i)
+        {
+            chunks.push_back("chunk " + std::to_string(i));
+        }
+
+        return chunks;
+    }
+
+    std::vector<bzn::hash_t>
+    make_manifest(const std::vector<std::string>& chunks)
+    {
+        std::vector<bzn::hash_t> manifest;
+        for (const auto& chunk : chunks)
+        {
+            manifest.push_back(bzn::pbft_state_transfer::chunk_hash(chunk));
+        }
+
+        return manifest;
+    }
+}
+
+
+TEST(pbft_state_transfer, test_that_manifest_must_match_checkpoint_hash)
+{
+    const auto manifest = make_manifest(make_chunks());
+
+    bzn::pbft_state_transfer transfer({100, "not the state hash"}, TEST_SOURCES);
+    EXPECT_FALSE(transfer.set_manifest(manifest));
+    EXPECT_FALSE(transfer.has_manifest());
+
+    bzn::pbft_state_transfer transfer2({100, bzn::pbft_state_transfer::state_hash(manifest)}, TEST_SOURCES);
+    EXPECT_TRUE(transfer2.set_manifest(manifest));
+    EXPECT_TRUE(transfer2.has_manifest());
+}
+
+
+TEST(pbft_state_transfer, test_that_chunks_are_spread_across_sources)
+{
+    const auto manifest = make_manifest(make_chunks());
+
+    bzn::pbft_state_transfer transfer({100, bzn::pbft_state_transfer::state_hash(manifest)}, TEST_SOURCES);
+    ASSERT_TRUE(transfer.set_manifest(manifest));
+    transfer.set_needed_chunks({1, 2, 3, 4, 5, 6});
+
+    const auto assignments = transfer.assign_chunks();
+
+    EXPECT_EQ(TEST_SOURCES.size(), assignments.size());
+    for (const auto& assignment : assignments)
+    {
+        EXPECT_EQ(size_t(2), assignment.second.size());
+    }
+}
+
+
+TEST(pbft_state_transfer, test_that_outstanding_chunks_move_to_the_next_source)
+{
+    const auto chunks = make_chunks();
+    const auto manifest = make_manifest(chunks);
+
+    bzn::pbft_state_transfer transfer({100, bzn::pbft_state_transfer::state_hash(manifest)}, TEST_SOURCES);
+    ASSERT_TRUE(transfer.set_manifest(manifest));
+    transfer.set_needed_chunks({1, 2, 3});
+
+    const auto first = transfer.assign_chunks();
+    EXPECT_EQ(first, transfer.assign_chunks());
+
+    ASSERT_TRUE(transfer.add_chunk(1, chunks[1]));
+    transfer.move_outstanding_chunks();
+
+    const auto second = transfer.assign_chunks();
+
+    std::map<size_t, bzn::uuid_t> before;
+    for (const auto& assignment : first)
+    {
+        for (const auto chunk : assignment.second)
+        {
+            before[chunk] = assignment.first;
+        }
+    }
+
+    size_t outstanding = 0;
+    for (const auto& assignment : second)
+    {
+        for (const auto chunk : assignment.second)
+        {
+            EXPECT_NE(1u, chunk);
+            EXPECT_NE(before[chunk], assignment.first);
+            ++outstanding;
+        }
+    }
+
+    EXPECT_EQ(2u, outstanding);
+}
+
+
+TEST(pbft_state_transfer, test_that_only_matching_needed_chunks_are_accepted)
+{
+    const auto chunks = make_chunks();
+    const auto manifest = make_manifest(chunks);
+
+    bzn::pbft_state_transfer transfer({100, bzn::pbft_state_transfer::state_hash(manifest)}, TEST_SOURCES);
+    ASSERT_TRUE(transfer.set_manifest(manifest));
+    transfer.set_needed_chunks({1, 7});
+
+    EXPECT_FALSE(transfer.add_chunk(2, chunks[2]));
+    EXPECT_FALSE(transfer.add_chunk(1, chunks[7]));
+    EXPECT_TRUE(transfer.add_chunk(1, chunks[1]));
+    EXPECT_FALSE(transfer.is_complete());
+
+    EXPECT_TRUE(transfer.add_chunk(7, chunks[7]));
+    EXPECT_TRUE(transfer.is_complete());
+    EXPECT_TRUE(transfer.assign_chunks().empty());
+    EXPECT_EQ(size_t(2), transfer.get_chunks().size());
+}
@@ -34,29 +34,217 @@ namespace bzn::test
     {
         this->build_pbft();
         EXPECT_CALL(*mock_node, send_message_str(_, ResultOf(is_preprepare, Eq(true))))
-                .Times(Exactly(TEST_PEER_LIST.size()));
+                .Times(Exactly(TEST_PEER_LIST.size() - 1));
 
         pbft->handle_database_message(this->request_json, this->mock_session);
     }
 
+    TEST_F(pbft_test, test_retry_on_another_connection_is_not_ordered_again)
+    {
+        this->build_pbft();
+        EXPECT_CALL(*mock_node, send_message_str(_, ResultOf(is_preprepare, Eq(true))))
+                .Times(Exactly(TEST_PEER_LIST.size() - 1));
+
+        auto other_session = std::make_shared<NiceMock<bzn::Mocksession_base>>();
+        ON_CALL(*this->mock_session, get_session_id()).WillByDefault(Return(1));
+        ON_CALL(*other_session, get_session_id()).WillByDefault(Return(2));
+
+        // no client id, so the database and transaction id say it's the same request...
+        pbft->handle_database_message(this->request_json, this->mock_session);
+        pbft->handle_database_message(this->request_json, other_session);
+    }
+
+    TEST_F(pbft_test, test_same_request_from_different_clients_is_ordered_for_each)
+    {
+        this->build_pbft();
+        EXPECT_CALL(*mock_node, send_message_str(_, ResultOf(is_preprepare, Eq(true))))
+                .Times(Exactly(2 * (TEST_PEER_LIST.size() - 1)));
+
+        database_msg req;
+        req.mutable_header()->set_transaction_id(5);
+
+        req.mutable_header()->set_client_id("client1");
+        pbft->handle_database_message(wrap_request(req), this->mock_session);
+
+        req.mutable_header()->set_client_id("client2");
+        pbft->handle_database_message(wrap_request(req), this->mock_session);
+    }
+
+    TEST_F(pbft_test, test_retry_with_a_client_id_on_another_connection_is_not_ordered_again)
+    {
+        this->build_pbft();
+        EXPECT_CALL(*mock_node, send_message_str(_, ResultOf(is_preprepare, Eq(true))))
+                .Times(Exactly(TEST_PEER_LIST.size() - 1));
+
+        auto other_session = std::make_shared<NiceMock<bzn::Mocksession_base>>();
+        ON_CALL(*this->mock_session, get_session_id()).WillByDefault(Return(1));
+        ON_CALL(*other_session, get_session_id()).WillByDefault(Return(2));
+
+        database_msg req;
+        req.mutable_header()->set_client_id("client1");
+        req.mutable_header()->set_transaction_id(5);
+
+        pbft->handle_database_message(wrap_request(req), this->mock_session);
+        pbft->handle_database_message(wrap_request(req), other_session);
+    }
+
     TEST_F(pbft_test, test_forwarded_to_primary_when_not_primary)
     {
-        boost::asio::ip::tcp::endpoint msg_sent_to;
-        bzn::json_message msg_sent;
+        std::vector<bzn::asio::task> posted;
+        EXPECT_CALL(*(this->mock_io_context), post(_)).WillRepeatedly(Invoke([&](auto task){ posted.push_back(task); }));
+
+        this->uuid = SECOND_NODE_UUID;
+        this->build_pbft();
+        EXPECT_FALSE(pbft->is_primary());
 
-        EXPECT_CALL(*mock_node, send_message(_, _)).Times(1).WillRepeatedly(Invoke(
-                [&](auto ep, auto msg)
+        // requests arriving together go to the primary together...
+        pbft->handle_database_message(this->request_json, this->mock_session);
+        pbft->handle_database_message(this->request_json, this->mock_session);
+
+        pbft_msg forwarded;
+        EXPECT_CALL(*mock_node, send_message_str(make_endpoint(this->pbft->get_primary()), _)).WillOnce(Invoke(
+                [&](auto, auto msg)
                 {
-                    EXPECT_EQ(ep, make_endpoint(this->pbft->get_primary()));
-                    EXPECT_EQ((*msg)["bzn-api"], "database");
+                    forwarded = extract_pbft_msg(*msg);
                 }));
 
+        ASSERT_EQ(posted.size(), 1u);
+        posted.front()();
+
+        EXPECT_EQ(forwarded.type(), PBFT_MSG_FORWARD);
+        ASSERT_EQ(forwarded.forwarded_requests_size(), 2);
+        EXPECT_NE(forwarded.forwarded_requests(0).forward_id(), forwarded.forwarded_requests(1).forward_id());
+        EXPECT_TRUE(forwarded.forwarded_requests(0).request().has_operation());
+    }
+
+    TEST_F(pbft_test, test_reply_to_forwarded_request_relayed_to_client)
+    {
+        std::vector<bzn::asio::task> posted;
+        EXPECT_CALL(*(this->mock_io_context), post(_)).WillRepeatedly(Invoke([&](auto task){ posted.push_back(task); }));
+
         this->uuid = SECOND_NODE_UUID;
         this->build_pbft();
-        EXPECT_FALSE(pbft->is_primary());
+
+        pbft_msg forwarded;
+        EXPECT_CALL(*mock_node, send_message_str(_, _)).WillOnce(Invoke(
+                [&](auto, auto msg)
+                {
+                    forwarded = extract_pbft_msg(*msg);
+                }));
 
         pbft->handle_database_message(this->request_json, this->mock_session);
+        ASSERT_EQ(posted.size(), 1u);
+        posted.front()();
+        ASSERT_EQ(forwarded.forwarded_requests_size(), 1);
+
+        database_response response;
+        response.mutable_header()->set_transaction_id(42);
 
+        EXPECT_CALL(*mock_session, send_message(Matcher<std::shared_ptr<bzn::encoded_message>>(Pointee(Eq(response.SerializeAsString()))), false))
+                .Times(Exactly(1));
+
+        pbft_msg reply;
+        reply.set_type(PBFT_MSG_FORWARD_REPLY);
+        reply.set_forward_id(forwarded.forwarded_requests(0).forward_id());
+        reply.set_forward_reply(response.SerializeAsString());
+
+        // only the replica the request went to can answer it, and only once...
+        this->pbft->handle_message(reply, from("not the primary"));
+        this->pbft->handle_message(reply, from(this->pbft->get_primary().uuid));
+        this->pbft->handle_message(reply, from(this->pbft->get_primary().uuid));
+    }
+
+    TEST_F(pbft_test, test_primary_sends_reply_to_forwarded_request_back_to_forwarder)
+    {
+        std::vector<bzn::asio::task> posted;
+        EXPECT_CALL(*(this->mock_io_context), post(_)).WillRepeatedly(Invoke([&](auto task){ posted.push_back(task); }));
+
+        std::shared_ptr<bzn::pbft_operation> executed;
+        EXPECT_CALL(*(this->mock_service), apply_operation(_)).WillOnce(Invoke([&](auto op){ executed = op; }));
+
+        this->build_pbft();
+        ASSERT_TRUE(this->pbft->is_primary());
+
+        const auto forwarder = std::find_if(TEST_PEER_LIST.begin(), TEST_PEER_LIST.end(), [](const auto& p){ return p.uuid == SECOND_NODE_UUID; });
+
+        pbft_msg forward;
+        forward.set_type(PBFT_MSG_FORWARD);
+        auto forwarded = forward.add_forwarded_requests();
+        forwarded->set_forward_id(7);
+        *forwarded->mutable_request() = this->preprepare_msg.request();
+
+        EXPECT_CALL(*mock_node, send_message_str(_, ResultOf(is_preprepare, Eq(false))))
+                .Times(AnyNumber());
+        EXPECT_CALL(*mock_node, send_message_str(_, ResultOf(is_preprepare, Eq(true))))
+                .Times(Exactly(TEST_PEER_LIST.size() - 1));
+
+        this->pbft->handle_message(forward, from(SECOND_NODE_UUID));
+
+        pbft_msg preprepare = pbft_msg(this->preprepare_msg);
+        preprepare.set_sequence(1);
+
+        for (const auto& peer : TEST_PEER_LIST)
+        {
+            pbft_msg prepare = pbft_msg(preprepare);
+            pbft_msg commit = pbft_msg(preprepare);
+            prepare.set_type(PBFT_MSG_PREPARE);
+            commit.set_type(PBFT_MSG_COMMIT);
+            this->pbft->handle_message(prepare, from(peer.uuid));
+            this->pbft->handle_message(commit, from(peer.uuid));
+        }
+
+        while (!posted.empty())
+        {
+            auto task = posted.front();
+            posted.erase(posted.begin());
+            task();
+        }
+
+        ASSERT_TRUE(executed);
+        auto session = executed->session().lock();
+        ASSERT_TRUE(session);
+
+        Mock::VerifyAndClearExpectations(mock_node.get());
+
+        pbft_msg reply;
+        EXPECT_CALL(*mock_node, send_message_str(make_endpoint(*forwarder), _)).WillOnce(Invoke(
+                [&](auto, auto msg)
+                {
+                    reply = extract_pbft_msg(*msg);
+                }));
+
+        session->send_message(std::make_shared<bzn::encoded_message>("response"), false);
+
+        // ...sent once the posted task can take pbft_lock
+        ASSERT_FALSE(posted.empty());
+        while (!posted.empty())
+        {
+            auto task = posted.front();
+            posted.erase(posted.begin());
+            task();
+        }
+
+        EXPECT_EQ(reply.type(), PBFT_MSG_FORWARD_REPLY);
+        EXPECT_EQ(reply.forward_id(), 7u);
+        EXPECT_EQ(reply.forward_reply(), "response");
+    }
+
+    TEST_F(pbft_test, test_forward_from_non_member_ignored)
+    {
+        this->build_pbft();
+        ASSERT_TRUE(this->pbft->is_primary());
+
+        pbft_msg forward;
+        forward.set_type(PBFT_MSG_FORWARD);
+        auto forwarded = forward.add_forwarded_requests();
+        forwarded->set_forward_id(7);
+        *forwarded->mutable_request() = this->preprepare_msg.request();
+
+        EXPECT_CALL(*mock_node, send_message_str(_, ResultOf(is_preprepare, Eq(true))))
+                .Times(Exactly(0));
+
+        this->pbft->handle_message(forward, from("not a swarm member"));
+        this->pbft->handle_message(forward, from(""));
     }
 
     std::set<uint64_t> seen_sequences;
@@ -88,7 +276,7 @@ namespace bzn::test
     {
         this->build_pbft();
         EXPECT_CALL(*mock_node, send_message_str(_, ResultOf(is_prepare, Eq(true))))
-                .Times(Exactly(TEST_PEER_LIST.size()));
+                .Times(Exactly(TEST_PEER_LIST.size() - 1));
 
         this->pbft->handle_message(this->preprepare_msg, default_original_msg);
     }
@@ -121,7 +309,7 @@ namespace bzn::test
     TEST_F(pbft_test, test_no_duplicate_prepares_same_sequence_number)
     {
         this->build_pbft();
-        EXPECT_CALL(*mock_node, send_message_str(_, _)).Times(Exactly(TEST_PEER_LIST.size()));
+        EXPECT_CALL(*mock_node, send_message_str(_, _)).Times(Exactly(TEST_PEER_LIST.size() - 1));
 
         pbft_msg prepreparea(this->preprepare_msg);
         pbft_msg preprepareb(this->preprepare_msg);
@@ -142,9 +330,9 @@ namespace bzn::test
     {
         this->build_pbft();
         EXPECT_CALL(*mock_node, send_message_str(_, ResultOf(is_prepare, Eq(true))))
-                .Times(Exactly(TEST_PEER_LIST.size()));
+                .Times(Exactly(TEST_PEER_LIST.size() - 1));
         EXPECT_CALL(*mock_node, send_message_str(_, ResultOf(is_commit, Eq(true))))
-                .Times(Exactly(TEST_PEER_LIST.size()));
+                .Times(Exactly(TEST_PEER_LIST.size() - 1));
 
         this->pbft->handle_message(this->preprepare_msg, default_original_msg);
         for (const auto& peer : TEST_PEER_LIST)
@@ -155,9 +343,62 @@ namespace bzn::test
         }
     }
 
+    TEST_F(pbft_test, test_own_messages_delivered_without_network)
+    {
+        std::vector<bzn::asio::task> posted;
+        EXPECT_CALL(*(this->mock_io_context), post(_)).WillRepeatedly(Invoke([&](auto task){ posted.push_back(task); }));
+
+        const auto self = std::find_if(TEST_PEER_LIST.begin(), TEST_PEER_LIST.end(), [](const auto& p){ return p.uuid == TEST_NODE_UUID; });
+        EXPECT_CALL(*mock_node, send_message_str(bzn::make_endpoint(*self), _)).Times(Exactly(0));
+
+        this->build_pbft();
+
+        std::set<std::shared_ptr<bzn::encoded_message>> buffers;
+        EXPECT_CALL(*mock_node, send_message_str(Ne(bzn::make_endpoint(*self)), ResultOf(is_prepare, Eq(true))))
+            .Times(Exactly(TEST_PEER_LIST.size() - 1))
+            .WillRepeatedly(Invoke([&](auto, auto msg){ buffers.insert(msg); }));
+
+        this->pbft->handle_message(this->preprepare_msg, default_original_msg);
+        EXPECT_EQ(buffers.size(), 1u);
+        EXPECT_EQ(this->pbft->get_metrics().messages_received(PBFT_MSG_PREPARE), 0u);
+
+        ASSERT_EQ(posted.size(), 1u);
+        posted.front()();
+        EXPECT_EQ(this->pbft->get_metrics().messages_received(PBFT_MSG_PREPARE), 1u);
+    }
+
     TEST_F(pbft_test, test_commits_applied)
     {
-        EXPECT_CALL(*(this->mock_io_context), post(_)).Times(Exactly(1));
+        std::vector<bzn::asio::task> posted;
+        EXPECT_CALL(*(this->mock_io_context), post(_)).WillRepeatedly(Invoke([&](auto task){ posted.push_back(task); }));
+        EXPECT_CALL(*(this->mock_service), apply_operation(_)).Times(Exactly(1));
+        this->build_pbft();
+
+        pbft_msg preprepare = pbft_msg(this->preprepare_msg);
+        preprepare.set_sequence(1);
+        this->pbft->handle_message(preprepare, default_original_msg);
+
+        for (const auto& peer : TEST_PEER_LIST)
+        {
+            pbft_msg prepare = pbft_msg(preprepare);
+            pbft_msg commit = pbft_msg(preprepare);
+            prepare.set_type(PBFT_MSG_PREPARE);
+            commit.set_type(PBFT_MSG_COMMIT);
+            this->pbft->handle_message(prepare, from(peer.uuid));
+            this->pbft->handle_message(commit, from(peer.uuid));
+        }
+
+        // our own prepare and commit come back too, but change nothing...
+        while (!posted.empty())
+        {
+            auto task = posted.front();
+            posted.erase(posted.begin());
+            task();
+        }
+    }
+
+    TEST_F(pbft_test, test_committed_operation_reported_in_metrics)
+    {
         this->build_pbft();
 
         pbft_msg preprepare = pbft_msg(this->preprepare_msg);
@@ -173,11 +414,80 @@ namespace bzn::test
             this->pbft->handle_message(prepare, from(peer.uuid));
             this->pbft->handle_message(commit, from(peer.uuid));
         }
+
+        this->service_execute_handler(preprepare.request(), 1);
+
+        const auto& metrics = this->pbft->get_metrics();
+        EXPECT_EQ(metrics.messages_received(PBFT_MSG_PREPREPARE), 1u);
+        EXPECT_EQ(metrics.messages_received(PBFT_MSG_PREPARE), TEST_PEER_LIST.size());
+        EXPECT_EQ(metrics.messages_received(PBFT_MSG_COMMIT), TEST_PEER_LIST.size());
+        EXPECT_EQ(metrics.histogram(bzn::pbft_metrics::phase::commit).count(), 1u);
+        EXPECT_EQ(metrics.histogram(bzn::pbft_metrics::phase::total).count(), 1u);
+
+        auto mock_session = std::make_shared<NiceMock<bzn::Mocksession_base>>();
+        EXPECT_CALL(*mock_session, send_message(A<std::shared_ptr<bzn::json_message>>(), false)).WillOnce(Invoke(
+            [](auto msg, auto)
+            {
+                EXPECT_EQ((*msg)["metrics"]["phases"]["execute"]["count"].asUInt64(), 1u);
+                EXPECT_EQ((*msg)["metrics"]["messages"]["PBFT_MSG_COMMIT"]["count"].asUInt64(), TEST_PEER_LIST.size());
+            }));
+
+        bzn::json_message msg;
+        msg["bzn-api"] = "metrics";
+        this->metrics_handler(msg, mock_session);
+    }
+
+    TEST_F(pbft_test, test_prepared_operation_applied_tentatively_when_enabled)
+    {
+        std::vector<bzn::asio::task> posted;
+        EXPECT_CALL(*(this->mock_io_context), post(_)).WillRepeatedly(Invoke([&](auto task){ posted.push_back(task); }));
+        EXPECT_CALL(*(this->mock_service), apply_operation_tentatively(_)).Times(Exactly(1));
+        EXPECT_CALL(*(this->mock_service), apply_operation(_)).Times(Exactly(0));
+        this->build_pbft();
+        this->pbft->set_tentative_execution_enabled(true);
+
+        pbft_msg preprepare = pbft_msg(this->preprepare_msg);
+        preprepare.set_sequence(1);
+        preprepare.mutable_request()->mutable_operation();
+        this->pbft->handle_message(preprepare, default_original_msg);
+
+        for (const auto& peer : TEST_PEER_LIST)
+        {
+            pbft_msg prepare = pbft_msg(preprepare);
+            prepare.set_type(PBFT_MSG_PREPARE);
+            this->pbft->handle_message(prepare, from(peer.uuid));
+        }
+
+        for (size_t i = 0; i < posted.size(); ++i)
+        {
+            posted[i]();
+        }
+    }
+
+    TEST_F(pbft_test, test_that_retry_of_rolled_back_request_is_ordered_again)
+    {
+        this->build_pbft();
+        this->pbft->set_tentative_execution_enabled(true);
+
+        std::vector<pbft_request> ordered;
+        EXPECT_CALL(*mock_node, send_message_str(_, ResultOf(is_preprepare, Eq(true))))
+                .WillRepeatedly(Invoke([&](auto, auto msg) { ordered.push_back(extract_pbft_msg(*msg).request()); }));
+
+        pbft->handle_database_message(this->request_json, this->mock_session);
+        pbft->handle_database_message(this->request_json, this->mock_session);
+        ASSERT_EQ(ordered.size(), TEST_PEER_LIST.size() - 1);
+
+        // the view changes before the request commits...
+        EXPECT_CALL(*(this->mock_service), rollback_tentative_operations()).WillOnce(Return(std::vector<pbft_request>{ordered.front()}));
+        this->pbft->handle_failure();
+
+        pbft->handle_database_message(this->request_json, this->mock_session);
+        EXPECT_EQ(ordered.size(), 2 * (TEST_PEER_LIST.size() - 1));
     }
 
     TEST_F(pbft_test, dummy_pbft_service_does_not_crash)
     {
-        mock_service->query(request_msg, 0);
+        mock_service->query(request_msg);
         mock_service->consolidate_log(2);
     }
 
@@ -258,4 +568,275 @@ namespace bzn::test
         EXPECT_FALSE(pbft->is_primary());
         pbft->handle_database_message(this->request_json, this->mock_session);
     }
+
+    TEST_F(pbft_test, prepares_and_commits_use_authenticators_when_crypto_enabled)
+    {
+        this->mock_crypto = std::make_shared<NiceMock<bzn::Mockcrypto_base>>();
+
+        EXPECT_CALL(*this->mock_crypto, authenticate(_, SizeIs(TEST_PEER_LIST.size()))).Times(Exactly(2));
+        EXPECT_CALL(*this->mock_crypto, sign(_)).Times(Exactly(0));
+
+        // keys are agreed with the members once, up front, not for whoever claims to send a message...
+        EXPECT_CALL(*this->mock_crypto, set_authenticated_peers(SizeIs(TEST_PEER_LIST.size()))).Times(Exactly(1));
+
+        this->build_pbft();
+
+        pbft_msg preprepare = pbft_msg(this->preprepare_msg);
+        preprepare.set_sequence(1);
+        this->pbft->handle_message(preprepare, default_original_msg);
+
+        for (const auto& peer : TEST_PEER_LIST)
+        {
+            pbft_msg prepare = pbft_msg(preprepare);
+            prepare.set_type(PBFT_MSG_PREPARE);
+            this->pbft->handle_message(prepare, from(peer.uuid));
+        }
+    }
+
+    class pbft_query_test : public pbft_test
+    {
+    public:
+        pbft_query_test()
+        {
+            bzn_msg msg;
+            msg.mutable_db()->mutable_header()->set_db_uuid("uuid");
+            msg.mutable_db()->mutable_read()->set_key("key");
+            this->read_json["bzn-api"] = "database";
+            this->read_json["msg"] = boost::beast::detail::base64_encode(msg.SerializeAsString());
+
+            this->local_response.mutable_read()->set_key("key");
+            this->local_response.mutable_read()->set_value("value");
+
+            EXPECT_CALL(*this->mock_service, query(_)).WillRepeatedly(Invoke(
+                [&](auto)
+                {
+                    this->service_queries++;
+                    return this->local_response;
+                }));
+
+            EXPECT_CALL(*this->mock_io_context, post(_)).WillRepeatedly(Invoke([&](auto task){ this->posted.push_back(task); }));
+
+            EXPECT_CALL(*this->mock_node, send_message_str(_, _)).WillRepeatedly(Invoke(
+                [&](auto, auto wrapped_msg)
+                {
+                    pbft_msg msg = extract_pbft_msg(*wrapped_msg);
+                    if (msg.type() == PBFT_MSG_QUERY)
+                    {
+                        this->query_ids.insert(msg.query_id());
+                        this->queries_sent++;
+                    }
+                    else if (msg.type() == PBFT_MSG_QUERY_REPLY)
+                    {
+                        this->query_replies_sent++;
+                    }
+                    else if (msg.type() == PBFT_MSG_PREPREPARE)
+                    {
+                        this->preprepares_sent++;
+                    }
+                }));
+        }
+
+        void reply(const uuid_t& sender, const database_response& response)
+        {
+            ASSERT_EQ(1u, this->query_ids.size());
+
+            pbft_msg msg;
+            msg.set_type(PBFT_MSG_QUERY_REPLY);
+            msg.set_query_id(*this->query_ids.begin());
+            msg.set_query_response(response.SerializeAsString());
+            this->pbft->handle_message(msg, from(sender));
+        }
+
+        void run_posted()
+        {
+            auto tasks = std::move(this->posted);
+            this->posted.clear();
+
+            for (const auto& task : tasks)
+            {
+                task();
+            }
+        }
+
+        bzn::json_message read_json;
+        database_response local_response;
+        std::vector<bzn::asio::task> posted;
+        size_t service_queries = 0;
+        std::set<uint64_t> query_ids;
+        size_t queries_sent = 0;
+        size_t query_replies_sent = 0;
+        size_t preprepares_sent = 0;
+    };
+
+    TEST_F(pbft_query_test, read_only_request_is_executed_by_replicas_without_ordering)
+    {
+        this->build_pbft();
+        this->database_handler(this->read_json, this->mock_session);
+
+        EXPECT_EQ(TEST_PEER_LIST.size() - 1, this->queries_sent);
+        EXPECT_EQ(0u, this->preprepares_sent);
+        EXPECT_EQ(0u, this->pbft->outstanding_operations_count());
+    }
+
+    TEST_F(pbft_query_test, query_from_peer_is_not_expected_to_execute)
+    {
+        EXPECT_CALL(*this->mock_failure_detector, request_seen(_)).Times(Exactly(0));
+
+        this->build_pbft();
+
+        pbft_msg msg;
+        msg.set_type(PBFT_MSG_QUERY);
+        msg.set_view(1);
+        msg.set_query_id(7);
+        msg.mutable_request()->mutable_operation()->mutable_header()->set_db_uuid("uuid");
+        msg.mutable_request()->mutable_operation()->mutable_read()->set_key("key");
+        this->pbft->handle_message(msg, from("uuid0"));
+        this->run_posted();
+
+        // answered all the same...
+        EXPECT_EQ(1u, this->query_replies_sent);
+    }
+
+    TEST_F(pbft_query_test, query_from_non_member_is_ignored)
+    {
+        this->build_pbft();
+
+        pbft_msg msg;
+        msg.set_type(PBFT_MSG_QUERY);
+        msg.set_view(1);
+        msg.set_query_id(7);
+        msg.mutable_request()->mutable_operation()->mutable_header()->set_db_uuid("uuid");
+        msg.mutable_request()->mutable_operation()->mutable_read()->set_key("key");
+        this->pbft->handle_message(msg, from("not a swarm member"));
+        this->run_posted();
+
+        EXPECT_EQ(0u, this->service_queries);
+        EXPECT_EQ(0u, this->query_replies_sent);
+    }
+
+    TEST_F(pbft_query_test, queries_are_answered_once_pbft_lock_is_released)
+    {
+        this->build_pbft();
+
+        pbft_msg msg;
+        msg.set_type(PBFT_MSG_QUERY);
+        msg.set_view(1);
+        msg.set_query_id(7);
+        msg.mutable_request()->mutable_operation()->mutable_header()->set_db_uuid("uuid");
+        msg.mutable_request()->mutable_operation()->mutable_read()->set_key("key");
+        this->pbft->handle_message(msg, from("uuid0"));
+        this->database_handler(this->read_json, this->mock_session);
+
+        // the service may be waiting on requests being executed, so it isn't asked while handling the message...
+        EXPECT_EQ(0u, this->service_queries);
+        EXPECT_EQ(0u, this->query_replies_sent);
+
+        this->run_posted();
+
+        EXPECT_EQ(2u, this->service_queries);
+        EXPECT_EQ(1u, this->query_replies_sent);
+    }
+
+    TEST_F(pbft_query_test, quorum_of_matching_replies_is_returned_to_client)
+    {
+        std::vector<std::string> sent;
+        EXPECT_CALL(*this->mock_session, send_message(A<std::shared_ptr<std::string>>(), _)).WillRepeatedly(Invoke(
+            [&](auto msg, auto)
+            {
+                sent.push_back(*msg);
+            }));
+
+        this->build_pbft();
+        this->database_handler(this->read_json, this->mock_session);
+        this->run_posted();
+
+        // ack only...
+        EXPECT_EQ(1u, sent.size());
+
+        this->reply("uuid0", this->local_response);
+        EXPECT_EQ(1u, sent.size());
+
+        this->reply("uuid2", this->local_response);
+        ASSERT_EQ(2u, sent.size());
+        EXPECT_EQ(this->local_response.SerializeAsString(), sent.back());
+
+        // late replies are ignored...
+        this->reply("uuid3", this->local_response);
+        EXPECT_EQ(2u, sent.size());
+        EXPECT_EQ(0u, this->preprepares_sent);
+    }
+
+    TEST_F(pbft_query_test, replies_from_outside_the_swarm_are_ignored)
+    {
+        size_t sent = 0;
+        EXPECT_CALL(*this->mock_session, send_message(A<std::shared_ptr<std::string>>(), _)).WillRepeatedly(Invoke(
+            [&](auto, auto)
+            {
+                sent++;
+            }));
+
+        this->build_pbft();
+        this->database_handler(this->read_json, this->mock_session);
+        this->run_posted();
+
+        // ack only...
+        EXPECT_EQ(1u, sent);
+
+        // however many made up uuids agree...
+        for (const auto& sender : {"mallory0", "mallory1", "mallory2"})
+        {
+            this->reply(sender, this->local_response);
+        }
+
+        EXPECT_EQ(1u, sent);
+
+        this->reply("uuid0", this->local_response);
+        EXPECT_EQ(1u, sent);
+
+        this->reply("uuid2", this->local_response);
+        EXPECT_EQ(2u, sent);
+    }
+
+    TEST_F(pbft_query_test, mismatched_replies_fall_back_to_ordered_execution)
+    {
+        this->build_pbft();
+        this->database_handler(this->read_json, this->mock_session);
+        this->run_posted();
+
+        database_response other_response = this->local_response;
+        other_response.mutable_read()->set_value("stale value");
+
+        this->reply("uuid0", other_response);
+        EXPECT_EQ(0u, this->preprepares_sent);
+
+        other_response.mutable_read()->set_value("older value");
+
+        this->reply("uuid2", other_response);
+        EXPECT_EQ(TEST_PEER_LIST.size() - 1, this->preprepares_sent);
+        EXPECT_EQ(1u, this->pbft->outstanding_operations_count());
+    }
+
+    TEST_F(pbft_query_test, tentative_replies_do_not_count_towards_agreement)
+    {
+        this->local_response.set_tentative(true);
+
+        size_t sent = 0;
+        EXPECT_CALL(*this->mock_session, send_message(A<std::shared_ptr<std::string>>(), _)).WillRepeatedly(Invoke(
+            [&](auto, auto)
+            {
+                sent++;
+            }));
+
+        this->build_pbft();
+        this->database_handler(this->read_json, this->mock_session);
+        this->run_posted();
+
+        // every replica read the same state, but it may yet be rolled back...
+        this->reply("uuid0", this->local_response);
+        this->reply("uuid2", this->local_response);
+
+        EXPECT_EQ(1u, sent);
+        EXPECT_EQ(TEST_PEER_LIST.size() - 1, this->preprepares_sent);
+    }
 }
+
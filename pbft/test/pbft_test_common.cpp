@@ -53,12 +53,28 @@ namespace bzn::test
                                 }
                         ));
 
+        EXPECT_CALL(*(this->mock_node), register_for_message("metrics", _))
+                .Times(Exactly(1))
+                .WillOnce(
+                        Invoke(
+                                [&](const auto&, auto handler)
+                                {
+                                    this->metrics_handler = handler;
+                                    return true;
+                                }
+                        ));
+
         EXPECT_CALL(*(this->mock_io_context), make_unique_steady_timer())
-                .Times(AtMost(1))
+                .Times(AtMost(2))
                 .WillOnce(
                         Invoke(
                                 [&]()
                                 { return std::move(this->audit_heartbeat_timer); }
+                        ))
+                .WillOnce(
+                        Invoke(
+                                [&]()
+                                { return std::move(this->state_transfer_timer); }
                         ));
 
         EXPECT_CALL(*(this->audit_heartbeat_timer), async_wait(_))
@@ -69,6 +85,14 @@ namespace bzn::test
                                 { this->audit_heartbeat_timer_callback = handler; }
                         ));
 
+        EXPECT_CALL(*(this->state_transfer_timer), async_wait(_))
+                .Times(AnyNumber())
+                .WillRepeatedly(
+                        Invoke(
+                                [&](auto handler)
+                                { this->state_transfer_timer_callback = handler; }
+                        ));
+
         EXPECT_CALL(*(this->mock_service), register_execute_handler(_))
                 .Times(Exactly(1))
                 .WillOnce(
@@ -100,6 +124,7 @@ namespace bzn::test
                 , this->uuid
                 , this->mock_service
                 , this->mock_failure_detector
+                , this->mock_crypto
         );
         this->pbft->set_audit_enabled(false);
         this->pbft->start();
@@ -179,15 +204,19 @@ namespace bzn::test
     bool
     is_audit(std::shared_ptr<std::string> msg)
     {
-        Json::Value json;
-        Json::Reader reader;
+        bzn_envelope envelope;
 
-        if (!reader.parse(*msg, json))
-        {
-            return false;
-        }
+        return envelope.ParseFromString(*msg) && envelope.payload_case() == bzn_envelope::kAudit;
+    }
+
+    bool
+    is_audit_commit_batch(std::shared_ptr<std::string> msg)
+    {
+        bzn_envelope envelope;
+        audit_message audit;
 
-        return json["bzn-api"] == "audit";
+        return envelope.ParseFromString(*msg) && envelope.payload_case() == bzn_envelope::kAudit
+            && audit.ParseFromString(envelope.audit()) && audit.has_pbft_commit_batch();
     }
 
     bzn_envelope
@@ -201,8 +230,11 @@ namespace bzn::test
     bzn::json_message
     wrap_request(const database_msg& db)
     {
+        bzn_msg msg;
+        *msg.mutable_db() = db;
+
         bzn::json_message json;
-        json["msg"] = boost::beast::detail::base64_encode(db.SerializeAsString());
+        json["msg"] = boost::beast::detail::base64_encode(msg.SerializeAsString());
         json["bzn-api"] = "database";
 
         return json;
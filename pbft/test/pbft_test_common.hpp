@@ -28,6 +28,7 @@
 #include <mocks/mock_pbft_failure_detector.hpp>
 #include <mocks/mock_pbft_service_base.hpp>
 #include <mocks/mock_session_base.hpp>
+#include <mocks/mock_crypto_base.hpp>
 
 using namespace ::testing;
 
@@ -61,6 +62,8 @@ namespace bzn::test
         std::shared_ptr<bzn::Mocksession_base> mock_session =
                 std::make_shared<NiceMock<bzn::Mocksession_base>>();
 
+        std::shared_ptr<bzn::Mockcrypto_base> mock_crypto;
+
         std::shared_ptr<bzn::pbft> pbft;
 
         std::unique_ptr<bzn::asio::Mocksteady_timer_base> audit_heartbeat_timer =
@@ -68,9 +71,15 @@ namespace bzn::test
 
         bzn::asio::wait_handler audit_heartbeat_timer_callback;
 
+        std::unique_ptr<bzn::asio::Mocksteady_timer_base> state_transfer_timer =
+                std::make_unique<NiceMock<bzn::asio::Mocksteady_timer_base >>();
+
+        bzn::asio::wait_handler state_transfer_timer_callback;
+
         std::function<void(const pbft_request&, uint64_t)> service_execute_handler;
         bzn::protobuf_handler message_handler;
         bzn::message_handler database_handler;
+        bzn::message_handler metrics_handler;
 
         bzn::uuid_t uuid = TEST_NODE_UUID;
 
@@ -98,6 +107,7 @@ namespace bzn::test
     bool is_commit(std::shared_ptr<std::string> msg);
     bool is_checkpoint(std::shared_ptr<std::string> msg);
     bool is_audit(std::shared_ptr<std::string> msg);
+    bool is_audit_commit_batch(std::shared_ptr<std::string> msg);
 
     bzn_envelope from(uuid_t uuid);
 }
@@ -63,12 +63,14 @@ raft::raft(
         bzn::uuid_t uuid,
         const std::string state_dir, size_t maximum_raft_storage,
         bool enable_peer_validation,
-        const std::string& signed_key
+        const std::string& signed_key,
+        std::shared_ptr<bzn::crypto_base> crypto
         )
         :timer(io_context->make_unique_steady_timer())
         ,uuid(std::move(uuid))
         ,node(std::move(node))
         ,state_dir(std::move(state_dir))
+        ,crypto(std::move(crypto))
         ,enable_peer_validation(enable_peer_validation)
         ,signed_key(signed_key)
 {
@@ -405,6 +407,8 @@ raft::handle_ws_append_entries(const bzn::json_message& msg, std::shared_ptr<bzn
     // update leader's peer index
     this->peer_match_index[this->leader] = msg["data"]["commitIndex"].asUInt();
 
+    this->audit_heartbeat();
+
     this->start_election_timer();
 }
 
@@ -823,6 +827,7 @@ raft::handle_heartbeat_timeout(const boost::system::error_code& ec)
 
     this->request_append_entries();
     this->notify_leader_status();
+    this->audit_heartbeat();
 }
 
 
@@ -860,19 +865,56 @@ raft::notify_commit(size_t log_index, const std::string& operation)
         return;
     }
 
+    // audited in batches, sent every few heartbeats...
+    this->audit_commits.add_log_indexes(log_index);
+    this->audit_commits.add_operations(operation);
+
+    if (static_cast<size_t>(this->audit_commits.operations_size()) >= RAFT_AUDIT_COMMIT_BATCH_SIZE)
+    {
+        this->flush_audit_commits();
+    }
+}
+
+
+void
+raft::audit_heartbeat()
+{
+    if (++this->heartbeats_since_audit_flush >= RAFT_AUDIT_FLUSH_HEARTBEATS)
+    {
+        this->flush_audit_commits();
+    }
+}
+
+
+void
+raft::flush_audit_commits()
+{
+    this->heartbeats_since_audit_flush = 0;
+
+    if (!this->enable_audit || this->audit_commits.operations_size() == 0)
+    {
+        return;
+    }
+
     audit_message msg;
-    msg.mutable_raft_commit()->set_log_index(log_index);
-    msg.mutable_raft_commit()->set_operation(operation);
+    this->audit_commits.set_sender_uuid(this->uuid);
+    msg.mutable_raft_commit_batch()->Swap(&this->audit_commits);
 
-    auto json_ptr = std::make_shared<bzn::json_message>();
-    (*json_ptr)["bzn-api"] = "audit";
-    (*json_ptr)["audit-data"] = boost::beast::detail::base64_encode(msg.SerializeAsString());
+    bzn_envelope env;
+    env.set_audit(msg.SerializeAsString());
+    env.set_sender(this->uuid);
 
+    if (this->crypto)
+    {
+        this->crypto->sign(env);
+    }
+
+    auto encoded = std::make_shared<bzn::encoded_message>(env.SerializeAsString());
 
     for (const auto& peer : this->get_all_peers())
     {
         auto ep = boost::asio::ip::tcp::endpoint{boost::asio::ip::address_v4::from_string(peer.host), peer.port};
-        this->node->send_message(ep, json_ptr);
+        this->node->send_message_str(ep, encoded);
     }
 }
 
@@ -22,6 +22,8 @@
 #include <raft/raft_log.hpp>
 #include <storage/mem_storage.hpp>
 #include <node/node_base.hpp>
+#include <crypto/crypto_base.hpp>
+#include <proto/audit.pb.h>
 #include <gtest/gtest_prod.h>
 #include <fstream>
 #include <optional>
@@ -46,6 +48,10 @@ namespace
     const std::string ERROR_BOOTSTRAP_LIST_MUST_HAVE_MORE_THAN_ONE_PEER{"ERROR_BOOTSTRAP_LIST_MUST_HAVE_MORE_THAN_ONE_PEER"};
     const std::string ERROR_UNABLE_TO_ADD_PEER_TO_SWARM{"Unable to add this peer to the swarm. Please ensure that it is listed in peers.json."};
     const std::string ERROR_PEER_BLACKLISTED{"This node has been actively disallowed from the Bluzelle network. Please contact support@bluzelle.com."};
+
+    // commits go to the audit channel in batches, every so many heartbeats sent or received, or sooner if they pile up...
+    const size_t RAFT_AUDIT_FLUSH_HEARTBEATS = 20;
+    const size_t RAFT_AUDIT_COMMIT_BATCH_SIZE = 100;
 }
 
 
@@ -62,7 +68,8 @@ namespace bzn
                 const std::string state_dir,
                 size_t maximum_raft_storage = bzn::DEFAULT_MAX_STORAGE_SIZE,
                 bool enable_peer_validation = false,
-                const std::string& signed_key = "");
+                const std::string& signed_key = "",
+                std::shared_ptr<bzn::crypto_base> crypto = nullptr);
 
         bzn::raft_state get_state() override;
 
@@ -174,6 +181,10 @@ namespace bzn
 
         void notify_leader_status();
         void notify_commit(size_t log_index, const std::string& operation);
+
+        // count a heartbeat, sending the accumulated commits every RAFT_AUDIT_FLUSH_HEARTBEATS; needs raft_lock
+        void audit_heartbeat();
+        void flush_audit_commits();
         bzn::log_entry_type deduce_type_from_message(const bzn::json_message& message);
 
         void shutdown_on_exceeded_max_storage(bool do_throw = false);
@@ -223,6 +234,9 @@ namespace bzn
         const std::string state_dir;
 
         bool enable_audit = true;
+        raft_commit_batch audit_commits;
+        size_t heartbeats_since_audit_flush = 0;
+        std::shared_ptr<bzn::crypto_base> crypto;
 
         bool enable_peer_validation{false}; // TODO: RHN - this is only temporary, until the security functionality is tested and in use.
         std::string signed_key;
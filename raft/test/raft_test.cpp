@@ -822,6 +822,79 @@ namespace bzn
     }
 
 
+    TEST_F(raft_test, test_that_commits_are_audited_in_batches)
+    {
+        auto mock_steady_timer = std::make_unique<NiceMock<bzn::asio::Mocksteady_timer_base>>();
+
+        EXPECT_CALL(*this->mock_io_context, make_unique_steady_timer()).WillOnce(Invoke(
+            [&]()
+            { return std::move(mock_steady_timer); }));
+
+        auto raft = std::make_shared<bzn::raft>(this->mock_io_context, this->mock_node, TEST_PEER_LIST, "uuid1", TEST_STATE_DIR);
+
+        bzn::message_handler mh;
+        EXPECT_CALL(*mock_node, register_for_message("raft", _)).WillOnce(Invoke(
+            [&](const auto&, auto handler)
+            {
+                mh = handler;
+                return true;
+            }));
+
+        raft->start();
+
+        EXPECT_CALL(*this->mock_session, send_message(An<std::shared_ptr<bzn::json_message>>(), _)).Times(AnyNumber());
+        raft->register_commit_handler([](const bzn::json_message&){ return true; });
+
+        // nothing is sent per commit...
+        EXPECT_CALL(*mock_node, send_message_str(_, _)).Times(Exactly(0));
+
+        bzn::json_message entry;
+        entry["bzn-api"] = "utest";
+
+        // one that only brings us up to the leader's term, then two heartbeats that each commit an entry...
+        mh(bzn::create_append_entries_request(TEST_NODE_UUID, 2, 1, 0, 0, 0, bzn::json_message()), this->mock_session);
+        mh(bzn::create_append_entries_request(TEST_NODE_UUID, 2, 2, 0, 0, 2, entry), this->mock_session);
+        mh(bzn::create_append_entries_request(TEST_NODE_UUID, 2, 3, 1, 2, 2, entry), this->mock_session);
+
+        const auto heartbeat = bzn::create_append_entries_request(TEST_NODE_UUID, 2, 3, 2, 2, 0, bzn::json_message());
+        for (size_t i = 2; i + 1 < RAFT_AUDIT_FLUSH_HEARTBEATS; ++i)
+        {
+            mh(heartbeat, this->mock_session);
+        }
+
+        Mock::VerifyAndClearExpectations(mock_node.get());
+
+        // ... but one batch holding both goes to every peer after enough heartbeats
+        std::vector<std::shared_ptr<std::string>> batches;
+        EXPECT_CALL(*mock_node, send_message_str(_, _)).Times(Exactly(TEST_PEER_LIST.size())).WillRepeatedly(Invoke(
+            [&](auto, auto msg){ batches.push_back(msg); }));
+
+        mh(heartbeat, this->mock_session);
+
+        ASSERT_FALSE(batches.empty());
+
+        bzn_envelope envelope;
+        audit_message audit;
+        ASSERT_TRUE(envelope.ParseFromString(*batches.front()));
+        ASSERT_TRUE(audit.ParseFromString(envelope.audit()));
+        EXPECT_EQ(envelope.sender(), "uuid1");
+        EXPECT_EQ(audit.raft_commit_batch().sender_uuid(), "uuid1");
+        ASSERT_EQ(audit.raft_commit_batch().log_indexes_size(), 2);
+        EXPECT_EQ(audit.raft_commit_batch().log_indexes(0), 1u);
+        EXPECT_EQ(audit.raft_commit_batch().log_indexes(1), 2u);
+        EXPECT_EQ(audit.raft_commit_batch().operations_size(), 2);
+
+        // and it is not sent again
+        Mock::VerifyAndClearExpectations(mock_node.get());
+        EXPECT_CALL(*mock_node, send_message_str(_, _)).Times(Exactly(0));
+
+        for (size_t i = 0; i < RAFT_AUDIT_FLUSH_HEARTBEATS; ++i)
+        {
+            mh(heartbeat, this->mock_session);
+        }
+    }
+
+
     TEST(raft, test_raft_timeout_scale_can_get_set)
     {
         // none set
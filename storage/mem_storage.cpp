@@ -16,6 +16,65 @@
 
 using namespace bzn;
 
+namespace
+{
+    // FNV-1a; std::hash is not guaranteed to agree between nodes built with different standard libraries
+    size_t chunk_of(const bzn::uuid_t& uuid, const bzn::key_t& key, size_t chunk_count)
+    {
+        uint64_t hash = 14695981039346656037ull;
+
+        for (const auto& part : {uuid, key})
+        {
+            for (const unsigned char c : part)
+            {
+                hash = (hash ^ c) * 1099511628211ull;
+            }
+
+            // separate uuid from key so that ("ab", "c") and ("a", "bc") don't collide
+            hash = (hash ^ 0xff) * 1099511628211ull;
+        }
+
+        return hash % chunk_count;
+    }
+
+    void append_field(std::string& out, const std::string& field)
+    {
+        const uint32_t size = field.size();
+
+        for (size_t i = 0; i < sizeof(size); ++i)
+        {
+            out.push_back(char((size >> (8 * i)) & 0xff));
+        }
+
+        out.append(field);
+    }
+
+    bool read_field(const std::string& in, size_t& pos, std::string& field)
+    {
+        uint32_t size = 0;
+
+        if (in.size() - pos < sizeof(size))
+        {
+            return false;
+        }
+
+        for (size_t i = 0; i < sizeof(size); ++i)
+        {
+            size |= uint32_t(uint8_t(in[pos++])) << (8 * i);
+        }
+
+        if (in.size() - pos < size)
+        {
+            return false;
+        }
+
+        field = in.substr(pos, size);
+        pos += size;
+
+        return true;
+    }
+}
+
 
 storage_base::result
 mem_storage::create(const bzn::uuid_t& uuid, const std::string& key, const std::string& value)
@@ -46,6 +105,7 @@ mem_storage::create(const bzn::uuid_t& uuid, const std::string& key, const std::
     {
         // todo: test if insert failed?
         inner_db.insert(std::make_pair(key,value));
+        this->record_changed(uuid, key);
     }
     else
     {
@@ -107,6 +167,8 @@ mem_storage::update(const bzn::uuid_t& uuid, const std::string& key, const std::
     }
 
     inner_search->second = value;
+    this->record_changed(uuid, key);
+
     return storage_base::result::ok;
 }
 
@@ -131,6 +193,8 @@ mem_storage::remove(const bzn::uuid_t& uuid, const std::string& key)
     }
 
     search->second.erase(record);
+    this->record_changed(uuid, key);
+
     return storage_base::result::ok;
 }
 
@@ -190,3 +254,237 @@ mem_storage::get_size(const bzn::uuid_t& uuid)
 
     return std::make_pair(keys, size);
 }
+
+
+bool
+mem_storage::create_snapshot()
+{
+    std::lock_guard<std::shared_mutex> lock(this->lock); // lock for write access, as the changed records are taken
+    std::lock_guard<std::mutex> snapshot_guard(this->snapshot_lock);
+
+    if (!this->snapshot)
+    {
+        this->snapshot = this->kv_store;
+        this->chunk_count = 0;
+        this->snapshot_records.clear();
+        this->snapshot_chunks.clear();
+        this->changed_records.assign(1, {});
+
+        return true;
+    }
+
+    // only records written since the last snapshot are copied, and only the chunks they fall into serialized again...
+    for (size_t chunk = 0; chunk < this->changed_records.size(); ++chunk)
+    {
+        for (const auto& record : this->changed_records[chunk])
+        {
+            const bzn::value_t* value = nullptr;
+            if (auto db = this->kv_store.find(record.first); db != this->kv_store.end())
+            {
+                if (auto it = db->second.find(record.second); it != db->second.end())
+                {
+                    value = &it->second;
+                }
+            }
+
+            if (value)
+            {
+                (*this->snapshot)[record.first][record.second] = *value;
+            }
+            else if (auto snapshot_db = this->snapshot->find(record.first); snapshot_db != this->snapshot->end())
+            {
+                snapshot_db->second.erase(record.second);
+            }
+
+            if (this->chunk_count)
+            {
+                if (value)
+                {
+                    this->snapshot_records[chunk].insert(record);
+                }
+                else
+                {
+                    this->snapshot_records[chunk].erase(record);
+                }
+
+                this->snapshot_chunks[chunk] = nullptr;
+            }
+        }
+
+        this->changed_records[chunk].clear();
+    }
+
+    return true;
+}
+
+
+std::shared_ptr<std::string>
+mem_storage::get_snapshot_chunk(std::size_t chunk, std::size_t chunk_count)
+{
+    {
+        std::lock_guard<std::mutex> snapshot_guard(this->snapshot_lock);
+
+        if (!this->snapshot || chunk >= chunk_count)
+        {
+            return nullptr;
+        }
+
+        if (chunk_count == this->chunk_count)
+        {
+            return this->serialize_snapshot_chunk(chunk);
+        }
+    }
+
+    // a new split of the keyspace also moves the changed records between chunks...
+    std::lock_guard<std::shared_mutex> lock(this->lock); // lock for write access
+    std::lock_guard<std::mutex> snapshot_guard(this->snapshot_lock);
+
+    if (!this->snapshot)
+    {
+        return nullptr;
+    }
+
+    this->index_snapshot(chunk_count);
+
+    return this->serialize_snapshot_chunk(chunk);
+}
+
+
+bool
+mem_storage::load_snapshot_chunk(std::size_t chunk, std::size_t chunk_count, const std::string& data)
+{
+    if (chunk >= chunk_count)
+    {
+        return false;
+    }
+
+    std::unordered_map<bzn::uuid_t, std::unordered_map<bzn::key_t, bzn::value_t>> records;
+
+    size_t pos = 0;
+    while (pos < data.size())
+    {
+        bzn::uuid_t uuid;
+        bzn::key_t key;
+        bzn::value_t value;
+
+        if (!read_field(data, pos, uuid) || !read_field(data, pos, key) || !read_field(data, pos, value)
+            || chunk_of(uuid, key, chunk_count) != chunk)
+        {
+            LOG(error) << "malformed snapshot chunk " << chunk;
+            return false;
+        }
+
+        records[uuid][key] = std::move(value);
+    }
+
+    std::lock_guard<std::shared_mutex> lock(this->lock); // lock for write access
+    std::lock_guard<std::mutex> snapshot_guard(this->snapshot_lock);
+
+    if (this->snapshot && chunk_count == this->chunk_count)
+    {
+        // the records in the chunk are those of the snapshot and any written since, so there is no need to look
+        // through the rest...
+        std::vector<record_id> replaced(this->snapshot_records[chunk].begin(), this->snapshot_records[chunk].end());
+        replaced.insert(replaced.end(), this->changed_records[chunk].begin(), this->changed_records[chunk].end());
+
+        for (const auto& record : replaced)
+        {
+            if (auto db = this->kv_store.find(record.first); db != this->kv_store.end() && db->second.erase(record.second))
+            {
+                this->record_changed(record.first, record.second);
+            }
+        }
+    }
+    else
+    {
+        for (auto& db : this->kv_store)
+        {
+            for (auto it = db.second.begin(); it != db.second.end();)
+            {
+                if (chunk_of(db.first, it->first, chunk_count) == chunk)
+                {
+                    this->record_changed(db.first, it->first);
+                    it = db.second.erase(it);
+                }
+                else
+                {
+                    ++it;
+                }
+            }
+        }
+    }
+
+    for (auto& db : records)
+    {
+        for (auto& record : db.second)
+        {
+            this->record_changed(db.first, record.first);
+            this->kv_store[db.first][record.first] = std::move(record.second);
+        }
+    }
+
+    return true;
+}
+
+
+void
+mem_storage::record_changed(const bzn::uuid_t& uuid, const bzn::key_t& key)
+{
+    // until the first snapshot there is nothing to bring up to date...
+    if (!this->snapshot)
+    {
+        return;
+    }
+
+    this->changed_records[this->chunk_count ? chunk_of(uuid, key, this->chunk_count) : 0].emplace(uuid, key);
+}
+
+
+void
+mem_storage::index_snapshot(std::size_t chunk_count)
+{
+    this->chunk_count = chunk_count;
+    this->snapshot_records.assign(chunk_count, {});
+    this->snapshot_chunks.assign(chunk_count, nullptr);
+
+    for (const auto& db : *this->snapshot)
+    {
+        for (const auto& record : db.second)
+        {
+            this->snapshot_records[chunk_of(db.first, record.first, chunk_count)].emplace(db.first, record.first);
+        }
+    }
+
+    std::vector<std::set<record_id>> changed(chunk_count);
+    for (const auto& chunk_records : this->changed_records)
+    {
+        for (const auto& record : chunk_records)
+        {
+            changed[chunk_of(record.first, record.second, chunk_count)].insert(record);
+        }
+    }
+
+    this->changed_records = std::move(changed);
+}
+
+
+std::shared_ptr<std::string>
+mem_storage::serialize_snapshot_chunk(std::size_t chunk)
+{
+    if (!this->snapshot_chunks[chunk])
+    {
+        auto data = std::make_shared<std::string>();
+
+        // records are kept sorted, so they are serialized in the same order on every node...
+        for (const auto& record : this->snapshot_records[chunk])
+        {
+            append_field(*data, record.first);
+            append_field(*data, record.second);
+            append_field(*data, this->snapshot->at(record.first).at(record.second));
+        }
+
+        this->snapshot_chunks[chunk] = std::move(data);
+    }
+
+    return this->snapshot_chunks[chunk];
+}
@@ -15,14 +15,17 @@
 #pragma once
 
 #include <include/bluzelle.hpp>
-#include <storage/storage_base.hpp>
+#include <storage/snapshot_storage_base.hpp>
+#include <mutex>
 #include <unordered_map>
+#include <set>
 #include <shared_mutex>
+#include <vector>
 
 
 namespace bzn
 {
-    class mem_storage : public bzn::storage_base
+    class mem_storage : public bzn::snapshot_storage_base
     {
     public:
 
@@ -40,10 +43,38 @@ namespace bzn
 
         std::pair<std::size_t, std::size_t> get_size(const bzn::uuid_t& uuid) override;
 
+        bool create_snapshot() override;
+
+        std::shared_ptr<std::string> get_snapshot_chunk(std::size_t chunk, std::size_t chunk_count) override;
+
+        bool load_snapshot_chunk(std::size_t chunk, std::size_t chunk_count, const std::string& data) override;
+
     private:
+        using record_id = std::pair<bzn::uuid_t, bzn::key_t>;
+
+        // remember a record written since the last snapshot; needs lock for write access
+        void record_changed(const bzn::uuid_t& uuid, const bzn::key_t& key);
+
+        // sort the snapshot's records into chunk_count chunks; needs both locks
+        void index_snapshot(std::size_t chunk_count);
+
+        // needs snapshot_lock
+        std::shared_ptr<std::string> serialize_snapshot_chunk(std::size_t chunk);
+
         std::unordered_map<bzn::uuid_t, std::unordered_map<bzn::key_t, bzn::value_t>> kv_store;
 
         std::shared_mutex lock; // for multi-reader and single writer access
+
+        // the last snapshot, its records by chunk, and their serialized form; a chunk is only serialized again once
+        // a record in it has changed. The chunk count is that of the last chunk asked for (0 until then)...
+        std::optional<std::unordered_map<bzn::uuid_t, std::unordered_map<bzn::key_t, bzn::value_t>>> snapshot;
+        std::size_t chunk_count = 0;
+        std::vector<std::set<record_id>> snapshot_records;
+        std::vector<std::shared_ptr<std::string>> snapshot_chunks;
+        std::mutex snapshot_lock;
+
+        // records written since the last snapshot by chunk, which is all the next one has to copy
+        std::vector<std::set<record_id>> changed_records;
     };
 
 } // bzn
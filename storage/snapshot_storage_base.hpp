@@ -0,0 +1,56 @@
+// Copyright (C) 2018 Bluzelle
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU Affero General Public License, version 3,
+// as published by the Free Software Foundation.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU Affero General Public License for more details.
+//
+// You should have received a copy of the GNU Affero General Public License
+// along with this program. If not, see <http://www.gnu.org/licenses/>.
+
+#pragma once
+
+#include <storage/storage_base.hpp>
+#include <memory>
+
+
+namespace bzn
+{
+    // Storage that can serve its contents to a lagging peer in chunks. PBFT state transfer needs this, so the pbft
+    // crud only accepts storage that implements it.
+    class snapshot_storage_base : public bzn::storage_base
+    {
+    public:
+
+        /**
+         * Take a point in time copy of every database so that it can be served in chunks to a lagging peer. Only
+         * records written since the last snapshot have to be copied.
+         * @return true if a snapshot was taken
+         */
+        virtual bool create_snapshot() = 0;
+
+        /**
+         * Serialize the records of the last snapshot that fall into one chunk. Records are assigned to one of
+         * chunk_count chunks by a hash of their uuid and key, so the same record lands in the same chunk on every node.
+         * A chunk with no records changed since the last snapshot is returned as the same string as then.
+         * @param chunk         index of the chunk
+         * @param chunk_count   number of chunks the keyspace is divided into
+         * @return serialized chunk or nullptr if no snapshot has been taken
+         */
+        virtual std::shared_ptr<std::string> get_snapshot_chunk(std::size_t chunk, std::size_t chunk_count) = 0;
+
+        /**
+         * Replace every record that falls into a chunk with the records of a serialized chunk
+         * @param chunk         index of the chunk
+         * @param chunk_count   number of chunks the keyspace is divided into
+         * @param data          chunk as returned by get_snapshot_chunk
+         * @return true if the chunk was loaded
+         */
+        virtual bool load_snapshot_chunk(std::size_t chunk, std::size_t chunk_count, const std::string& data) = 0;
+    };
+
+} // bzn
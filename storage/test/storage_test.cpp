@@ -254,3 +254,165 @@ TYPED_TEST(storageTest, test_that_storage_fails_to_update_with_a_value_that_exce
     EXPECT_EQ(bzn::storage_base::result::value_too_large, this->storage->update(USER_UUID, KEY, bad_value));
     EXPECT_EQ(expected_value, *this->storage->read(USER_UUID, KEY));
 }
+
+
+TEST(mem_storage, test_that_snapshot_chunks_can_be_loaded_into_another_storage)
+{
+    const size_t CHUNK_COUNT = 8;
+
+    bzn::mem_storage source;
+    bzn::mem_storage target;
+
+    for (size_t i = 0; i < 100; ++i)
+    {
+        EXPECT_EQ(bzn::storage_base::result::ok, source.create(USER_UUID, "key" + std::to_string(i), generate_test_string()));
+    }
+
+    // stale records in target that must be replaced...
+    EXPECT_EQ(bzn::storage_base::result::ok, target.create(USER_UUID, "stale", "value"));
+
+    EXPECT_EQ(nullptr, source.get_snapshot_chunk(0, CHUNK_COUNT));
+    EXPECT_TRUE(source.create_snapshot());
+
+    // changes after the snapshot are not part of it...
+    EXPECT_EQ(bzn::storage_base::result::ok, source.create(USER_UUID, "later", "value"));
+
+    for (size_t chunk = 0; chunk < CHUNK_COUNT; ++chunk)
+    {
+        auto data = source.get_snapshot_chunk(chunk, CHUNK_COUNT);
+        ASSERT_NE(nullptr, data);
+        EXPECT_TRUE(target.load_snapshot_chunk(chunk, CHUNK_COUNT, *data));
+    }
+
+    EXPECT_FALSE(target.has(USER_UUID, "stale"));
+    EXPECT_FALSE(target.has(USER_UUID, "later"));
+    EXPECT_EQ(size_t(100), target.get_keys(USER_UUID).size());
+
+    for (size_t i = 0; i < 100; ++i)
+    {
+        EXPECT_EQ(source.read(USER_UUID, "key" + std::to_string(i)), target.read(USER_UUID, "key" + std::to_string(i)));
+    }
+
+    // identical contents serialize identically...
+    EXPECT_TRUE(target.create_snapshot());
+    for (size_t chunk = 0; chunk < CHUNK_COUNT; ++chunk)
+    {
+        EXPECT_EQ(*source.get_snapshot_chunk(chunk, CHUNK_COUNT), *target.get_snapshot_chunk(chunk, CHUNK_COUNT));
+    }
+}
+
+
+TEST(mem_storage, test_that_a_new_snapshot_replaces_the_chunks_of_the_last)
+{
+    const size_t CHUNK_COUNT = 4;
+
+    bzn::mem_storage storage;
+    EXPECT_EQ(bzn::storage_base::result::ok, storage.create(USER_UUID, "key", "value"));
+
+    EXPECT_TRUE(storage.create_snapshot());
+    std::string before;
+    for (size_t chunk = 0; chunk < CHUNK_COUNT; ++chunk)
+    {
+        before += *storage.get_snapshot_chunk(chunk, CHUNK_COUNT);
+    }
+
+    EXPECT_EQ(bzn::storage_base::result::ok, storage.update(USER_UUID, "key", "other value"));
+
+    EXPECT_TRUE(storage.create_snapshot());
+    std::string after;
+    for (size_t chunk = 0; chunk < CHUNK_COUNT; ++chunk)
+    {
+        after += *storage.get_snapshot_chunk(chunk, CHUNK_COUNT);
+    }
+
+    EXPECT_NE(before, after);
+    EXPECT_NE(std::string::npos, after.find("other value"));
+
+    // and can still be split differently...
+    EXPECT_EQ(after, *storage.get_snapshot_chunk(0, 1));
+}
+
+
+TEST(mem_storage, test_that_only_chunks_with_changes_are_serialized_again)
+{
+    const size_t CHUNK_COUNT = 8;
+
+    bzn::mem_storage storage;
+    for (size_t i = 0; i < 100; ++i)
+    {
+        EXPECT_EQ(bzn::storage_base::result::ok, storage.create(USER_UUID, "key" + std::to_string(i), "value"));
+    }
+
+    EXPECT_TRUE(storage.create_snapshot());
+    std::vector<std::shared_ptr<std::string>> before;
+    for (size_t chunk = 0; chunk < CHUNK_COUNT; ++chunk)
+    {
+        before.push_back(storage.get_snapshot_chunk(chunk, CHUNK_COUNT));
+    }
+
+    EXPECT_EQ(bzn::storage_base::result::ok, storage.update(USER_UUID, "key7", "other value"));
+
+    EXPECT_TRUE(storage.create_snapshot());
+    size_t changed = 0;
+    for (size_t chunk = 0; chunk < CHUNK_COUNT; ++chunk)
+    {
+        auto after = storage.get_snapshot_chunk(chunk, CHUNK_COUNT);
+
+        if (after != before[chunk])
+        {
+            ++changed;
+            EXPECT_NE(std::string::npos, after->find("other value"));
+        }
+    }
+
+    EXPECT_EQ(1u, changed);
+}
+
+
+TEST(mem_storage, test_that_snapshot_chunks_replace_records_written_since_the_last_snapshot)
+{
+    const size_t CHUNK_COUNT = 8;
+
+    bzn::mem_storage source;
+    bzn::mem_storage target;
+
+    for (size_t i = 0; i < 100; ++i)
+    {
+        EXPECT_EQ(bzn::storage_base::result::ok, source.create(USER_UUID, "key" + std::to_string(i), "value"));
+        EXPECT_EQ(bzn::storage_base::result::ok, target.create(USER_UUID, "key" + std::to_string(i), "stale"));
+    }
+
+    EXPECT_TRUE(source.create_snapshot());
+
+    // the target's chunks are known, but it has moved on since...
+    EXPECT_TRUE(target.create_snapshot());
+    EXPECT_NE(nullptr, target.get_snapshot_chunk(0, CHUNK_COUNT));
+    EXPECT_EQ(bzn::storage_base::result::ok, target.create(USER_UUID, "later", "value"));
+    EXPECT_EQ(bzn::storage_base::result::ok, target.remove(USER_UUID, "key1"));
+
+    for (size_t chunk = 0; chunk < CHUNK_COUNT; ++chunk)
+    {
+        EXPECT_TRUE(target.load_snapshot_chunk(chunk, CHUNK_COUNT, *source.get_snapshot_chunk(chunk, CHUNK_COUNT)));
+    }
+
+    EXPECT_FALSE(target.has(USER_UUID, "later"));
+    EXPECT_EQ(size_t(100), target.get_keys(USER_UUID).size());
+
+    EXPECT_TRUE(target.create_snapshot());
+    for (size_t chunk = 0; chunk < CHUNK_COUNT; ++chunk)
+    {
+        EXPECT_EQ(*source.get_snapshot_chunk(chunk, CHUNK_COUNT), *target.get_snapshot_chunk(chunk, CHUNK_COUNT));
+    }
+}
+
+
+TEST(mem_storage, test_that_malformed_snapshot_chunk_is_rejected)
+{
+    bzn::mem_storage storage;
+
+    EXPECT_EQ(bzn::storage_base::result::ok, storage.create(USER_UUID, KEY, value));
+
+    EXPECT_FALSE(storage.load_snapshot_chunk(0, 1, "garbage"));
+    EXPECT_FALSE(storage.load_snapshot_chunk(1, 1, ""));
+    EXPECT_EQ(value, *storage.read(USER_UUID, KEY));
+}
@@ -23,6 +23,7 @@
 #include <ethereum/ethereum.hpp>
 #include <http/server.hpp>
 #include <node/node.hpp>
+#include <node/reactor_pool.hpp>
 #include <options/options.hpp>
 #include <options/simple_options.hpp>
 #include <pbft/pbft.hpp>
@@ -207,17 +208,39 @@ main(int argc, const char* argv[])
         if (!init_peers(peers, options->get_bootstrap_peers_file(), options->get_bootstrap_peers_url()))
             throw std::runtime_error("Bootstrap peers initialization failed.");
 
-        auto io_context = std::make_shared<bzn::asio::io_context>();
+        // with reactors, everything but the listeners and their sessions runs on the consensus reactor...
+        std::shared_ptr<bzn::reactor_pool> reactors;
+        std::vector<std::shared_ptr<bzn::asio::io_context_base>> network_reactors;
+        std::shared_ptr<bzn::asio::io_context_base> io_context;
+
+        if (auto count = options->get_simple_options().get<size_t>(bzn::option_names::IO_REACTORS))
+        {
+            reactors = std::make_shared<bzn::reactor_pool>(count);
+            network_reactors = reactors->get_network_reactors();
+            io_context = reactors->get_consensus_reactor();
+        }
+        else
+        {
+            io_context = std::make_shared<bzn::asio::io_context>();
+        }
 
         // setup signal handler...
         boost::asio::signal_set signals(io_context->get_io_context(), SIGINT, SIGTERM);
 
-        signals.async_wait([io_context](const boost::system::error_code& error, int signal_number)
+        signals.async_wait([io_context, reactors](const boost::system::error_code& error, int signal_number)
             {
                 if (!error)
                 {
                     LOG(info) << "signal received -- shutting down (" << signal_number << ")";
-                    io_context->stop();
+
+                    if (reactors)
+                    {
+                        reactors->stop();
+                    }
+                    else
+                    {
+                        io_context->stop();
+                    }
                 }
             });
 
@@ -225,7 +248,8 @@ main(int argc, const char* argv[])
         auto crypto = std::make_shared<bzn::crypto>(options);
         auto chaos = std::make_shared<bzn::chaos>(io_context, options);
         auto websocket = std::make_shared<bzn::beast::websocket>();
-        auto node = std::make_shared<bzn::node>(io_context, websocket, chaos, options->get_ws_idle_timeout(), boost::asio::ip::tcp::endpoint{options->get_listener()}, crypto, options);
+        auto node = std::make_shared<bzn::node>(io_context, websocket, chaos, options->get_ws_idle_timeout(), boost::asio::ip::tcp::endpoint{options->get_listener()}, crypto, options,
+            network_reactors);
         auto audit = std::make_shared<bzn::audit>(io_context, node, options->get_monitor_endpoint(io_context), options->get_uuid(), options->get_audit_mem_size(), options->pbft_enabled());
         std::shared_ptr<bzn::status> status;
 
@@ -239,7 +263,8 @@ main(int argc, const char* argv[])
 
         if (options->pbft_enabled())
         {
-            auto failure_detector = std::make_shared<bzn::pbft_failure_detector>(io_context);
+            auto failure_detector = std::make_shared<bzn::pbft_failure_detector>(io_context,
+                std::lround(CHECKPOINT_INTERVAL*HIGH_WATER_INTERVAL_IN_CHECKPOINTS));
 
             // todo: for now use mem storage instead of rocksdb...
             auto unstable_storage = std::make_shared<bzn::mem_storage>();
@@ -247,11 +272,15 @@ main(int argc, const char* argv[])
             auto crud = std::make_shared<bzn::crud>(stable_storage, std::make_shared<bzn::subscription_manager>(io_context));
 
             auto pbft = std::make_shared<bzn::pbft>(node, io_context, peers.get_peers(), options->get_uuid(),
-                std::make_shared<bzn::database_pbft_service>(io_context, unstable_storage, crud, options->get_uuid()), failure_detector);
+                std::make_shared<bzn::database_pbft_service>(io_context, unstable_storage, crud, options->get_uuid(),
+                    options->get_simple_options().get<size_t>(bzn::option_names::PBFT_EXECUTION_THREADS)), failure_detector,
+                options->get_simple_options().get<bool>(bzn::option_names::CRYPTO_ENABLED_OUTGOING) ? crypto : nullptr);
 
             pbft->set_audit_enabled(options->get_simple_options().get<bool>(bzn::option_names::AUDIT_ENABLED));
+            pbft->set_tentative_execution_enabled(options->get_simple_options().get<bool>(bzn::option_names::PBFT_TENTATIVE_EXECUTION));
+            pbft->set_max_clients(options->get_simple_options().get<size_t>(bzn::option_names::PBFT_MAX_CLIENTS));
 
-            status = std::make_shared<bzn::status>(node, bzn::status::status_provider_list_t{pbft}, true);
+            status = std::make_shared<bzn::status>(node, bzn::status::status_provider_list_t{pbft, node}, true);
 
             crud->start();
             pbft->start();
@@ -266,7 +295,8 @@ main(int argc, const char* argv[])
             auto raft = std::make_shared<bzn::raft>(
                     io_context, node, peers.get_peers(),
                     options->get_uuid(), options->get_state_dir(), options->get_max_storage(),
-                    options->peer_validation_enabled(), options->get_signed_key());
+                    options->peer_validation_enabled(), options->get_signed_key(),
+                    options->get_simple_options().get<bool>(bzn::option_names::CRYPTO_ENABLED_OUTGOING) ? crypto : nullptr);
 
             // which type of storage?
             std::shared_ptr<bzn::storage_base> storage;
@@ -283,8 +313,8 @@ main(int argc, const char* argv[])
             }
 
             auto crud = std::make_shared<bzn::raft_crud>(node, raft, storage, std::make_shared<bzn::subscription_manager>(io_context));
-            auto http_server = std::make_shared<bzn::http::server>(io_context, crud, ep);
-            status = std::make_shared<bzn::status>(node, bzn::status::status_provider_list_t{raft}, false);
+            auto http_server = std::make_shared<bzn::http::server>(io_context, crud, ep, network_reactors);
+            status = std::make_shared<bzn::status>(node, bzn::status::status_provider_list_t{raft, node}, false);
 
             raft->set_audit_enabled(options->get_simple_options().get<bool>(bzn::option_names::AUDIT_ENABLED));
 
@@ -299,7 +329,14 @@ main(int argc, const char* argv[])
         
         print_banner(*options, eth_balance);
 
-        start_worker_threads_and_wait(io_context);
+        if (reactors)
+        {
+            reactors->run();
+        }
+        else
+        {
+            start_worker_threads_and_wait(io_context);
+        }
     }
     catch(std::exception& ex)
     {